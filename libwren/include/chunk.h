@@ -1,24 +1,184 @@
 #pragma once
 #include "value.h"
 #include "opcode.h"
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <string>
 
+// ============================================
+// CONSTANT TABLE
+// ============================================
+// Pool de constantes de um chunk. add() devolve o índice de uma constante
+// igual que já lá esteja (índice por hash): os `1` de cada i++ e as strings
+// repetidas ocupam um só slot. Igualdade exata: strings internadas por
+// ponteiro, doubles por bits, 1 e 1.0 diferentes.
+//
+// Várias funções podem usar a mesma tabela (share, e cópias da tabela):
+// é assim que o compiler dá uma só pool a um módulo inteiro.
+class ConstantTable
+{
+public:
+    ConstantTable();
+
+    const Value &operator[](size_t index) const { return storage_->values[index]; }
+    size_t size() const { return storage_->values.size(); }
+
+    // Para o loop do interpretador guardar por frame: só a compilação faz
+    // crescer a pool, por isso o ponteiro não muda enquanto se executa
+    const Value *data() const { return storage_->values.data(); }
+
+    int add(const Value &value);
+
+    // -1 se ainda não está na tabela
+    int find(const Value &value) const;
+
+    // Passa a usar a tabela de other (a pool própria é descartada)
+    void share(const ConstantTable &other) { storage_ = other.storage_; }
+    bool isSharedWith(const ConstantTable &other) const { return storage_ == other.storage_; }
+
+private:
+    struct Key
+    {
+        uint64_t bits;
+        int type;
+        bool operator==(const Key &other) const { return bits == other.bits && type == other.type; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+    struct Storage
+    {
+        std::vector<Value> values;
+        std::unordered_map<Key, int, KeyHash> index;
+    };
+
+    static Key keyOf(const Value &value);
+
+    std::shared_ptr<Storage> storage_;
+};
+
+// ============================================
+// LINE TABLE
+// ============================================
+// Linha de origem de cada byte do código, guardada por runs: um run por
+// sequência de bytes da mesma linha em vez de um int por byte. Só se lê
+// em erros e no disassembler; lineAt faz pesquisa binária.
+class LineTable
+{
+public:
+    LineTable() : count_(0) {}
+
+    // A linha do byte seguinte
+    void add(int line)
+    {
+        if (runs_.empty() || runs_.back().line != line)
+        {
+            LineRun run = {(int)count_, line};
+            runs_.push_back(run);
+        }
+        count_++;
+    }
+
+    int lineAt(size_t offset) const;
+
+    // Bytes cobertos (igual a code.size() no chunk)
+    size_t size() const { return count_; }
+    size_t runCount() const { return runs_.size(); }
+
+    void truncate(size_t count);
+    void clear()
+    {
+        runs_.clear();
+        count_ = 0;
+    }
+    void swap(LineTable &other)
+    {
+        runs_.swap(other.runs_);
+        std::swap(count_, other.count_);
+    }
+
+private:
+    struct LineRun
+    {
+        int start; // offset do primeiro byte do run
+        int line;
+    };
+
+    std::vector<LineRun> runs_;
+    size_t count_;
+};
+
+// ============================================
+// SWITCH TABLE
+// ============================================
+// Destinos de um OP_SWITCH (offsets absolutos no código do chunk). Os
+// ints contíguos vão num vetor indexado por valor - low (os buracos
+// apontam para o default), os outros ints e as strings num hash; as
+// strings são internadas, por isso a chave é o ponteiro.
+struct SwitchTable
+{
+    int low;
+    std::vector<int> dense;
+    std::unordered_map<int, int> ints;
+    std::unordered_map<const char *, int> strings;
+    int defaultTarget;
+
+    SwitchTable() : low(0), defaultTarget(0) {}
+
+    int targetOf(const Value &value) const;
+
+    // Cada destino, default incluído (verifier e optimizer)
+    template <typename F>
+    void forEachTarget(F f)
+    {
+        for (int &target : dense)
+            f(target);
+        for (std::unordered_map<int, int>::value_type &entry : ints)
+            f(entry.second);
+        for (std::unordered_map<const char *, int>::value_type &entry : strings)
+            f(entry.second);
+        f(defaultTarget);
+    }
+
+    template <typename F>
+    void forEachTarget(F f) const
+    {
+        for (int target : dense)
+            f(target);
+        for (const std::unordered_map<int, int>::value_type &entry : ints)
+            f(entry.second);
+        for (const std::unordered_map<const char *, int>::value_type &entry : strings)
+            f(entry.second);
+        f(defaultTarget);
+    }
+};
+
 struct Chunk
 {
     std::vector<uint8_t> code;
-    std::vector<Value> constants;
-    std::vector<int> lines;
+    ConstantTable constants;
+    LineTable lines;
+    std::vector<SwitchTable> switches; // indexadas pelo operando do OP_SWITCH
     Chunk();
 
     const char* getStringPtr(size_t index) const ;
     
     void write(uint8_t byte, int line);
+    // Reaproveita uma constante igual (ver ConstantTable)
     int addConstant(Value value);
 
+    // Descarta o código a partir de `offset` (usado pelo peephole do compiler)
+    void truncate(size_t offset);
+
     size_t count() const { return code.size(); }
 };
 
+struct JitCode;
+struct LoopState;
+
 struct Function
 {
     int arity;
@@ -26,5 +186,34 @@ struct Function
     std::string name;
     bool hasReturn;
 
+    // O global com o nome da função foi reatribuído: as calls diretas
+    // (OP_CALL_DIRECT) deixam de poder assumir que o callee é esta função
+    bool rebound;
+
+    // Altura máxima da stack do frame (slot 0 e parâmetros incluídos),
+    // calculada pelo Verifier; -1 enquanto a função não foi verificada
+    int maxStack;
+
+    // Versão register do mesmo código (vazia se não foi possível gerar).
+    // Partilha as constantes do chunk.
+    std::vector<uint8_t> regCode;
+    LineTable regLines;
+    int regCount;
+
+    bool hasRegisterCode() const { return !regCode.empty(); }
+
+    // JIT: calls e iterações de loop contam para hotness; ao passar o
+    // limiar a VM gera código nativo (nullptr enquanto não houver)
+    int hotness;
+    JitCode *jit;
+
+    // Tracing JIT: um estado por cabeça de loop (destino de OP_LOOP),
+    // criado à primeira passagem; o endereço é estável
+    std::vector<LoopState *> loops;
+
     Function(const std::string &n = "<script>", int a = 0);
+    ~Function();
+
+    Function(const Function &) = delete;
+    Function &operator=(const Function &) = delete;
 };
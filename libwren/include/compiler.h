@@ -2,6 +2,7 @@
 
 #include "lexer.h"
 #include "chunk.h"
+#include "optimizer.h"
 #include "value.h"
 #include <string>
 #include <vector>
@@ -35,7 +36,7 @@ struct ParseRule
 };
 
 #define MAX_IDENTIFIER_LENGTH 32
-#define MAX_LOCALS 256
+#define MAX_LOCALS 65536
 
 struct Local
 {
@@ -72,14 +73,18 @@ struct Local
 #define MAX_LOOP_DEPTH 32
 #define MAX_BREAKS_PER_LOOP 256
 
+// loopStart < 0: o destino do continue ainda não existe (o OP_FOR_LOOP
+// sai depois do corpo) e os continues ficam em continueJumps
 struct LoopContext
 {
     int loopStart;
     int breakJumps[MAX_BREAKS_PER_LOOP];
     int breakCount;
+    int continueJumps[MAX_BREAKS_PER_LOOP];
+    int continueCount;
     int scopeDepth;
 
-    LoopContext() : loopStart(0), breakCount(0), scopeDepth(0) {}
+    LoopContext() : loopStart(0), breakCount(0), continueCount(0), scopeDepth(0) {}
 
     bool addBreak(int jump)
     {
@@ -91,9 +96,64 @@ struct LoopContext
         breakJumps[breakCount++] = jump;
         return true;
     }
+
+    bool addContinue(int jump)
+    {
+        if (continueCount >= MAX_BREAKS_PER_LOOP)
+        {
+            return false;
+        }
+        continueJumps[continueCount++] = jump;
+        return true;
+    }
+};
+
+// for (var i = a; i < b; i++) reconhecido pelo forStatement: o limite é
+// um slot ou um literal (limitOp PUSH_INT/CONSTANT e o seu operando)
+struct CountedFor
+{
+    uint8_t counter;
+    uint8_t compare;
+    uint8_t limitOp;
+    int limitArg;
+    int16_t step;
 };
 
-#define MAX_LOCALS 256
+// case com valor literal (int ou string): vai para a tabela do OP_SWITCH
+struct SwitchCase
+{
+    Value value;
+    int target; // início do corpo
+};
+
+// Offsets das últimas instruções candidatas a superinstrução.
+// -1 = nenhuma. lastJumpTarget guarda o último destino de salto
+// (patchJump): nunca se funde um grupo que tenha um destino lá dentro.
+struct Peephole
+{
+    int lastGetLocal;
+    int prevGetLocal;
+    int lastConstant;
+    int lastPushInt;
+    int lastCompare;
+    int lastCall;
+    int lastJumpTarget;
+
+    Peephole() { reset(); }
+
+    void reset()
+    {
+        lastGetLocal = -1;
+        prevGetLocal = -1;
+        lastConstant = -1;
+        lastPushInt = -1;
+        lastCompare = -1;
+        lastCall = -1;
+        lastJumpTarget = 0;
+    }
+};
+
+#define MAX_LOCALS 65536
 class Compiler
 {
 public:
@@ -118,12 +178,18 @@ private:
     bool panicMode;
 
     int scopeDepth;
-    Local locals_[MAX_LOCALS];
+    std::vector<Local> locals_; // cresce até MAX_LOCALS
     int localCount_;
   
     LoopContext loopContexts_[MAX_LOOP_DEPTH];
     int loopDepth_;
 
+    Peephole peephole_;
+
+    // Saltos para a frente com mais de 64KB: o optimizer codifica-os
+    // na forma larga (ver optimizeBytecode)
+    std::vector<FarJump> farJumps_;
+
     // Token management
     void advance();
     bool check(TokenType type);
@@ -133,6 +199,7 @@ private:
     void beginLoop(int loopStart);
     void endLoop();
     void emitBreak();
+    void popLocalsAbove(int depth);
     void emitContinue();
 
     void breakStatement();
@@ -149,9 +216,17 @@ private:
     void emitBytes(uint8_t byte1, uint8_t byte2);
     void emitReturn();
     void emitConstant(Value value);
-    uint8_t makeConstant(Value value);
+    int makeConstant(Value value);
+    int16_t pushedInt(int offset) const;
+
+    // Superinstructions
+    void emitArith(uint8_t op);
+    void emitCompare(uint8_t op);
+    bool canFuse(int groupStart) const;
+    void rewindTo(int offset);
 
     int emitJump(uint8_t instruction);
+    int emitConditionJump();
     void patchJump(int offset);
     void emitLoop(int loopStart);
 
@@ -186,7 +261,12 @@ private:
     void doWhileStatement();
     void loopStatement();
     void switchStatement();
+    bool caseConstant(int start, Value &value) const;
+    void finishSwitch(int operand, const std::vector<SwitchCase> &cases, int defaultTarget);
     void forStatement();
+    bool countedCondition(int start, CountedFor &loop);
+    bool countedIncrement(int start, CountedFor &loop);
+    void countedFor(const CountedFor &loop);
     void returnStatement();
     void block();
 
@@ -194,11 +274,16 @@ private:
     void prefixDecrement(bool canAssign);
 
     // Variables
-    uint8_t identifierConstant(Token &name);
+    uint16_t globalSlot(Token &name);
+    void emitVariable(uint8_t op, int arg);
     void namedVariable(Token &name, bool canAssign);
-    void defineVariable(uint8_t global);
+    bool stepLocal(uint8_t getOp, int arg, int valueStart, uint8_t step);
+    void defineVariable(uint16_t global);
     void declareVariable();
     void addLocal(Token &name);
+    void reserveCalleeSlot();
+    void optimizeBytecode(Function *fn);
+    void verifyBytecode(Function *fn);
     int resolveLocal(Token &name);
     void markInitialized();
 
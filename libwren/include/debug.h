@@ -7,9 +7,19 @@ public:
     static void disassembleChunk(const Chunk &chunk, const char *name);
     static int disassembleInstruction(const Chunk &chunk, int offset);
 
+    // Formato register (Function::regCode)
+    static void disassembleRegisterCode(const Function &function);
+    static int disassembleRegisterInstruction(const Function &function, int offset);
+
 private:
     static int simpleInstruction(const char *name, int offset);
     static int constantInstruction(const char *name, const Chunk &chunk, int offset);
     static int byteInstruction(const char *name, const Chunk &chunk, int offset);
+    static int shortInstruction(const char *name, const Chunk &chunk, int offset);
     static int jumpInstruction(const char *name, int sign, const Chunk &chunk, int offset);
+    static int longJumpInstruction(const char *name, int sign, const Chunk &chunk, int offset);
+    static int immediateInstruction(const char *name, const Chunk &chunk, int offset);
+    static int immediateJumpInstruction(const char *name, const Chunk &chunk, int offset);
+    static int forInstruction(const char *name, const Chunk &chunk, int offset);
+    static int switchInstruction(const char *name, const Chunk &chunk, int offset);
 };
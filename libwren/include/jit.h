@@ -0,0 +1,65 @@
+#pragma once
+#include "chunk.h"
+#include <vector>
+
+// ============================================
+// JIT BASELINE (x86-64 Linux)
+// ============================================
+// Funções quentes (calls + iterações de loops) passam a código nativo
+// montado a partir de stencils por opcode: cada instrução do bytecode de
+// stack é um bloco de máquina pré-escrito, copiado e remendado com os
+// operandos (slots, constantes, destinos de salto).
+//
+// O código nativo usa a mesma stack e os mesmos slots que o interpretador,
+// por isso pode entrar e sair em qualquer instrução. Só os casos rápidos
+// (ints, locais, globais definidas, saltos) ficam em nativo; calls,
+// returns, doubles, strings e erros saem para o interpretador na própria
+// instrução, que a executa e volta a entrar no fim da call ou no OP_LOOP.
+//
+// -DWREN_JIT=0 (opção do CMake) desliga tudo; noutras plataformas o
+// compile devolve sempre nullptr e a VM só interpreta.
+
+#ifndef WREN_JIT
+#define WREN_JIT 1
+#endif
+
+#if WREN_JIT && defined(__x86_64__) && defined(__linux__)
+#define WREN_JIT_ENABLED 1
+#else
+#define WREN_JIT_ENABLED 0
+#endif
+
+typedef uint8_t *(*JitEntry)(Value *slots, Value *sp, void *globals,
+                             const uint8_t *target, Value **spOut);
+
+struct JitCode
+{
+    uint8_t *memory;
+    size_t size;
+    JitEntry entry;
+    const uint8_t *bytecode;         // chunk.code.data() da função
+    std::vector<uint32_t> offsets;   // offset do bytecode -> offset nativo
+};
+
+class Jit
+{
+public:
+    // Calls + iterações de loop até a função ser compilada
+    static const int HOT_THRESHOLD = 200;
+
+    // Conforme a libwren foi compilada (não quem inclui este header)
+    static bool isAvailable();
+
+    // nullptr se a plataforma não tem JIT ou a memória falhou
+    static JitCode *compile(Function *function, bool perfMap);
+    static void release(JitCode *code);
+
+    // Corre a partir de ip até uma instrução que o JIT não trata e devolve
+    // o ip dela; sp entra e sai com o topo da stack
+    static inline uint8_t *run(JitCode *code, uint8_t *ip, Value *slots,
+                               Value *&sp, void *globals)
+    {
+        const uint8_t *target = code->memory + code->offsets[ip - code->bytecode];
+        return code->entry(slots, sp, globals, target, &sp);
+    }
+};
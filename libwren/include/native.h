@@ -1,31 +1,44 @@
 #pragma once
 #include "value.h"
-#include <functional>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class VM;
 
-using NativeFunction = std::function<Value(VM *, int, Value *)>;
+// Ponteiro simples (sem std::function): userdata é o que foi passado
+// ao registar, para natives que precisam de estado do host
+using NativeFunction = Value (*)(VM *vm, int argCount, Value *args, void *userdata);
 
 struct NativeFn
 {
     std::string name;
     int arity;
     NativeFunction function;
+    void *userdata;
 
-    NativeFn(const std::string &n, int a, NativeFunction fn)
-        : name(n), arity(a), function(fn) {}
+    NativeFn(const std::string &n, int a, NativeFunction fn, void *data)
+        : name(n), arity(a), function(fn), userdata(data) {}
 };
 
+// Natives ficam num vetor: o compiler resolve o nome para um índice e o
+// OP_CALL_NATIVE só indexa. O mapa por nome é usado só a compilar.
 class NativeRegistry
 {
 public:
-    void registerFunction(const std::string &name, int arity, NativeFunction fn);
+    static const int MAX_NATIVES = 256; // índice cabe num byte
+
+    int registerFunction(const std::string &name, int arity, NativeFunction fn,
+                         void *userdata = nullptr);
+    int getIndex(const std::string &name) const;
     NativeFn *getFunction(const std::string &name);
+    NativeFn &get(int index) { return functions_[index]; }
     bool hasFunction(const std::string &name) const;
+    int count() const { return (int)functions_.size(); }
     void registerBuiltins();
 
 private:
-    std::unordered_map<std::string, NativeFn> functions_;
+    std::vector<NativeFn> functions_;
+    std::unordered_map<std::string, int> indices_;
 };
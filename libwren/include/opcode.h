@@ -43,14 +43,181 @@ enum Opcode : uint8_t
     // Control flow
     OP_JUMP,
     OP_JUMP_IF_FALSE,
+    OP_JUMP_IF_TRUE, // [hi][lo] espreita e salta se truthy (gerado pelo optimizer)
     OP_LOOP,
 
     // Functions
     OP_CALL,
-    OP_CALL_NATIVE,
+    OP_TAIL_CALL, // [argc] return f(...): reutiliza o frame atual
+    OP_CALL_DIRECT,      // [argc] callee é um def conhecido (sem type check)
+    OP_TAIL_CALL_DIRECT, // [argc]
+    OP_CALL_NATIVE, // [native][argc] índice no NativeRegistry
     OP_RETURN,
     OP_RETURN_NIL,
 
     // I/O
     OP_PRINT,
+
+    // Quickened: a VM reescreve OP_ADD/OP_LESS/... in place depois de ver
+    // os tipos dos operandos. Se o guard falhar, volta à forma genérica.
+    OP_ADD_INT,
+    OP_ADD_DOUBLE,
+    OP_ADD_STRING,
+    OP_SUBTRACT_INT,
+    OP_SUBTRACT_DOUBLE,
+    OP_MULTIPLY_INT,
+    OP_MULTIPLY_DOUBLE,
+    OP_EQUAL_INT,
+    OP_NOT_EQUAL_INT,
+    OP_GREATER_INT,
+    OP_GREATER_DOUBLE,
+    OP_GREATER_EQUAL_INT,
+    OP_GREATER_EQUAL_DOUBLE,
+    OP_LESS_INT,
+    OP_LESS_DOUBLE,
+    OP_LESS_EQUAL_INT,
+    OP_LESS_EQUAL_DOUBLE,
+
+    // Superinstructions (emitidas pelo compiler)
+    OP_ADD_LOCALS,     // [a][b]    push(slots[a] + slots[b])
+    OP_ADD_CONST,      // [k]       top = top + constants[k]
+    OP_SUBTRACT_CONST, // [k]       top = top - constants[k]
+    OP_INC_LOCAL,      // [a]       slots[a] += 1 (stack intacta)
+    OP_DEC_LOCAL,      // [a]       slots[a] -= 1
+
+    // Intrinsics: builtins que o compiler baixa para opcodes quando o
+    // nome não está tapado por um local (mesma semântica que as natives)
+    OP_SQRT, // top = sqrt(top)
+    OP_ABS,  // top = abs(top)
+    OP_POW,  // pow(a, b)
+    OP_LEN,  // top = len(top)
+    OP_STR,  // top = str(top)
+
+    // Formas largas: o compiler só as usa quando o operando não cabe na
+    // forma curta (os globais já são u16 em todas as formas)
+    OP_CONSTANT_LONG,      // [k2][k1][k0] índice u24
+    OP_GET_LOCAL_LONG,     // [hi][lo]     slot u16
+    OP_SET_LOCAL_LONG,     // [hi][lo]
+    OP_JUMP_LONG,          // [b2][b1][b0] offset u24
+    OP_JUMP_IF_FALSE_LONG, // [b2][b1][b0]
+    OP_JUMP_IF_TRUE_LONG,  // [b2][b1][b0]
+    OP_LOOP_LONG,          // [b2][b1][b0]
+
+    // Imediatos: um int16 no próprio bytecode, sem ir à pool de constantes
+    OP_PUSH_INT,     // [i1][i0]  push(imm)
+    OP_ADD_IMM,      // [i1][i0]  top = top + imm
+    OP_SUBTRACT_IMM, // [i1][i0]  top = top - imm
+
+    // Condições de if/while/for: os operandos saem da stack e salta-se se
+    // a condição for falsa (nem bool na stack nem POP em cada ramo).
+    // Os compares seguem a ordem de OP_EQUAL..OP_LESS_EQUAL.
+    OP_POP_JUMP_IF_FALSE,             // [hi][lo]          pop c, salta se !c
+    OP_JUMP_IF_NOT_EQUAL,             // [hi][lo]          pop a b, salta se !(a == b)
+    OP_JUMP_IF_EQUAL,                 // [hi][lo]          pop a b, salta se !(a != b)
+    OP_JUMP_IF_NOT_GREATER,           // [hi][lo]          pop a b, salta se !(a > b)
+    OP_JUMP_IF_NOT_GREATER_EQUAL,     // [hi][lo]
+    OP_JUMP_IF_NOT_LESS,              // [hi][lo]
+    OP_JUMP_IF_NOT_LESS_EQUAL,        // [hi][lo]
+    OP_JUMP_IF_NOT_EQUAL_IMM,         // [i1][i0][hi][lo]  pop a, salta se !(a == imm)
+    OP_JUMP_IF_EQUAL_IMM,             // [i1][i0][hi][lo]
+    OP_JUMP_IF_NOT_GREATER_IMM,       // [i1][i0][hi][lo]
+    OP_JUMP_IF_NOT_GREATER_EQUAL_IMM, // [i1][i0][hi][lo]
+    OP_JUMP_IF_NOT_LESS_IMM,          // [i1][i0][hi][lo]
+    OP_JUMP_IF_NOT_LESS_EQUAL_IMM,    // [i1][i0][hi][lo]
+    OP_POP_JUMP_IF_FALSE_LONG,        // [b2][b1][b0]
+
+    // for (var i = a; i < b; i++): contador e limite em slots, passo int16.
+    // [c] e [l] são slots, [op] o compare (OP_GREATER..OP_LESS_EQUAL).
+    OP_FOR_PREP,      // [c][l][op][hi][lo]          salta para a frente se !(c op l)
+    OP_FOR_LOOP,      // [c][l][op][s1][s0][hi][lo]  c += s, volta atrás se c op l
+    OP_FOR_PREP_LONG, // [c][l][op][b2][b1][b0]
+    OP_FOR_LOOP_LONG, // [c][l][op][s1][s0][b2][b1][b0]
+
+    // switch com cases constantes: salta pela tabela [t] do chunk
+    // (Chunk::switches) conforme o valor no topo, que fica na stack
+    OP_SWITCH, // [t1][t0]
+};
+
+// Salto de condição para um compare (OP_EQUAL..OP_LESS_EQUAL)
+inline uint8_t conditionBranch(uint8_t compare, bool immediate)
+{
+    return (uint8_t)((immediate ? OP_JUMP_IF_NOT_EQUAL_IMM : OP_JUMP_IF_NOT_EQUAL) +
+                     (compare - OP_EQUAL));
+}
+
+inline bool isCompareBranch(uint8_t op)
+{
+    return op >= OP_JUMP_IF_NOT_EQUAL && op <= OP_JUMP_IF_NOT_LESS_EQUAL_IMM;
+}
+
+inline bool isImmediateBranch(uint8_t op)
+{
+    return op >= OP_JUMP_IF_NOT_EQUAL_IMM && op <= OP_JUMP_IF_NOT_LESS_EQUAL_IMM;
+}
+
+// O compare cuja falsidade faz saltar um isCompareBranch
+inline uint8_t branchCompare(uint8_t op)
+{
+    return (uint8_t)(OP_EQUAL + (op - (isImmediateBranch(op) ? OP_JUMP_IF_NOT_EQUAL_IMM
+                                                              : OP_JUMP_IF_NOT_EQUAL)));
+}
+
+// ============================================
+// FORMATO REGISTER
+// ============================================
+// Três endereços sobre os slots do frame (registos = slots, u8).
+// Gerado a partir do bytecode de stack (ver regcompiler.h) e corrido
+// por VM::executeRegister. Saltos usam offset absoluto u16.
+enum RegOpcode : uint8_t
+{
+    R_MOVE,        // dst src
+    R_LOADK,       // dst k
+    R_LOADNIL,     // dst
+    R_LOADTRUE,    // dst
+    R_LOADFALSE,   // dst
+
+    R_ADD,         // dst a b
+    R_SUBTRACT,    // dst a b
+    R_MULTIPLY,    // dst a b
+    R_DIVIDE,      // dst a b
+    R_MODULO,      // dst a b
+    R_ADDK,        // dst a k
+    R_SUBTRACTK,   // dst a k
+    R_NEGATE,      // dst src
+    R_NOT,         // dst src
+    R_INC,         // reg
+    R_DEC,         // reg
+
+    R_EQUAL,         // dst a b
+    R_NOT_EQUAL,     // dst a b
+    R_GREATER,       // dst a b
+    R_GREATER_EQUAL, // dst a b
+    R_LESS,          // dst a b
+    R_LESS_EQUAL,    // dst a b
+
+    R_GET_GLOBAL,    // dst k
+    R_SET_GLOBAL,    // src k
+    R_DEFINE_GLOBAL, // src k
+
+    R_JUMP,                  // [hi][lo]
+    R_JUMP_IF_FALSE,         // src [hi][lo]
+    R_JUMP_IF_TRUE,          // src [hi][lo]
+    R_LESS_JUMP_IF_FALSE,    // a b [hi][lo]  salta se !(a < b)
+    R_GREATER_JUMP_IF_FALSE, // a b [hi][lo]
+    R_EQUAL_JUMP_IF_FALSE,   // a b [hi][lo]
+
+    R_CALL,        // base argc       callee em base, args em base+1..
+    R_CALL_NATIVE, // base n argc     args em base.., resultado em base
+    R_TAIL_CALL,   // base argc       move callee e args para regs[0..]
+    R_CALL_DIRECT,      // base argc  como R_CALL, callee é um def conhecido
+    R_TAIL_CALL_DIRECT, // base argc
+    R_RETURN,      // src
+    R_RETURN_NIL,
+    R_PRINT,       // src
+
+    R_SQRT,        // dst src
+    R_ABS,         // dst src
+    R_POW,         // dst a b
+    R_LEN,         // dst src
+    R_STR,         // dst src
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include "chunk.h"
+#include <vector>
+
+// ============================================
+// OPTIMIZER
+// ============================================
+// Passagem sobre o bytecode de stack de cada função, depois do compiler e
+// antes do verifier. O compiler emite à medida que faz parse e não vê o
+// que vem a seguir; aqui a função inteira está disponível:
+//
+//  - dobra constantes (2 * 3, -1, !true, "a" + "b", if (true) ...)
+//  - EQUAL+NOT passa a NOT_EQUAL; NOT+JUMP_IF_FALSE com POP nos dois
+//    caminhos passa a JUMP_IF_TRUE (o bool negado nunca é lido)
+//  - encurta cadeias de saltos (elif, && e || encadeados)
+//  - junta compare + POP_JUMP_IF_FALSE num só salto (JUMP_IF_NOT_*) e
+//    as condições de && que saltam para outra condição
+//  - apaga código inalcançável (depois de return, break, ...)
+//
+// O código é descodificado numa lista de instruções em que os saltos
+// apontam para índices, reescrito e codificado de novo; offsets de salto,
+// destinos das tabelas do OP_SWITCH e Chunk::lines são recalculados. Cada salto fica na forma curta se
+// couber nos 16 bits e na _LONG se não.
+
+// Salto para a frente que o compiler não conseguiu resolver em 16 bits:
+// o operando fica por preencher e o destino vem aqui
+struct FarJump
+{
+    int offset; // dos dois bytes do salto (os últimos da instrução)
+    int target;
+};
+
+class Optimizer
+{
+public:
+    // false se o código ficou igual (nada a fazer, ou algum salto deixaria
+    // de caber nos 24 bits). Com farJumps o código é sempre recodificado;
+    // false quer então dizer que não foi possível.
+    static bool optimize(Function *function,
+                         const std::vector<FarJump> &farJumps = std::vector<FarJump>());
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include "chunk.h"
+
+// ============================================
+// REGISTER COMPILER
+// ============================================
+// Gera o formato register de uma função a partir do bytecode de stack.
+// Cada posição da stack do frame é um registo: a profundidade de cada
+// instrução é conhecida em compile time, por isso GET_LOCAL/CONSTANT não
+// precisam de copiar nada - o consumidor lê o slot/constante directamente.
+//
+// Se a função usar algo que o tradutor não conhece, regCode fica vazio
+// e a VM corre a versão de stack dessa função.
+class RegisterCompiler
+{
+public:
+    static bool compile(Function *function);
+};
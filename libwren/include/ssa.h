@@ -0,0 +1,30 @@
+#pragma once
+#include "chunk.h"
+
+// ============================================
+// MIDDLE END SSA (-O)
+// ============================================
+// O compiler emite bytecode à medida que faz parse, por isso nenhuma
+// optimização vê mais do que um token à frente. Com -O (VM::setOptimize)
+// cada função passa por um middle end antes do optimizer de bytecode:
+//
+//  1. o bytecode de stack é baixado para um CFG em SSA: cada posição da
+//     stack (locais incluídos) é uma variável, GET_LOCAL/SET_LOCAL/POP
+//     desaparecem e os blocos com vários predecessores ganham phis
+//     (a propagação de cópias sai daqui e da remoção de phis triviais)
+//  2. propagação de constantes condicional (SCCP): valores e ramos
+//     conhecidos em compile time, blocos que nunca correm
+//  3. GET_GLOBAL invariantes saem dos loops que não escrevem o global
+//     nem fazem calls (LICM)
+//  4. eliminação de código morto
+//  5. geração de bytecode: as expressões voltam a ser árvores na stack,
+//     os valores que atravessam blocos ou têm vários usos ficam em slots
+//     do frame atribuídos por coloração do grafo de interferência
+//
+// As operações que podem falhar ou têm efeitos ficam pela ordem original.
+// Se a função usar algo que o middle end não conhece, fica como estava.
+class SsaOptimizer
+{
+public:
+    static bool optimize(Function *function);
+};
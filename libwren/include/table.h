@@ -30,7 +30,7 @@ private:
         HashNode() : occupied(false)
         {
             key[0] = '\0';
-            value.type = VAL_NULL;
+            value = Value::makeNull();
             len = 0;
         }
 
@@ -76,16 +76,20 @@ private:
     {
         size_t h = 14695981039346656037ULL;
         const char *p = str;
+        const char *end = str + strlen(str);
 
-        // Process 8 bytes at a time when possible
-        while (*p && *(p + 7))
+        // Process 8 bytes at a time when possible (nunca passa do '\0':
+        // bytes a seguir à string davam hashes diferentes para a mesma key)
+        while (end - p >= 8)
         {
-            h = (h ^ *(uint64_t *)p) * 1099511628211ULL;
+            uint64_t chunk;
+            memcpy(&chunk, p, sizeof(chunk));
+            h = (h ^ chunk) * 1099511628211ULL;
             p += 8;
         }
 
         // Finish remaining bytes
-        while (*p)
+        while (p < end)
             h = (h ^ *p++) * 1099511628211ULL;
 
         return h;
@@ -126,7 +130,7 @@ private:
         Value *new_array = (Value *)calloc(new_capacity, sizeof(Value));
 
         for (size_t i = 0; i < new_capacity; ++i)
-            new_array[i].type = VAL_NULL;
+            new_array[i] = Value::makeNull();
 
         if (array)
         {
@@ -261,7 +265,7 @@ public:
         if (array)
         {
             for (size_t i = 0; i < array_size; ++i)
-                array[i].type = VAL_NULL;
+                array[i] = Value::makeNull();
             array_size = 0;
         }
 
@@ -284,7 +288,7 @@ public:
     {
         size_t count = 0;
         for (size_t i = 0; i < array_size; ++i)
-            if (array[i].type != VAL_NULL)
+            if (!array[i].isNull())
                 ++count;
         return count + hash_size;
     }
@@ -293,7 +297,7 @@ public:
     {
         size_t count = 0;
         for (size_t i = 0; i < array_size; ++i)
-            if (array[i].type != VAL_NULL)
+            if (!array[i].isNull())
                 ++count;
         return count;
     }
@@ -308,7 +312,7 @@ public:
     void for_each_array(Func func) const
     {
         for (size_t i = 0; i < array_size; ++i)
-            if (array[i].type != VAL_NULL)
+            if (!array[i].isNull())
                 func(i, array[i]);
     }
 
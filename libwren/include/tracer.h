@@ -0,0 +1,54 @@
+#pragma once
+#include "chunk.h"
+#include "jit.h"
+#include <vector>
+
+// ============================================
+// TRACING JIT (x86-64 Linux)
+// ============================================
+// Cada cabeça de loop tem um contador de back-edges (o interpretador e o
+// OP_LOOP do JIT baseline descontam). A zero, o recorder executa uma
+// iteração do loop ele próprio e grava o caminho seguido: que instruções
+// correram, que lado cada salto condicional tomou e o tipo (int/bool) de
+// cada local e global que o loop toca.
+//
+// O trace é código linear: os locais e globais ficam em registos durante
+// o loop todo, a stack de operandos desaparece (é resolvida em tempo de
+// compilação) e os saltos condicionais passam a guards. Um guard que
+// falha escreve os registos de volta nos slots/globais, reconstrói a
+// stack da instrução e devolve o ip dela ao interpretador.
+//
+// Só traça o subconjunto int/bool sem calls; o resto aborta a gravação
+// (o interpretador continua onde o recorder parou) e, à terceira vez, a
+// cabeça fica na lista negra.
+
+struct TraceCode;
+
+struct LoopState
+{
+    int header;     // offset do destino do OP_LOOP
+    int countdown;  // back-edges até gravar; o baseline desconta em nativo
+    int aborts;
+    TraceCode *trace;
+};
+
+class VM;
+
+class Tracer
+{
+public:
+    static const int HOT_LOOP = 50;
+    static const int MAX_ABORTS = 3;
+    static const int MAX_TRACE = 256; // instruções gravadas por iteração
+
+    // Cria o estado à primeira chamada para esta cabeça
+    static LoopState *loopAt(Function *function, int header);
+
+    // Back-edge no interpretador (ip já na cabeça): corre o trace, grava
+    // ou só conta. Devolve o ip onde o interpretador continua.
+    static uint8_t *onLoop(VM *vm, Function *function, uint8_t *ip,
+                           Value *slots, Value *&sp);
+
+    static bool hasTrace(const Function *function);
+    static void release(std::vector<LoopState *> &loops);
+};
@@ -1,7 +1,14 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <string>
- 
+
+// WREN_NAN_TAGGING=1: Value ocupa 8 bytes (NaN-boxing). Doubles são
+// guardados tal como estão; os outros tipos vivem no espaço de quiet NaNs.
+// Com 0 fica o tagged union clássico (16 bytes). Ver opção no CMake.
+#ifndef WREN_NAN_TAGGING
+#define WREN_NAN_TAGGING 0
+#endif
 
 enum ValueType
 {
@@ -13,6 +20,117 @@ enum ValueType
     VAL_FUNCTION
 };
 
+#if WREN_NAN_TAGGING
+
+// Layout dos 64 bits:
+//
+//   double          qualquer padrão sem os bits de QNAN todos a 1
+//   string          1 | 11111111111 | 11 | ponteiro de 48 bits (SIGN | QNAN)
+//   null/bool/int/  0 | 11111111111 | 11 | ... | tag (bits 32-34) | payload 32 bits
+//   function
+//
+// Os NaNs gerados pela aritmética (0x7ff8.../0xfff8...) têm o bit 50 a 0,
+// por isso nunca colidem com QNAN.
+struct Value
+{
+    uint64_t bits;
+
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000ULL;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000ULL;
+
+    static constexpr uint64_t TAG_NULL = 1;
+    static constexpr uint64_t TAG_FALSE = 2;
+    static constexpr uint64_t TAG_TRUE = 3;
+    static constexpr uint64_t TAG_INT = 4;
+    static constexpr uint64_t TAG_FUNCTION = 5;
+
+    static constexpr uint64_t NULL_VAL = QNAN | (TAG_NULL << 32);
+    static constexpr uint64_t FALSE_VAL = QNAN | (TAG_FALSE << 32);
+    static constexpr uint64_t TRUE_VAL = QNAN | (TAG_TRUE << 32);
+
+    // Metade alta de um int/function: compara-se com um único shift
+    static constexpr uint32_t INT_HIGH = (uint32_t)((QNAN | (TAG_INT << 32)) >> 32);
+    static constexpr uint32_t FUNCTION_HIGH = (uint32_t)((QNAN | (TAG_FUNCTION << 32)) >> 32);
+
+    // Constructors
+    Value() : bits(NULL_VAL) {}
+    Value(const Value &other) = default;
+    Value(Value &&other) noexcept = default;
+    Value &operator=(const Value &other) = default;
+    Value &operator=(Value &&other) noexcept = default;
+    ~Value() = default;
+
+    // Factory methods
+    static Value makeNull() { return fromBits(NULL_VAL); }
+    static Value makeBool(bool b) { return fromBits(b ? TRUE_VAL : FALSE_VAL); }
+    static Value makeTrue() { return makeBool(true); }
+    static Value makeFalse() { return makeBool(false); }
+    static Value makeInt(int i) { return fromBits(QNAN | (TAG_INT << 32) | (uint32_t)i); }
+    static Value makeDouble(double d)
+    {
+        Value v;
+        std::memcpy(&v.bits, &d, sizeof(double));
+        return v;
+    }
+    static Value makeFloat(float f) { return makeDouble(f); }
+    static Value makeString(const char *str);
+    static Value makeString(const std::string &str);
+    static Value makeFunction(int idx) { return fromBits(QNAN | (TAG_FUNCTION << 32) | (uint32_t)idx); }
+
+    // Type checks
+    bool isNull() const { return bits == NULL_VAL; }
+    bool isBool() const { return (bits | (1ULL << 32)) == TRUE_VAL; }
+    bool isInt() const { return (uint32_t)(bits >> 32) == INT_HIGH; }
+    bool isDouble() const { return (bits & QNAN) != QNAN; }
+    bool isString() const { return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+    bool isFunction() const { return (uint32_t)(bits >> 32) == FUNCTION_HIGH; }
+
+    ValueType getType() const
+    {
+        if (isDouble())
+            return VAL_DOUBLE;
+        if (bits & SIGN_BIT)
+            return VAL_STRING;
+
+        switch ((bits >> 32) & 7)
+        {
+        case TAG_FALSE:
+        case TAG_TRUE:
+            return VAL_BOOL;
+        case TAG_INT:
+            return VAL_INT;
+        case TAG_FUNCTION:
+            return VAL_FUNCTION;
+        default:
+            return VAL_NULL;
+        }
+    }
+
+    // Conversions
+    bool asBool() const { return bits == TRUE_VAL; }
+    int asInt() const { return (int)(uint32_t)bits; }
+    double asDouble() const
+    {
+        double d;
+        std::memcpy(&d, &bits, sizeof(double));
+        return d;
+    }
+    float asFloat() const { return (float)asDouble(); }
+    const char *asString() const { return (const char *)(uintptr_t)(bits & ~(QNAN | SIGN_BIT)); }
+    int asFunctionIdx() const { return (int)(uint32_t)bits; }
+
+    static Value fromBits(uint64_t b)
+    {
+        Value v;
+        v.bits = b;
+        return v;
+    }
+};
+
+static_assert(sizeof(Value) == 8, "NaN-tagged Value must be 8 bytes");
+
+#else
+
 struct Value
 {
     ValueType type;
@@ -27,26 +145,48 @@ struct Value
     } as;
 
     // Constructors
-    Value();
+    Value() : type(VAL_NULL) { as.number = 0; }
     Value(const Value &other) = default;
     Value(Value &&other) noexcept = default;
     Value &operator=(const Value &other) = default;
     Value &operator=(Value &&other) noexcept = default;
     ~Value() = default;
 
-    
-
     // Factory methods
-    static Value makeNull();
-    static Value makeBool(bool b);
+    static Value makeNull() { return Value(); }
+    static Value makeBool(bool b)
+    {
+        Value v;
+        v.type = VAL_BOOL;
+        v.as.boolean = b;
+        return v;
+    }
     static Value makeTrue() { return makeBool(true); }
     static Value makeFalse() { return makeBool(false); }
-    static Value makeInt(int i);
-    static Value makeDouble(double d);
-    static Value makeFloat(float f);
+    static Value makeInt(int i)
+    {
+        Value v;
+        v.type = VAL_INT;
+        v.as.integer = i;
+        return v;
+    }
+    static Value makeDouble(double d)
+    {
+        Value v;
+        v.type = VAL_DOUBLE;
+        v.as.number = d;
+        return v;
+    }
+    static Value makeFloat(float f) { return makeDouble(f); }
     static Value makeString(const char *str);
     static Value makeString(const std::string &str);
-    static Value makeFunction(int idx);
+    static Value makeFunction(int idx)
+    {
+        Value v;
+        v.type = VAL_FUNCTION;
+        v.as.functionIdx = idx;
+        return v;
+    }
 
     // Type checks
     bool isNull() const { return type == VAL_NULL; }
@@ -56,14 +196,18 @@ struct Value
     bool isString() const { return type == VAL_STRING; }
     bool isFunction() const { return type == VAL_FUNCTION; }
 
+    ValueType getType() const { return type; }
+
     // Conversions
-    bool asBool() const;
-    int asInt() const;
-    double asDouble() const;
-    float asFloat() const;
-    const char *asString() const;
-    int asFunctionIdx() const;
+    bool asBool() const { return as.boolean; }
+    int asInt() const { return as.integer; }
+    double asDouble() const { return as.number; }
+    float asFloat() const { return (float)as.number; }
+    const char *asString() const { return as.string; }
+    int asFunctionIdx() const { return as.functionIdx; }
 };
 
+#endif
+
 void printValue(const Value &value);
 std::string valueToString(const Value &value);
@@ -0,0 +1,38 @@
+#pragma once
+#include "chunk.h"
+
+// ============================================
+// VERIFIER
+// ============================================
+// Corre sobre o bytecode de stack de cada função antes de ela ser
+// executada: valida opcodes, operandos e destinos de salto e calcula a
+// altura máxima da stack (Function::maxStack). Com isso a VM só verifica
+// overflow uma vez por call e o loop principal faz push/pop sem testes.
+
+// Forma de uma instrução de stack: tamanho, efeito na stack e saltos
+struct StackInstruction
+{
+    int length;        // bytes da instrução
+    int delta;         // variação da profundidade
+    int pops;          // valores do topo que a instrução lê
+    int jumpTarget;    // -1 se não salta
+    bool fallsThrough; // false para JUMP, LOOP e RETURN
+};
+
+// Limites dos índices que os operandos podem usar
+struct VerifierLimits
+{
+    int globals;
+    int natives;
+};
+
+class Verifier
+{
+public:
+    static bool decode(const Chunk &chunk, int offset, StackInstruction &info);
+
+    // Preenche function->maxStack; em caso de erro escreve a razão em
+    // error (tamanho size) e devolve false
+    static bool verify(Function *function, const VerifierLimits &limits,
+                       char *error, size_t size);
+};
@@ -17,11 +17,23 @@ enum class InterpretResult
     RUNTIME_ERROR
 };
 
+// Stack: bytecode de stack (default). Register: formato de três endereços
+// gerado pelo compiler; funções sem versão register correm em stack.
+enum class ExecutionMode
+{
+    Stack,
+    Register
+};
+
 class VM
 {
 public:
-    static constexpr int STACK_MAX = 256;
-    static constexpr int FRAMES_MAX = 64;
+    // A stack e os frames começam pequenos e crescem a pedido até aos
+    // limites (ajustáveis com setStackLimits)
+    static constexpr int STACK_INITIAL = 256;
+    static constexpr int FRAMES_INITIAL = 64;
+    static constexpr int STACK_MAX = 1 << 20;
+    static constexpr int FRAMES_MAX = 1 << 16;
 
     VM();
     ~VM();
@@ -32,7 +44,32 @@ public:
     
     InterpretResult interpretExpression(const std::string& source);
 
-    void registerNative(const char* name, int arity, NativeFunction fn);
+    void registerNative(const char* name, int arity, NativeFunction fn,
+                        void *userdata = nullptr);
+
+    void setExecutionMode(ExecutionMode mode) { executionMode_ = mode; }
+    ExecutionMode getExecutionMode() const { return executionMode_; }
+
+    // Máximo de valores na stack e de calls aninhadas
+    void setStackLimits(int maxValues, int maxFrames);
+
+    // JIT baseline para funções quentes em modo Stack (só x86-64 Linux
+    // com WREN_JIT; noutros casos não tem efeito). Ligado por omissão.
+    void setJitEnabled(bool enabled) { jitEnabled_ = enabled; }
+    bool isJitEnabled() const { return jitEnabled_; }
+
+    // Middle end SSA (ssa.h) nas funções compiladas a partir daqui.
+    // Desligado por omissão.
+    void setOptimize(bool enabled) { optimize_ = enabled; }
+    bool isOptimizing() const { return optimize_; }
+
+    // Todas as funções de um módulo (cada interpret) usam a mesma
+    // ConstantTable em vez de uma por função. Desligado por omissão.
+    void setShareConstants(bool enabled) { shareConstants_ = enabled; }
+    bool isSharingConstants() const { return shareConstants_; }
+
+    // Regista o código gerado em /tmp/perf-PID.map para o perf
+    void setPerfMapEnabled(bool enabled) { perfMap_ = enabled; }
 
     
     
@@ -99,27 +136,40 @@ public:
 
 private:
     friend class Compiler;
+    friend class Jit;
+    friend class Tracer;
     Compiler* compiler;
-    Value stack_[STACK_MAX];
+    Value *stack_;
+    Value *stackEnd_; // stack_ + capacidade atual
     Value *stackTop_;
-
-   struct GlobalCache {
-        const char* name;
-        Value* value_ptr;
-        
-        GlobalCache() : name(nullptr), value_ptr(nullptr) {}
-        
-        void invalidate() {
-            name = nullptr;
-            value_ptr = nullptr;
-        }
-    } global_cache_;
+    int stackLimit_;
+
+    // Argumentos de uma native copiados para a stack C++ (acima disto, heap)
+    static constexpr int NATIVE_INLINE_ARGS = 8;
+
+    // Globais: o compiler dá a cada nome um slot fixo e os opcodes
+    // indexam o vetor; o mapa por nome serve o compiler e a API
+    struct GlobalSlot
+    {
+        Value value;
+        const char *name; // interned, para mensagens de erro
+        bool defined;
+    };
+    static const size_t MAX_GLOBALS = 65536; // índice u16 nos opcodes
+
+    std::vector<GlobalSlot> globals_;
+    std::unordered_map<const char *, uint16_t> globalNames_;
     
-    CallFrame frames_[FRAMES_MAX];
+    std::vector<CallFrame> frames_;
     int frameCount_;
+    int framesLimit_;
     bool hasFatalError_;
+    ExecutionMode executionMode_;
+    bool jitEnabled_;
+    bool perfMap_;
+    bool optimize_;
+    bool shareConstants_;
 
-     Table* globals_;
 
     std::vector<Function *> functions_;
     std::unordered_map<const char*, uint16_t> functionNames_;
@@ -127,8 +177,8 @@ private:
     NativeRegistry natives_;
 
     bool run();
-    bool executeUntilReturn(int targetFrameCount) ;
-    bool executeInstruction(CallFrame*& frame);
+    bool executeUntilReturn(int targetFrameCount);
+    bool executeRegister(int targetFrameCount);
 
     bool isTruthy(const Value &value);
 
@@ -136,8 +186,21 @@ private:
     Value pop();
     const Value& peek(int distance);
 
-    bool callNative(const char* name, int argCount);
+    bool callNative(int index, int argCount);
     bool callFunction(Function *function, int argCount);
+    void compileHot(Function *function);
+    inline bool checkStack(Function *function, Value *&slots);
+    inline bool reserveStack(Value *&base, int count);
+    bool growStack(int needed);
+    bool growFrames();
+    bool verifyFunction(Function *function, char *error, size_t size);
+
+    int globalSlot(const char *name);
+    Value *getGlobalPtr(const char *name);
+
+    inline Function *directCallee(Value *callee);
+    Function *reboundCallee(Value *callee);
+    inline void storeGlobal(Value *slot, const Value &value);
 
     void runtimeError(const char *format, ...);
     void resetStack();
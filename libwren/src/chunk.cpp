@@ -1,33 +1,157 @@
 #include "chunk.h"
+#include "jit.h"
+#include "tracer.h"
+#include <cstring>
+
+ConstantTable::ConstantTable() : storage_(std::make_shared<Storage>())
+{
+    storage_->values.reserve(64);
+}
+
+ConstantTable::Key ConstantTable::keyOf(const Value &value)
+{
+    Key key;
+    key.type = (int)value.getType();
+    key.bits = 0;
+    switch (value.getType())
+    {
+    case VAL_BOOL:
+        key.bits = value.asBool();
+        break;
+    case VAL_INT:
+        key.bits = (uint32_t)value.asInt();
+        break;
+    case VAL_DOUBLE:
+    {
+        double d = value.asDouble();
+        memcpy(&key.bits, &d, sizeof(d));
+        break;
+    }
+    case VAL_STRING:
+        key.bits = (uint64_t)(uintptr_t)value.asString();
+        break;
+    case VAL_FUNCTION:
+        key.bits = (uint32_t)value.asFunctionIdx();
+        break;
+    default:
+        break;
+    }
+    return key;
+}
+
+size_t ConstantTable::KeyHash::operator()(const Key &key) const
+{
+    // Mistura de 64 bits (splitmix): os ponteiros e os doubles têm os
+    // bits baixos quase sempre iguais
+    uint64_t h = key.bits + 0x9e3779b97f4a7c15ULL * (uint64_t)(key.type + 1);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return (size_t)(h ^ (h >> 31));
+}
+
+int ConstantTable::add(const Value &value)
+{
+    Key key = keyOf(value);
+    std::unordered_map<Key, int, KeyHash>::iterator it = storage_->index.find(key);
+    if (it != storage_->index.end())
+        return it->second;
+
+    int index = (int)storage_->values.size();
+    storage_->values.push_back(value);
+    storage_->index[key] = index;
+    return index;
+}
+
+int ConstantTable::find(const Value &value) const
+{
+    std::unordered_map<Key, int, KeyHash>::const_iterator it = storage_->index.find(keyOf(value));
+    return it == storage_->index.end() ? -1 : it->second;
+}
+
+int LineTable::lineAt(size_t offset) const
+{
+    // Último run que começa em offset ou antes
+    int lo = 0, hi = (int)runs_.size() - 1;
+    if (hi < 0)
+        return 0;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if ((size_t)runs_[mid].start <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return runs_[lo].line;
+}
+
+void LineTable::truncate(size_t count)
+{
+    if (count >= count_)
+        return;
+    while (!runs_.empty() && (size_t)runs_.back().start >= count)
+        runs_.pop_back();
+    count_ = count;
+}
+
+int SwitchTable::targetOf(const Value &value) const
+{
+    if (value.isInt())
+    {
+        long long index = (long long)value.asInt() - low;
+        if (index >= 0 && index < (long long)dense.size())
+            return dense[(size_t)index];
+        std::unordered_map<int, int>::const_iterator it = ints.find(value.asInt());
+        if (it != ints.end())
+            return it->second;
+    }
+    else if (value.isString())
+    {
+        std::unordered_map<const char *, int>::const_iterator it = strings.find(value.asString());
+        if (it != strings.end())
+            return it->second;
+    }
+    return defaultTarget;
+}
 
 void Chunk::write(uint8_t byte, int line)
 {
     code.push_back(byte);
-    lines.push_back(line);
+    lines.add(line);
 }
 
 Chunk::Chunk()
 {
-    code.reserve(256);  
-    constants.reserve(64);
-    lines.reserve(256);
+    code.reserve(256);
 }
 
 const char *Chunk::getStringPtr(size_t index) const
 {
     const Value &v = constants[index];
-    if (v.type == VAL_STRING)
+    if (v.isString())
     {
-        return v.as.string;
+        return v.asString();
     }
     return nullptr;
 }
 
 int Chunk::addConstant(Value value)
 {
-    constants.push_back(value);
-    return static_cast<int>(constants.size() - 1);
+    return constants.add(value);
+}
+
+void Chunk::truncate(size_t offset)
+{
+    code.resize(offset);
+    lines.truncate(offset);
 }
 
 Function::Function(const std::string &n, int a)
-    : arity(a), name(n), hasReturn(false) {}
+    : arity(a), name(n), hasReturn(false), rebound(false), maxStack(-1), regCount(0),
+      hotness(0), jit(nullptr) {}
+
+Function::~Function()
+{
+    Jit::release(jit);
+    Tracer::release(loops);
+}
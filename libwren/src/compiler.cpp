@@ -1,6 +1,11 @@
 #include "compiler.h"
+#include "fold.h"
+#include "optimizer.h"
+#include "regcompiler.h"
+#include "ssa.h"
 #include "stringpool.h"
 #include "vm.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 
@@ -100,6 +105,7 @@ Function *Compiler::compile(const std::string &source, VM *vm)
 
     function = new Function("__main__", 0);
     currentChunk = &function->chunk;
+    reserveCalleeSlot();
 
     advance();
 
@@ -109,6 +115,12 @@ Function *Compiler::compile(const std::string &source, VM *vm)
     }
 
     emitReturn();
+    if (!hadError)
+    {
+        optimizeBytecode(function);
+        verifyBytecode(function);
+    }
+    RegisterCompiler::compile(function);
 
     Function *result = function;
     function = nullptr;
@@ -130,6 +142,7 @@ Function *Compiler::compileExpression(const std::string &source, VM *vm)
 
     function = new Function("__expr__", 0);
     currentChunk = &function->chunk;
+    reserveCalleeSlot();
 
     advance();
 
@@ -145,6 +158,12 @@ Function *Compiler::compileExpression(const std::string &source, VM *vm)
     consume(TOKEN_EOF, "Expect end of expression");
 
     emitByte(OP_RETURN);
+    if (!hadError)
+    {
+        optimizeBytecode(function);
+        verifyBytecode(function);
+    }
+    RegisterCompiler::compile(function);
 
     Function *result = function;
     function = nullptr;
@@ -169,6 +188,8 @@ void Compiler::clear()
     scopeDepth = 0;
     localCount_ = 0;
     loopDepth_ = 0;
+    peephole_.reset();
+    farJumps_.clear();
 }
 
 // ============================================
@@ -290,6 +311,18 @@ void Compiler::emitByte(uint8_t byte)
 
 void Compiler::emitBytes(uint8_t byte1, uint8_t byte2)
 {
+    int offset = (int)currentChunk->count();
+
+    if (byte1 == OP_GET_LOCAL)
+    {
+        peephole_.prevGetLocal = peephole_.lastGetLocal;
+        peephole_.lastGetLocal = offset;
+    }
+    else if (byte1 == OP_CONSTANT)
+    {
+        peephole_.lastConstant = offset;
+    }
+
     emitByte(byte1);
     emitByte(byte2);
 }
@@ -300,21 +333,121 @@ void Compiler::emitReturn()
     emitByte(OP_RETURN);
 }
 
+// Ints pequenos vão como imediato (OP_PUSH_INT). Os outros para a pool:
+// índices até 255 num byte, acima disso OP_CONSTANT_LONG com 3 bytes.
 void Compiler::emitConstant(Value value)
 {
-    emitBytes(OP_CONSTANT, makeConstant(value));
+    if (fold::immediate(value))
+    {
+        peephole_.lastPushInt = (int)currentChunk->count();
+        int16_t imm = (int16_t)value.asInt();
+        emitByte(OP_PUSH_INT);
+        emitByte((uint8_t)(((uint16_t)imm >> 8) & 0xff));
+        emitByte((uint8_t)((uint16_t)imm & 0xff));
+        return;
+    }
+
+    int constant = makeConstant(value);
+    if (constant <= UINT8_MAX)
+    {
+        emitBytes(OP_CONSTANT, (uint8_t)constant);
+        return;
+    }
+    emitByte(OP_CONSTANT_LONG);
+    emitByte((uint8_t)((constant >> 16) & 0xff));
+    emitByte((uint8_t)((constant >> 8) & 0xff));
+    emitByte((uint8_t)(constant & 0xff));
 }
 
-uint8_t Compiler::makeConstant(Value value)
+int Compiler::makeConstant(Value value)
 {
     int constant = currentChunk->addConstant(value);
-    if (constant > UINT8_MAX)
+    if (constant > 0xffffff)
     {
         error("Too many constants in one chunk");
         return 0;
     }
 
-    return (uint8_t)constant;
+    return constant;
+}
+
+// Imediato do OP_PUSH_INT em offset
+int16_t Compiler::pushedInt(int offset) const
+{
+    const uint8_t *code = currentChunk->code.data();
+    return (int16_t)((code[offset + 1] << 8) | code[offset + 2]);
+}
+
+// ============================================
+// SUPERINSTRUCTIONS
+// ============================================
+// Fusão feita na emissão: quando o operador chega, olha-se para as
+// instruções que acabaram de ser emitidas. Se formarem um padrão conhecido
+// e nenhum salto cair no meio delas, recua-se e emite-se a versão fundida.
+
+bool Compiler::canFuse(int groupStart) const
+{
+    return peephole_.lastJumpTarget <= groupStart;
+}
+
+void Compiler::rewindTo(int offset)
+{
+    currentChunk->truncate(offset);
+
+    // Os offsets guardados deixam de corresponder ao código
+    int jumpTarget = peephole_.lastJumpTarget;
+    peephole_.reset();
+    peephole_.lastJumpTarget = jumpTarget;
+}
+
+void Compiler::emitArith(uint8_t op)
+{
+    int end = (int)currentChunk->count();
+
+    // GET_LOCAL a, GET_LOCAL b, ADD -> ADD_LOCALS a b
+    if (op == OP_ADD && peephole_.lastGetLocal == end - 2 &&
+        peephole_.prevGetLocal == end - 4 && canFuse(end - 4))
+    {
+        uint8_t a = currentChunk->code[end - 3];
+        uint8_t b = currentChunk->code[end - 1];
+        rewindTo(end - 4);
+        emitByte(OP_ADD_LOCALS);
+        emitByte(a);
+        emitByte(b);
+        return;
+    }
+
+    // PUSH_INT n, ADD/SUBTRACT -> ADD_IMM/SUBTRACT_IMM n
+    if ((op == OP_ADD || op == OP_SUBTRACT) &&
+        peephole_.lastPushInt == end - 3 && canFuse(end - 3))
+    {
+        uint8_t hi = currentChunk->code[end - 2];
+        uint8_t lo = currentChunk->code[end - 1];
+        rewindTo(end - 3);
+        emitByte(op == OP_ADD ? OP_ADD_IMM : OP_SUBTRACT_IMM);
+        emitByte(hi);
+        emitByte(lo);
+        return;
+    }
+
+    // CONSTANT k, ADD/SUBTRACT -> ADD_CONST/SUBTRACT_CONST k
+    if ((op == OP_ADD || op == OP_SUBTRACT) &&
+        peephole_.lastConstant == end - 2 && canFuse(end - 2))
+    {
+        uint8_t k = currentChunk->code[end - 1];
+        rewindTo(end - 2);
+        emitByte(op == OP_ADD ? OP_ADD_CONST : OP_SUBTRACT_CONST);
+        emitByte(k);
+        return;
+    }
+
+    emitByte(op);
+}
+
+void Compiler::emitCompare(uint8_t op)
+{
+    peephole_.lastCompare = (int)currentChunk->count();
+    emitByte(op);
 }
 
 // ============================================
@@ -329,29 +462,76 @@ int Compiler::emitJump(uint8_t instruction)
     return currentChunk->count() - 2;
 }
 
+// Condição de if/while/for: o valor nunca é preciso depois do salto.
+// Um compare no fim da expressão (com o PUSH_INT antes dele, se houver)
+// passa a um salto que consome os operandos; sem compare, o valor sai
+// da stack no próprio salto. Nenhum dos ramos começa com POP.
+int Compiler::emitConditionJump()
+{
+    int end = (int)currentChunk->count();
+    if (peephole_.lastCompare != end - 1 || !canFuse(end - 1))
+        return emitJump(OP_POP_JUMP_IF_FALSE);
+
+    uint8_t compare = currentChunk->code[end - 1];
+    if (peephole_.lastPushInt == end - 4 && canFuse(end - 4))
+    {
+        uint8_t hi = currentChunk->code[end - 3];
+        uint8_t lo = currentChunk->code[end - 2];
+        rewindTo(end - 4);
+        emitByte(conditionBranch(compare, true));
+        emitByte(hi);
+        emitByte(lo);
+        emitByte(0xff);
+        emitByte(0xff);
+        return currentChunk->count() - 2;
+    }
+
+    rewindTo(end - 1);
+    return emitJump(conditionBranch(compare, false));
+}
+
 void Compiler::patchJump(int offset)
 {
     int jump = currentChunk->count() - offset - 2;
 
     if (jump > UINT16_MAX)
     {
-        error("Too much code to jump over");
+        // O salto ainda não sabe quanto código vem a seguir: fica
+        // registado e o optimizer passa-o à forma larga no fim
+        FarJump far;
+        far.offset = offset;
+        far.target = (int)currentChunk->count();
+        farJumps_.push_back(far);
+        peephole_.lastJumpTarget = (int)currentChunk->count();
+        return;
     }
 
     currentChunk->code[offset] = (jump >> 8) & 0xff;
     currentChunk->code[offset + 1] = jump & 0xff;
+
+    peephole_.lastJumpTarget = (int)currentChunk->count();
 }
 
 void Compiler::emitLoop(int loopStart)
 {
-    emitByte(OP_LOOP);
+    int offset = currentChunk->count() - loopStart + 3;
+    if (offset <= UINT16_MAX)
+    {
+        emitByte(OP_LOOP);
+        emitByte((offset >> 8) & 0xff);
+        emitByte(offset & 0xff);
+        return;
+    }
 
-    int offset = currentChunk->count() - loopStart + 2;
-    if (offset > UINT16_MAX)
+    // Para trás o destino já é conhecido: a forma larga sai logo aqui
+    offset++;
+    if (offset > 0xffffff)
     {
         error("Loop body too large");
     }
 
+    emitByte(OP_LOOP_LONG);
+    emitByte((offset >> 16) & 0xff);
     emitByte((offset >> 8) & 0xff);
     emitByte(offset & 0xff);
 }
@@ -473,10 +653,10 @@ void Compiler::binary(bool canAssign)
     switch (operatorType)
     {
     case TOKEN_PLUS:
-        emitByte(OP_ADD);
+        emitArith(OP_ADD);
         break;
     case TOKEN_MINUS:
-        emitByte(OP_SUBTRACT);
+        emitArith(OP_SUBTRACT);
         break;
     case TOKEN_STAR:
         emitByte(OP_MULTIPLY);
@@ -488,26 +668,23 @@ void Compiler::binary(bool canAssign)
         emitByte(OP_MODULO);
         break;
     case TOKEN_EQUAL_EQUAL:
-        emitByte(OP_EQUAL);
+        emitCompare(OP_EQUAL);
         break;
     case TOKEN_BANG_EQUAL:
-        emitByte(OP_EQUAL);
-        emitByte(OP_NOT);
+        emitCompare(OP_NOT_EQUAL);
         break;
 
     case TOKEN_LESS:
-        emitByte(OP_LESS);
+        emitCompare(OP_LESS);
         break;
     case TOKEN_LESS_EQUAL:
-        emitByte(OP_GREATER);
-        emitByte(OP_NOT);
+        emitCompare(OP_LESS_EQUAL);
         break;
     case TOKEN_GREATER:
-        emitByte(OP_GREATER);
+        emitCompare(OP_GREATER);
         break;
     case TOKEN_GREATER_EQUAL:
-        emitByte(OP_LESS);
-        emitByte(OP_NOT);
+        emitCompare(OP_GREATER_EQUAL);
         break;
 
     default:
@@ -615,7 +792,8 @@ void Compiler::varDeclaration()
     consume(TOKEN_IDENTIFIER, "Expect variable name");
     Token nameToken = previous;
 
-    uint8_t global = identifierConstant(nameToken);
+    // Locais não precisam de slot global
+    uint16_t global = scopeDepth == 0 ? globalSlot(nameToken) : 0;
 
     if (scopeDepth > 0)
     {
@@ -636,6 +814,32 @@ void Compiler::varDeclaration()
     defineVariable(global);
 }
 
+// Builtins que viram opcode (ver OP_SQRT...). A aridade já foi
+// verificada contra a native com o mesmo nome.
+struct Intrinsic
+{
+    const char *name;
+    uint8_t opcode;
+};
+
+static const Intrinsic intrinsics[] = {
+    {"sqrt", OP_SQRT},
+    {"abs", OP_ABS},
+    {"pow", OP_POW},
+    {"len", OP_LEN},
+    {"str", OP_STR},
+};
+
+static int intrinsicOpcode(const char *name)
+{
+    for (const Intrinsic &intrinsic : intrinsics)
+    {
+        if (strcmp(intrinsic.name, name) == 0)
+            return intrinsic.opcode;
+    }
+    return -1;
+}
+
 void Compiler::variable(bool canAssign)
 {
     Token name = previous;
@@ -644,15 +848,42 @@ void Compiler::variable(bool canAssign)
     {
         const char *interned = StringPool::instance().intern(name.lexeme);
 
-        if (vm_->natives_.hasFunction(interned))
+        int native = vm_->natives_.getIndex(interned);
+        if (native != -1)
         {
             advance(); // Consome '('
             uint8_t argCount = argumentList();
-            uint8_t nameIdx = makeConstant(Value::makeString(interned));
-            emitBytes(OP_CALL_NATIVE, nameIdx);
+            int arity = vm_->natives_.get(native).arity;
+            if (arity != -1 && argCount != arity)
+            {
+                error("Wrong number of arguments for native function");
+            }
+
+            // As natives ganham sempre aos locais numa call, por isso o
+            // builtin nunca está tapado e pode correr inline
+            int intrinsic = intrinsicOpcode(interned);
+            if (intrinsic != -1)
+            {
+                emitByte((uint8_t)intrinsic);
+                return;
+            }
+            emitBytes(OP_CALL_NATIVE, (uint8_t)native);
             emitByte(argCount);
             return;
         }
+
+        // def global já registado (inclui a função a ser compilada):
+        // a função vai como constante, sem OP_GET_GLOBAL nem type check
+        auto it = vm_->functionNames_.find(interned);
+        if (it != vm_->functionNames_.end() && resolveLocal(name) == -1)
+        {
+            advance(); // Consome '('
+            emitConstant(Value::makeFunction(it->second));
+            uint8_t argCount = argumentList();
+            peephole_.lastCall = (int)currentChunk->count();
+            emitBytes(OP_CALL_DIRECT, argCount);
+            return;
+        }
     }
 
     namedVariable(name, canAssign);
@@ -679,10 +910,36 @@ void Compiler::or_(bool canAssign)
     patchJump(endJump);
 }
 
-uint8_t Compiler::identifierConstant(Token &name)
+// Slot do global na VM: os opcodes de globais levam o índice (u16) e
+// não o nome, por isso o mesmo nome dá o mesmo slot em qualquer script
+uint16_t Compiler::globalSlot(Token &name)
 {
     const char *interned = StringPool::instance().intern(name.lexeme);
-    return makeConstant(Value::makeString(interned));
+    int slot = vm_->globalSlot(interned);
+    if (slot < 0)
+    {
+        error("Too many global variables");
+        return 0;
+    }
+    return (uint16_t)slot;
+}
+
+// GET/SET de locais levam o slot num byte (dois nas formas _LONG, acima
+// do slot 255); de globais, sempre em dois
+void Compiler::emitVariable(uint8_t op, int arg)
+{
+    if ((op == OP_GET_LOCAL || op == OP_SET_LOCAL) && arg <= UINT8_MAX)
+    {
+        emitBytes(op, (uint8_t)arg);
+        return;
+    }
+    if (op == OP_GET_LOCAL)
+        op = OP_GET_LOCAL_LONG;
+    else if (op == OP_SET_LOCAL)
+        op = OP_SET_LOCAL_LONG;
+    emitByte(op);
+    emitByte((uint8_t)((arg >> 8) & 0xff));
+    emitByte((uint8_t)(arg & 0xff));
 }
 
 void Compiler::namedVariable(Token &name, bool canAssign)
@@ -697,7 +954,7 @@ void Compiler::namedVariable(Token &name, bool canAssign)
     }
     else
     {
-        arg = identifierConstant(name);
+        arg = globalSlot(name);
         getOp = OP_GET_GLOBAL;
         setOp = OP_SET_GLOBAL;
     }
@@ -706,71 +963,102 @@ void Compiler::namedVariable(Token &name, bool canAssign)
     if (match(TOKEN_PLUS_PLUS))
     {
         // i++ (postfix)
-        emitBytes(getOp, (uint8_t)arg);
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
+        if (getOp == OP_GET_LOCAL && arg <= UINT8_MAX)
+        {
+            emitBytes(OP_INC_LOCAL, (uint8_t)arg); // Stack: [5], slot = 6
+            return;
+        }
+        emitVariable(getOp, arg);
         emitConstant(Value::makeInt(1));
-        emitByte(OP_ADD);
-        emitBytes(setOp, (uint8_t)arg);
+        emitArith(OP_ADD);
+        emitVariable(setOp, arg);
         emitByte(OP_POP);
     }
     else if (match(TOKEN_MINUS_MINUS))
     {
         // i-- (postfix)
-        emitBytes(getOp, (uint8_t)arg);  // Lê i → Stack: [5]
-        emitBytes(getOp, (uint8_t)arg);  // Lê i → Stack: [5, 5]
+        emitVariable(getOp, arg);   // Lê i → Stack: [5]
+        if (getOp == OP_GET_LOCAL && arg <= UINT8_MAX)
+        {
+            emitBytes(OP_DEC_LOCAL, (uint8_t)arg); // Stack: [5], slot = 4
+            return;
+        }
+        emitVariable(getOp, arg);   // Lê i → Stack: [5, 5]
         emitConstant(Value::makeInt(1)); // Stack: [5, 5, 1]
-        emitByte(OP_SUBTRACT);           // Stack: [5, 4]
-        emitBytes(setOp, (uint8_t)arg);  // Guarda 4, Stack: [5, 4]
+        emitArith(OP_SUBTRACT);          // Stack: [5, 4]
+        emitVariable(setOp, arg);   // Guarda 4, Stack: [5, 4]
         emitByte(OP_POP);                // Stack: [5]
     }
     else if (canAssign && match(TOKEN_EQUAL))
     {
         expression();
-        emitBytes(setOp, (uint8_t)arg);
+        emitVariable(setOp, arg);
     }
     else if (canAssign && match(TOKEN_PLUS_EQUAL))
     {
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
+        int valueStart = (int)currentChunk->count();
         expression();
-        emitByte(OP_ADD);
-        emitBytes(setOp, (uint8_t)arg);
+        if (stepLocal(getOp, arg, valueStart, OP_INC_LOCAL))
+            return;
+        emitArith(OP_ADD);
+        emitVariable(setOp, arg);
     }
     else if (canAssign && match(TOKEN_MINUS_EQUAL))
     {
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
+        int valueStart = (int)currentChunk->count();
         expression();
-        emitByte(OP_SUBTRACT);
-        emitBytes(setOp, (uint8_t)arg);
+        if (stepLocal(getOp, arg, valueStart, OP_DEC_LOCAL))
+            return;
+        emitArith(OP_SUBTRACT);
+        emitVariable(setOp, arg);
     }
     else if (canAssign && match(TOKEN_STAR_EQUAL))
     {
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
         expression();
         emitByte(OP_MULTIPLY);
-        emitBytes(setOp, (uint8_t)arg);
+        emitVariable(setOp, arg);
     }
     else if (canAssign && match(TOKEN_SLASH_EQUAL))
     {
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
         expression();
         emitByte(OP_DIVIDE);
-        emitBytes(setOp, (uint8_t)arg);
+        emitVariable(setOp, arg);
     }
     else if (canAssign && match(TOKEN_PERCENT_EQUAL))
     {
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
         expression();
         emitByte(OP_MODULO);
-        emitBytes(setOp, (uint8_t)arg);
+        emitVariable(setOp, arg);
     }
     else
     {
         // Leitura normal
-        emitBytes(getOp, (uint8_t)arg);
+        emitVariable(getOp, arg);
     }
 }
 
-void Compiler::defineVariable(uint8_t global)
+// x += 1 / x -= 1 num local: GET_LOCAL x, PUSH_INT 1 passa a INC/DEC_LOCAL x
+// no slot e um GET_LOCAL x para o valor da expressão
+bool Compiler::stepLocal(uint8_t getOp, int arg, int valueStart, uint8_t step)
+{
+    int end = (int)currentChunk->count();
+    if (getOp != OP_GET_LOCAL || arg > UINT8_MAX || peephole_.lastPushInt != valueStart ||
+        end != valueStart + 3 || pushedInt(valueStart) != 1 || !canFuse(valueStart - 2))
+        return false;
+
+    rewindTo(valueStart - 2);
+    emitBytes(step, (uint8_t)arg);
+    emitVariable(OP_GET_LOCAL, arg);
+    return true;
+}
+
+void Compiler::defineVariable(uint16_t global)
 {
     if (scopeDepth > 0)
     {
@@ -779,7 +1067,7 @@ void Compiler::defineVariable(uint8_t global)
         return;
     }
 
-    emitBytes(OP_DEFINE_GLOBAL, global);
+    emitVariable(OP_DEFINE_GLOBAL, global);
 }
 
 void Compiler::declareVariable()
@@ -814,6 +1102,8 @@ void Compiler::addLocal(Token &name)
         error("Too many local variables in function");
         return;
     }
+    if (localCount_ == (int)locals_.size())
+        locals_.push_back(Local());
 
     size_t len = name.lexeme.length();
 
@@ -833,6 +1123,43 @@ void Compiler::addLocal(Token &name)
     localCount_++;
 }
 
+// Slot 0 de cada frame guarda o callee (no script, um placeholder):
+// os parâmetros começam no slot 1. Sem nome, nunca é resolvido.
+void Compiler::reserveCalleeSlot()
+{
+    if (localCount_ == (int)locals_.size())
+        locals_.push_back(Local());
+    locals_[localCount_].name[0] = '\0';
+    locals_[localCount_].length = 0;
+    locals_[localCount_].depth = 0;
+    localCount_++;
+}
+
+// Com -O o middle end SSA corre primeiro; o optimizer de bytecode limpa
+// o que ficar (saltos encadeados, NOT+JUMP_IF_FALSE, ...)
+void Compiler::optimizeBytecode(Function *fn)
+{
+    // Com saltos por codificar o código ainda não é válido para o SSA
+    if (vm_ && vm_->isOptimizing() && farJumps_.empty())
+        SsaOptimizer::optimize(fn);
+    if (!Optimizer::optimize(fn, farJumps_) && !farJumps_.empty())
+        error("Too much code to jump over");
+}
+
+// O verifier dá à função o maxStack que a VM usa nas calls; se falhar
+// é bug do compiler, mas mais vale erro de compilação que stack corrompida
+void Compiler::verifyBytecode(Function *fn)
+{
+    char reason[128];
+    if (!vm_->verifyFunction(fn, reason, sizeof(reason)))
+    {
+        char message[192];
+        snprintf(message, sizeof(message), "Invalid bytecode in '%s': %s",
+                 fn->name.c_str(), reason);
+        error(message);
+    }
+}
+
 void Compiler::markInitialized()
 {
     if (scopeDepth == 0)
@@ -898,49 +1225,45 @@ void Compiler::ifStatement()
     expression();
     consume(TOKEN_RPAREN, "Expect ')' after condition");
 
-    // Jump para próximo bloco se condição for falsa
-    int thenJump = emitJump(OP_JUMP_IF_FALSE);
-    emitByte(OP_POP); // Pop da condição se for true
+    // Jump para próximo bloco se condição for falsa (a condição sai da
+    // stack no próprio salto)
+    int nextJump = emitConditionJump();
 
     // Then branch
     statement();
 
     // Lista de jumps para o final (depois de cada then/elif executar)
     std::vector<int> endJumps;
-    endJumps.push_back(emitJump(OP_JUMP)); // Jump do if
-
-    // Patch do thenJump (aponta para o próximo elif/else/end)
-    patchJump(thenJump);
-    emitByte(OP_POP); // Pop da condição se for false
 
     // Elif branches (pode ter vários)
     while (match(TOKEN_ELIF))
     {
+        // O bloco anterior salta para o final; o nextJump cai aqui
+        endJumps.push_back(emitJump(OP_JUMP));
+        patchJump(nextJump);
+
         // elif (condition)
         consume(TOKEN_LPAREN, "Expect '(' after 'elif'");
         expression();
         consume(TOKEN_RPAREN, "Expect ')' after elif condition");
 
-        // Jump para próximo bloco se condição for falsa
-        int elifJump = emitJump(OP_JUMP_IF_FALSE);
-        emitByte(OP_POP); // Pop se elif for true
+        nextJump = emitConditionJump();
 
         // Elif body
         statement();
-
-        // Jump para o final após executar elif
-        endJumps.push_back(emitJump(OP_JUMP));
-
-        // Patch do elifJump (aponta para próximo elif/else/end)
-        patchJump(elifJump);
-        emitByte(OP_POP); // Pop se elif for false
     }
 
     // Else branch (opcional)
     if (match(TOKEN_ELSE))
     {
+        endJumps.push_back(emitJump(OP_JUMP));
+        patchJump(nextJump);
         statement();
     }
+    else
+    {
+        patchJump(nextJump);
+    }
 
     // Patch todos os jumps para apontarem para o final
     for (int jump : endJumps)
@@ -991,7 +1314,14 @@ void Compiler::beginLoop(int loopStart)
     loopContexts_[loopDepth_].loopStart = loopStart;
     loopContexts_[loopDepth_].scopeDepth = scopeDepth;
     loopContexts_[loopDepth_].breakCount = 0;
+    loopContexts_[loopDepth_].continueCount = 0;
     loopDepth_++;
+
+    // loopStart é destino do OP_LOOP
+    if (loopStart > peephole_.lastJumpTarget)
+    {
+        peephole_.lastJumpTarget = loopStart;
+    }
 }
 
 void Compiler::endLoop()
@@ -1009,6 +1339,15 @@ void Compiler::endLoop()
     }
 }
 
+// POPs dos locais mais fundos que depth, sem os esquecer (break/continue)
+void Compiler::popLocalsAbove(int depth)
+{
+    for (int i = localCount_ - 1; i >= 0 && locals_[i].depth > depth; i--)
+    {
+        emitByte(OP_POP);
+    }
+}
+
 void Compiler::emitBreak()
 {
     if (loopDepth_ == 0)
@@ -1018,11 +1357,9 @@ void Compiler::emitBreak()
     }
     LoopContext &ctx = loopContexts_[loopDepth_ - 1];
 
-    while (localCount_ > 0 && locals_[localCount_ - 1].depth > ctx.scopeDepth)
-    {
-        emitByte(OP_POP);
-        localCount_--;
-    }
+    // Os locais continuam declarados: o código a seguir (outro ramo,
+    // o resto do bloco) ainda os tem na stack
+    popLocalsAbove(ctx.scopeDepth);
 
     if(!ctx.addBreak(emitJump(OP_JUMP)))
     {
@@ -1039,13 +1376,16 @@ void Compiler::emitContinue()
     }
     LoopContext &ctx = loopContexts_[loopDepth_ - 1];
 
-    while (localCount_ > 0 && locals_[localCount_ - 1].depth > ctx.scopeDepth)
+    popLocalsAbove(ctx.scopeDepth);
+
+    if (ctx.loopStart >= 0)
     {
-        emitByte(OP_POP);
-        localCount_--;
+        emitLoop(ctx.loopStart);
+    }
+    else if (!ctx.addContinue(emitJump(OP_JUMP)))
+    {
+        error("Too many continues");
     }
-
-    emitLoop(ctx.loopStart);
 }
 
 void Compiler::whileStatement()
@@ -1056,8 +1396,7 @@ void Compiler::whileStatement()
     expression();
     consume(TOKEN_RPAREN, "Expect ')' after condition");
 
-    int exitJump = emitJump(OP_JUMP_IF_FALSE);
-    emitByte(OP_POP);
+    int exitJump = emitConditionJump();
 
     beginLoop(loopStart); // Guarda loopStart SEM scope
 
@@ -1065,10 +1404,9 @@ void Compiler::whileStatement()
 
     emitLoop(loopStart);
 
-    endLoop(); // Patch dos breaks
-
     patchJump(exitJump);
-    emitByte(OP_POP);
+
+    endLoop(); // Patch dos breaks (a condição já saiu da stack no salto)
 }
 void Compiler::doWhileStatement()
 {
@@ -1092,12 +1430,10 @@ void Compiler::doWhileStatement()
     consume(TOKEN_SEMICOLON, "Expect ';' after do-while");
 
     // Se condição for TRUE, volta ao início
-    int exitJump = emitJump(OP_JUMP_IF_FALSE);
-    emitByte(OP_POP); // Pop se true
+    int exitJump = emitConditionJump();
     emitLoop(loopStart);
 
     patchJump(exitJump);
-    emitByte(OP_POP); // Pop se false
 
     endLoop();
 }
@@ -1122,71 +1458,66 @@ void Compiler::loopStatement()
     // Patch dos breaks (única forma de sair!)
     endLoop();
 }
+// Com pelo menos isto de cases literais o switch salta pela tabela; com
+// menos a cadeia de compares custa o mesmo
+static const int MIN_SWITCH_CASES = 3;
+
 void Compiler::switchStatement()
 {
     consume(TOKEN_LPAREN, "Expect '(' after 'switch'");
-    expression(); // Valor do switch fica na stack
+
+    // O valor do switch fica num slot até ao fim (no script também): um
+    // local com nome que o código não consegue escrever, que o endScope
+    // tira da stack
+    beginScope();
+    expression();
     consume(TOKEN_RPAREN, "Expect ')' after switch expression");
     consume(TOKEN_LBRACE, "Expect '{' before switch body");
 
-    // Variável temporária para guardar o valor do switch
-    int switchValueSlot = -1;
+    Token temp;
+    temp.lexeme = "__switch_temp__";
+    addLocal(temp);
+    markInitialized();
+    int switchValueSlot = localCount_ - 1;
 
-    if (scopeDepth > 0)
-    {
-        // Local: adiciona variável temporária
-        Token temp;
-        temp.lexeme = "__switch_temp__";
-        addLocal(temp);
-        markInitialized();
- 
-        switchValueSlot = localCount_ - 1;
-
-        emitBytes(OP_SET_LOCAL, (uint8_t)switchValueSlot);
-    }
-    else
-    {
-        // Global: cria variável temporária
-        const char *tempName = StringPool::instance().intern("__switch_temp__");
-        uint8_t globalIdx = makeConstant(Value::makeString(tempName));
-        emitBytes(OP_DEFINE_GLOBAL, globalIdx);
-    }
+    // A tabela só se conhece no fim: ver finishSwitch
+    int switchAt = (int)currentChunk->count();
+    emitByte(OP_SWITCH);
+    emitByte(0xff);
+    emitByte(0xff);
 
+    std::vector<SwitchCase> cases;
     std::vector<int> caseEndJumps;
+    bool constantCases = true;
     int defaultStart = -1;
-    bool hasDefault = false;
 
-    // Parse todos os cases
+    // Parse todos os cases. Cada um continua a ter o seu teste, para os
+    // switches que não dão tabela
     while (!check(TOKEN_RBRACE) && !check(TOKEN_EOF))
     {
         if (match(TOKEN_CASE))
         {
             // case VALUE:
+            emitVariable(OP_GET_LOCAL, switchValueSlot);
 
-            // Carrega valor do switch
-            if (switchValueSlot != -1)
-            {
-                emitBytes(OP_GET_LOCAL, (uint8_t)switchValueSlot);
-            }
-            else
-            {
-                const char *tempName = StringPool::instance().intern("__switch_temp__");
-                uint8_t globalIdx = makeConstant(Value::makeString(tempName));
-                emitBytes(OP_GET_GLOBAL, globalIdx);
-            }
-
-            // Valor do case
+            int valueStart = (int)currentChunk->count();
             expression();
             consume(TOKEN_COLON, "Expect ':' after case value");
 
-            // Compara
-            emitByte(OP_EQUAL);
+            // Um case depois do default só corre depois dele: fica na cadeia
+            SwitchCase entry;
+            if (defaultStart >= 0 || !caseConstant(valueStart, entry.value))
+                constantCases = false;
+
+            // Se NÃO for igual, salta este case (a comparação sai da stack)
+            emitCompare(OP_EQUAL);
+            int skipCase = emitConditionJump();
 
-            // Se NÃO for igual, salta este case
-            int skipCase = emitJump(OP_JUMP_IF_FALSE);
-            emitByte(OP_POP);
+            // O corpo é destino da tabela
+            entry.target = (int)currentChunk->count();
+            peephole_.lastJumpTarget = entry.target;
+            cases.push_back(entry);
 
-            // Executa statements do case
             while (!check(TOKEN_CASE) && !check(TOKEN_DEFAULT) &&
                    !check(TOKEN_RBRACE) && !check(TOKEN_EOF))
             {
@@ -1198,20 +1529,19 @@ void Compiler::switchStatement()
 
             // Se não era igual, salta para aqui (próximo case)
             patchJump(skipCase);
-            emitByte(OP_POP);
         }
         else if (match(TOKEN_DEFAULT))
         {
             // default:
             consume(TOKEN_COLON, "Expect ':' after 'default'");
 
-            if (hasDefault)
+            if (defaultStart >= 0)
             {
                 error("Switch can only have one 'default' case");
             }
-            hasDefault = true;
+            defaultStart = (int)currentChunk->count();
+            peephole_.lastJumpTarget = defaultStart;
 
-            // Executa statements
             while (!check(TOKEN_CASE) && !check(TOKEN_RBRACE) && !check(TOKEN_EOF))
             {
                 statement();
@@ -1232,15 +1562,120 @@ void Compiler::switchStatement()
         patchJump(jump);
     }
 
-    // Limpa variável temporária do switch
-    if (switchValueSlot != -1)
+    int end = (int)currentChunk->count();
+    finishSwitch(switchAt, constantCases ? cases : std::vector<SwitchCase>(),
+                 defaultStart >= 0 ? defaultStart : end);
+
+    // Limpa o valor do switch
+    endScope();
+}
+
+// Valor de um case que é só um literal int (com - à frente, ou não) ou
+// string, emitido a partir de start
+bool Compiler::caseConstant(int start, Value &value) const
+{
+    const std::vector<uint8_t> &code = currentChunk->code;
+    int end = (int)code.size();
+    if (start >= end)
+        return false;
+
+    int length;
+    switch (code[start])
     {
-        // Local - já vai ser limpo pelo endScope se necessário
+    case OP_PUSH_INT:
+        value = Value::makeInt(pushedInt(start));
+        length = 3;
+        break;
+    case OP_CONSTANT:
+        if (start + 1 >= end)
+            return false;
+        value = currentChunk->constants[code[start + 1]];
+        length = 2;
+        break;
+    case OP_CONSTANT_LONG:
+        if (start + 3 >= end)
+            return false;
+        value = currentChunk->constants[(code[start + 1] << 16) | (code[start + 2] << 8) |
+                                        code[start + 3]];
+        length = 4;
+        break;
+    default:
+        return false;
     }
-    else
+
+    if (start + length == end - 1 && code[end - 1] == OP_NEGATE && value.isInt() &&
+        value.asInt() != INT32_MIN)
     {
-        // Global - podemos deixar (ou limpar )
+        value = Value::makeInt(-value.asInt());
+        length++;
     }
+    return start + length == end && (value.isInt() || value.isString());
+}
+
+// Preenche o OP_SWITCH emitido em `at`. Sem cases suficientes (ou algum
+// que não seja literal) passa a um salto para a instrução seguinte, que o
+// optimizer apaga, e o switch é a cadeia de compares. Com tabela a cadeia
+// fica inalcançável. Valores repetidos: ganha o primeiro case, como na
+// cadeia.
+void Compiler::finishSwitch(int at, const std::vector<SwitchCase> &cases, int defaultTarget)
+{
+    std::vector<uint8_t> &code = currentChunk->code;
+    if ((int)cases.size() < MIN_SWITCH_CASES || currentChunk->switches.size() > UINT16_MAX)
+    {
+        code[at] = OP_JUMP;
+        code[at + 1] = 0;
+        code[at + 2] = 0;
+        return;
+    }
+
+    SwitchTable table;
+    table.defaultTarget = defaultTarget;
+
+    // Ints em vetor se pelo menos metade das posições tiver case
+    int ints = 0;
+    int low = INT32_MAX, high = INT32_MIN;
+    for (const SwitchCase &entry : cases)
+    {
+        if (!entry.value.isInt())
+            continue;
+        ints++;
+        low = std::min(low, entry.value.asInt());
+        high = std::max(high, entry.value.asInt());
+    }
+    bool dense = ints > 0 && (long long)high - low + 1 <= 2LL * ints;
+    if (dense)
+    {
+        table.low = low;
+        table.dense.assign((size_t)(high - low + 1), -1);
+    }
+
+    for (const SwitchCase &entry : cases)
+    {
+        if (entry.value.isString())
+        {
+            table.strings.insert(std::make_pair(entry.value.asString(), entry.target));
+        }
+        else if (dense)
+        {
+            int &target = table.dense[(size_t)(entry.value.asInt() - low)];
+            if (target < 0)
+                target = entry.target;
+        }
+        else
+        {
+            table.ints.insert(std::make_pair(entry.value.asInt(), entry.target));
+        }
+    }
+    for (int &target : table.dense)
+    {
+        if (target < 0)
+            target = defaultTarget;
+    }
+
+    int index = (int)currentChunk->switches.size();
+    currentChunk->switches.push_back(table);
+    code[at + 1] = (uint8_t)((index >> 8) & 0xff);
+    code[at + 2] = (uint8_t)(index & 0xff);
 }
 
 void Compiler::breakStatement()
@@ -1282,14 +1717,18 @@ void Compiler::forStatement()
 
     // CONDITION (opcional)
     int exitJump = -1;
+    CountedFor counted;
+    bool isCounted = false;
     if (!check(TOKEN_SEMICOLON))
     {
         expression(); // i < 10
         consume(TOKEN_SEMICOLON, "Expect ';' after loop condition");
 
+        // Antes do emitConditionJump, que funde o compare no salto
+        isCounted = countedCondition(loopStart, counted);
+
         // salta para fora se condição for falsa
-        exitJump = emitJump(OP_JUMP_IF_FALSE);
-        emitByte(OP_POP); // Pop da condição
+        exitJump = emitConditionJump();
     }
     else
     {
@@ -1306,6 +1745,18 @@ void Compiler::forStatement()
 
         int incrementStart = currentChunk->count();
         expression();     // i = i + 1
+
+        // for numérico: deita fora o que foi emitido e recomeça com
+        // FOR_PREP/FOR_LOOP (ver countedFor)
+        if (isCounted && countedIncrement(incrementStart, counted))
+        {
+            consume(TOKEN_RPAREN, "Expect ')' after for clauses");
+            rewindTo(loopStart);
+            countedFor(counted);
+            endScope();
+            return;
+        }
+
         emitByte(OP_POP); // Pop do resultado
         consume(TOKEN_RPAREN, "Expect ')' after for clauses");
 
@@ -1336,13 +1787,184 @@ void Compiler::forStatement()
     if (exitJump != -1)
     {
         patchJump(exitJump);
-        emitByte(OP_POP); // Pop da condição falsa
     }
 
     endLoop();  // Patch dos breaks
     endScope(); // Limpa variáveis do initializer
 }
 
+// ============================================
+// FOR NUMÉRICO
+// ============================================
+// for (var i = a; i < b; i++) com contador local, limite local ou literal
+// e passo constante: em vez de condição + salto + incremento + OP_LOOP
+// (quatro dispatches por iteração) sai
+//
+//        FOR_PREP  i n <  -> exit
+//   body:
+//        ...
+//        FOR_LOOP  i n < +1 -> body
+//   exit:
+//
+// O limite é lido do slot em cada iteração, como a condição original; um
+// literal vai para um local escondido.
+
+// Condição em [start, fim): GET_LOCAL c, limite, compare de ordem
+bool Compiler::countedCondition(int start, CountedFor &loop)
+{
+    const uint8_t *code = currentChunk->code.data();
+    int end = (int)currentChunk->count();
+
+    if (end - start < 5 || code[start] != OP_GET_LOCAL)
+        return false;
+    uint8_t compare = code[end - 1];
+    if (compare < OP_GREATER || compare > OP_LESS_EQUAL)
+        return false;
+
+    int limit = start + 2;
+    loop.counter = code[start + 1];
+    loop.compare = compare;
+    loop.limitOp = code[limit];
+    switch (loop.limitOp)
+    {
+    case OP_GET_LOCAL:
+        loop.limitArg = code[limit + 1];
+        return end - limit == 3;
+    case OP_PUSH_INT:
+        loop.limitArg = pushedInt(limit);
+        return end - limit == 4;
+    case OP_CONSTANT:
+    {
+        loop.limitArg = code[limit + 1];
+        const Value &value = currentChunk->constants[loop.limitArg];
+        return end - limit == 3 && (value.isInt() || value.isDouble());
+    }
+    default:
+        return false;
+    }
+}
+
+// Incremento em [start, fim) que só soma uma constante ao contador:
+// i++, ++i, i += k, i = i + k e os simétricos
+bool Compiler::countedIncrement(int start, CountedFor &loop)
+{
+    const uint8_t *code = currentChunk->code.data();
+    int length = (int)currentChunk->count() - start;
+    uint8_t c = loop.counter;
+
+    // Um literal precisa de um slot para o limite
+    if (loop.limitOp != OP_GET_LOCAL && localCount_ > UINT8_MAX)
+        return false;
+
+    if (length == 4)
+    {
+        // GET_LOCAL c, INC_LOCAL c (i++) ou INC_LOCAL c, GET_LOCAL c (++i)
+        uint8_t step = code[start] == OP_GET_LOCAL ? code[start + 2] : code[start];
+        uint8_t get = code[start] == OP_GET_LOCAL ? code[start] : code[start + 2];
+        if (get != OP_GET_LOCAL || code[start + 1] != c || code[start + 3] != c)
+            return false;
+        if (step != OP_INC_LOCAL && step != OP_DEC_LOCAL)
+            return false;
+        loop.step = step == OP_INC_LOCAL ? 1 : -1;
+        return true;
+    }
+
+    // GET_LOCAL c, ADD_IMM/SUBTRACT_IMM k, SET_LOCAL c
+    if (length != 7 || code[start] != OP_GET_LOCAL || code[start + 1] != c ||
+        code[start + 5] != OP_SET_LOCAL || code[start + 6] != c)
+        return false;
+
+    int16_t k = pushedInt(start + 2);
+    if (code[start + 2] == OP_ADD_IMM)
+        loop.step = k;
+    else if (code[start + 2] == OP_SUBTRACT_IMM && k != INT16_MIN)
+        loop.step = (int16_t)-k;
+    else
+        return false;
+    return true;
+}
+
+void Compiler::countedFor(const CountedFor &loop)
+{
+    uint8_t limit = (uint8_t)loop.limitArg;
+    if (loop.limitOp != OP_GET_LOCAL)
+    {
+        if (loop.limitOp == OP_PUSH_INT)
+        {
+            emitByte(OP_PUSH_INT);
+            emitByte((uint8_t)((loop.limitArg >> 8) & 0xff));
+            emitByte((uint8_t)(loop.limitArg & 0xff));
+        }
+        else
+        {
+            emitBytes(OP_CONSTANT, (uint8_t)loop.limitArg);
+        }
+
+        Token hidden;
+        hidden.lexeme = "__for_limit__";
+        addLocal(hidden);
+        markInitialized();
+        limit = (uint8_t)(localCount_ - 1);
+    }
+
+    emitByte(OP_FOR_PREP);
+    emitByte(loop.counter);
+    emitByte(limit);
+    emitByte(loop.compare);
+    emitByte(0xff);
+    emitByte(0xff);
+    int exitJump = currentChunk->count() - 2;
+
+    // O corpo é destino do FOR_LOOP; o continue salta para o FOR_LOOP
+    int bodyStart = currentChunk->count();
+    beginLoop(-1);
+    peephole_.lastJumpTarget = bodyStart;
+
+    statement();
+
+    LoopContext &ctx = loopContexts_[loopDepth_ - 1];
+    for (int i = 0; i < ctx.continueCount; i++)
+    {
+        patchJump(ctx.continueJumps[i]);
+    }
+
+    uint8_t stepHi = (uint8_t)((loop.step >> 8) & 0xff);
+    uint8_t stepLo = (uint8_t)(loop.step & 0xff);
+    int offset = currentChunk->count() - bodyStart + 8;
+    if (offset <= UINT16_MAX)
+    {
+        emitByte(OP_FOR_LOOP);
+        emitByte(loop.counter);
+        emitByte(limit);
+        emitByte(loop.compare);
+        emitByte(stepHi);
+        emitByte(stepLo);
+        emitByte((offset >> 8) & 0xff);
+        emitByte(offset & 0xff);
+    }
+    else
+    {
+        offset++;
+        if (offset > 0xffffff)
+        {
+            error("Loop body too large");
+        }
+
+        emitByte(OP_FOR_LOOP_LONG);
+        emitByte(loop.counter);
+        emitByte(limit);
+        emitByte(loop.compare);
+        emitByte(stepHi);
+        emitByte(stepLo);
+        emitByte((offset >> 16) & 0xff);
+        emitByte((offset >> 8) & 0xff);
+        emitByte(offset & 0xff);
+    }
+
+    patchJump(exitJump);
+    endLoop(); // Patch dos breaks
+}
+
 void Compiler::returnStatement()
 {
 
@@ -1362,7 +1984,19 @@ void Compiler::returnStatement()
         // return <expr>;
         expression();
         consume(TOKEN_SEMICOLON, "Expect ';' after return value");
-        emitByte(OP_RETURN);
+
+        // return f(...): se a call é a última instrução e nenhum salto
+        // cai depois dela, vira tail call e o OP_RETURN não é preciso
+        int call = peephole_.lastCall;
+        if (call >= 0 && call + 2 == (int)currentChunk->count() && canFuse(call))
+        {
+            uint8_t &op = currentChunk->code[call];
+            op = (op == OP_CALL_DIRECT) ? OP_TAIL_CALL_DIRECT : OP_TAIL_CALL;
+        }
+        else
+        {
+            emitByte(OP_RETURN);
+        }
     }
 
     function->hasReturn = true;
@@ -1393,6 +2027,7 @@ uint8_t Compiler::argumentList()
 void Compiler::call(bool canAssign)
 {
     uint8_t argCount = argumentList();
+    peephole_.lastCall = (int)currentChunk->count();
     emitByte(OP_CALL);
     emitByte(argCount);
 }
@@ -1410,7 +2045,7 @@ void Compiler::funDeclaration()
         return;
     }
 
-    uint8_t nameConstant = identifierConstant(nameToken);
+    uint16_t nameSlot = scopeDepth == 0 ? globalSlot(nameToken) : 0;
 
     // 2. Declare variable (antes de compilar o corpo!)
     if (scopeDepth > 0)
@@ -1422,7 +2057,7 @@ void Compiler::funDeclaration()
     compileFunction(nameToken.lexeme);
 
     // 4. Define variable
-    defineVariable(nameConstant);
+    defineVariable(nameSlot);
 }
 void Compiler::compileFunction(const std::string &name)
 {
@@ -1434,15 +2069,22 @@ void Compiler::compileFunction(const std::string &name)
 
     Function *function = new Function(name, 0);
     uint16_t idx = vm_->registerFunction(name, function);
+    if (vm_->isSharingConstants())
+        function->chunk.constants.share(currentChunk->constants);
 
     // Salvar estado do compiler atual
     Function *enclosingFunction = this->function;
     Chunk *enclosingChunk = this->currentChunk;
     int enclosingScopeDepth = this->scopeDepth;
 
-    Local enclosingLocals[MAX_LOCALS];
+    std::vector<Local> enclosingLocals(locals_.begin(), locals_.begin() + localCount_);
     int enclosingLocalCount = this->localCount_;
-    std::memcpy(enclosingLocals, locals_, sizeof(Local) * localCount_);
+
+    std::vector<FarJump> enclosingFarJumps;
+    enclosingFarJumps.swap(farJumps_);
+
+    Peephole enclosingPeephole = this->peephole_;
+    this->peephole_.reset();
 
     // Mudar para compilar a função
     this->function = function;
@@ -1450,6 +2092,7 @@ void Compiler::compileFunction(const std::string &name)
     this->scopeDepth = 0;
 
     this->localCount_ = 0;
+    reserveCalleeSlot();
 
     function->hasReturn = false;
 
@@ -1486,6 +2129,12 @@ void Compiler::compileFunction(const std::string &name)
     {
         emitReturn();
     }
+    if (!hadError)
+    {
+        optimizeBytecode(function);
+        verifyBytecode(function);
+    }
+    RegisterCompiler::compile(function);
 
     // Restaurar estado do compiler
     this->function = enclosingFunction;
@@ -1493,9 +2142,11 @@ void Compiler::compileFunction(const std::string &name)
     this->scopeDepth = enclosingScopeDepth;
 
     this->localCount_ = enclosingLocalCount;
-    std::memcpy(locals_, enclosingLocals, sizeof(Local) * localCount_);
+    std::copy(enclosingLocals.begin(), enclosingLocals.end(), locals_.begin());
+    this->peephole_ = enclosingPeephole;
+    farJumps_.swap(enclosingFarJumps);
 
-    emitBytes(OP_CONSTANT, makeConstant(Value::makeFunction(idx)));
+    emitConstant(Value::makeFunction(idx));
 }
 
 void Compiler::prefixIncrement(bool canAssign)
@@ -1522,19 +2173,23 @@ void Compiler::prefixIncrement(bool canAssign)
     }
     else
     {
-        arg = identifierConstant(name);
+        arg = globalSlot(name);
         getOp = OP_GET_GLOBAL;
         setOp = OP_SET_GLOBAL;
     }
 
-    // i = i + 1
-    emitBytes(getOp, (uint8_t)arg);
-    emitConstant(Value::makeInt(1));
-    emitByte(OP_ADD);
-    emitBytes(setOp, (uint8_t)arg);
+    if (getOp == OP_GET_LOCAL && arg <= UINT8_MAX)
+    {
+        emitBytes(OP_INC_LOCAL, (uint8_t)arg);
+        emitVariable(getOp, arg);
+        return;
+    }
 
-    // Lê o novo valor para retornar
-    emitBytes(getOp, (uint8_t)arg);
+    // i = i + 1 (o SET deixa o novo valor na stack)
+    emitVariable(getOp, arg);
+    emitConstant(Value::makeInt(1));
+    emitArith(OP_ADD);
+    emitVariable(setOp, arg);
 }
 
 void Compiler::prefixDecrement(bool canAssign)
@@ -1560,15 +2215,20 @@ void Compiler::prefixDecrement(bool canAssign)
     }
     else
     {
-        arg = identifierConstant(name);
+        arg = globalSlot(name);
         getOp = OP_GET_GLOBAL;
         setOp = OP_SET_GLOBAL;
     }
 
-    emitBytes(getOp, (uint8_t)arg);
-    emitConstant(Value::makeInt(1));
-    emitByte(OP_SUBTRACT);
-    emitBytes(setOp, (uint8_t)arg);
+    if (getOp == OP_GET_LOCAL && arg <= UINT8_MAX)
+    {
+        emitBytes(OP_DEC_LOCAL, (uint8_t)arg);
+        emitVariable(getOp, arg);
+        return;
+    }
 
-    emitBytes(getOp, (uint8_t)arg);
+    emitVariable(getOp, arg);
+    emitConstant(Value::makeInt(1));
+    emitArith(OP_SUBTRACT);
+    emitVariable(setOp, arg);
 }
@@ -15,13 +15,14 @@ int Debug::disassembleInstruction(const Chunk &chunk, int offset)
 {
     printf("%04d ", offset);
 
-    if (offset > 0 && chunk.lines[offset] == chunk.lines[offset - 1])
+    int line = chunk.lines.lineAt(offset);
+    if (offset > 0 && line == chunk.lines.lineAt(offset - 1))
     {
         printf("   | ");
     }
     else
     {
-        printf("%4d ", chunk.lines[offset]);
+        printf("%4d ", line);
     }
 
     uint8_t instruction = chunk.code[offset];
@@ -47,6 +48,10 @@ int Debug::disassembleInstruction(const Chunk &chunk, int offset)
         return simpleInstruction("OP_DIVIDE", offset);
     case OP_NEGATE:
         return simpleInstruction("OP_NEGATE", offset);
+    case OP_NOT:
+        return simpleInstruction("OP_NOT", offset);
+    case OP_MODULO:
+        return simpleInstruction("OP_MODULO", offset);
     case OP_EQUAL:
         return simpleInstruction("OP_EQUAL", offset);
     case OP_NOT_EQUAL:
@@ -65,24 +70,173 @@ int Debug::disassembleInstruction(const Chunk &chunk, int offset)
         return byteInstruction("OP_GET_LOCAL", chunk, offset);
     case OP_SET_LOCAL:
         return byteInstruction("OP_SET_LOCAL", chunk, offset);
+    case OP_GET_GLOBAL:
+        return shortInstruction("OP_GET_GLOBAL", chunk, offset);
+    case OP_SET_GLOBAL:
+        return shortInstruction("OP_SET_GLOBAL", chunk, offset);
+    case OP_DEFINE_GLOBAL:
+        return shortInstruction("OP_DEFINE_GLOBAL", chunk, offset);
+    case OP_CALL:
+        return byteInstruction("OP_CALL", chunk, offset);
+    case OP_TAIL_CALL:
+        return byteInstruction("OP_TAIL_CALL", chunk, offset);
+    case OP_SQRT:
+        return simpleInstruction("OP_SQRT", offset);
+    case OP_ABS:
+        return simpleInstruction("OP_ABS", offset);
+    case OP_POW:
+        return simpleInstruction("OP_POW", offset);
+    case OP_LEN:
+        return simpleInstruction("OP_LEN", offset);
+    case OP_STR:
+        return simpleInstruction("OP_STR", offset);
+    case OP_CALL_DIRECT:
+        return byteInstruction("OP_CALL_DIRECT", chunk, offset);
+    case OP_TAIL_CALL_DIRECT:
+        return byteInstruction("OP_TAIL_CALL_DIRECT", chunk, offset);
     case OP_JUMP:
         return jumpInstruction("OP_JUMP", 1, chunk, offset);
     case OP_JUMP_IF_FALSE:
         return jumpInstruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
+    case OP_JUMP_IF_TRUE:
+        return jumpInstruction("OP_JUMP_IF_TRUE", 1, chunk, offset);
     case OP_LOOP:
         return jumpInstruction("OP_LOOP", -1, chunk, offset);
     case OP_CALL_NATIVE:
     {
-        uint8_t nameIdx = chunk.code[offset + 1];
+        uint8_t native = chunk.code[offset + 1];
         uint8_t argCount = chunk.code[offset + 2];
-        printf("%-16s %4d '%s' (%d args)\n", "OP_CALL_NATIVE",
-               nameIdx,
-               chunk.constants[nameIdx].asString(),
-               argCount);
+        printf("%-16s %4d (%d args)\n", "OP_CALL_NATIVE", native, argCount);
         return offset + 3;
     }
     case OP_RETURN:
         return simpleInstruction("OP_RETURN", offset);
+    case OP_RETURN_NIL:
+        return simpleInstruction("OP_RETURN_NIL", offset);
+
+    // Quickened
+    case OP_ADD_INT:
+        return simpleInstruction("OP_ADD_INT", offset);
+    case OP_ADD_DOUBLE:
+        return simpleInstruction("OP_ADD_DOUBLE", offset);
+    case OP_ADD_STRING:
+        return simpleInstruction("OP_ADD_STRING", offset);
+    case OP_SUBTRACT_INT:
+        return simpleInstruction("OP_SUBTRACT_INT", offset);
+    case OP_SUBTRACT_DOUBLE:
+        return simpleInstruction("OP_SUBTRACT_DOUBLE", offset);
+    case OP_MULTIPLY_INT:
+        return simpleInstruction("OP_MULTIPLY_INT", offset);
+    case OP_MULTIPLY_DOUBLE:
+        return simpleInstruction("OP_MULTIPLY_DOUBLE", offset);
+    case OP_EQUAL_INT:
+        return simpleInstruction("OP_EQUAL_INT", offset);
+    case OP_NOT_EQUAL_INT:
+        return simpleInstruction("OP_NOT_EQUAL_INT", offset);
+    case OP_GREATER_INT:
+        return simpleInstruction("OP_GREATER_INT", offset);
+    case OP_GREATER_DOUBLE:
+        return simpleInstruction("OP_GREATER_DOUBLE", offset);
+    case OP_GREATER_EQUAL_INT:
+        return simpleInstruction("OP_GREATER_EQUAL_INT", offset);
+    case OP_GREATER_EQUAL_DOUBLE:
+        return simpleInstruction("OP_GREATER_EQUAL_DOUBLE", offset);
+    case OP_LESS_INT:
+        return simpleInstruction("OP_LESS_INT", offset);
+    case OP_LESS_DOUBLE:
+        return simpleInstruction("OP_LESS_DOUBLE", offset);
+    case OP_LESS_EQUAL_INT:
+        return simpleInstruction("OP_LESS_EQUAL_INT", offset);
+    case OP_LESS_EQUAL_DOUBLE:
+        return simpleInstruction("OP_LESS_EQUAL_DOUBLE", offset);
+
+    // Superinstructions
+    case OP_ADD_LOCALS:
+    {
+        uint8_t a = chunk.code[offset + 1];
+        uint8_t b = chunk.code[offset + 2];
+        printf("%-16s %4d %4d\n", "OP_ADD_LOCALS", a, b);
+        return offset + 3;
+    }
+    case OP_ADD_CONST:
+        return constantInstruction("OP_ADD_CONST", chunk, offset);
+    case OP_SUBTRACT_CONST:
+        return constantInstruction("OP_SUBTRACT_CONST", chunk, offset);
+    case OP_INC_LOCAL:
+        return byteInstruction("OP_INC_LOCAL", chunk, offset);
+    case OP_DEC_LOCAL:
+        return byteInstruction("OP_DEC_LOCAL", chunk, offset);
+
+    // Formas largas
+    case OP_CONSTANT_LONG:
+    {
+        int index = (chunk.code[offset + 1] << 16) | (chunk.code[offset + 2] << 8) |
+                    chunk.code[offset + 3];
+        printf("%-16s %4d '", "OP_CONSTANT_LONG", index);
+        printValue(chunk.constants[index]);
+        printf("'\n");
+        return offset + 4;
+    }
+    case OP_GET_LOCAL_LONG:
+        return shortInstruction("OP_GET_LOCAL_LONG", chunk, offset);
+    case OP_SET_LOCAL_LONG:
+        return shortInstruction("OP_SET_LOCAL_LONG", chunk, offset);
+    case OP_JUMP_LONG:
+        return longJumpInstruction("OP_JUMP_LONG", 1, chunk, offset);
+    case OP_JUMP_IF_FALSE_LONG:
+        return longJumpInstruction("OP_JUMP_IF_FALSE_LONG", 1, chunk, offset);
+    case OP_JUMP_IF_TRUE_LONG:
+        return longJumpInstruction("OP_JUMP_IF_TRUE_LONG", 1, chunk, offset);
+    case OP_LOOP_LONG:
+        return longJumpInstruction("OP_LOOP_LONG", -1, chunk, offset);
+
+    // Imediatos
+    case OP_PUSH_INT:
+        return immediateInstruction("OP_PUSH_INT", chunk, offset);
+    case OP_ADD_IMM:
+        return immediateInstruction("OP_ADD_IMM", chunk, offset);
+    case OP_SUBTRACT_IMM:
+        return immediateInstruction("OP_SUBTRACT_IMM", chunk, offset);
+
+    // Condições
+    case OP_POP_JUMP_IF_FALSE:
+        return jumpInstruction("OP_POP_JUMP_IF_FALSE", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_EQUAL:
+        return jumpInstruction("OP_JUMP_IF_NOT_EQUAL", 1, chunk, offset);
+    case OP_JUMP_IF_EQUAL:
+        return jumpInstruction("OP_JUMP_IF_EQUAL", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_GREATER:
+        return jumpInstruction("OP_JUMP_IF_NOT_GREATER", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+        return jumpInstruction("OP_JUMP_IF_NOT_GREATER_EQUAL", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_LESS:
+        return jumpInstruction("OP_JUMP_IF_NOT_LESS", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+        return jumpInstruction("OP_JUMP_IF_NOT_LESS_EQUAL", 1, chunk, offset);
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_NOT_EQUAL_IMM", chunk, offset);
+    case OP_JUMP_IF_EQUAL_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_EQUAL_IMM", chunk, offset);
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_NOT_GREATER_IMM", chunk, offset);
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_NOT_GREATER_EQUAL_IMM", chunk, offset);
+    case OP_JUMP_IF_NOT_LESS_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_NOT_LESS_IMM", chunk, offset);
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        return immediateJumpInstruction("OP_JUMP_IF_NOT_LESS_EQUAL_IMM", chunk, offset);
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        return longJumpInstruction("OP_POP_JUMP_IF_FALSE_LONG", 1, chunk, offset);
+    case OP_FOR_PREP:
+        return forInstruction("OP_FOR_PREP", chunk, offset);
+    case OP_FOR_LOOP:
+        return forInstruction("OP_FOR_LOOP", chunk, offset);
+    case OP_FOR_PREP_LONG:
+        return forInstruction("OP_FOR_PREP_LONG", chunk, offset);
+    case OP_FOR_LOOP_LONG:
+        return forInstruction("OP_FOR_LOOP_LONG", chunk, offset);
+    case OP_SWITCH:
+        return switchInstruction("OP_SWITCH", chunk, offset);
     default:
         printf("Unknown opcode %d\n", instruction);
         return offset + 1;
@@ -111,6 +265,13 @@ int Debug::byteInstruction(const char *name, const Chunk &chunk, int offset)
     return offset + 2;
 }
 
+int Debug::shortInstruction(const char *name, const Chunk &chunk, int offset)
+{
+    uint16_t slot = (uint16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    printf("%-16s %4d\n", name, slot);
+    return offset + 3;
+}
+
 int Debug::jumpInstruction(const char *name, int sign, const Chunk &chunk, int offset)
 {
     uint16_t jump = (uint16_t)(chunk.code[offset + 1] << 8);
@@ -118,3 +279,231 @@ int Debug::jumpInstruction(const char *name, int sign, const Chunk &chunk, int o
     printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
     return offset + 3;
 }
+
+int Debug::longJumpInstruction(const char *name, int sign, const Chunk &chunk, int offset)
+{
+    int jump = (chunk.code[offset + 1] << 16) | (chunk.code[offset + 2] << 8) |
+               chunk.code[offset + 3];
+    printf("%-16s %4d -> %d\n", name, offset, offset + 4 + sign * jump);
+    return offset + 4;
+}
+
+int Debug::immediateInstruction(const char *name, const Chunk &chunk, int offset)
+{
+    int16_t value = (int16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    printf("%-16s %4d\n", name, value);
+    return offset + 3;
+}
+
+int Debug::immediateJumpInstruction(const char *name, const Chunk &chunk, int offset)
+{
+    int16_t value = (int16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    int jump = (chunk.code[offset + 3] << 8) | chunk.code[offset + 4];
+    printf("%-16s %4d %4d -> %d\n", name, value, offset, offset + 5 + jump);
+    return offset + 5;
+}
+
+int Debug::forInstruction(const char *name, const Chunk &chunk, int offset)
+{
+    uint8_t op = chunk.code[offset];
+    bool loop = op == OP_FOR_LOOP || op == OP_FOR_LOOP_LONG;
+    bool wide = op == OP_FOR_PREP_LONG || op == OP_FOR_LOOP_LONG;
+    int length = (loop ? 8 : 6) + (wide ? 1 : 0);
+
+    static const char *compares[] = {">", ">=", "<", "<="};
+    uint8_t compare = chunk.code[offset + 3];
+    const char *cmp = compare >= OP_GREATER && compare <= OP_LESS_EQUAL
+                          ? compares[compare - OP_GREATER]
+                          : "?";
+
+    const uint8_t *at = &chunk.code[offset + (loop ? 6 : 4)];
+    int jump = wide ? (at[0] << 16) | (at[1] << 8) | at[2] : (at[0] << 8) | at[1];
+    printf("%-16s %4d %s %d", name, chunk.code[offset + 1], cmp, chunk.code[offset + 2]);
+    if (loop)
+    {
+        int16_t step = (int16_t)((chunk.code[offset + 4] << 8) | chunk.code[offset + 5]);
+        printf(" step %d -> %d\n", step, offset + length - jump);
+    }
+    else
+    {
+        printf(" -> %d\n", offset + length + jump);
+    }
+    return offset + length;
+}
+
+int Debug::switchInstruction(const char *name, const Chunk &chunk, int offset)
+{
+    uint16_t index = (uint16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    printf("%-16s %4d", name, index);
+    if (index < chunk.switches.size())
+    {
+        const SwitchTable &table = chunk.switches[index];
+        printf(" %d dense from %d, %d sparse, %d strings, default -> %d",
+               (int)table.dense.size(), table.low, (int)table.ints.size(),
+               (int)table.strings.size(), table.defaultTarget);
+    }
+    printf("\n");
+    return offset + 3;
+}
+
+// ============================================
+// FORMATO REGISTER
+// ============================================
+
+void Debug::disassembleRegisterCode(const Function &function)
+{
+    printf("== %s (register, %d regs) ==\n", function.name.c_str(), function.regCount);
+
+    for (size_t offset = 0; offset < function.regCode.size();)
+    {
+        offset = disassembleRegisterInstruction(function, offset);
+    }
+}
+
+int Debug::disassembleRegisterInstruction(const Function &function, int offset)
+{
+    const std::vector<uint8_t> &code = function.regCode;
+    const Chunk &chunk = function.chunk;
+
+    printf("%04d ", offset);
+    int line = function.regLines.lineAt(offset);
+    if (offset > 0 && line == function.regLines.lineAt(offset - 1))
+    {
+        printf("   | ");
+    }
+    else
+    {
+        printf("%4d ", line);
+    }
+
+    uint8_t instruction = code[offset];
+    switch (instruction)
+    {
+    case R_MOVE:
+        printf("%-16s r%d r%d\n", "R_MOVE", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_LOADK:
+        printf("%-16s r%d '", "R_LOADK", code[offset + 1]);
+        printValue(chunk.constants[code[offset + 2]]);
+        printf("'\n");
+        return offset + 3;
+    case R_GET_GLOBAL:
+    case R_SET_GLOBAL:
+    case R_DEFINE_GLOBAL:
+        printf("%-16s r%d g%d\n",
+               instruction == R_GET_GLOBAL   ? "R_GET_GLOBAL"
+               : instruction == R_SET_GLOBAL ? "R_SET_GLOBAL"
+                                             : "R_DEFINE_GLOBAL",
+               code[offset + 1], (code[offset + 2] << 8) | code[offset + 3]);
+        return offset + 4;
+    case R_LOADNIL:
+        printf("%-16s r%d\n", "R_LOADNIL", code[offset + 1]);
+        return offset + 2;
+    case R_LOADTRUE:
+        printf("%-16s r%d\n", "R_LOADTRUE", code[offset + 1]);
+        return offset + 2;
+    case R_LOADFALSE:
+        printf("%-16s r%d\n", "R_LOADFALSE", code[offset + 1]);
+        return offset + 2;
+    case R_INC:
+        printf("%-16s r%d\n", "R_INC", code[offset + 1]);
+        return offset + 2;
+    case R_DEC:
+        printf("%-16s r%d\n", "R_DEC", code[offset + 1]);
+        return offset + 2;
+    case R_PRINT:
+        printf("%-16s r%d\n", "R_PRINT", code[offset + 1]);
+        return offset + 2;
+    case R_RETURN:
+        printf("%-16s r%d\n", "R_RETURN", code[offset + 1]);
+        return offset + 2;
+    case R_RETURN_NIL:
+        printf("R_RETURN_NIL\n");
+        return offset + 1;
+    case R_NEGATE:
+        printf("%-16s r%d r%d\n", "R_NEGATE", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_NOT:
+        printf("%-16s r%d r%d\n", "R_NOT", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_SQRT:
+    case R_ABS:
+    case R_LEN:
+    case R_STR:
+    {
+        static const char *names[] = {"R_SQRT", "R_ABS", "R_POW", "R_LEN", "R_STR"};
+        printf("%-16s r%d r%d\n", names[instruction - R_SQRT], code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    }
+    case R_POW:
+        printf("%-16s r%d r%d r%d\n", "R_POW", code[offset + 1], code[offset + 2], code[offset + 3]);
+        return offset + 4;
+    case R_ADDK:
+    case R_SUBTRACTK:
+        printf("%-16s r%d r%d '", instruction == R_ADDK ? "R_ADDK" : "R_SUBTRACTK",
+               code[offset + 1], code[offset + 2]);
+        printValue(chunk.constants[code[offset + 3]]);
+        printf("'\n");
+        return offset + 4;
+    case R_ADD:
+    case R_SUBTRACT:
+    case R_MULTIPLY:
+    case R_DIVIDE:
+    case R_MODULO:
+    case R_EQUAL:
+    case R_NOT_EQUAL:
+    case R_GREATER:
+    case R_GREATER_EQUAL:
+    case R_LESS:
+    case R_LESS_EQUAL:
+    {
+        static const char *names[] = {"R_ADD", "R_SUBTRACT", "R_MULTIPLY", "R_DIVIDE", "R_MODULO"};
+        static const char *compares[] = {"R_EQUAL", "R_NOT_EQUAL", "R_GREATER",
+                                         "R_GREATER_EQUAL", "R_LESS", "R_LESS_EQUAL"};
+        const char *name = instruction <= R_MODULO ? names[instruction - R_ADD]
+                                                   : compares[instruction - R_EQUAL];
+        printf("%-16s r%d r%d r%d\n", name, code[offset + 1], code[offset + 2], code[offset + 3]);
+        return offset + 4;
+    }
+    case R_JUMP:
+        printf("%-16s -> %d\n", "R_JUMP", (code[offset + 1] << 8) | code[offset + 2]);
+        return offset + 3;
+    case R_JUMP_IF_FALSE:
+    case R_JUMP_IF_TRUE:
+        printf("%-16s r%d -> %d\n",
+               instruction == R_JUMP_IF_FALSE ? "R_JUMP_IF_FALSE" : "R_JUMP_IF_TRUE",
+               code[offset + 1], (code[offset + 2] << 8) | code[offset + 3]);
+        return offset + 4;
+    case R_LESS_JUMP_IF_FALSE:
+    case R_GREATER_JUMP_IF_FALSE:
+    case R_EQUAL_JUMP_IF_FALSE:
+    {
+        const char *name = instruction == R_LESS_JUMP_IF_FALSE      ? "R_LESS_JUMP_IF_FALSE"
+                           : instruction == R_GREATER_JUMP_IF_FALSE ? "R_GREATER_JUMP_IF_FALSE"
+                                                                    : "R_EQUAL_JUMP_IF_FALSE";
+        printf("%-16s r%d r%d -> %d\n", name, code[offset + 1], code[offset + 2],
+               (code[offset + 3] << 8) | code[offset + 4]);
+        return offset + 5;
+    }
+    case R_CALL:
+        printf("%-16s r%d (%d args)\n", "R_CALL", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_CALL_NATIVE:
+        printf("%-16s r%d #%d (%d args)\n", "R_CALL_NATIVE", code[offset + 1],
+               code[offset + 2], code[offset + 3]);
+        return offset + 4;
+    case R_TAIL_CALL:
+        printf("%-16s r%d (%d args)\n", "R_TAIL_CALL", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_CALL_DIRECT:
+        printf("%-16s r%d (%d args)\n", "R_CALL_DIRECT", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    case R_TAIL_CALL_DIRECT:
+        printf("%-16s r%d (%d args)\n", "R_TAIL_CALL_DIRECT", code[offset + 1], code[offset + 2]);
+        return offset + 3;
+    default:
+        printf("Unknown register opcode %d\n", instruction);
+        return offset + 1;
+    }
+}
+
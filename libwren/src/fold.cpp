@@ -0,0 +1,189 @@
+#include "fold.h"
+#include "stringpool.h"
+#include <climits>
+#include <cstring>
+
+bool fold::truthy(const Value &value)
+{
+    if (value.isNull())
+        return false;
+    if (value.isBool())
+        return value.asBool();
+    if (value.isInt())
+        return value.asInt() != 0;
+    if (value.isDouble())
+        return value.asDouble() != 0.0;
+    return true;
+}
+
+static bool isNumber(const Value &value)
+{
+    return value.isInt() || value.isDouble();
+}
+
+static double asNumber(const Value &value)
+{
+    return value.isInt() ? (double)value.asInt() : value.asDouble();
+}
+
+bool fold::binary(uint8_t op, const Value &a, const Value &b, Value &out)
+{
+    switch (op)
+    {
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    {
+        if (a.isString() || b.isString())
+            return false;
+        bool equal;
+        if (a.getType() != b.getType())
+            equal = false;
+        else if (a.isInt())
+            equal = a.asInt() == b.asInt();
+        else if (a.isBool())
+            equal = a.asBool() == b.asBool();
+        else if (a.isDouble())
+            equal = a.asDouble() == b.asDouble();
+        else
+            equal = a.isNull();
+        out = Value::makeBool(op == OP_EQUAL ? equal : !equal);
+        return true;
+    }
+
+    case OP_ADD:
+        if (a.isString() && b.isString())
+        {
+            out = Value::makeString(StringPool::instance().concat(a.asString(), b.asString()));
+            return true;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (!isNumber(a) || !isNumber(b))
+        return false;
+
+    if (a.isInt() && b.isInt())
+    {
+        uint32_t x = (uint32_t)a.asInt();
+        uint32_t y = (uint32_t)b.asInt();
+        int32_t sx = a.asInt(), sy = b.asInt();
+        switch (op)
+        {
+        case OP_ADD:
+            out = Value::makeInt((int)(x + y));
+            return true;
+        case OP_SUBTRACT:
+            out = Value::makeInt((int)(x - y));
+            return true;
+        case OP_MULTIPLY:
+            out = Value::makeInt((int)(x * y));
+            return true;
+        case OP_DIVIDE:
+        case OP_MODULO:
+            if (sy == 0 || (sy == -1 && sx == INT_MIN))
+                return false;
+            out = Value::makeInt(op == OP_DIVIDE ? sx / sy : sx % sy);
+            return true;
+        case OP_GREATER:
+            out = Value::makeBool(sx > sy);
+            return true;
+        case OP_GREATER_EQUAL:
+            out = Value::makeBool(sx >= sy);
+            return true;
+        case OP_LESS:
+            out = Value::makeBool(sx < sy);
+            return true;
+        case OP_LESS_EQUAL:
+            out = Value::makeBool(sx <= sy);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    double x = asNumber(a), y = asNumber(b);
+    switch (op)
+    {
+    case OP_ADD:
+        out = Value::makeDouble(x + y);
+        return true;
+    case OP_SUBTRACT:
+        out = Value::makeDouble(x - y);
+        return true;
+    case OP_MULTIPLY:
+        out = Value::makeDouble(x * y);
+        return true;
+    case OP_DIVIDE:
+        if (y == 0.0)
+            return false;
+        out = Value::makeDouble(x / y);
+        return true;
+    case OP_GREATER:
+        out = Value::makeBool(x > y);
+        return true;
+    case OP_GREATER_EQUAL:
+        out = Value::makeBool(x >= y);
+        return true;
+    case OP_LESS:
+        out = Value::makeBool(x < y);
+        return true;
+    case OP_LESS_EQUAL:
+        out = Value::makeBool(x <= y);
+        return true;
+    default:
+        return false; // MODULO só com ints
+    }
+}
+
+bool fold::sameConstant(const Value &a, const Value &b)
+{
+    if (a.getType() != b.getType())
+        return false;
+    if (a.isInt())
+        return a.asInt() == b.asInt();
+    if (a.isString())
+        return a.asString() == b.asString();
+    if (a.isFunction())
+        return a.asFunctionIdx() == b.asFunctionIdx();
+    if (a.isBool())
+        return a.asBool() == b.asBool();
+    if (a.isDouble())
+    {
+        double x = a.asDouble(), y = b.asDouble();
+        return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    return a.isNull();
+}
+
+bool fold::unary(uint8_t op, const Value &a, Value &out)
+{
+    switch (op)
+    {
+    case OP_NOT:
+        out = Value::makeBool(!truthy(a));
+        return true;
+    case OP_NEGATE:
+        if (a.isInt())
+            out = Value::makeInt((int)(0u - (uint32_t)a.asInt()));
+        else if (a.isDouble())
+            out = Value::makeDouble(-a.asDouble());
+        else
+            return false;
+        return true;
+    default:
+        return false;
+    }
+}
+
+int fold::constantIndex(Chunk &chunk, const Value &value)
+{
+    int k = chunk.constants.find(value);
+    if (k >= 0)
+        return k <= UINT8_MAX ? k : -1;
+    if (chunk.constants.size() > UINT8_MAX)
+        return -1;
+    return chunk.addConstant(value);
+}
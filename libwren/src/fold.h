@@ -0,0 +1,37 @@
+#pragma once
+#include "chunk.h"
+
+// Avaliação de operações sobre literais em tempo de compilação, com a
+// mesma semântica que os handlers genéricos da VM. Partilhado pelo
+// optimizer de bytecode (optimizer.cpp), pelo middle end SSA (ssa.cpp) e
+// pelo tradutor para registos (regcompiler.cpp).
+// Os casos que dão erro em runtime (tipos errados, divisão por zero) não
+// dobram: o erro tem de acontecer quando e onde o programa o produziria.
+
+namespace fold
+{
+
+// Mesma regra que VM::isTruthy
+bool truthy(const Value &value);
+
+// OP_ADD .. OP_LESS_EQUAL (forma genérica); false se não dobra
+bool binary(uint8_t op, const Value &a, const Value &b, Value &out);
+
+// OP_NOT e OP_NEGATE
+bool unary(uint8_t op, const Value &a, Value &out);
+
+// Igualdade exata para reaproveitar constantes: strings estão internadas,
+// doubles comparam bits (0.0 e -0.0 são constantes diferentes)
+bool sameConstant(const Value &a, const Value &b);
+
+// Int que cabe num operando imediato int16 (OP_PUSH_INT, OP_ADD_IMM, ...)
+inline bool immediate(const Value &value)
+{
+    return value.isInt() && value.asInt() >= INT16_MIN && value.asInt() <= INT16_MAX;
+}
+
+// Índice de value na pool (reaproveita ou acrescenta); -1 se não cabe
+// num operando u8
+int constantIndex(Chunk &chunk, const Value &value);
+
+} // namespace fold
@@ -0,0 +1,778 @@
+#include "jit.h"
+#include "tracer.h"
+#include "verifier.h"
+#include "vm.h"
+
+#if WREN_JIT_ENABLED
+
+#include "x64.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+
+using namespace x64;
+
+// Registos fixos do código gerado (callee-saved, sobrevivem ao frame todo)
+const int SLOTS = RBX;
+const int SP = R14;
+const int GLOBALS = R15;
+const int SP_OUT = R13;
+
+// ============================================
+// EMISSOR
+// ============================================
+
+// VM::GlobalSlot é privado: o Jit (friend) passa o layout ao emissor
+struct GlobalLayout
+{
+    int32_t size;
+    int32_t value;
+    int32_t defined;
+};
+
+class Emitter
+{
+public:
+    Emitter(Function *function, const GlobalLayout &globals)
+        : function_(function), chunk_(function->chunk), globals_(globals),
+          code_(function->chunk.code.data()),
+          offsets_(function->chunk.count(), UINT32_MAX),
+          exitStubs_(function->chunk.count(), -1) {}
+
+    bool emit();
+
+    std::vector<uint8_t> &code() { return a_.code; }
+    std::vector<uint32_t> &offsets() { return offsets_; }
+
+private:
+    struct Fixup
+    {
+        int end;    // posição a seguir ao rel32
+        int target; // offset no bytecode
+    };
+
+    Function *function_;
+    const Chunk &chunk_;
+    GlobalLayout globals_;
+    uint8_t *code_;
+    Assembler a_;
+    std::vector<uint32_t> offsets_;
+    std::vector<Fixup> jumps_;
+    std::vector<Fixup> exits_;
+    std::vector<int> exitStubs_;
+    int exitLabel_;
+
+    void emitPrologue();
+    bool emitInstruction(int offset, const StackInstruction &info);
+
+    // Saída para o interpretador: ele executa a instrução em `offset`
+    void exitTo(int offset);
+    void exitIf(int cc, int offset) { exits_.push_back({a_.jcc(cc), offset}); }
+    void jumpIf(int cc, int target) { jumps_.push_back({a_.jcc(cc), target}); }
+    void jumpTo(int target) { jumps_.push_back({a_.jmp(), target}); }
+
+    // Stencils de valores
+    void copyValue(int dstBase, int32_t dstDisp, int srcBase, int32_t srcDisp);
+    void storeConstant(int base, int32_t disp, const Value &value);
+    void guardInt(int base, int32_t disp, int offset);
+    void loadInt(int reg, int base, int32_t disp);
+    void storeInt(int base, int32_t disp, int reg);
+    void updateInt(int base, int32_t disp, int reg);
+    void storeBool(int base, int32_t disp, int reg);
+    void jumpIfTruth(int offset, int target, bool onTrue, bool pop = false);
+
+    void binaryIntOp(int offset, uint8_t opcode);
+    void compareIntOp(int offset, int cc);
+    void divideIntOp(int offset, bool modulo);
+
+    int32_t globalDisp(int slot) const;
+    static int32_t top(int n) { return -n * VALUE_SIZE; }
+};
+
+void Emitter::emitPrologue()
+{
+    // entry(slots, sp, globals, target, spOut): rdi, rsi, rdx, rcx, r8
+    a_.push(RBX);
+    a_.push(R13);
+    a_.push(R14);
+    a_.push(R15);
+    a_.mov64(SLOTS, RDI);
+    a_.mov64(SP, RSI);
+    a_.mov64(GLOBALS, RDX);
+    a_.mov64(SP_OUT, R8);
+    a_.jmpReg(RCX);
+
+    // Saída comum: rax tem o ip onde o interpretador continua
+    exitLabel_ = a_.here();
+    a_.store64(SP_OUT, 0, SP);
+    a_.pop(R15);
+    a_.pop(R14);
+    a_.pop(R13);
+    a_.pop(RBX);
+    a_.ret();
+}
+
+void Emitter::exitTo(int offset)
+{
+    a_.movImm64(RAX, (uint64_t)(uintptr_t)(code_ + offset));
+    a_.patch(a_.jmp(), exitLabel_);
+}
+
+void Emitter::copyValue(int dstBase, int32_t dstDisp, int srcBase, int32_t srcDisp)
+{
+    for (int32_t i = 0; i < VALUE_SIZE; i += 8)
+    {
+        a_.load64(RAX, srcBase, srcDisp + i);
+        a_.store64(dstBase, dstDisp + i, RAX);
+    }
+}
+
+void Emitter::storeConstant(int base, int32_t disp, const Value &value)
+{
+    uint64_t words[sizeof(Value) / 8];
+    memcpy(words, &value, sizeof(Value));
+    for (size_t i = 0; i < sizeof(Value) / 8; i++)
+    {
+        a_.movImm64(RAX, words[i]);
+        a_.store64(base, disp + (int32_t)(i * 8), RAX);
+    }
+}
+
+void Emitter::guardInt(int base, int32_t disp, int offset)
+{
+    a_.cmp32Imm(base, disp + TAG_DISP, TAG_INT);
+    exitIf(CC_NE, offset);
+}
+
+void Emitter::loadInt(int reg, int base, int32_t disp)
+{
+    a_.load32(reg, base, disp + PAYLOAD_DISP);
+}
+
+// reg tem o int nos 32 bits baixos e zeros em cima (efeito de qualquer
+// operação de 32 bits), como o makeInt deixa o union. Usa rcx.
+void Emitter::storeInt(int base, int32_t disp, int reg)
+{
+#if WREN_NAN_TAGGING
+    a_.movImm64(RCX, (uint64_t)TAG_INT << 32);
+    a_.or64(reg, RCX);
+    a_.store64(base, disp, reg);
+#else
+    a_.store64(base, disp + PAYLOAD_DISP, reg);
+    a_.store64Imm(base, disp + TAG_DISP, VAL_INT);
+#endif
+}
+
+// Só o payload: o tipo já é int (guard feito antes)
+void Emitter::updateInt(int base, int32_t disp, int reg)
+{
+#if WREN_NAN_TAGGING
+    storeInt(base, disp, reg);
+#else
+    a_.store64(base, disp + PAYLOAD_DISP, reg);
+#endif
+}
+
+// reg tem 0 ou 1 e fica intacto (os saltos fundidos testam-no). Usa rcx.
+void Emitter::storeBool(int base, int32_t disp, int reg)
+{
+#if WREN_NAN_TAGGING
+    a_.mov64(RCX, reg);
+    a_.add32Imm(RCX, (int32_t)TAG_FALSE); // TAG_TRUE = TAG_FALSE + 1
+    a_.shl64Imm(RCX, 32);
+    a_.store64(base, disp, RCX);
+#else
+    a_.store64(base, disp + PAYLOAD_DISP, reg);
+    a_.store64Imm(base, disp + TAG_DISP, VAL_BOOL);
+#endif
+}
+
+// Mesma regra que VM::isTruthy para null, bool e int; o resto sai.
+// Salta para target quando a condição é truthy == onTrue. Com pop a
+// condição sai da stack nos dois caminhos (depois dos guards, para que
+// uma saída a deixe ao interpretador).
+void Emitter::jumpIfTruth(int offset, int target, bool onTrue, bool pop)
+{
+    int32_t disp = top(1);
+    std::vector<int> done;
+    std::vector<int> taken;
+    auto branch = [&](int cc) {
+        if (pop)
+            taken.push_back(a_.jcc(cc));
+        else
+            jumpIf(cc, target);
+    };
+#if WREN_NAN_TAGGING
+    a_.load32(RAX, SP, disp + TAG_DISP);
+    a_.cmpReg32Imm(RAX, (int32_t)TAG_TRUE);
+    if (onTrue)
+        branch(CC_E);
+    else
+        done.push_back(a_.jcc(CC_E));
+    a_.cmpReg32Imm(RAX, (int32_t)TAG_FALSE);
+    int isFalse = a_.jcc(CC_E);
+    a_.cmpReg32Imm(RAX, (int32_t)TAG_NULL);
+    int isNull = a_.jcc(CC_E);
+    a_.cmpReg32Imm(RAX, (int32_t)TAG_INT);
+    exitIf(CC_NE, offset);
+    a_.cmp32Imm(SP, disp + PAYLOAD_DISP, 0);
+    branch(onTrue ? CC_NE : CC_E);
+    done.push_back(a_.jmp());
+
+    // false e null
+    a_.patch(isFalse, a_.here());
+    a_.patch(isNull, a_.here());
+    if (!onTrue)
+    {
+        if (pop)
+            taken.push_back(a_.jmp());
+        else
+            jumpTo(target);
+    }
+#else
+    a_.cmp32Imm(SP, disp + TAG_DISP, VAL_BOOL);
+    int notBool = a_.jcc(CC_NE);
+    a_.cmp8Imm(SP, disp + PAYLOAD_DISP, 0);
+    branch(onTrue ? CC_NE : CC_E);
+    done.push_back(a_.jmp());
+
+    a_.patch(notBool, a_.here());
+    a_.cmp32Imm(SP, disp + TAG_DISP, VAL_NULL);
+    if (onTrue)
+        done.push_back(a_.jcc(CC_E));
+    else
+        branch(CC_E);
+    a_.cmp32Imm(SP, disp + TAG_DISP, VAL_INT);
+    exitIf(CC_NE, offset);
+    a_.cmp32Imm(SP, disp + PAYLOAD_DISP, 0);
+    branch(onTrue ? CC_NE : CC_E);
+#endif
+    for (int jump : done)
+        a_.patch(jump, a_.here());
+    if (!pop)
+        return;
+
+    a_.sub64Imm(SP, VALUE_SIZE);
+    int skip = a_.jmp();
+    for (int jump : taken)
+        a_.patch(jump, a_.here());
+    a_.sub64Imm(SP, VALUE_SIZE);
+    jumpTo(target);
+    a_.patch(skip, a_.here());
+}
+
+// a op b com os dois ints: resultado no lugar de a
+void Emitter::binaryIntOp(int offset, uint8_t opcode)
+{
+    guardInt(SP, top(2), offset);
+    guardInt(SP, top(1), offset);
+    loadInt(RAX, SP, top(2));
+    loadInt(RCX, SP, top(1));
+    switch (opcode)
+    {
+    case OP_ADD:
+        a_.alu32(ALU_ADD, RAX, RCX);
+        break;
+    case OP_SUBTRACT:
+        a_.alu32(ALU_SUB, RAX, RCX);
+        break;
+    default:
+        a_.imul32(RAX, RCX);
+        break;
+    }
+    updateInt(SP, top(2), RAX);
+    a_.sub64Imm(SP, VALUE_SIZE);
+}
+
+void Emitter::compareIntOp(int offset, int cc)
+{
+    guardInt(SP, top(2), offset);
+    guardInt(SP, top(1), offset);
+    loadInt(RAX, SP, top(2));
+    loadInt(RCX, SP, top(1));
+    a_.alu32(ALU_CMP, RAX, RCX);
+    a_.setBool(cc, RAX);
+    storeBool(SP, top(2), RAX);
+    a_.sub64Imm(SP, VALUE_SIZE);
+}
+
+// Divisor 0 (erro) e -1 (INT_MIN / -1 faz trap no idiv) ficam com o
+// interpretador
+void Emitter::divideIntOp(int offset, bool modulo)
+{
+    guardInt(SP, top(2), offset);
+    guardInt(SP, top(1), offset);
+    loadInt(RCX, SP, top(1));
+    a_.cmpReg32Imm(RCX, 0);
+    exitIf(CC_E, offset);
+    a_.cmpReg32Imm(RCX, -1);
+    exitIf(CC_E, offset);
+    loadInt(RAX, SP, top(2));
+    a_.idiv32(RCX);
+    updateInt(SP, top(2), modulo ? RDX : RAX);
+    a_.sub64Imm(SP, VALUE_SIZE);
+}
+
+// Condição do salto de uma condição que consome os operandos (ints)
+static int branchCond(uint8_t compare)
+{
+    switch (compare)
+    {
+    case OP_EQUAL:
+        return CC_NE;
+    case OP_NOT_EQUAL:
+        return CC_E;
+    case OP_GREATER:
+        return CC_LE;
+    case OP_GREATER_EQUAL:
+        return CC_L;
+    case OP_LESS:
+        return CC_GE;
+    default:
+        return CC_G;
+    }
+}
+
+int32_t Emitter::globalDisp(int slot) const
+{
+    return slot * globals_.size;
+}
+
+bool Emitter::emitInstruction(int offset, const StackInstruction &info)
+{
+    const uint8_t *ip = code_ + offset;
+
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+        storeConstant(SP, 0, chunk_.constants[ip[1]]);
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_PUSH_INT:
+        storeConstant(SP, 0, Value::makeInt((int16_t)((ip[1] << 8) | ip[2])));
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_NIL:
+        storeConstant(SP, 0, Value::makeNull());
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_TRUE:
+    case OP_FALSE:
+        storeConstant(SP, 0, Value::makeBool(ip[0] == OP_TRUE));
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_POP:
+        a_.sub64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_GET_LOCAL:
+        copyValue(SP, 0, SLOTS, ip[1] * VALUE_SIZE);
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_SET_LOCAL:
+        copyValue(SLOTS, ip[1] * VALUE_SIZE, SP, top(1));
+        break;
+
+    case OP_GET_GLOBAL:
+    {
+        int32_t disp = globalDisp((ip[1] << 8) | ip[2]);
+        a_.cmp8Imm(GLOBALS, disp + globals_.defined, 0);
+        exitIf(CC_E, offset);
+        copyValue(SP, 0, GLOBALS, disp + globals_.value);
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+    }
+
+    case OP_SET_GLOBAL:
+    {
+        // Sobrepor uma função marca-a como rebound: fica com o interpretador
+        int32_t disp = globalDisp((ip[1] << 8) | ip[2]);
+        int32_t value = disp + globals_.value;
+        a_.cmp8Imm(GLOBALS, disp + globals_.defined, 0);
+        exitIf(CC_E, offset);
+        a_.cmp32Imm(GLOBALS, value + TAG_DISP, TAG_FUNCTION);
+        exitIf(CC_E, offset);
+        copyValue(GLOBALS, value, SP, top(1));
+        break;
+    }
+
+    case OP_JUMP:
+        jumpTo(info.jumpTarget);
+        break;
+
+    case OP_LOOP:
+    {
+        // Back-edges contam para o tracer: a zero sai no próprio OP_LOOP e
+        // o interpretador grava ou entra no trace
+        LoopState *loop = Tracer::loopAt(function_, info.jumpTarget);
+        a_.movImm64(RAX, (uint64_t)(uintptr_t)&loop->countdown);
+        a_.sub32MemImm(RAX, 0, 1);
+        exitIf(CC_E, offset);
+        jumpTo(info.jumpTarget);
+        break;
+    }
+
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+        jumpIfTruth(offset, info.jumpTarget, ip[0] == OP_JUMP_IF_TRUE);
+        break;
+
+    case OP_ADD:
+    case OP_ADD_INT:
+    case OP_ADD_DOUBLE:
+    case OP_ADD_STRING:
+        binaryIntOp(offset, OP_ADD);
+        break;
+
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_INT:
+    case OP_SUBTRACT_DOUBLE:
+        binaryIntOp(offset, OP_SUBTRACT);
+        break;
+
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_INT:
+    case OP_MULTIPLY_DOUBLE:
+        binaryIntOp(offset, OP_MULTIPLY);
+        break;
+
+    case OP_DIVIDE:
+        divideIntOp(offset, false);
+        break;
+
+    case OP_MODULO:
+        divideIntOp(offset, true);
+        break;
+
+    case OP_NEGATE:
+        guardInt(SP, top(1), offset);
+        loadInt(RAX, SP, top(1));
+        a_.neg32(RAX);
+        updateInt(SP, top(1), RAX);
+        break;
+
+    case OP_EQUAL:
+    case OP_EQUAL_INT:
+        compareIntOp(offset, CC_E);
+        break;
+
+    case OP_NOT_EQUAL:
+    case OP_NOT_EQUAL_INT:
+        compareIntOp(offset, CC_NE);
+        break;
+
+    case OP_GREATER:
+    case OP_GREATER_INT:
+    case OP_GREATER_DOUBLE:
+        compareIntOp(offset, CC_G);
+        break;
+
+    case OP_GREATER_EQUAL:
+    case OP_GREATER_EQUAL_INT:
+    case OP_GREATER_EQUAL_DOUBLE:
+        compareIntOp(offset, CC_GE);
+        break;
+
+    case OP_LESS:
+    case OP_LESS_INT:
+    case OP_LESS_DOUBLE:
+        compareIntOp(offset, CC_L);
+        break;
+
+    case OP_LESS_EQUAL:
+    case OP_LESS_EQUAL_INT:
+    case OP_LESS_EQUAL_DOUBLE:
+        compareIntOp(offset, CC_LE);
+        break;
+
+    case OP_POP_JUMP_IF_FALSE:
+        jumpIfTruth(offset, info.jumpTarget, false, true);
+        break;
+
+    // Os guards correm com os operandos ainda na stack; o cmp vem depois
+    // do sub (que mexe nas flags)
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+    case OP_JUMP_IF_NOT_LESS:
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+        guardInt(SP, top(2), offset);
+        guardInt(SP, top(1), offset);
+        loadInt(RAX, SP, top(2));
+        loadInt(RCX, SP, top(1));
+        a_.sub64Imm(SP, 2 * VALUE_SIZE);
+        a_.alu32(ALU_CMP, RAX, RCX);
+        jumpIf(branchCond(branchCompare(ip[0])), info.jumpTarget);
+        break;
+
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+    case OP_JUMP_IF_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_LESS_IMM:
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        guardInt(SP, top(1), offset);
+        loadInt(RAX, SP, top(1));
+        a_.sub64Imm(SP, VALUE_SIZE);
+        a_.cmpReg32Imm(RAX, (int16_t)((ip[1] << 8) | ip[2]));
+        jumpIf(branchCond(branchCompare(ip[0])), info.jumpTarget);
+        break;
+
+    case OP_ADD_LOCALS:
+        guardInt(SLOTS, ip[1] * VALUE_SIZE, offset);
+        guardInt(SLOTS, ip[2] * VALUE_SIZE, offset);
+        loadInt(RAX, SLOTS, ip[1] * VALUE_SIZE);
+        loadInt(RCX, SLOTS, ip[2] * VALUE_SIZE);
+        a_.alu32(ALU_ADD, RAX, RCX);
+        storeInt(SP, 0, RAX);
+        a_.add64Imm(SP, VALUE_SIZE);
+        break;
+
+    case OP_ADD_CONST:
+    case OP_SUBTRACT_CONST:
+    {
+        const Value &k = chunk_.constants[ip[1]];
+        if (!k.isInt())
+        {
+            exitTo(offset);
+            break;
+        }
+        guardInt(SP, top(1), offset);
+        loadInt(RAX, SP, top(1));
+        if (ip[0] == OP_ADD_CONST)
+            a_.add32Imm(RAX, k.asInt());
+        else
+            a_.sub32Imm(RAX, k.asInt());
+        updateInt(SP, top(1), RAX);
+        break;
+    }
+
+    case OP_ADD_IMM:
+    case OP_SUBTRACT_IMM:
+    {
+        int16_t k = (int16_t)((ip[1] << 8) | ip[2]);
+        guardInt(SP, top(1), offset);
+        loadInt(RAX, SP, top(1));
+        a_.add32Imm(RAX, ip[0] == OP_ADD_IMM ? k : -k);
+        updateInt(SP, top(1), RAX);
+        break;
+    }
+
+    case OP_INC_LOCAL:
+    case OP_DEC_LOCAL:
+        guardInt(SLOTS, ip[1] * VALUE_SIZE, offset);
+        loadInt(RAX, SLOTS, ip[1] * VALUE_SIZE);
+        a_.add32Imm(RAX, ip[0] == OP_INC_LOCAL ? 1 : -1);
+        updateInt(SLOTS, ip[1] * VALUE_SIZE, RAX);
+        break;
+
+    // For numérico com contador e limite int
+    case OP_FOR_PREP:
+        guardInt(SLOTS, ip[1] * VALUE_SIZE, offset);
+        guardInt(SLOTS, ip[2] * VALUE_SIZE, offset);
+        loadInt(RAX, SLOTS, ip[1] * VALUE_SIZE);
+        loadInt(RCX, SLOTS, ip[2] * VALUE_SIZE);
+        a_.alu32(ALU_CMP, RAX, RCX);
+        jumpIf(branchCond(ip[3]), info.jumpTarget);
+        break;
+
+    // Como o OP_LOOP, a contagem do tracer pode sair no próprio FOR_LOOP:
+    // o contador só é escrito depois, para o interpretador o repetir
+    case OP_FOR_LOOP:
+    {
+        guardInt(SLOTS, ip[1] * VALUE_SIZE, offset);
+        guardInt(SLOTS, ip[2] * VALUE_SIZE, offset);
+        loadInt(RAX, SLOTS, ip[1] * VALUE_SIZE);
+        a_.add32Imm(RAX, (int16_t)((ip[4] << 8) | ip[5]));
+        loadInt(RCX, SLOTS, ip[2] * VALUE_SIZE);
+        a_.alu32(ALU_CMP, RAX, RCX);
+        int exit = a_.jcc(branchCond(ip[3]));
+
+        LoopState *loop = Tracer::loopAt(function_, info.jumpTarget);
+        a_.movImm64(RCX, (uint64_t)(uintptr_t)&loop->countdown);
+        a_.sub32MemImm(RCX, 0, 1);
+        exitIf(CC_E, offset);
+        updateInt(SLOTS, ip[1] * VALUE_SIZE, RAX);
+        jumpTo(info.jumpTarget);
+
+        a_.patch(exit, a_.here());
+        updateInt(SLOTS, ip[1] * VALUE_SIZE, RAX);
+        break;
+    }
+
+    // Calls, returns, natives, print, intrinsics, DEFINE_GLOBAL e NOT
+    default:
+        exitTo(offset);
+        break;
+    }
+
+    return true;
+}
+
+bool Emitter::emit()
+{
+    int count = (int)chunk_.count();
+
+    emitPrologue();
+
+    for (int offset = 0; offset < count;)
+    {
+        StackInstruction info;
+        if (!Verifier::decode(chunk_, offset, info))
+            return false;
+        offsets_[offset] = (uint32_t)a_.here();
+        if (!emitInstruction(offset, info))
+            return false;
+        offset += info.length;
+    }
+
+    for (const Fixup &jump : jumps_)
+    {
+        if (jump.target < 0 || jump.target >= count || offsets_[jump.target] == UINT32_MAX)
+            return false;
+        a_.patch(jump.end, (int)offsets_[jump.target]);
+    }
+
+    // Stubs frios: um por instrução com guards
+    for (const Fixup &exit : exits_)
+    {
+        if (exitStubs_[exit.target] < 0)
+        {
+            exitStubs_[exit.target] = a_.here();
+            exitTo(exit.target);
+        }
+        a_.patch(exit.end, exitStubs_[exit.target]);
+    }
+
+    return true;
+}
+
+} // namespace
+
+// ============================================
+// MEMÓRIA EXECUTÁVEL / PERF
+// ============================================
+
+uint8_t *x64::install(const std::vector<uint8_t> &machine, size_t &size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (machine.size() + page - 1) & ~(page - 1);
+
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return nullptr;
+
+    memcpy(memory, machine.data(), machine.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return (uint8_t *)memory;
+}
+
+void x64::uninstall(uint8_t *memory, size_t size)
+{
+    munmap(memory, size);
+}
+
+// Formato do perf: "início tamanho nome" em hex, um por bloco de código
+void x64::writePerfMap(const uint8_t *start, size_t length, const char *name)
+{
+    static FILE *file = nullptr;
+    if (!file)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        file = fopen(path, "a");
+        if (!file)
+            return;
+    }
+    fprintf(file, "%lx %zx %s\n", (unsigned long)(uintptr_t)start, length, name);
+    fflush(file);
+}
+
+// ============================================
+// API
+// ============================================
+
+bool Jit::isAvailable()
+{
+    return true;
+}
+
+JitCode *Jit::compile(Function *function, bool perfMap)
+{
+    if (function->chunk.count() == 0)
+        return nullptr;
+
+    GlobalLayout globals;
+    globals.size = (int32_t)sizeof(VM::GlobalSlot);
+    globals.value = (int32_t)offsetof(VM::GlobalSlot, value);
+    globals.defined = (int32_t)offsetof(VM::GlobalSlot, defined);
+
+    Emitter emitter(function, globals);
+    if (!emitter.emit())
+        return nullptr;
+
+    std::vector<uint8_t> &machine = emitter.code();
+    size_t size;
+    uint8_t *memory = x64::install(machine, size);
+    if (!memory)
+        return nullptr;
+
+    JitCode *code = new JitCode();
+    code->memory = memory;
+    code->size = size;
+    code->entry = (JitEntry)memory;
+    code->bytecode = function->chunk.code.data();
+    code->offsets.swap(emitter.offsets());
+
+    if (perfMap)
+    {
+        std::string name = "wren:" + (function->name.empty() ? std::string("script") : function->name);
+        x64::writePerfMap(code->memory, machine.size(), name.c_str());
+    }
+
+    return code;
+}
+
+void Jit::release(JitCode *code)
+{
+    if (!code)
+        return;
+    x64::uninstall(code->memory, code->size);
+    delete code;
+}
+
+#else
+
+bool Jit::isAvailable()
+{
+    return false;
+}
+
+JitCode *Jit::compile(Function *, bool)
+{
+    return nullptr;
+}
+
+void Jit::release(JitCode *code)
+{
+    delete code;
+}
+
+#endif
@@ -6,24 +6,36 @@
 #include <chrono>
 #include <cstring>
 
-void NativeRegistry::registerFunction(const std::string &name, int arity, NativeFunction fn)
+// Devolve o índice, ou -1 se já existe ou não há espaço
+int NativeRegistry::registerFunction(const std::string &name, int arity, NativeFunction fn,
+                                     void *userdata)
 {
-    functions_.emplace(name, NativeFn(name, arity, fn));
+    if (indices_.count(name) || (int)functions_.size() >= MAX_NATIVES)
+    {
+        return -1;
+    }
+
+    int index = (int)functions_.size();
+    functions_.push_back(NativeFn(name, arity, fn, userdata));
+    indices_.emplace(name, index);
+    return index;
+}
+
+int NativeRegistry::getIndex(const std::string &name) const
+{
+    auto it = indices_.find(name);
+    return it != indices_.end() ? it->second : -1;
 }
 
 NativeFn *NativeRegistry::getFunction(const std::string &name)
 {
-    auto it = functions_.find(name);
-    if (it != functions_.end())
-    {
-        return &it->second;
-    }
-    return nullptr;
+    int index = getIndex(name);
+    return index >= 0 ? &functions_[index] : nullptr;
 }
 
 bool NativeRegistry::hasFunction(const std::string &name) const
 {
-    return functions_.find(name) != functions_.end();
+    return indices_.find(name) != indices_.end();
 }
 
 // Built-in functions
@@ -37,9 +49,10 @@ bool NativeRegistry::hasFunction(const std::string &name) const
 
  
 
-static Value nativeClock(VM *vm, int argCount, Value *args)
+static Value nativeClock(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     (void)argCount;
     (void)args;
     
@@ -51,9 +64,10 @@ static Value nativeClock(VM *vm, int argCount, Value *args)
     return Value::makeDouble(seconds);
 }
 
-static Value nativePrint(VM *vm, int argCount, Value *args)
+static Value nativePrint(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     for (int i = 0; i < argCount; i++)
     {
         printValue(args[i]);
@@ -64,9 +78,10 @@ static Value nativePrint(VM *vm, int argCount, Value *args)
     return Value::makeNull();
 }
 
-static Value nativeSqrt(VM *vm, int argCount, Value *args)
+static Value nativeSqrt(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     if (argCount != 1)
     {
         fprintf(stderr, "sqrt() expects 1 argument\n");
@@ -86,9 +101,10 @@ static Value nativeSqrt(VM *vm, int argCount, Value *args)
     return Value::makeNull();
 }
 
-static Value nativeAbs(VM *vm, int argCount, Value *args)
+static Value nativeAbs(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     if (argCount != 1)
     {
         fprintf(stderr, "abs() expects 1 argument\n");
@@ -108,9 +124,10 @@ static Value nativeAbs(VM *vm, int argCount, Value *args)
     return Value::makeNull();
 }
 
-static Value nativePow(VM *vm, int argCount, Value *args)
+static Value nativePow(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     if (argCount != 2)
     {
         fprintf(stderr, "pow() expects 2 arguments\n");
@@ -123,9 +140,10 @@ static Value nativePow(VM *vm, int argCount, Value *args)
     return Value::makeDouble(std::pow(base, exp));
 }
 
-static Value nativeStr(VM *vm, int argCount, Value *args)
+static Value nativeStr(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     if (argCount != 1)
     {
         fprintf(stderr, "str() expects 1 argument\n");
@@ -136,9 +154,10 @@ static Value nativeStr(VM *vm, int argCount, Value *args)
     return Value::makeString(result.c_str());
 }
 
-static Value nativeLen(VM *vm, int argCount, Value *args)
+static Value nativeLen(VM *vm, int argCount, Value *args, void *userdata)
 {
     (void)vm;
+    (void)userdata;
     if (argCount != 1)
     {
         fprintf(stderr, "len() expects 1 argument\n");
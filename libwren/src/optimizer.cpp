@@ -0,0 +1,843 @@
+#include "optimizer.h"
+#include "fold.h"
+#include "verifier.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+struct Instruction
+{
+    uint8_t op;
+    uint8_t operands[8]; // bytes a seguir ao opcode (os do salto só no encode)
+    int length;
+    int line;
+    int target; // saltos: índice da instrução destino; -1 nas outras
+    bool dead;
+};
+
+bool isJump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP:
+    case OP_LOOP:
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+        return true;
+    default:
+        return isCompareBranch(op);
+    }
+}
+
+bool fallsThrough(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP:
+    case OP_LOOP:
+    case OP_RETURN:
+    case OP_RETURN_NIL:
+    case OP_TAIL_CALL:
+    case OP_TAIL_CALL_DIRECT:
+    case OP_SWITCH:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Os saltos largos são tratados como os curtos; o encode escolhe a forma
+uint8_t narrowJump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP_LONG:
+        return OP_JUMP;
+    case OP_LOOP_LONG:
+        return OP_LOOP;
+    case OP_JUMP_IF_FALSE_LONG:
+        return OP_JUMP_IF_FALSE;
+    case OP_JUMP_IF_TRUE_LONG:
+        return OP_JUMP_IF_TRUE;
+    case OP_POP_JUMP_IF_FALSE_LONG:
+        return OP_POP_JUMP_IF_FALSE;
+    case OP_FOR_PREP_LONG:
+        return OP_FOR_PREP;
+    case OP_FOR_LOOP_LONG:
+        return OP_FOR_LOOP;
+    default:
+        return op;
+    }
+}
+
+uint8_t wideJump(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JUMP:
+        return OP_JUMP_LONG;
+    case OP_LOOP:
+        return OP_LOOP_LONG;
+    case OP_JUMP_IF_TRUE:
+        return OP_JUMP_IF_TRUE_LONG;
+    case OP_POP_JUMP_IF_FALSE:
+        return OP_POP_JUMP_IF_FALSE_LONG;
+    case OP_FOR_PREP:
+        return OP_FOR_PREP_LONG;
+    case OP_FOR_LOOP:
+        return OP_FOR_LOOP_LONG;
+    default:
+        // os compares que saltam separam-se em compare + salto
+        return isCompareBranch(op) ? OP_POP_JUMP_IF_FALSE_LONG : OP_JUMP_IF_FALSE_LONG;
+    }
+}
+
+bool isCountedFor(uint8_t op)
+{
+    return op == OP_FOR_PREP || op == OP_FOR_LOOP;
+}
+
+// Saltos que tiram a condição da stack (os dois ramos já a perderam); os
+// do for numérico nunca a tiveram lá
+bool consumesCondition(uint8_t op)
+{
+    return op == OP_POP_JUMP_IF_FALSE || isCompareBranch(op) || isCountedFor(op);
+}
+
+// Bytes entre o opcode de um salto e o offset
+int jumpOperands(uint8_t op)
+{
+    if (op == OP_FOR_PREP)
+        return 3; // [c][l][op]
+    if (op == OP_FOR_LOOP)
+        return 5; // [c][l][op][s1][s0]
+    return isImmediateBranch(op) ? 2 : 0;
+}
+
+// Operando dos imediatos (os dois primeiros bytes)
+int16_t immediate(const Instruction &ins)
+{
+    return (int16_t)((ins.operands[0] << 8) | ins.operands[1]);
+}
+
+class Pass
+{
+public:
+    explicit Pass(Chunk &chunk) : chunk_(chunk) {}
+
+    bool decode(const std::vector<FarJump> &farJumps);
+    bool run();
+    bool encode();
+
+private:
+    Chunk &chunk_;
+    std::vector<Instruction> code_;
+    std::vector<int> incoming_; // saltos vivos para cada instrução
+    // Cópia de Chunk::switches com os destinos em índices de instrução
+    std::vector<SwitchTable> switches_;
+
+    static const int MAX_ROUNDS = 8;
+    static const int MAX_HOPS = 16;
+
+    int next(int i) const;
+    int resolve(int i) const;
+    void kill(int i) { code_[i].dead = true; }
+    void countIncoming();
+    const SwitchTable &switchTable(const Instruction &ins) const
+    {
+        return switches_[(ins.operands[0] << 8) | ins.operands[1]];
+    }
+    int width(int i, bool wide) const;
+
+    bool literal(int i, Value &value) const;
+    bool setLiteral(int i, const Value &value);
+
+    bool foldConstants();
+    bool foldNot();
+    bool threadJumps();
+    bool fuseConditions();
+    bool removeUnreachable();
+};
+
+int Pass::next(int i) const
+{
+    for (int j = i + 1; j < (int)code_.size(); j++)
+    {
+        if (!code_[j].dead)
+            return j;
+    }
+    return -1;
+}
+
+// Um salto para uma instrução apagada continua na seguinte viva: só se
+// apagam instruções sem efeito ou cujo efeito passou para a seguinte
+int Pass::resolve(int i) const
+{
+    return code_[i].dead ? next(i) : i;
+}
+
+void Pass::countIncoming()
+{
+    incoming_.assign(code_.size(), 0);
+    for (const Instruction &ins : code_)
+    {
+        if (!ins.dead && ins.target >= 0)
+        {
+            int target = resolve(ins.target);
+            if (target >= 0)
+                incoming_[target]++;
+        }
+        if (!ins.dead && ins.op == OP_SWITCH)
+        {
+            switchTable(ins).forEachTarget([&](int target) {
+                target = resolve(target);
+                if (target >= 0)
+                    incoming_[target]++;
+            });
+        }
+    }
+}
+
+bool Pass::literal(int i, Value &value) const
+{
+    switch (code_[i].op)
+    {
+    case OP_NIL:
+        value = Value::makeNull();
+        return true;
+    case OP_TRUE:
+    case OP_FALSE:
+        value = Value::makeBool(code_[i].op == OP_TRUE);
+        return true;
+    case OP_PUSH_INT:
+        value = Value::makeInt(immediate(code_[i]));
+        return true;
+    case OP_CONSTANT:
+        value = chunk_.constants[code_[i].operands[0]];
+        return value.isInt() || value.isDouble() || value.isString();
+    case OP_CONSTANT_LONG:
+        value = chunk_.constants[(code_[i].operands[0] << 16) | (code_[i].operands[1] << 8) |
+                                 code_[i].operands[2]];
+        return value.isInt() || value.isDouble() || value.isString();
+    default:
+        return false;
+    }
+}
+
+// false se a pool de constantes está cheia
+bool Pass::setLiteral(int i, const Value &value)
+{
+    Instruction &ins = code_[i];
+    if (value.isNull() || value.isBool())
+    {
+        ins.op = value.isNull() ? OP_NIL : value.asBool() ? OP_TRUE : OP_FALSE;
+        ins.length = 1;
+        return true;
+    }
+    if (fold::immediate(value))
+    {
+        int16_t k = (int16_t)value.asInt();
+        ins.op = OP_PUSH_INT;
+        ins.operands[0] = (uint8_t)((uint16_t)k >> 8);
+        ins.operands[1] = (uint8_t)k;
+        ins.length = 3;
+        return true;
+    }
+
+    int index = fold::constantIndex(chunk_, value);
+    if (index < 0)
+        return false;
+
+    ins.op = OP_CONSTANT;
+    ins.operands[0] = (uint8_t)index;
+    ins.length = 2;
+    return true;
+}
+
+bool Pass::foldConstants()
+{
+    bool changed = false;
+    countIncoming();
+
+    for (int i = 0; i < (int)code_.size(); i++)
+    {
+        Value a;
+        if (code_[i].dead || !literal(i, a))
+            continue;
+        int j = next(i);
+        if (j < 0 || incoming_[j] > 0)
+            continue;
+        Instruction &second = code_[j];
+        Value out;
+
+        switch (second.op)
+        {
+        // Literal descartado (restos de if (false), while (true), ...)
+        case OP_POP:
+            kill(i);
+            kill(j);
+            changed = true;
+            continue;
+
+        case OP_NEGATE:
+        case OP_NOT:
+            if (!fold::unary(second.op, a, out))
+                continue;
+            break;
+
+        case OP_ADD_CONST:
+        case OP_SUBTRACT_CONST:
+            if (!fold::binary(second.op == OP_ADD_CONST ? OP_ADD : OP_SUBTRACT, a,
+                            chunk_.constants[second.operands[0]], out))
+                continue;
+            break;
+
+        case OP_ADD_IMM:
+        case OP_SUBTRACT_IMM:
+            if (!fold::binary(second.op == OP_ADD_IMM ? OP_ADD : OP_SUBTRACT, a,
+                            Value::makeInt(immediate(second)), out))
+                continue;
+            break;
+
+        // Condição conhecida: o salto passa a incondicional ou desaparece
+        // (o valor fica na stack como antes, os POPs não mudam)
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+            if (fold::truthy(a) == (second.op == OP_JUMP_IF_TRUE))
+                second.op = OP_JUMP;
+            else
+                kill(j);
+            changed = true;
+            continue;
+
+        // Nos que consomem a condição sai também o literal
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_NOT_EQUAL_IMM:
+        case OP_JUMP_IF_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_GREATER_IMM:
+        case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_LESS_IMM:
+        case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        {
+            if (second.op == OP_POP_JUMP_IF_FALSE)
+                out = Value::makeBool(fold::truthy(a));
+            else if (!fold::binary(branchCompare(second.op), a,
+                                   Value::makeInt(immediate(second)), out))
+                continue;
+            kill(i);
+            if (out.asBool())
+                kill(j);
+            else
+            {
+                second.op = OP_JUMP;
+                second.length = 3;
+            }
+            changed = true;
+            continue;
+        }
+
+        default:
+        {
+            // literal, literal, operador
+            Value b;
+            int k = next(j);
+            if (!literal(j, b) || k < 0 || incoming_[k] > 0)
+                continue;
+            Instruction &third = code_[k];
+
+            if (isCompareBranch(third.op))
+            {
+                if (!fold::binary(branchCompare(third.op), a, b, out))
+                    continue;
+                kill(i);
+                kill(j);
+                if (out.asBool())
+                    kill(k);
+                else
+                    third.op = OP_JUMP;
+                changed = true;
+                continue;
+            }
+
+            if (!fold::binary(third.op, a, b, out) || !setLiteral(i, out))
+                continue;
+            kill(j);
+            kill(k);
+            changed = true;
+            continue;
+        }
+        }
+
+        if (setLiteral(i, out))
+        {
+            kill(j);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Pass::foldNot()
+{
+    bool changed = false;
+    countIncoming();
+
+    for (int i = 0; i < (int)code_.size(); i++)
+    {
+        Instruction &ins = code_[i];
+        int j = next(i);
+        if (ins.dead || j < 0 || incoming_[j] > 0)
+            continue;
+        Instruction &second = code_[j];
+
+        // a == b, NOT -> a != b (e vice-versa)
+        if ((ins.op == OP_EQUAL || ins.op == OP_NOT_EQUAL) && second.op == OP_NOT)
+        {
+            ins.op = ins.op == OP_EQUAL ? OP_NOT_EQUAL : OP_EQUAL;
+            kill(j);
+            changed = true;
+            continue;
+        }
+
+        // NOT, JUMP_IF_FALSE L com POP a seguir e em L: o bool negado só
+        // decide o salto, por isso salta-se pela condição original. Saltos
+        // para o NOT caem no salto invertido, que faz o mesmo.
+        if (ins.op == OP_NOT &&
+            (second.op == OP_JUMP_IF_FALSE || second.op == OP_JUMP_IF_TRUE))
+        {
+            int fall = next(j);
+            int target = resolve(second.target);
+            if (fall < 0 || target < 0 || code_[fall].op != OP_POP ||
+                code_[target].op != OP_POP)
+                continue;
+            second.op = second.op == OP_JUMP_IF_FALSE ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE;
+            kill(i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Segue o destino de cada salto enquanto o que lá está só volta a saltar.
+// Um salto condicional chega ao destino com a condição conhecida (falsa
+// nos JUMP_IF_FALSE e fundidos, verdadeira no JUMP_IF_TRUE), por isso
+// também atravessa os testes da mesma condição (&&, || e elif em cadeia).
+// Os que consomem a condição só atravessam saltos incondicionais.
+bool Pass::threadJumps()
+{
+    bool changed = false;
+
+    for (int i = 0; i < (int)code_.size(); i++)
+    {
+        Instruction &ins = code_[i];
+        // O FOR_LOOP volta sempre ao corpo do seu FOR_PREP
+        if (ins.dead || ins.target < 0 || ins.op == OP_FOR_LOOP)
+            continue;
+
+        bool conditional = ins.op != OP_JUMP && ins.op != OP_LOOP;
+        bool known = ins.op != OP_JUMP_IF_TRUE; // condição falsa à chegada
+        bool consumed = consumesCondition(ins.op);
+        int target = resolve(ins.target);
+
+        for (int hop = 0; hop < MAX_HOPS && target >= 0; hop++)
+        {
+            const Instruction &at = code_[target];
+            int follow;
+            if (at.op == OP_JUMP || at.op == OP_LOOP)
+                follow = resolve(at.target);
+            else if (conditional && !consumed &&
+                     (at.op == OP_JUMP_IF_FALSE || at.op == OP_JUMP_IF_TRUE))
+                follow = (at.op == OP_JUMP_IF_FALSE) == known ? resolve(at.target) : next(target);
+            else
+                break;
+
+            // Os condicionais só saltam para a frente
+            if (follow < 0 || follow == target || (conditional && follow <= i))
+                break;
+            target = follow;
+        }
+        if (target < 0)
+            continue;
+
+        if (target != ins.target)
+        {
+            ins.target = target;
+            changed = true;
+        }
+
+        // Salto para a instrução seguinte (os com imediato e os compares
+        // que consomem os operandos seriam duas instruções; ficam)
+        if (target == next(i) && !isImmediateBranch(ins.op) && !isCompareBranch(ins.op) &&
+            !isCountedFor(ins.op))
+        {
+            if (ins.op == OP_POP_JUMP_IF_FALSE)
+            {
+                // A condição continua a sair da stack
+                ins.op = OP_POP;
+                ins.length = 1;
+                ins.target = -1;
+            }
+            else
+                kill(i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// JUMP_IF_FALSE L com POP a seguir, e em L um salto que
+// consome a condição: a condição é falsa à chegada, por isso o salto de L
+// é sempre tomado. Salta-se logo para lá e o valor sai no próprio salto
+// (a && b como condição de if/while).
+bool Pass::fuseConditions()
+{
+    bool changed = false;
+    countIncoming();
+
+    for (int i = 0; i < (int)code_.size(); i++)
+    {
+        Instruction &ins = code_[i];
+        if (ins.dead || ins.op != OP_JUMP_IF_FALSE)
+            continue;
+        int fall = next(i);
+        int target = resolve(ins.target);
+        if (fall < 0 || target < 0 || incoming_[fall] > 0 || code_[fall].op != OP_POP ||
+            code_[target].op != OP_POP_JUMP_IF_FALSE)
+            continue;
+
+        ins.target = code_[target].target;
+        ins.op = OP_POP_JUMP_IF_FALSE;
+        kill(fall);
+        changed = true;
+    }
+
+    // Compare seguido de POP_JUMP_IF_FALSE (o que sobrou acima, ou um
+    // salto com o compare dobrado) passa a um só salto; com PUSH_INT antes
+    // do compare, à forma com imediato. Um salto para o compare continua a
+    // cair no salto novo, que faz o mesmo.
+    countIncoming();
+    int before = -1, prev = -1;
+    for (int i = 0; i < (int)code_.size(); i++)
+    {
+        Instruction &ins = code_[i];
+        if (ins.dead)
+            continue;
+        if (ins.op == OP_POP_JUMP_IF_FALSE && incoming_[i] == 0 && prev >= 0 &&
+            code_[prev].op >= OP_EQUAL && code_[prev].op <= OP_LESS_EQUAL)
+        {
+            bool immediate = before >= 0 && code_[before].op == OP_PUSH_INT &&
+                             incoming_[prev] == 0;
+            ins.op = conditionBranch(code_[prev].op, immediate);
+            kill(prev);
+            if (immediate)
+            {
+                ins.operands[0] = code_[before].operands[0];
+                ins.operands[1] = code_[before].operands[1];
+                ins.length = 5;
+                kill(before);
+            }
+            changed = true;
+        }
+        before = prev;
+        prev = i;
+    }
+    return changed;
+}
+
+bool Pass::removeUnreachable()
+{
+    std::vector<bool> reached(code_.size(), false);
+    std::vector<int> work;
+    int entry = resolve(0);
+    if (entry >= 0)
+        work.push_back(entry);
+
+    while (!work.empty())
+    {
+        int i = work.back();
+        work.pop_back();
+        if (i < 0 || reached[i])
+            continue;
+        reached[i] = true;
+        if (fallsThrough(code_[i].op))
+            work.push_back(next(i));
+        if (code_[i].target >= 0)
+            work.push_back(resolve(code_[i].target));
+        if (code_[i].op == OP_SWITCH)
+            switchTable(code_[i]).forEachTarget([&](int target) { work.push_back(resolve(target)); });
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < code_.size(); i++)
+    {
+        if (!code_[i].dead && !reached[i])
+        {
+            kill((int)i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// farJumps: saltos que o compiler não conseguiu codificar (o operando
+// ainda não é válido; o destino vem daqui)
+bool Pass::decode(const std::vector<FarJump> &farJumps)
+{
+    int count = (int)chunk_.count();
+    std::vector<int> index(count + 1, -1);
+    std::vector<int> targets;
+    std::vector<int> far(count, -1);
+    for (const FarJump &jump : farJumps)
+    {
+        if (jump.offset < 0 || jump.offset >= count)
+            return false;
+        far[jump.offset] = jump.target;
+    }
+
+    for (int offset = 0; offset < count;)
+    {
+        StackInstruction info;
+        if (!Verifier::decode(chunk_, offset, info) || info.length > 9)
+            return false;
+        if (info.jumpTarget >= 0 && far[offset + info.length - 2] >= 0)
+            info.jumpTarget = far[offset + info.length - 2];
+
+        Instruction ins;
+        ins.op = narrowJump(chunk_.code[offset]);
+        ins.length = info.length;
+        ins.line = chunk_.lines.lineAt(offset);
+        ins.target = -1;
+        ins.dead = false;
+        memset(ins.operands, 0, sizeof(ins.operands));
+        // Nos saltos guarda-se só o que vem antes do offset (o imediato,
+        // os slots do for numérico)
+        if (isJump(ins.op))
+            ins.length = 3 + jumpOperands(ins.op);
+        for (int k = 1; k < ins.length - (isJump(ins.op) ? 2 : 0); k++)
+            ins.operands[k - 1] = chunk_.code[offset + k];
+
+        index[offset] = (int)code_.size();
+        targets.push_back(info.jumpTarget);
+        code_.push_back(ins);
+        offset += info.length;
+    }
+
+    for (size_t i = 0; i < code_.size(); i++)
+    {
+        if (targets[i] < 0)
+            continue;
+        if (targets[i] > count || index[targets[i]] < 0)
+            return false;
+        code_[i].target = index[targets[i]];
+    }
+
+    bool valid = true;
+    switches_ = chunk_.switches;
+    for (SwitchTable &table : switches_)
+    {
+        table.forEachTarget([&](int &target) {
+            if (target < 0 || target >= count || index[target] < 0)
+                valid = false;
+            else
+                target = index[target];
+        });
+    }
+    return valid && !code_.empty();
+}
+
+bool Pass::run()
+{
+    bool changed = false;
+    for (int round = 0; round < MAX_ROUNDS; round++)
+    {
+        bool progress = foldConstants();
+        progress |= foldNot();
+        progress |= threadJumps();
+        progress |= fuseConditions();
+        progress |= removeUnreachable();
+        if (!progress)
+            break;
+        changed = true;
+    }
+    return changed;
+}
+
+// Comprimento de uma instrução na forma curta ou larga
+int Pass::width(int i, bool wide) const
+{
+    const Instruction &ins = code_[i];
+    if (ins.target < 0 || !wide)
+        return ins.length;
+    if (isCountedFor(ins.op))
+        return ins.length + 1; // mesmos operandos, salto de 24 bits
+    if (isImmediateBranch(ins.op))
+        return 8; // PUSH_INT + compare + salto largo
+    return isCompareBranch(ins.op) ? 5 : 4; // compare + salto largo
+}
+
+bool Pass::encode()
+{
+    // Saltos que não cabem em 16 bits passam à forma larga; como isso
+    // afasta outros destinos, repete-se até nenhum mudar
+    std::vector<char> wide(code_.size(), 0);
+    std::vector<int> offsets(code_.size(), -1);
+    int size = 0;
+    for (;;)
+    {
+        size = 0;
+        for (size_t i = 0; i < code_.size(); i++)
+        {
+            if (code_[i].dead)
+                continue;
+            offsets[i] = size;
+            size += width((int)i, wide[i]);
+        }
+
+        bool grew = false;
+        for (size_t i = 0; i < code_.size(); i++)
+        {
+            if (code_[i].dead || code_[i].target < 0 || wide[i])
+                continue;
+            int target = resolve(code_[i].target);
+            if (target < 0)
+                return false;
+            int from = offsets[i] + width((int)i, false);
+            int distance = offsets[target] - from;
+            if (distance > UINT16_MAX || -distance > UINT16_MAX)
+            {
+                wide[i] = 1;
+                grew = true;
+            }
+        }
+        if (!grew)
+            break;
+    }
+
+    std::vector<uint8_t> code;
+    LineTable lines;
+    code.reserve(size);
+
+    for (size_t i = 0; i < code_.size(); i++)
+    {
+        Instruction &ins = code_[i];
+        if (ins.dead)
+            continue;
+
+        uint8_t op = ins.op;
+        int length = ins.length;
+        uint8_t operands[8];
+        memcpy(operands, ins.operands, sizeof(operands));
+        if (ins.target >= 0)
+        {
+            int target = resolve(ins.target);
+            if (target < 0)
+                return false;
+            int from = offsets[i] + width((int)i, wide[i]);
+            int to = offsets[target];
+            int jump;
+            if (op == OP_JUMP || op == OP_LOOP)
+            {
+                op = to >= from ? OP_JUMP : OP_LOOP;
+                jump = to >= from ? to - from : from - to;
+            }
+            else if (op == OP_FOR_LOOP)
+            {
+                if (to > from)
+                    return false;
+                jump = from - to;
+            }
+            else
+            {
+                if (to < from)
+                    return false;
+                jump = to - from;
+            }
+
+            if (wide[i])
+            {
+                if (jump > 0xffffff)
+                    return false;
+                if (isCountedFor(op))
+                {
+                    // Os slots ficam; só o offset cresce
+                    operands[length - 3] = (uint8_t)(jump >> 16);
+                    operands[length - 2] = (uint8_t)(jump >> 8);
+                    operands[length - 1] = (uint8_t)jump;
+                    op = wideJump(op);
+                    length++;
+                }
+                else
+                {
+                    if (isImmediateBranch(op))
+                    {
+                        code.push_back(OP_PUSH_INT);
+                        code.push_back(operands[0]);
+                        code.push_back(operands[1]);
+                        for (int k = 0; k < 3; k++)
+                            lines.add(ins.line);
+                    }
+                    if (isCompareBranch(op))
+                    {
+                        code.push_back(branchCompare(op));
+                        lines.add(ins.line);
+                    }
+                    op = wideJump(op);
+                    length = 4;
+                    operands[0] = (uint8_t)(jump >> 16);
+                    operands[1] = (uint8_t)(jump >> 8);
+                    operands[2] = (uint8_t)jump;
+                }
+            }
+            else
+            {
+                operands[length - 3] = (uint8_t)(jump >> 8);
+                operands[length - 2] = (uint8_t)jump;
+            }
+        }
+
+        code.push_back(op);
+        lines.add(ins.line);
+        for (int k = 1; k < length; k++)
+        {
+            code.push_back(operands[k - 1]);
+            lines.add(ins.line);
+        }
+    }
+
+    bool valid = true;
+    for (SwitchTable &table : switches_)
+    {
+        table.forEachTarget([&](int &target) {
+            int at = resolve(target);
+            if (at < 0)
+                valid = false;
+            else
+                target = offsets[at];
+        });
+    }
+    if (!valid)
+        return false;
+
+    chunk_.code.swap(code);
+    chunk_.lines.swap(lines);
+    chunk_.switches.swap(switches_);
+    return true;
+}
+
+} // namespace
+
+bool Optimizer::optimize(Function *function, const std::vector<FarJump> &farJumps)
+{
+    Pass pass(function->chunk);
+    if (!pass.decode(farJumps))
+        return false;
+    // Com saltos por codificar o encode é obrigatório
+    if (!pass.run() && farJumps.empty())
+        return false;
+    return pass.encode();
+}
@@ -0,0 +1,828 @@
+#include "regcompiler.h"
+#include "fold.h"
+#include "verifier.h"
+#include <vector>
+
+namespace
+{
+
+// ============================================
+// TRADUTOR
+// ============================================
+
+// Valor da stack abstracta: ou já está num registo (slot), ou é uma
+// constante que ainda não foi carregada.
+struct Operand
+{
+    bool isConstant;
+    uint8_t index;
+
+    static Operand reg(int r)
+    {
+        Operand op;
+        op.isConstant = false;
+        op.index = (uint8_t)r;
+        return op;
+    }
+
+    static Operand constant(int k)
+    {
+        Operand op;
+        op.isConstant = true;
+        op.index = (uint8_t)k;
+        return op;
+    }
+};
+
+class Translator
+{
+public:
+    explicit Translator(Function *function)
+        : function_(function), chunk_(function->chunk), line_(0), maxDepth_(0),
+          lastDst_(-1), lastDstEnd_(-1)
+    {
+    }
+
+    bool run();
+
+private:
+    Function *function_;
+    const Chunk &chunk_;
+
+    std::vector<int> depth_;   // profundidade à entrada (-1 = inalcançável)
+    std::vector<char> isTarget_;
+    std::vector<int> regOffset_;
+
+    std::vector<Operand> stack_;
+    std::vector<uint8_t> code_;
+    LineTable lines_;
+
+    struct Fixup
+    {
+        size_t at;
+        int target;
+    };
+    std::vector<Fixup> fixups_;
+
+    int line_;
+    int maxDepth_;
+
+    // Operando dst da última instrução emitida (para SET_LOCAL escrever
+    // directamente no local em vez de MOVE)
+    int lastDst_;
+    int lastDstEnd_;
+
+    bool analyze();
+    bool translate(int offset, const StackInstruction &info);
+
+    void emit(uint8_t byte);
+    void emitOpDst(uint8_t op, int dst);
+    void emitJumpTo(int stackTarget);
+    void markDst();
+
+    int depth() const { return (int)stack_.size(); }
+    void push(Operand op);
+    void materialize(int i);
+    void flush(int from = 0, int to = -1);
+    int read(int i);
+    int readLocal(int slot);
+    void protect(int slot);
+    bool conditionIsDead(int offset, const StackInstruction &info) const;
+    int immediateConstant(int offset);
+};
+
+// Profundidade de cada instrução por worklist; cada destino tem de ser
+// alcançado sempre com a mesma profundidade.
+bool Translator::analyze()
+{
+    int size = (int)chunk_.count();
+    depth_.assign(size, -1);
+    isTarget_.assign(size, 0);
+
+    std::vector<int> worklist;
+    depth_[0] = function_->arity + 1; // slot 0 = callee
+    worklist.push_back(0);
+
+    while (!worklist.empty())
+    {
+        int offset = worklist.back();
+        worklist.pop_back();
+
+        StackInstruction info;
+        if (!Verifier::decode(chunk_, offset, info))
+            return false;
+
+        int after = depth_[offset] + info.delta;
+        if (after < 0 || after > 255)
+            return false;
+        if (after > maxDepth_)
+            maxDepth_ = after;
+        if (depth_[offset] > maxDepth_)
+            maxDepth_ = depth_[offset];
+
+        int next[2] = {-1, -1};
+        if (info.fallsThrough)
+            next[0] = offset + info.length;
+        if (info.jumpTarget >= 0)
+        {
+            if (info.jumpTarget >= size)
+                return false;
+            isTarget_[info.jumpTarget] = 1;
+            next[1] = info.jumpTarget;
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            int target = next[i];
+            if (target < 0)
+                continue;
+            if (target >= size)
+                return false;
+            if (depth_[target] == -1)
+            {
+                depth_[target] = after;
+                worklist.push_back(target);
+            }
+            else if (depth_[target] != after)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void Translator::emit(uint8_t byte)
+{
+    code_.push_back(byte);
+    lines_.add(line_);
+}
+
+void Translator::emitJumpTo(int stackTarget)
+{
+    Fixup fixup;
+    fixup.at = code_.size();
+    fixup.target = stackTarget;
+    fixups_.push_back(fixup);
+    emit(0xff);
+    emit(0xff);
+}
+
+// Opcode + registo destino; a posição do dst fica guardada para que um
+// SET_LOCAL logo a seguir possa reescrevê-lo (markDst fecha a instrução).
+void Translator::emitOpDst(uint8_t op, int dst)
+{
+    emit(op);
+    lastDst_ = (int)code_.size();
+    emit((uint8_t)dst);
+}
+
+void Translator::markDst()
+{
+    lastDstEnd_ = (int)code_.size();
+}
+
+void Translator::push(Operand op)
+{
+    stack_.push_back(op);
+    if (depth() > maxDepth_)
+        maxDepth_ = depth();
+}
+
+// Garante que a entrada i vive no slot i
+void Translator::materialize(int i)
+{
+    Operand op = stack_[i];
+    if (!op.isConstant && op.index == i)
+        return;
+
+    if (op.isConstant)
+    {
+        emit(R_LOADK);
+        emit((uint8_t)i);
+        emit(op.index);
+    }
+    else
+    {
+        emit(R_MOVE);
+        emit((uint8_t)i);
+        emit(op.index);
+    }
+    stack_[i] = Operand::reg(i);
+}
+
+void Translator::flush(int from, int to)
+{
+    if (to < 0)
+        to = depth();
+    for (int i = from; i < to; i++)
+        materialize(i);
+}
+
+// Registo onde a entrada i pode ser lida
+int Translator::read(int i)
+{
+    if (stack_[i].isConstant)
+        materialize(i);
+    return stack_[i].index;
+}
+
+int Translator::readLocal(int slot)
+{
+    materialize(slot);
+    return slot;
+}
+
+// Antes de escrever num slot: quem ainda o referencia fica com uma cópia
+void Translator::protect(int slot)
+{
+    for (int j = 0; j < depth(); j++)
+    {
+        if (j != slot && !stack_[j].isConstant && stack_[j].index == slot)
+            materialize(j);
+    }
+}
+
+// JUMP_IF_FALSE seguido de POP nos dois caminhos: o bool nunca é lido
+bool Translator::conditionIsDead(int offset, const StackInstruction &info) const
+{
+    int fall = offset + info.length;
+    return fall < (int)chunk_.count() && chunk_.code[fall] == OP_POP &&
+           chunk_.code[info.jumpTarget] == OP_POP;
+}
+
+// O formato de registos não tem imediatos: o int16 vai para a pool e usa-se
+// a forma K. -1 se a pool já não cabe num operando u8.
+int Translator::immediateConstant(int offset)
+{
+    int16_t k = (int16_t)((chunk_.code[offset + 1] << 8) | chunk_.code[offset + 2]);
+    return fold::constantIndex(function_->chunk, Value::makeInt(k));
+}
+
+static uint8_t unaryToRegister(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_NOT:
+        return R_NOT;
+    case OP_NEGATE:
+        return R_NEGATE;
+    case OP_SQRT:
+        return R_SQRT;
+    case OP_ABS:
+        return R_ABS;
+    case OP_LEN:
+        return R_LEN;
+    default:
+        return R_STR;
+    }
+}
+
+static uint8_t binaryToRegister(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        return R_ADD;
+    case OP_SUBTRACT:
+        return R_SUBTRACT;
+    case OP_MULTIPLY:
+        return R_MULTIPLY;
+    case OP_DIVIDE:
+        return R_DIVIDE;
+    case OP_MODULO:
+        return R_MODULO;
+    case OP_EQUAL:
+        return R_EQUAL;
+    case OP_NOT_EQUAL:
+        return R_NOT_EQUAL;
+    case OP_GREATER:
+        return R_GREATER;
+    case OP_GREATER_EQUAL:
+        return R_GREATER_EQUAL;
+    case OP_LESS:
+        return R_LESS;
+    case OP_POW:
+        return R_POW;
+    default:
+        return R_LESS_EQUAL;
+    }
+}
+
+bool Translator::translate(int offset, const StackInstruction &info)
+{
+    const uint8_t *code = chunk_.code.data();
+    uint8_t op = code[offset];
+    int d = depth();
+
+    switch (op)
+    {
+    case OP_CONSTANT:
+        push(Operand::constant(code[offset + 1]));
+        return true;
+
+    case OP_PUSH_INT:
+    {
+        int k = immediateConstant(offset);
+        if (k < 0)
+            return false;
+        push(Operand::constant(k));
+        return true;
+    }
+
+    case OP_NIL:
+    case OP_TRUE:
+    case OP_FALSE:
+        emitOpDst(op == OP_NIL ? R_LOADNIL : op == OP_TRUE ? R_LOADTRUE : R_LOADFALSE, d);
+        markDst();
+        push(Operand::reg(d));
+        return true;
+
+    case OP_POP:
+        stack_.pop_back();
+        return true;
+
+    case OP_NOT:
+    case OP_NEGATE:
+    case OP_SQRT:
+    case OP_ABS:
+    case OP_LEN:
+    case OP_STR:
+    {
+        int src = read(d - 1);
+        emitOpDst(unaryToRegister(op), d - 1);
+        emit((uint8_t)src);
+        markDst();
+        stack_[d - 1] = Operand::reg(d - 1);
+        return true;
+    }
+
+    case OP_ADD:
+    case OP_SUBTRACT:
+    {
+        // Constante à direita: forma K, sem carregar a constante
+        if (stack_[d - 1].isConstant)
+        {
+            int k = stack_[d - 1].index;
+            int a = read(d - 2);
+            emitOpDst(op == OP_ADD ? R_ADDK : R_SUBTRACTK, d - 2);
+            emit((uint8_t)a);
+            emit((uint8_t)k);
+            markDst();
+            stack_.pop_back();
+            stack_[d - 2] = Operand::reg(d - 2);
+            return true;
+        }
+    }
+        // fallthrough
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER:
+    case OP_GREATER_EQUAL:
+    case OP_LESS:
+    case OP_LESS_EQUAL:
+    case OP_POW:
+    {
+        int b = read(d - 1);
+        int a = read(d - 2);
+        emitOpDst(binaryToRegister(op), d - 2);
+        emit((uint8_t)a);
+        emit((uint8_t)b);
+        markDst();
+        stack_.pop_back();
+        stack_[d - 2] = Operand::reg(d - 2);
+        return true;
+    }
+
+    case OP_GET_LOCAL:
+    {
+        int slot = code[offset + 1];
+        if (slot >= d)
+            return false;
+        push(Operand::reg(readLocal(slot)));
+        return true;
+    }
+
+    case OP_SET_LOCAL:
+    {
+        int slot = code[offset + 1];
+        if (slot >= d - 1)
+            return false;
+
+        Operand value = stack_[d - 1];
+        if (!value.isConstant && value.index == slot)
+            return true;
+
+        bool aliased = false;
+        for (int j = 0; j < d; j++)
+        {
+            if (j != slot && !stack_[j].isConstant && stack_[j].index == slot)
+                aliased = true;
+        }
+
+        // O valor acabou de ser calculado para o topo: escreve-o já no local
+        if (!aliased && !value.isConstant && value.index == d - 1 &&
+            lastDstEnd_ == (int)code_.size() && code_[lastDst_] == (uint8_t)(d - 1))
+        {
+            code_[lastDst_] = (uint8_t)slot;
+        }
+        else
+        {
+            protect(slot);
+            emit(value.isConstant ? R_LOADK : R_MOVE);
+            emit((uint8_t)slot);
+            emit(value.index);
+        }
+
+        stack_[slot] = Operand::reg(slot);
+        if (!value.isConstant)
+            stack_[d - 1] = Operand::reg(slot);
+        return true;
+    }
+
+    case OP_GET_GLOBAL:
+        emitOpDst(R_GET_GLOBAL, d);
+        emit(code[offset + 1]);
+        emit(code[offset + 2]);
+        markDst();
+        push(Operand::reg(d));
+        return true;
+
+    case OP_SET_GLOBAL:
+    case OP_DEFINE_GLOBAL:
+    {
+        int src = read(d - 1);
+        emit(op == OP_SET_GLOBAL ? R_SET_GLOBAL : R_DEFINE_GLOBAL);
+        emit((uint8_t)src);
+        emit(code[offset + 1]);
+        emit(code[offset + 2]);
+        if (op == OP_DEFINE_GLOBAL)
+            stack_.pop_back();
+        return true;
+    }
+
+    case OP_PRINT:
+    {
+        int src = read(d - 1);
+        emit(R_PRINT);
+        emit((uint8_t)src);
+        stack_.pop_back();
+        return true;
+    }
+
+    case OP_JUMP:
+    case OP_LOOP:
+        flush();
+        emit(R_JUMP);
+        emitJumpTo(info.jumpTarget);
+        return true;
+
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+    {
+        uint8_t jump = op == OP_JUMP_IF_FALSE ? R_JUMP_IF_FALSE : R_JUMP_IF_TRUE;
+        if (conditionIsDead(offset, info))
+        {
+            // Só o que está por baixo da condição precisa de ir para o slot
+            int src = read(d - 1);
+            flush(0, d - 1);
+            emit(jump);
+            emit((uint8_t)src);
+        }
+        else
+        {
+            flush();
+            emit(jump);
+            emit((uint8_t)(d - 1));
+        }
+        emitJumpTo(info.jumpTarget);
+        return true;
+    }
+
+    // Condições que consomem os operandos: o bool nunca é escrito (ou
+    // vai para o slot que ficou livre, nos compares sem forma fundida)
+    case OP_POP_JUMP_IF_FALSE:
+    {
+        int src = read(d - 1);
+        stack_.pop_back();
+        flush(0, d - 1);
+        emit(R_JUMP_IF_FALSE);
+        emit((uint8_t)src);
+        emitJumpTo(info.jumpTarget);
+        return true;
+    }
+
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+    case OP_JUMP_IF_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_LESS_IMM:
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+    {
+        int k = immediateConstant(offset);
+        if (k < 0)
+            return false;
+        push(Operand::constant(k));
+        d++;
+    }
+    // fallthrough
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+    case OP_JUMP_IF_NOT_LESS:
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+    {
+        uint8_t compare = branchCompare(op);
+        int b = read(d - 1);
+        int a = read(d - 2);
+        stack_.resize(d - 2);
+        flush(0, d - 2);
+
+        if (compare == OP_LESS || compare == OP_GREATER || compare == OP_EQUAL)
+        {
+            emit(compare == OP_LESS      ? R_LESS_JUMP_IF_FALSE
+                 : compare == OP_GREATER ? R_GREATER_JUMP_IF_FALSE
+                                         : R_EQUAL_JUMP_IF_FALSE);
+            emit((uint8_t)a);
+            emit((uint8_t)b);
+        }
+        else
+        {
+            emit(binaryToRegister(compare));
+            emit((uint8_t)(d - 2));
+            emit((uint8_t)a);
+            emit((uint8_t)b);
+            emit(R_JUMP_IF_FALSE);
+            emit((uint8_t)(d - 2));
+        }
+        emitJumpTo(info.jumpTarget);
+        return true;
+    }
+
+    case OP_CALL:
+    case OP_CALL_DIRECT:
+    {
+        int argCount = code[offset + 1];
+        int base = d - argCount - 1;
+        if (base < 0)
+            return false;
+        flush(base);
+        emit(op == OP_CALL ? R_CALL : R_CALL_DIRECT);
+        emit((uint8_t)base);
+        emit((uint8_t)argCount);
+        stack_.resize(base);
+        push(Operand::reg(base));
+        return true;
+    }
+
+    case OP_TAIL_CALL:
+    case OP_TAIL_CALL_DIRECT:
+    {
+        int argCount = code[offset + 1];
+        int base = d - argCount - 1;
+        if (base < 0)
+            return false;
+        flush(base);
+        emit(op == OP_TAIL_CALL ? R_TAIL_CALL : R_TAIL_CALL_DIRECT);
+        emit((uint8_t)base);
+        emit((uint8_t)argCount);
+        return true;
+    }
+
+    case OP_CALL_NATIVE:
+    {
+        int argCount = code[offset + 2];
+        int base = d - argCount;
+        if (base < 0)
+            return false;
+        flush(base);
+        emit(R_CALL_NATIVE);
+        emit((uint8_t)base);
+        emit(code[offset + 1]);
+        emit((uint8_t)argCount);
+        stack_.resize(base);
+        push(Operand::reg(base));
+        return true;
+    }
+
+    case OP_RETURN:
+    {
+        int src = read(d - 1);
+        emit(R_RETURN);
+        emit((uint8_t)src);
+        return true;
+    }
+
+    case OP_RETURN_NIL:
+        emit(R_RETURN_NIL);
+        return true;
+
+    case OP_ADD_LOCALS:
+    {
+        int a = code[offset + 1];
+        int b = code[offset + 2];
+        if (a >= d || b >= d)
+            return false;
+        a = readLocal(a);
+        b = readLocal(b);
+        emitOpDst(R_ADD, d);
+        emit((uint8_t)a);
+        emit((uint8_t)b);
+        markDst();
+        push(Operand::reg(d));
+        return true;
+    }
+
+    case OP_ADD_CONST:
+    case OP_SUBTRACT_CONST:
+    {
+        int a = read(d - 1);
+        emitOpDst(op == OP_ADD_CONST ? R_ADDK : R_SUBTRACTK, d - 1);
+        emit((uint8_t)a);
+        emit(code[offset + 1]);
+        markDst();
+        stack_[d - 1] = Operand::reg(d - 1);
+        return true;
+    }
+
+    case OP_ADD_IMM:
+    case OP_SUBTRACT_IMM:
+    {
+        int k = immediateConstant(offset);
+        if (k < 0)
+            return false;
+        int a = read(d - 1);
+        emitOpDst(op == OP_ADD_IMM ? R_ADDK : R_SUBTRACTK, d - 1);
+        emit((uint8_t)a);
+        emit((uint8_t)k);
+        markDst();
+        stack_[d - 1] = Operand::reg(d - 1);
+        return true;
+    }
+
+    case OP_INC_LOCAL:
+    case OP_DEC_LOCAL:
+    {
+        int slot = code[offset + 1];
+        if (slot >= d)
+            return false;
+        readLocal(slot);
+        protect(slot);
+        emit(op == OP_INC_LOCAL ? R_INC : R_DEC);
+        emit((uint8_t)slot);
+        return true;
+    }
+
+    // For numérico: soma do passo no slot do contador e compare + salto
+    // (o bool, quando preciso, vai para o registo acima da stack)
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+    {
+        int counter = code[offset + 1];
+        int limit = code[offset + 2];
+        uint8_t compare = code[offset + 3];
+        if (counter >= d || limit >= d)
+            return false;
+
+        if (op == OP_FOR_LOOP)
+        {
+            int16_t step = (int16_t)((code[offset + 4] << 8) | code[offset + 5]);
+            int k = -1;
+            if (step != 1 && step != -1)
+            {
+                k = fold::constantIndex(function_->chunk, Value::makeInt(step < 0 ? -step : step));
+                if (k < 0)
+                    return false;
+            }
+            readLocal(counter);
+            protect(counter);
+            if (k < 0)
+            {
+                emit(step > 0 ? R_INC : R_DEC);
+                emit((uint8_t)counter);
+            }
+            else
+            {
+                emit(step < 0 ? R_SUBTRACTK : R_ADDK);
+                emit((uint8_t)counter);
+                emit((uint8_t)counter);
+                emit((uint8_t)k);
+            }
+        }
+        flush();
+
+        if (op == OP_FOR_PREP && (compare == OP_LESS || compare == OP_GREATER))
+        {
+            emit(compare == OP_LESS ? R_LESS_JUMP_IF_FALSE : R_GREATER_JUMP_IF_FALSE);
+            emit((uint8_t)counter);
+            emit((uint8_t)limit);
+        }
+        else
+        {
+            emit(binaryToRegister(compare));
+            emit((uint8_t)d);
+            emit((uint8_t)counter);
+            emit((uint8_t)limit);
+            emit(op == OP_FOR_PREP ? R_JUMP_IF_FALSE : R_JUMP_IF_TRUE);
+            emit((uint8_t)d);
+        }
+        emitJumpTo(info.jumpTarget);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool Translator::run()
+{
+    if (chunk_.count() == 0 || !analyze())
+        return false;
+
+    int size = (int)chunk_.count();
+    regOffset_.assign(size, -1);
+
+    bool blockStart = true; // início, ou depois de JUMP/LOOP/RETURN
+    int offset = 0;
+
+    while (offset < size)
+    {
+        StackInstruction info;
+        if (!Verifier::decode(chunk_, offset, info))
+            return false;
+
+        if (depth_[offset] < 0)
+        {
+            // Código morto (depois de um return, p.ex.)
+            blockStart = true;
+            offset += info.length;
+            continue;
+        }
+
+        line_ = chunk_.lines.lineAt(offset);
+
+        if (isTarget_[offset] || blockStart)
+        {
+            // Em destinos de salto tudo vive no seu slot
+            if (!blockStart)
+                flush();
+            stack_.clear();
+            for (int i = 0; i < depth_[offset]; i++)
+                stack_.push_back(Operand::reg(i));
+            lastDstEnd_ = -1;
+        }
+        else if (depth() != depth_[offset])
+        {
+            return false;
+        }
+
+        regOffset_[offset] = (int)code_.size();
+
+        if (!translate(offset, info))
+            return false;
+
+        blockStart = !info.fallsThrough;
+        offset += info.length;
+    }
+
+    if (code_.size() > UINT16_MAX)
+        return false;
+
+    for (size_t i = 0; i < fixups_.size(); i++)
+    {
+        int target = regOffset_[fixups_[i].target];
+        if (target < 0)
+            return false;
+        code_[fixups_[i].at] = (uint8_t)((target >> 8) & 0xff);
+        code_[fixups_[i].at + 1] = (uint8_t)(target & 0xff);
+    }
+
+    function_->regCode.swap(code_);
+    function_->regLines.swap(lines_);
+    function_->regCount = maxDepth_ + 1;
+    return true;
+}
+
+} // namespace
+
+bool RegisterCompiler::compile(Function *function)
+{
+    function->regCode.clear();
+    function->regLines.clear();
+    function->regCount = 0;
+
+    Translator translator(function);
+    if (translator.run())
+        return true;
+
+    function->regCode.clear();
+    function->regLines.clear();
+    function->regCount = 0;
+    return false;
+}
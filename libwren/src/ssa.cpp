@@ -0,0 +1,2103 @@
+#include "ssa.h"
+#include "fold.h"
+#include "verifier.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// ============================================
+// IR
+// ============================================
+
+enum NodeKind : uint8_t
+{
+    N_PARAM, // slot do frame à entrada (callee e argumentos)
+    N_PHI,   // posição da stack à entrada de um bloco com vários predecessores
+    N_CONST, // literal, do bytecode ou dobrado
+    N_OP,    // operação, com o opcode de stack na forma genérica
+};
+
+struct Node
+{
+    NodeKind kind;
+    uint8_t op;
+    uint16_t operand; // N_OP: global, argc ou native; N_PARAM: slot
+    uint8_t argc;     // CALL_NATIVE
+    int block;
+    int line;
+    int order;    // posição no programa original (ordena os efeitos)
+    Value value;  // N_CONST
+    int constant; // N_CONST: índice na pool (-1 se ainda não tem)
+    std::vector<int> args;
+    int alias; // substituído por este valor (-1 se não)
+    bool live;
+};
+
+enum TermKind : uint8_t
+{
+    T_JUMP,
+    T_BRANCH,
+    T_RETURN,
+    T_RETURN_NIL,
+    T_TAIL_CALL,
+};
+
+// Aresta de entrada: bloco de origem e qual dos sucessores dele é
+struct Edge
+{
+    int block;
+    int slot;
+};
+
+struct Block
+{
+    int start; // offset no bytecode original (-1 na entrada sintética)
+    int end;
+    std::vector<int> phis;   // um por posição da stack à entrada
+    std::vector<int> nodes;  // N_OP por ordem
+    std::vector<Edge> preds; // alinhado com os args dos phis
+    std::vector<int> exit;   // stack à saída
+    TermKind term;
+    uint8_t termOp; // T_TAIL_CALL
+    int termLine;
+    std::vector<int> termArgs; // BRANCH: condição; RETURN: valor; TAIL_CALL: callee e args
+    int succ[2];               // JUMP: [0]; BRANCH: [0] se verdadeiro, [1] se falso
+    int idom;
+    int rpo; // posição em order_ (-1 = fora do CFG)
+};
+
+enum Lattice : uint8_t
+{
+    L_TOP,
+    L_CONST,
+    L_BOTTOM,
+};
+
+// Não falham nem têm efeitos: podem mudar de sítio ou desaparecer
+bool isPure(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_NOT:
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_SQRT:
+    case OP_ABS:
+    case OP_POW:
+    case OP_LEN:
+    case OP_STR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool hasResult(uint8_t op)
+{
+    return op != OP_SET_GLOBAL && op != OP_DEFINE_GLOBAL && op != OP_PRINT;
+}
+
+bool isCall(uint8_t op)
+{
+    return op == OP_CALL || op == OP_CALL_DIRECT || op == OP_CALL_NATIVE;
+}
+
+bool accessesGlobal(uint8_t op)
+{
+    return op == OP_GET_GLOBAL || op == OP_SET_GLOBAL || op == OP_DEFINE_GLOBAL;
+}
+
+Value immediateAt(const uint8_t *code)
+{
+    return Value::makeInt((int16_t)((code[0] << 8) | code[1]));
+}
+
+// Profundidade da stack à entrada de cada instrução alcançável (-1 nas
+// outras); false se o código não tem uma profundidade fixa por offset
+bool stackDepths(const Chunk &chunk, int arity, std::vector<int> &depth)
+{
+    int size = (int)chunk.count();
+    depth.assign(size, -1);
+    if (size == 0)
+        return false;
+
+    std::vector<int> work;
+    depth[0] = arity + 1;
+    work.push_back(0);
+    while (!work.empty())
+    {
+        int offset = work.back();
+        work.pop_back();
+
+        StackInstruction info;
+        if (!Verifier::decode(chunk, offset, info))
+            return false;
+        int after = depth[offset] + info.delta;
+        if (depth[offset] < info.pops || after < 0 || after > UINT8_MAX + 1)
+            return false;
+
+        int next[2] = {info.fallsThrough ? offset + info.length : -1, info.jumpTarget};
+        for (int target : next)
+        {
+            if (target < 0)
+                continue;
+            if (target >= size)
+                return false;
+            if (depth[target] == -1)
+            {
+                depth[target] = after;
+                work.push_back(target);
+            }
+            else if (depth[target] != after)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Conjunto de valores com slot (índices densos) por bloco
+struct BitSet
+{
+    std::vector<uint64_t> words;
+
+    void resize(int bits) { words.assign((bits + 63) / 64, 0); }
+    bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(int i) { words[i >> 6] |= 1ULL << (i & 63); }
+    void reset(int i) { words[i >> 6] &= ~(1ULL << (i & 63)); }
+};
+
+class Ssa
+{
+public:
+    explicit Ssa(Function *function)
+        : function_(function), chunk_(function->chunk), nextOrder_(0), failed_(false),
+          line_(0)
+    {
+    }
+
+    bool build();
+    void simplifyPhis();
+    void propagateConstants();
+    void hoistGlobalLoads();
+    void eliminateDeadCode();
+    bool generate();
+
+private:
+    Function *function_;
+    Chunk &chunk_;
+    std::vector<Node> nodes_;
+    std::vector<Block> blocks_;
+    std::vector<int> order_; // reverse postorder a partir da entrada
+    int nextOrder_;
+
+    // SCCP
+    std::vector<uint8_t> lattice_;
+    std::vector<Value> known_;
+
+    // Geração de código
+    std::vector<int> uses_;
+    std::vector<char> escapes_; // usado por um phi ou noutro bloco
+    std::vector<int> phiUser_;
+    std::vector<char> inline_;  // calculado dentro da árvore do utilizador
+    std::vector<int> homeId_;   // índice denso dos valores com slot (-1)
+    std::vector<int> homes_;
+    std::vector<int> color_;    // slot de cada valor com slot
+    std::vector<std::vector<int>> roots_;
+    std::vector<uint8_t> code_;
+    LineTable lines_;
+    std::vector<int> blockOffset_;
+    std::vector<char> entryPop_; // o ramo que entra deixou a condição na stack
+
+    struct Fixup
+    {
+        size_t at;
+        int block;
+    };
+    std::vector<Fixup> fixups_;
+    bool failed_;
+    int line_;
+
+    int resolve(int v) const;
+    int newNode(NodeKind kind, int block, int line);
+    int newConst(int block, int line, const Value &value, int constant);
+    int newOp(uint8_t op, int block, int line, const std::vector<int> &args, int operand = 0,
+              int argc = 0);
+    bool lower(int b, std::vector<int> &stack);
+    void computeOrder();
+    void computeDominators();
+    bool dominates(int a, int b) const;
+    int edgeIndex(int block, int pred, int slot) const;
+    void removeEdge(int block, int pred, int slot);
+
+    uint8_t latticeOf(int v, Value &value) const;
+    uint8_t evaluate(const Node &node, Value &value) const;
+    bool update(int v, uint8_t lattice, const Value &value);
+
+    bool homed(int v) const { return homeId_[v] >= 0; }
+    int home(int v) const { return color_[homeId_[v]]; }
+    void countUses();
+    void schedule(int b);
+    void expand(int v, std::vector<int> &sequence) const;
+    void leaves(int v, std::vector<int> &out) const;
+    void termLeaves(int b, std::vector<int> &out) const;
+    bool allocate();
+    int frameSize() const;
+
+    void emit(uint8_t byte);
+    void emitShort(int value);
+    void emitValue(int v);
+    void emitNode(int v);
+    void emitRoot(int v);
+    void emitConstant(int v);
+    void emitMoves(int b, int slot, int succ);
+    void emitJump(int target);
+    void emitGoto(int target, int next);
+    void emitTerminator(int b, int next);
+    bool popsOnEntry(int b) const;
+};
+
+int Ssa::resolve(int v) const
+{
+    while (nodes_[v].alias >= 0)
+        v = nodes_[v].alias;
+    return v;
+}
+
+int Ssa::newNode(NodeKind kind, int block, int line)
+{
+    Node node;
+    node.kind = kind;
+    node.op = 0;
+    node.operand = 0;
+    node.argc = 0;
+    node.block = block;
+    node.line = line;
+    node.order = nextOrder_++;
+    node.constant = -1;
+    node.alias = -1;
+    node.live = false;
+    nodes_.push_back(node);
+    return (int)nodes_.size() - 1;
+}
+
+int Ssa::newConst(int block, int line, const Value &value, int constant)
+{
+    int v = newNode(N_CONST, block, line);
+    nodes_[v].value = value;
+    nodes_[v].constant = constant;
+    return v;
+}
+
+int Ssa::newOp(uint8_t op, int block, int line, const std::vector<int> &args, int operand,
+               int argc)
+{
+    int v = newNode(N_OP, block, line);
+    nodes_[v].op = op;
+    nodes_[v].operand = (uint16_t)operand;
+    nodes_[v].argc = (uint8_t)argc;
+    nodes_[v].args = args;
+    blocks_[block].nodes.push_back(v);
+    return v;
+}
+
+// ============================================
+// CONSTRUÇÃO DO SSA
+// ============================================
+
+bool Ssa::build()
+{
+    std::vector<int> depth;
+    if (!stackDepths(chunk_, function_->arity, depth))
+        return false;
+
+    const uint8_t *code = chunk_.code.data();
+    int size = (int)chunk_.count();
+
+    // Inícios de bloco: destinos de salto e o que vem depois de um salto
+    std::vector<char> leader(size, 0);
+    leader[0] = 1;
+    for (int offset = 0; offset < size;)
+    {
+        StackInstruction info;
+        if (!Verifier::decode(chunk_, offset, info))
+            return false;
+        int next = offset + info.length;
+        if (info.jumpTarget >= 0 && info.jumpTarget < size)
+            leader[info.jumpTarget] = 1;
+        if ((info.jumpTarget >= 0 || !info.fallsThrough) && next < size)
+            leader[next] = 1;
+        offset = next;
+    }
+
+    // Bloco 0: entrada sintética (os parâmetros), cai no código
+    Block entry;
+    entry.start = -1;
+    entry.end = -1;
+    entry.term = T_JUMP;
+    entry.termOp = 0;
+    entry.termLine = size > 0 ? chunk_.lines.lineAt(0) : 0;
+    entry.succ[0] = entry.succ[1] = -1;
+    entry.idom = 0;
+    entry.rpo = -1;
+    blocks_.push_back(entry);
+
+    std::vector<int> blockAt(size, -1);
+    for (int offset = 0; offset < size;)
+    {
+        StackInstruction info;
+        Verifier::decode(chunk_, offset, info);
+        if (leader[offset] && depth[offset] >= 0)
+        {
+            Block block = entry;
+            block.start = offset;
+            blockAt[offset] = (int)blocks_.size();
+            blocks_.push_back(block);
+        }
+        offset += info.length;
+    }
+    blocks_[0].succ[0] = blockAt[0];
+
+    for (size_t b = 1; b < blocks_.size(); b++)
+    {
+        Block &block = blocks_[b];
+        int offset = block.start;
+        int last = offset;
+        StackInstruction info;
+        for (;;)
+        {
+            Verifier::decode(chunk_, offset, info);
+            last = offset;
+            offset += info.length;
+            if (offset >= size || leader[offset] || !info.fallsThrough || info.jumpTarget >= 0)
+                break;
+        }
+        block.end = offset;
+        block.termLine = chunk_.lines.lineAt(last);
+
+        switch (code[last])
+        {
+        case OP_JUMP:
+        case OP_LOOP:
+        case OP_JUMP_LONG:
+        case OP_LOOP_LONG:
+            block.succ[0] = blockAt[info.jumpTarget];
+            break;
+        case OP_JUMP_IF_TRUE:
+        case OP_JUMP_IF_TRUE_LONG:
+        case OP_FOR_LOOP:
+        case OP_FOR_LOOP_LONG:
+            block.term = T_BRANCH;
+            block.succ[0] = blockAt[info.jumpTarget];
+            block.succ[1] = blockAt[offset];
+            break;
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_FALSE_LONG:
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_POP_JUMP_IF_FALSE_LONG:
+        case OP_JUMP_IF_NOT_EQUAL:
+        case OP_JUMP_IF_EQUAL:
+        case OP_JUMP_IF_NOT_GREATER:
+        case OP_JUMP_IF_NOT_GREATER_EQUAL:
+        case OP_JUMP_IF_NOT_LESS:
+        case OP_JUMP_IF_NOT_LESS_EQUAL:
+        case OP_JUMP_IF_NOT_EQUAL_IMM:
+        case OP_JUMP_IF_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_GREATER_IMM:
+        case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_LESS_IMM:
+        case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        case OP_FOR_PREP:
+        case OP_FOR_PREP_LONG:
+            block.term = T_BRANCH;
+            block.succ[0] = blockAt[offset];
+            block.succ[1] = blockAt[info.jumpTarget];
+            break;
+        case OP_RETURN:
+            block.term = T_RETURN;
+            break;
+        case OP_RETURN_NIL:
+            block.term = T_RETURN_NIL;
+            break;
+        case OP_TAIL_CALL:
+        case OP_TAIL_CALL_DIRECT:
+            block.term = T_TAIL_CALL;
+            block.termOp = code[last];
+            break;
+        default:
+            // Cai no bloco seguinte
+            block.succ[0] = blockAt[offset];
+            break;
+        }
+    }
+
+    for (size_t b = 0; b < blocks_.size(); b++)
+    {
+        for (int slot = 0; slot < 2; slot++)
+        {
+            int succ = blocks_[b].succ[slot];
+            if (succ < 0)
+                continue;
+            Edge edge = {(int)b, slot};
+            blocks_[succ].preds.push_back(edge);
+        }
+    }
+
+    computeOrder();
+
+    // Stack abstrata bloco a bloco: cada posição guarda o valor SSA que lá
+    // está; um bloco com um só predecessor herda a stack dele, os outros
+    // começam com um phi por posição
+    for (int b : order_)
+    {
+        Block &block = blocks_[b];
+        std::vector<int> stack;
+
+        if (b == 0)
+        {
+            for (int slot = 0; slot <= function_->arity; slot++)
+            {
+                int param = newNode(N_PARAM, 0, block.termLine);
+                nodes_[param].operand = (uint16_t)slot;
+                stack.push_back(param);
+            }
+            blocks_[0].exit = stack;
+            continue;
+        }
+
+        if (block.preds.size() == 1 && blocks_[block.preds[0].block].rpo < block.rpo)
+        {
+            stack = blocks_[block.preds[0].block].exit;
+        }
+        else
+        {
+            for (int i = 0; i < depth[block.start]; i++)
+            {
+                int phi = newNode(N_PHI, b, chunk_.lines.lineAt(block.start));
+                blocks_[b].phis.push_back(phi);
+                stack.push_back(phi);
+            }
+        }
+
+        if ((int)stack.size() != depth[block.start] || !lower(b, stack))
+            return false;
+        blocks_[b].exit = stack;
+    }
+
+    for (int b : order_)
+    {
+        Block &block = blocks_[b];
+        for (size_t k = 0; k < block.phis.size(); k++)
+        {
+            for (const Edge &edge : block.preds)
+            {
+                const std::vector<int> &exit = blocks_[edge.block].exit;
+                if (exit.size() != block.phis.size())
+                    return false;
+                nodes_[block.phis[k]].args.push_back(exit[k]);
+            }
+        }
+    }
+    return true;
+}
+
+bool Ssa::lower(int b, std::vector<int> &stack)
+{
+    const uint8_t *code = chunk_.code.data();
+    int offset = blocks_[b].start;
+    int end = blocks_[b].end;
+
+    while (offset < end)
+    {
+        StackInstruction info;
+        Verifier::decode(chunk_, offset, info);
+        uint8_t op = code[offset];
+        int line = chunk_.lines.lineAt(offset);
+        int d = (int)stack.size();
+
+        switch (op)
+        {
+        case OP_CONSTANT:
+            stack.push_back(newConst(b, line, chunk_.constants[code[offset + 1]], code[offset + 1]));
+            break;
+
+        case OP_PUSH_INT:
+            stack.push_back(newConst(b, line, immediateAt(&code[offset + 1]), -1));
+            break;
+
+        case OP_NIL:
+            stack.push_back(newConst(b, line, Value::makeNull(), -1));
+            break;
+
+        case OP_TRUE:
+        case OP_FALSE:
+            stack.push_back(newConst(b, line, Value::makeBool(op == OP_TRUE), -1));
+            break;
+
+        case OP_POP:
+            stack.pop_back();
+            break;
+
+        case OP_NOT:
+        case OP_NEGATE:
+        case OP_SQRT:
+        case OP_ABS:
+        case OP_LEN:
+        case OP_STR:
+            stack.back() = newOp(op, b, line, {stack.back()});
+            break;
+
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_POW:
+        {
+            int v = newOp(op, b, line, {stack[d - 2], stack[d - 1]});
+            stack.pop_back();
+            stack.back() = v;
+            break;
+        }
+
+        case OP_GET_LOCAL:
+            if (code[offset + 1] >= d)
+                return false;
+            stack.push_back(stack[code[offset + 1]]);
+            break;
+
+        case OP_SET_LOCAL:
+            if (code[offset + 1] >= d)
+                return false;
+            stack[code[offset + 1]] = stack.back();
+            break;
+
+        case OP_GET_GLOBAL:
+            stack.push_back(newOp(op, b, line, {}, (code[offset + 1] << 8) | code[offset + 2]));
+            break;
+
+        case OP_SET_GLOBAL:
+            newOp(op, b, line, {stack.back()}, (code[offset + 1] << 8) | code[offset + 2]);
+            break;
+
+        case OP_DEFINE_GLOBAL:
+            newOp(op, b, line, {stack.back()}, (code[offset + 1] << 8) | code[offset + 2]);
+            stack.pop_back();
+            break;
+
+        case OP_PRINT:
+            newOp(op, b, line, {stack.back()});
+            stack.pop_back();
+            break;
+
+        case OP_CALL:
+        case OP_CALL_DIRECT:
+        {
+            int argc = code[offset + 1];
+            if (argc + 1 > d)
+                return false;
+            std::vector<int> args(stack.end() - argc - 1, stack.end());
+            stack.resize(d - argc - 1);
+            stack.push_back(newOp(op, b, line, args, argc));
+            break;
+        }
+
+        case OP_CALL_NATIVE:
+        {
+            int argc = code[offset + 2];
+            if (argc > d)
+                return false;
+            std::vector<int> args(stack.end() - argc, stack.end());
+            stack.resize(d - argc);
+            stack.push_back(newOp(op, b, line, args, code[offset + 1], argc));
+            break;
+        }
+
+        case OP_ADD_LOCALS:
+            if (code[offset + 1] >= d || code[offset + 2] >= d)
+                return false;
+            stack.push_back(newOp(OP_ADD, b, line, {stack[code[offset + 1]], stack[code[offset + 2]]}));
+            break;
+
+        case OP_ADD_CONST:
+        case OP_SUBTRACT_CONST:
+        {
+            int k = newConst(b, line, chunk_.constants[code[offset + 1]], code[offset + 1]);
+            stack.back() = newOp(op == OP_ADD_CONST ? OP_ADD : OP_SUBTRACT, b, line, {stack.back(), k});
+            break;
+        }
+
+        case OP_ADD_IMM:
+        case OP_SUBTRACT_IMM:
+        {
+            int k = newConst(b, line, immediateAt(&code[offset + 1]), -1);
+            stack.back() = newOp(op == OP_ADD_IMM ? OP_ADD : OP_SUBTRACT, b, line, {stack.back(), k});
+            break;
+        }
+
+        case OP_INC_LOCAL:
+        case OP_DEC_LOCAL:
+        {
+            int slot = code[offset + 1];
+            if (slot >= d)
+                return false;
+            int one = newConst(b, line, Value::makeInt(1), -1);
+            stack[slot] = newOp(op == OP_INC_LOCAL ? OP_ADD : OP_SUBTRACT, b, line, {stack[slot], one});
+            break;
+        }
+
+        case OP_JUMP:
+        case OP_LOOP:
+        case OP_JUMP_LONG:
+        case OP_LOOP_LONG:
+            break;
+
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_JUMP_IF_FALSE_LONG:
+        case OP_JUMP_IF_TRUE_LONG:
+            blocks_[b].termArgs.push_back(stack.back());
+            break;
+
+        case OP_POP_JUMP_IF_FALSE:
+        case OP_POP_JUMP_IF_FALSE_LONG:
+            blocks_[b].termArgs.push_back(stack.back());
+            stack.pop_back();
+            break;
+
+        case OP_JUMP_IF_NOT_EQUAL:
+        case OP_JUMP_IF_EQUAL:
+        case OP_JUMP_IF_NOT_GREATER:
+        case OP_JUMP_IF_NOT_GREATER_EQUAL:
+        case OP_JUMP_IF_NOT_LESS:
+        case OP_JUMP_IF_NOT_LESS_EQUAL:
+        {
+            int v = newOp(branchCompare(op), b, line, {stack[d - 2], stack[d - 1]});
+            stack.resize(d - 2);
+            blocks_[b].termArgs.push_back(v);
+            break;
+        }
+
+        case OP_JUMP_IF_NOT_EQUAL_IMM:
+        case OP_JUMP_IF_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_GREATER_IMM:
+        case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+        case OP_JUMP_IF_NOT_LESS_IMM:
+        case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        {
+            int k = newConst(b, line, immediateAt(&code[offset + 1]), -1);
+            int v = newOp(branchCompare(op), b, line, {stack[d - 1], k});
+            stack.pop_back();
+            blocks_[b].termArgs.push_back(v);
+            break;
+        }
+
+        // O for numérico volta a ser compare + salto (e soma no FOR_LOOP)
+        case OP_FOR_PREP:
+        case OP_FOR_PREP_LONG:
+        case OP_FOR_LOOP:
+        case OP_FOR_LOOP_LONG:
+        {
+            int counter = code[offset + 1];
+            int limit = code[offset + 2];
+            if (counter >= d || limit >= d)
+                return false;
+            if (op == OP_FOR_LOOP || op == OP_FOR_LOOP_LONG)
+            {
+                int step = immediateAt(&code[offset + 4]).asInt();
+                int k = newConst(b, line, Value::makeInt(step < 0 ? -step : step), -1);
+                stack[counter] = newOp(step < 0 ? OP_SUBTRACT : OP_ADD, b, line, {stack[counter], k});
+            }
+            int v = newOp(code[offset + 3], b, line, {stack[counter], stack[limit]});
+            blocks_[b].termArgs.push_back(v);
+            break;
+        }
+
+        case OP_RETURN:
+            blocks_[b].termArgs.push_back(stack.back());
+            stack.pop_back();
+            break;
+
+        case OP_RETURN_NIL:
+            break;
+
+        case OP_TAIL_CALL:
+        case OP_TAIL_CALL_DIRECT:
+        {
+            int argc = code[offset + 1];
+            if (argc + 1 > d)
+                return false;
+            blocks_[b].termArgs.assign(stack.end() - argc - 1, stack.end());
+            break;
+        }
+
+        default:
+            return false;
+        }
+
+        offset += info.length;
+    }
+    return true;
+}
+
+void Ssa::computeOrder()
+{
+    for (Block &block : blocks_)
+        block.rpo = -1;
+
+    std::vector<char> visited(blocks_.size(), 0);
+    std::vector<int> post;
+    std::vector<std::pair<int, int>> stack;
+    stack.push_back(std::make_pair(0, 0));
+    visited[0] = 1;
+
+    while (!stack.empty())
+    {
+        int b = stack.back().first;
+        int &slot = stack.back().second;
+        if (slot < 2)
+        {
+            // O sucessor [0] (verdadeiro / fallthrough) é visitado em último
+            // lugar para ficar logo a seguir no layout
+            int succ = blocks_[b].succ[1 - slot++];
+            if (succ >= 0 && !visited[succ])
+            {
+                visited[succ] = 1;
+                stack.push_back(std::make_pair(succ, 0));
+            }
+            continue;
+        }
+        post.push_back(b);
+        stack.pop_back();
+    }
+
+    order_.assign(post.rbegin(), post.rend());
+    for (size_t i = 0; i < order_.size(); i++)
+        blocks_[order_[i]].rpo = (int)i;
+}
+
+int Ssa::edgeIndex(int block, int pred, int slot) const
+{
+    const std::vector<Edge> &preds = blocks_[block].preds;
+    for (size_t i = 0; i < preds.size(); i++)
+    {
+        if (preds[i].block == pred && preds[i].slot == slot)
+            return (int)i;
+    }
+    return -1;
+}
+
+void Ssa::removeEdge(int block, int pred, int slot)
+{
+    int i = edgeIndex(block, pred, slot);
+    if (i < 0)
+        return;
+    Block &target = blocks_[block];
+    for (int phi : target.phis)
+    {
+        Node &node = nodes_[phi];
+        if (node.kind == N_PHI && node.args.size() == target.preds.size())
+            node.args.erase(node.args.begin() + i);
+    }
+    target.preds.erase(target.preds.begin() + i);
+}
+
+// Phi com um só valor (além de si próprio) é uma cópia desse valor
+void Ssa::simplifyPhis()
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b : order_)
+        {
+            for (int phi : blocks_[b].phis)
+            {
+                Node &node = nodes_[phi];
+                if (node.kind != N_PHI || node.alias >= 0)
+                    continue;
+
+                int same = -1;
+                bool trivial = true;
+                for (int arg : node.args)
+                {
+                    arg = resolve(arg);
+                    if (arg == phi || arg == same)
+                        continue;
+                    if (same >= 0)
+                    {
+                        trivial = false;
+                        break;
+                    }
+                    same = arg;
+                }
+                if (!trivial)
+                    continue;
+
+                if (same < 0)
+                {
+                    // Só se referencia a si próprio: nunca tem valor
+                    node.kind = N_CONST;
+                    node.value = Value::makeNull();
+                    node.args.clear();
+                }
+                else
+                {
+                    node.alias = same;
+                }
+                changed = true;
+            }
+        }
+    }
+}
+
+// ============================================
+// PROPAGAÇÃO DE CONSTANTES (SCCP)
+// ============================================
+
+uint8_t Ssa::latticeOf(int v, Value &value) const
+{
+    v = resolve(v);
+    const Node &node = nodes_[v];
+    if (node.kind == N_CONST)
+    {
+        value = node.value;
+        return L_CONST;
+    }
+    if (node.kind == N_PARAM)
+        return L_BOTTOM;
+    value = known_[v];
+    return lattice_[v];
+}
+
+uint8_t Ssa::evaluate(const Node &node, Value &value) const
+{
+    Value args[2];
+    bool top = false;
+    if (node.args.size() > 2)
+        return L_BOTTOM;
+    for (size_t i = 0; i < node.args.size(); i++)
+    {
+        uint8_t lattice = latticeOf(node.args[i], args[i]);
+        if (lattice == L_BOTTOM)
+            return L_BOTTOM;
+        top |= lattice == L_TOP;
+    }
+
+    switch (node.op)
+    {
+    case OP_NOT:
+    case OP_NEGATE:
+        if (top)
+            return L_TOP;
+        return fold::unary(node.op, args[0], value) ? L_CONST : L_BOTTOM;
+
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER:
+    case OP_GREATER_EQUAL:
+    case OP_LESS:
+    case OP_LESS_EQUAL:
+        if (top)
+            return L_TOP;
+        return fold::binary(node.op, args[0], args[1], value) ? L_CONST : L_BOTTOM;
+
+    default:
+        return L_BOTTOM;
+    }
+}
+
+// Só desce no reticulado (TOP -> CONST -> BOTTOM)
+bool Ssa::update(int v, uint8_t lattice, const Value &value)
+{
+    uint8_t old = lattice_[v];
+    if (old == L_BOTTOM || lattice == L_TOP)
+        return false;
+    if (old == L_CONST)
+    {
+        if (lattice == L_CONST && fold::sameConstant(known_[v], value))
+            return false;
+        lattice_[v] = L_BOTTOM;
+        return true;
+    }
+    lattice_[v] = lattice;
+    known_[v] = value;
+    return true;
+}
+
+void Ssa::propagateConstants()
+{
+    lattice_.assign(nodes_.size(), L_TOP);
+    known_.assign(nodes_.size(), Value());
+    std::vector<char> reached(blocks_.size(), 0);
+    std::vector<std::vector<char>> taken(blocks_.size());
+    for (size_t b = 0; b < blocks_.size(); b++)
+        taken[b].assign(blocks_[b].preds.size(), 0);
+    reached[0] = 1;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b : order_)
+        {
+            if (!reached[b])
+                continue;
+            Block &block = blocks_[b];
+
+            for (int phi : block.phis)
+            {
+                const Node &node = nodes_[phi];
+                if (node.kind != N_PHI || node.alias >= 0)
+                    continue;
+                uint8_t lattice = L_TOP;
+                Value value;
+                for (size_t i = 0; i < node.args.size(); i++)
+                {
+                    if (!taken[b][i])
+                        continue;
+                    Value arg;
+                    uint8_t argLattice = latticeOf(node.args[i], arg);
+                    if (argLattice == L_TOP)
+                        continue;
+                    if (lattice == L_TOP)
+                    {
+                        lattice = argLattice;
+                        value = arg;
+                    }
+                    else if (argLattice == L_BOTTOM || !fold::sameConstant(value, arg))
+                        lattice = L_BOTTOM;
+                }
+                changed |= update(phi, lattice, value);
+            }
+
+            for (int v : block.nodes)
+            {
+                if (nodes_[v].alias >= 0)
+                    continue;
+                Value value;
+                uint8_t lattice = evaluate(nodes_[v], value);
+                changed |= update(v, lattice, value);
+            }
+
+            int slots[2] = {-1, -1};
+            if (block.term == T_JUMP)
+                slots[0] = 0;
+            else if (block.term == T_BRANCH)
+            {
+                Value cond;
+                uint8_t lattice = latticeOf(block.termArgs[0], cond);
+                if (lattice == L_CONST)
+                    slots[0] = fold::truthy(cond) ? 0 : 1;
+                else if (lattice == L_BOTTOM)
+                {
+                    slots[0] = 0;
+                    slots[1] = 1;
+                }
+            }
+            for (int slot : slots)
+            {
+                if (slot < 0)
+                    continue;
+                int succ = block.succ[slot];
+                int i = edgeIndex(succ, b, slot);
+                if (!taken[succ][i])
+                {
+                    taken[succ][i] = 1;
+                    reached[succ] = 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Valores conhecidos passam a literais
+    for (int b : order_)
+    {
+        if (!reached[b])
+            continue;
+        Block &block = blocks_[b];
+        for (int list = 0; list < 2; list++)
+        {
+            for (int v : list == 0 ? block.phis : block.nodes)
+            {
+                Node &node = nodes_[v];
+                if (node.alias >= 0 || lattice_[v] != L_CONST)
+                    continue;
+                node.kind = N_CONST;
+                node.value = known_[v];
+                node.constant = -1;
+                node.args.clear();
+            }
+        }
+    }
+
+    // Ramos com condição conhecida passam a saltos; arestas que nunca
+    // são tomadas e blocos que nunca correm saem do CFG
+    for (int b : order_)
+    {
+        Block &block = blocks_[b];
+        if (!reached[b])
+        {
+            for (int slot = 0; slot < 2; slot++)
+            {
+                if (block.succ[slot] >= 0)
+                    removeEdge(block.succ[slot], b, slot);
+                block.succ[slot] = -1;
+            }
+            continue;
+        }
+        if (block.term != T_BRANCH)
+            continue;
+
+        Value cond;
+        if (latticeOf(block.termArgs[0], cond) != L_CONST)
+            continue;
+        int keep = fold::truthy(cond) ? 0 : 1;
+        int drop = 1 - keep;
+        removeEdge(block.succ[drop], b, drop);
+        int target = block.succ[keep];
+        int i = edgeIndex(target, b, keep);
+        blocks_[target].preds[i].slot = 0;
+        block.term = T_JUMP;
+        block.termArgs.clear();
+        block.succ[0] = target;
+        block.succ[1] = -1;
+    }
+
+    computeOrder();
+}
+
+// ============================================
+// LICM DE GLOBAIS
+// ============================================
+
+void Ssa::computeDominators()
+{
+    for (Block &block : blocks_)
+        block.idom = -1;
+    blocks_[0].idom = 0;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int b : order_)
+        {
+            if (b == 0)
+                continue;
+            int idom = -1;
+            for (const Edge &edge : blocks_[b].preds)
+            {
+                int p = edge.block;
+                if (blocks_[p].idom < 0)
+                    continue;
+                if (idom < 0)
+                {
+                    idom = p;
+                    continue;
+                }
+                int x = p, y = idom;
+                while (x != y)
+                {
+                    while (blocks_[x].rpo > blocks_[y].rpo)
+                        x = blocks_[x].idom;
+                    while (blocks_[y].rpo > blocks_[x].rpo)
+                        y = blocks_[y].idom;
+                }
+                idom = x;
+            }
+            if (idom != blocks_[b].idom)
+            {
+                blocks_[b].idom = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool Ssa::dominates(int a, int b) const
+{
+    while (b != a && b != 0)
+        b = blocks_[b].idom;
+    return b == a;
+}
+
+void Ssa::hoistGlobalLoads()
+{
+    computeDominators();
+
+    // Loops naturais: aresta b -> h com h a dominar b. O corpo são os
+    // blocos que chegam a b sem passar por h.
+    struct Loop
+    {
+        int header;
+        std::vector<int> body;
+    };
+    std::vector<Loop> loops;
+    for (int b : order_)
+    {
+        for (int slot = 0; slot < 2; slot++)
+        {
+            int h = blocks_[b].succ[slot];
+            if (h < 0 || !dominates(h, b))
+                continue;
+
+            Loop *loop = nullptr;
+            for (Loop &other : loops)
+            {
+                if (other.header == h)
+                    loop = &other;
+            }
+            if (!loop)
+            {
+                loops.push_back(Loop());
+                loop = &loops.back();
+                loop->header = h;
+                loop->body.push_back(h);
+            }
+
+            std::vector<int> work(1, b);
+            while (!work.empty())
+            {
+                int x = work.back();
+                work.pop_back();
+                if (std::find(loop->body.begin(), loop->body.end(), x) != loop->body.end())
+                    continue;
+                loop->body.push_back(x);
+                for (const Edge &edge : blocks_[x].preds)
+                    work.push_back(edge.block);
+            }
+        }
+    }
+
+    // Os de dentro primeiro: o que sai deles ainda pode sair do de fora
+    std::sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+        return a.body.size() < b.body.size();
+    });
+
+    for (const Loop &loop : loops)
+    {
+        const Block &header = blocks_[loop.header];
+
+        // Um só predecessor de fora, que só salta para o header
+        int preheader = -1;
+        bool single = true;
+        for (const Edge &edge : header.preds)
+        {
+            if (std::find(loop.body.begin(), loop.body.end(), edge.block) != loop.body.end())
+                continue;
+            single &= preheader < 0;
+            preheader = edge.block;
+        }
+        if (!single || preheader < 0 || blocks_[preheader].term != T_JUMP)
+            continue;
+
+        // Globais escritos no loop; uma call pode escrever qualquer um
+        std::vector<int> written;
+        bool clobbersAll = false;
+        for (int b : loop.body)
+        {
+            clobbersAll |= blocks_[b].term == T_TAIL_CALL;
+            for (int v : blocks_[b].nodes)
+            {
+                const Node &node = nodes_[v];
+                if (node.kind != N_OP || node.alias >= 0)
+                    continue;
+                if (isCall(node.op))
+                    clobbersAll = true;
+                else if (node.op == OP_SET_GLOBAL || node.op == OP_DEFINE_GLOBAL)
+                    written.push_back(node.operand);
+            }
+        }
+        if (clobbersAll)
+            continue;
+
+        // Ler um global indefinido é erro: só sobe o que já foi acedido
+        // antes do loop (num dominador do preheader) ou que o header lê
+        // antes de qualquer coisa que possa falhar
+        std::vector<int> defined;
+        for (int d = preheader;; d = blocks_[d].idom)
+        {
+            for (int v : blocks_[d].nodes)
+            {
+                const Node &node = nodes_[v];
+                if (node.kind == N_OP && node.alias < 0 && accessesGlobal(node.op))
+                    defined.push_back(node.operand);
+            }
+            if (d == 0)
+                break;
+        }
+        for (int v : header.nodes)
+        {
+            const Node &node = nodes_[v];
+            if (node.kind != N_OP || node.alias >= 0)
+                continue;
+            if (node.op == OP_GET_GLOBAL)
+                defined.push_back(node.operand);
+            else if (!isPure(node.op))
+                break;
+        }
+
+        std::vector<std::pair<int, int>> hoisted; // global -> valor no preheader
+        for (int b : order_)
+        {
+            if (std::find(loop.body.begin(), loop.body.end(), b) == loop.body.end())
+                continue;
+            for (size_t i = 0; i < blocks_[b].nodes.size(); i++)
+            {
+                int v = blocks_[b].nodes[i];
+                if (nodes_[v].kind != N_OP || nodes_[v].alias >= 0 || nodes_[v].op != OP_GET_GLOBAL)
+                    continue;
+                int global = nodes_[v].operand;
+                if (std::find(written.begin(), written.end(), global) != written.end() ||
+                    std::find(defined.begin(), defined.end(), global) == defined.end())
+                    continue;
+
+                int load = -1;
+                for (const std::pair<int, int> &entry : hoisted)
+                {
+                    if (entry.first == global)
+                        load = entry.second;
+                }
+                if (load < 0)
+                {
+                    load = newOp(OP_GET_GLOBAL, preheader, nodes_[v].line, {}, global);
+                    hoisted.push_back(std::make_pair(global, load));
+                }
+                nodes_[v].alias = load;
+            }
+        }
+    }
+}
+
+// ============================================
+// CÓDIGO MORTO
+// ============================================
+
+void Ssa::eliminateDeadCode()
+{
+    for (Node &node : nodes_)
+        node.live = false;
+
+    std::vector<int> work;
+    for (int b : order_)
+    {
+        for (int v : blocks_[b].nodes)
+        {
+            const Node &node = nodes_[v];
+            if (node.kind == N_OP && node.alias < 0 && !isPure(node.op))
+                work.push_back(v);
+        }
+        for (int v : blocks_[b].termArgs)
+            work.push_back(v);
+    }
+
+    while (!work.empty())
+    {
+        int v = resolve(work.back());
+        work.pop_back();
+        if (nodes_[v].live)
+            continue;
+        nodes_[v].live = true;
+        for (int arg : nodes_[v].args)
+            work.push_back(arg);
+    }
+}
+
+// ============================================
+// GERAÇÃO DE BYTECODE
+// ============================================
+// Layout do frame: slot 0 e parâmetros como à entrada, mais os slots que
+// a alocação pedir (inicializados a nil no início). Entre blocos a stack
+// de operandos está vazia; os ramos deixam a condição, que sai com um POP
+// em cada aresta.
+
+void Ssa::countUses()
+{
+    size_t count = nodes_.size();
+    uses_.assign(count, 0);
+    escapes_.assign(count, 0);
+    phiUser_.assign(count, -1);
+
+    for (int b : order_)
+    {
+        const Block &block = blocks_[b];
+        for (int phi : block.phis)
+        {
+            if (nodes_[phi].kind != N_PHI || nodes_[phi].alias >= 0 || !nodes_[phi].live)
+                continue;
+            for (int arg : nodes_[phi].args)
+            {
+                arg = resolve(arg);
+                uses_[arg]++;
+                escapes_[arg] = 1;
+                phiUser_[arg] = phi;
+            }
+        }
+        for (int v : block.nodes)
+        {
+            if (nodes_[v].kind != N_OP || nodes_[v].alias >= 0 || !nodes_[v].live)
+                continue;
+            for (int arg : nodes_[v].args)
+            {
+                arg = resolve(arg);
+                uses_[arg]++;
+                if (nodes_[arg].block != b)
+                    escapes_[arg] = 1;
+            }
+        }
+        for (int arg : block.termArgs)
+        {
+            arg = resolve(arg);
+            uses_[arg]++;
+            if (nodes_[arg].block != b)
+                escapes_[arg] = 1;
+        }
+    }
+
+    inline_.assign(count, 0);
+    for (size_t v = 0; v < count; v++)
+    {
+        const Node &node = nodes_[v];
+        inline_[v] = node.kind == N_OP && node.alias < 0 && node.live && hasResult(node.op) &&
+                     uses_[v] == 1 && !escapes_[v];
+    }
+}
+
+void Ssa::expand(int v, std::vector<int> &sequence) const
+{
+    for (int arg : nodes_[v].args)
+    {
+        arg = resolve(arg);
+        if (inline_[arg])
+            expand(arg, sequence);
+    }
+    sequence.push_back(v);
+}
+
+// Um valor com um só uso é calculado dentro da árvore do utilizador, o
+// que o atrasa até lá. Se isso puser um efeito (ou algo que pode falhar)
+// depois de outro que vinha a seguir, esse valor volta a ser calculado no
+// seu lugar e guardado num slot.
+void Ssa::schedule(int b)
+{
+    const Block &block = blocks_[b];
+    for (;;)
+    {
+        std::vector<int> sequence;
+        for (int v : block.nodes)
+        {
+            const Node &node = nodes_[v];
+            if (node.kind == N_OP && node.alias < 0 && node.live && !inline_[v])
+                expand(v, sequence);
+        }
+        for (int arg : block.termArgs)
+        {
+            arg = resolve(arg);
+            if (inline_[arg])
+                expand(arg, sequence);
+        }
+
+        int last = -1;
+        int late = -1;
+        for (int v : sequence)
+        {
+            if (isPure(nodes_[v].op))
+                continue;
+            if (nodes_[v].order < last)
+            {
+                late = v;
+                break;
+            }
+            last = nodes_[v].order;
+        }
+        if (late < 0)
+            break;
+        inline_[late] = 0;
+    }
+
+    roots_[b].clear();
+    for (int v : block.nodes)
+    {
+        const Node &node = nodes_[v];
+        if (node.kind == N_OP && node.alias < 0 && node.live && !inline_[v])
+            roots_[b].push_back(v);
+    }
+}
+
+// Valores com slot lidos pela árvore de v
+void Ssa::leaves(int v, std::vector<int> &out) const
+{
+    for (int arg : nodes_[v].args)
+    {
+        arg = resolve(arg);
+        if (inline_[arg])
+            leaves(arg, out);
+        else if (homed(arg))
+            out.push_back(arg);
+    }
+}
+
+void Ssa::termLeaves(int b, std::vector<int> &out) const
+{
+    for (int arg : blocks_[b].termArgs)
+    {
+        arg = resolve(arg);
+        if (inline_[arg])
+            leaves(arg, out);
+        else if (homed(arg))
+            out.push_back(arg);
+    }
+}
+
+// Liveness por bloco e coloração do grafo de interferência; os
+// parâmetros ficam no slot com que chegam
+bool Ssa::allocate()
+{
+    size_t count = nodes_.size();
+    homeId_.assign(count, -1);
+    homes_.clear();
+    for (size_t v = 0; v < count; v++)
+    {
+        const Node &node = nodes_[v];
+        if (node.alias >= 0 || !node.live || uses_[v] == 0)
+            continue;
+        bool needsSlot = node.kind == N_PARAM || node.kind == N_PHI ||
+                         (node.kind == N_OP && hasResult(node.op) && !inline_[v]);
+        if (!needsSlot)
+            continue;
+        homeId_[v] = (int)homes_.size();
+        homes_.push_back((int)v);
+    }
+    int homeCount = (int)homes_.size();
+
+    // Usos de cada bloco que vêm de fora dele
+    std::vector<BitSet> upward(blocks_.size()), liveIn(blocks_.size()), liveOut(blocks_.size());
+    for (int b : order_)
+    {
+        upward[b].resize(homeCount);
+        liveIn[b].resize(homeCount);
+        liveOut[b].resize(homeCount);
+
+        std::vector<int> used;
+        for (int v : roots_[b])
+            leaves(v, used);
+        termLeaves(b, used);
+        for (int v : used)
+        {
+            if (nodes_[v].block != b)
+                upward[b].set(homeId_[v]);
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = (int)order_.size() - 1; i >= 0; i--)
+        {
+            int b = order_[i];
+            const Block &block = blocks_[b];
+            BitSet out;
+            out.resize(homeCount);
+            for (int slot = 0; slot < 2; slot++)
+            {
+                int succ = block.succ[slot];
+                if (succ < 0)
+                    continue;
+                for (size_t w = 0; w < out.words.size(); w++)
+                    out.words[w] |= liveIn[succ].words[w];
+                int e = edgeIndex(succ, b, slot);
+                for (int phi : blocks_[succ].phis)
+                {
+                    if (nodes_[phi].kind != N_PHI || !homed(phi))
+                        continue;
+                    int arg = resolve(nodes_[phi].args[e]);
+                    if (homed(arg))
+                        out.set(homeId_[arg]);
+                }
+            }
+
+            BitSet in = upward[b];
+            for (int k = 0; k < homeCount; k++)
+            {
+                if (out.test(k) && nodes_[homes_[k]].block != b)
+                    in.set(k);
+            }
+            if (in.words != liveIn[b].words || out.words != liveOut[b].words)
+            {
+                liveIn[b] = in;
+                liveOut[b] = out;
+                changed = true;
+            }
+        }
+    }
+
+    // Interferência: quem é definido interfere com tudo o que está vivo
+    // nesse ponto
+    std::vector<std::vector<int>> interferes(homeCount);
+    auto addEdge = [&](int a, int b) {
+        if (a == b)
+            return;
+        interferes[a].push_back(b);
+        interferes[b].push_back(a);
+    };
+
+    for (int b : order_)
+    {
+        BitSet live = liveOut[b];
+        std::vector<int> used;
+        termLeaves(b, used);
+        for (int v : used)
+            live.set(homeId_[v]);
+
+        for (int i = (int)roots_[b].size() - 1; i >= 0; i--)
+        {
+            int v = roots_[b][i];
+            if (homed(v))
+            {
+                int id = homeId_[v];
+                live.reset(id);
+                for (int k = 0; k < homeCount; k++)
+                {
+                    if (live.test(k))
+                        addEdge(id, k);
+                }
+            }
+            used.clear();
+            leaves(v, used);
+            for (int u : used)
+                live.set(homeId_[u]);
+        }
+
+        // Phis (e parâmetros na entrada) nascem todos ao mesmo tempo
+        std::vector<int> starts;
+        for (int phi : blocks_[b].phis)
+        {
+            if (nodes_[phi].kind == N_PHI && homed(phi))
+                starts.push_back(homeId_[phi]);
+        }
+        if (b == 0)
+        {
+            for (int k = 0; k < homeCount; k++)
+            {
+                if (nodes_[homes_[k]].kind == N_PARAM)
+                    starts.push_back(k);
+            }
+        }
+        for (int id : starts)
+            live.reset(id);
+        for (size_t i = 0; i < starts.size(); i++)
+        {
+            for (int k = 0; k < homeCount; k++)
+            {
+                if (live.test(k))
+                    addEdge(starts[i], k);
+            }
+            for (size_t j = i + 1; j < starts.size(); j++)
+                addEdge(starts[i], starts[j]);
+        }
+    }
+
+    // Coloração gulosa pela ordem das definições (dominância), a tentar
+    // dar ao phi o slot dos argumentos e vice-versa para poupar cópias
+    color_.assign(homeCount, -1);
+    std::vector<int> sequence;
+    for (int k = 0; k < homeCount; k++)
+    {
+        if (nodes_[homes_[k]].kind == N_PARAM)
+            color_[k] = nodes_[homes_[k]].operand;
+    }
+    for (int b : order_)
+    {
+        for (int phi : blocks_[b].phis)
+        {
+            if (nodes_[phi].kind == N_PHI && homed(phi))
+                sequence.push_back(phi);
+        }
+        for (int v : roots_[b])
+        {
+            if (homed(v))
+                sequence.push_back(v);
+        }
+    }
+
+    std::vector<char> taken;
+    for (int v : sequence)
+    {
+        int id = homeId_[v];
+        taken.assign(UINT8_MAX + 2, 0);
+        for (int other : interferes[id])
+        {
+            if (color_[other] >= 0)
+                taken[color_[other]] = 1;
+        }
+
+        std::vector<int> preferred;
+        const Node &node = nodes_[v];
+        if (node.kind == N_PHI || node.kind == N_OP)
+        {
+            for (int arg : node.args)
+            {
+                arg = resolve(arg);
+                if (homed(arg) && color_[homeId_[arg]] >= 0)
+                    preferred.push_back(color_[homeId_[arg]]);
+            }
+        }
+        if (phiUser_[v] >= 0 && homed(phiUser_[v]) && color_[homeId_[phiUser_[v]]] >= 0)
+            preferred.insert(preferred.begin(), color_[homeId_[phiUser_[v]]]);
+
+        int chosen = -1;
+        for (int c : preferred)
+        {
+            if (c > 0 && !taken[c])
+            {
+                chosen = c;
+                break;
+            }
+        }
+        for (int c = 1; chosen < 0 && c <= UINT8_MAX; c++)
+        {
+            if (!taken[c])
+                chosen = c;
+        }
+        if (chosen < 0)
+            return false;
+        color_[id] = chosen;
+    }
+    return true;
+}
+
+int Ssa::frameSize() const
+{
+    int size = function_->arity + 1;
+    for (int c : color_)
+        size = std::max(size, c + 1);
+    return size;
+}
+
+void Ssa::emit(uint8_t byte)
+{
+    code_.push_back(byte);
+    lines_.add(line_);
+}
+
+void Ssa::emitShort(int value)
+{
+    emit((uint8_t)((value >> 8) & 0xff));
+    emit((uint8_t)(value & 0xff));
+}
+
+void Ssa::emitConstant(int v)
+{
+    Node &node = nodes_[v];
+    if (node.value.isNull())
+    {
+        emit(OP_NIL);
+        return;
+    }
+    if (node.value.isBool())
+    {
+        emit(node.value.asBool() ? OP_TRUE : OP_FALSE);
+        return;
+    }
+    if (fold::immediate(node.value))
+    {
+        emit(OP_PUSH_INT);
+        emitShort((uint16_t)(int16_t)node.value.asInt());
+        return;
+    }
+    if (node.constant < 0)
+        node.constant = fold::constantIndex(chunk_, node.value);
+    if (node.constant < 0)
+    {
+        failed_ = true;
+        return;
+    }
+    emit(OP_CONSTANT);
+    emit((uint8_t)node.constant);
+}
+
+void Ssa::emitValue(int v)
+{
+    v = resolve(v);
+    if (nodes_[v].kind == N_CONST)
+        emitConstant(v);
+    else if (inline_[v])
+        emitNode(v);
+    else if (homed(v))
+    {
+        emit(OP_GET_LOCAL);
+        emit((uint8_t)home(v));
+    }
+    else
+        failed_ = true;
+}
+
+// Cada instrução fica com a linha do nó que a gerou (os erros de runtime
+// apontam para a linha original mesmo quando a árvore junta várias)
+void Ssa::emitNode(int v)
+{
+    const Node &node = nodes_[v];
+    switch (node.op)
+    {
+    case OP_ADD:
+    case OP_SUBTRACT:
+    {
+        int a = resolve(node.args[0]);
+        int b = resolve(node.args[1]);
+        const Node &right = nodes_[b];
+        if (right.kind == N_CONST && fold::immediate(right.value))
+        {
+            emitValue(a);
+            line_ = node.line;
+            emit(node.op == OP_ADD ? OP_ADD_IMM : OP_SUBTRACT_IMM);
+            emitShort((uint16_t)(int16_t)right.value.asInt());
+            return;
+        }
+        if (right.kind == N_CONST && (right.value.isInt() || right.value.isDouble() ||
+                                      right.value.isString()))
+        {
+            emitValue(a);
+            line_ = node.line;
+            emitConstant(b);
+            // OP_CONSTANT k acabado de emitir passa a OP_ADD_CONST k
+            code_[code_.size() - 2] = node.op == OP_ADD ? OP_ADD_CONST : OP_SUBTRACT_CONST;
+            return;
+        }
+        if (node.op == OP_ADD && homed(a) && homed(b))
+        {
+            line_ = node.line;
+            emit(OP_ADD_LOCALS);
+            emit((uint8_t)home(a));
+            emit((uint8_t)home(b));
+            return;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    for (int arg : node.args)
+        emitValue(arg);
+    line_ = node.line;
+    emit(node.op);
+
+    switch (node.op)
+    {
+    case OP_GET_GLOBAL:
+    case OP_SET_GLOBAL:
+    case OP_DEFINE_GLOBAL:
+        emitShort(node.operand);
+        break;
+    case OP_CALL:
+    case OP_CALL_DIRECT:
+        emit((uint8_t)node.operand);
+        break;
+    case OP_CALL_NATIVE:
+        emit((uint8_t)node.operand);
+        emit(node.argc);
+        break;
+    default:
+        break;
+    }
+}
+
+void Ssa::emitRoot(int v)
+{
+    const Node &node = nodes_[v];
+    line_ = node.line;
+
+    if (!hasResult(node.op))
+    {
+        emitNode(v);
+        if (node.op == OP_SET_GLOBAL)
+            emit(OP_POP);
+        return;
+    }
+    if (!homed(v))
+    {
+        emitNode(v);
+        emit(OP_POP);
+        return;
+    }
+
+    // x = x + 1 no mesmo slot
+    if (node.op == OP_ADD || node.op == OP_SUBTRACT)
+    {
+        int a = resolve(node.args[0]);
+        const Node &right = nodes_[resolve(node.args[1])];
+        if (homed(a) && home(a) == home(v) && right.kind == N_CONST && right.value.isInt() &&
+            right.value.asInt() == 1)
+        {
+            emit(node.op == OP_ADD ? OP_INC_LOCAL : OP_DEC_LOCAL);
+            emit((uint8_t)home(v));
+            return;
+        }
+    }
+
+    emitNode(v);
+    emit(OP_SET_LOCAL);
+    emit((uint8_t)home(v));
+    emit(OP_POP);
+}
+
+// Cópias para os phis do sucessor: empilha todos os valores e só depois
+// escreve nos slots, por isso a ordem das cópias não importa
+void Ssa::emitMoves(int b, int slot, int succ)
+{
+    int e = edgeIndex(succ, b, slot);
+    std::vector<int> targets;
+    for (int phi : blocks_[succ].phis)
+    {
+        if (nodes_[phi].kind != N_PHI || !homed(phi))
+            continue;
+        int arg = resolve(nodes_[phi].args[e]);
+        if (homed(arg) && home(arg) == home(phi))
+            continue;
+        emitValue(arg);
+        targets.push_back(phi);
+    }
+    for (int i = (int)targets.size() - 1; i >= 0; i--)
+    {
+        emit(OP_SET_LOCAL);
+        emit((uint8_t)home(targets[i]));
+        emit(OP_POP);
+    }
+}
+
+void Ssa::emitJump(int target)
+{
+    if (blockOffset_[target] >= 0)
+    {
+        int distance = (int)code_.size() + 3 - blockOffset_[target];
+        if (distance > UINT16_MAX)
+            failed_ = true; // só há formas curtas aqui
+        emit(OP_LOOP);
+        emitShort(distance);
+        return;
+    }
+    emit(OP_JUMP);
+    Fixup fixup = {code_.size(), target};
+    fixups_.push_back(fixup);
+    emitShort(0);
+}
+
+void Ssa::emitGoto(int target, int next)
+{
+    if (target != next)
+        emitJump(target);
+}
+
+// O único predecessor é um ramo: o bloco não precisa de cópias (e começa
+// por tirar a condição se o ramo a deixou na stack, ver entryPop_)
+bool Ssa::popsOnEntry(int b) const
+{
+    const Block &block = blocks_[b];
+    return b != 0 && block.preds.size() == 1 &&
+           blocks_[block.preds[0].block].term == T_BRANCH && blockOffset_[b] < 0;
+}
+
+void Ssa::emitTerminator(int b, int next)
+{
+    const Block &block = blocks_[b];
+    line_ = block.termLine;
+
+    switch (block.term)
+    {
+    case T_JUMP:
+        emitMoves(b, 0, block.succ[0]);
+        emitGoto(block.succ[0], next);
+        return;
+
+    case T_RETURN:
+        emitValue(block.termArgs[0]);
+        line_ = block.termLine;
+        emit(OP_RETURN);
+        return;
+
+    case T_RETURN_NIL:
+        emit(OP_RETURN_NIL);
+        return;
+
+    case T_TAIL_CALL:
+        for (int arg : block.termArgs)
+            emitValue(arg);
+        line_ = block.termLine;
+        emit(block.termOp);
+        emit((uint8_t)(block.termArgs.size() - 1));
+        return;
+
+    case T_BRANCH:
+        break;
+    }
+
+    int onTrue = block.succ[0];
+    int onFalse = block.succ[1];
+    int cond = resolve(block.termArgs[0]);
+    const Node &node = nodes_[cond];
+    bool fused = inline_[cond] && node.op >= OP_EQUAL && node.op <= OP_LESS_EQUAL;
+    // Comparação com um int pequeno: o imediato vai no próprio salto
+    int right = fused ? resolve(node.args[1]) : -1;
+    bool immediate = right >= 0 && nodes_[right].kind == N_CONST &&
+                     fold::immediate(nodes_[right].value);
+
+    // Salta se a condição for falsa; nos dois lados já saiu da stack
+    auto emitCondition = [&]() {
+        if (immediate)
+        {
+            emitValue(node.args[0]);
+            line_ = node.line;
+            emit(conditionBranch(node.op, true));
+            emitShort((uint16_t)(int16_t)nodes_[right].value.asInt());
+        }
+        else if (fused)
+        {
+            for (int arg : node.args)
+                emitValue(arg);
+            line_ = node.line;
+            emit(conditionBranch(node.op, false));
+        }
+        else
+        {
+            emitValue(cond);
+            emit(OP_POP_JUMP_IF_FALSE);
+        }
+    };
+
+    if (popsOnEntry(onFalse))
+    {
+        emitCondition();
+        Fixup fixup = {code_.size(), onFalse};
+        fixups_.push_back(fixup);
+        emitShort(0);
+
+        if (!popsOnEntry(onTrue))
+            emitMoves(b, 0, onTrue);
+        emitGoto(onTrue, next);
+        return;
+    }
+
+    if (popsOnEntry(onTrue) && onTrue == next)
+    {
+        // O lado falso precisa de cópias: salta-se pelo verdadeiro, que
+        // começa por tirar a condição
+        emitValue(cond);
+        emit(OP_JUMP_IF_TRUE);
+        Fixup fixup = {code_.size(), onTrue};
+        fixups_.push_back(fixup);
+        emitShort(0);
+        entryPop_[onTrue] = 1;
+        emit(OP_POP);
+        emitMoves(b, 1, onFalse);
+        emitJump(onFalse);
+        return;
+    }
+
+    // Os dois lados precisam de código próprio
+    emitCondition();
+    size_t stub = code_.size();
+    emitShort(0);
+    if (!popsOnEntry(onTrue))
+        emitMoves(b, 0, onTrue);
+    emitJump(onTrue);
+
+    int distance = (int)(code_.size() - stub - 2);
+    code_[stub] = (uint8_t)((distance >> 8) & 0xff);
+    code_[stub + 1] = (uint8_t)(distance & 0xff);
+    emitMoves(b, 1, onFalse);
+    emitGoto(onFalse, next);
+}
+
+bool Ssa::generate()
+{
+    countUses();
+    roots_.assign(blocks_.size(), std::vector<int>());
+    homeId_.assign(nodes_.size(), -1);
+    for (int b : order_)
+        schedule(b);
+    if (!allocate())
+        return false;
+
+    int frame = frameSize();
+    if (frame > UINT8_MAX + 1)
+        return false;
+
+    blockOffset_.assign(blocks_.size(), -1);
+    entryPop_.assign(blocks_.size(), 0);
+    for (size_t i = 0; i < order_.size(); i++)
+    {
+        int b = order_[i];
+        int next = i + 1 < order_.size() ? order_[i + 1] : -1;
+        bool pops = entryPop_[b] != 0;
+        blockOffset_[b] = (int)code_.size();
+
+        line_ = blocks_[b].termLine;
+        if (!roots_[b].empty())
+            line_ = nodes_[roots_[b][0]].line;
+        if (b == 0)
+        {
+            for (int slot = function_->arity + 1; slot < frame; slot++)
+                emit(OP_NIL);
+        }
+        if (pops)
+            emit(OP_POP);
+
+        for (int v : roots_[b])
+            emitRoot(v);
+        emitTerminator(b, next);
+    }
+
+    if (failed_)
+        return false;
+    for (const Fixup &fixup : fixups_)
+    {
+        int distance = blockOffset_[fixup.block] - (int)(fixup.at + 2);
+        if (distance < 0 || distance > UINT16_MAX)
+            return false;
+        code_[fixup.at] = (uint8_t)((distance >> 8) & 0xff);
+        code_[fixup.at + 1] = (uint8_t)(distance & 0xff);
+    }
+    // Defesa: o resultado tem de ter profundidade fixa como o original
+    Chunk check;
+    check.code = code_;
+    check.lines = lines_;
+    check.constants = chunk_.constants;
+    std::vector<int> depth;
+    if (!stackDepths(check, function_->arity, depth))
+        return false;
+
+    chunk_.code.swap(code_);
+    chunk_.lines.swap(lines_);
+    return true;
+}
+
+} // namespace
+
+bool SsaOptimizer::optimize(Function *function)
+{
+    Ssa ssa(function);
+    if (!ssa.build())
+        return false;
+    ssa.simplifyPhis();
+    ssa.propagateConstants();
+    ssa.simplifyPhis();
+    ssa.hoistGlobalLoads();
+    ssa.eliminateDeadCode();
+    return ssa.generate();
+}
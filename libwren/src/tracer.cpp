@@ -0,0 +1,1644 @@
+#include "tracer.h"
+#include "verifier.h"
+#include "vm.h"
+
+#include <climits>
+
+#if WREN_JIT_ENABLED
+
+#include "x64.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+
+typedef uint8_t *(*TraceEntry)(Value *slots, void *globals, Value **spOut);
+
+struct TraceCode
+{
+    uint8_t *memory;
+    size_t size;
+    TraceEntry entry;
+};
+
+namespace
+{
+
+using namespace x64;
+
+// ============================================
+// GRAVAÇÃO
+// ============================================
+
+enum TraceType : uint8_t
+{
+    TT_UNSET, // o trace não toca no slot
+    TT_OTHER, // tipo fora do subconjunto: o trace não compila
+    TT_INT,
+    TT_BOOL
+};
+
+TraceType typeOf(const Value &value)
+{
+    if (value.isInt())
+        return TT_INT;
+    if (value.isBool())
+        return TT_BOOL;
+    return TT_OTHER;
+}
+
+bool truthy(const Value &value)
+{
+    return value.isBool() ? value.asBool() : value.asInt() != 0;
+}
+
+// VM::GlobalSlot é privado: o Tracer (friend) passa o layout
+struct GlobalView
+{
+    uint8_t *base;
+    int32_t size;
+    int32_t value;
+    int32_t defined;
+
+    Value &valueAt(int slot) const { return *(Value *)(base + slot * size + value); }
+    bool definedAt(int slot) const { return *(bool *)(base + slot * size + defined); }
+};
+
+struct TraceStep
+{
+    int offset;
+    bool taken; // saltos condicionais: o salto foi tomado
+};
+
+struct TraceRecord
+{
+    int depth; // altura da stack na cabeça: slots abaixo são "homes"
+    std::vector<TraceStep> steps;
+    std::vector<TraceType> locals;                  // tipo à entrada por slot < depth
+    std::vector<std::pair<int, TraceType>> globals; // slot -> tipo à entrada
+};
+
+class Recorder
+{
+public:
+    Recorder(Function *function, const GlobalView &globals, Value *slots,
+             TraceRecord &record)
+        : chunk_(function->chunk), globals_(globals), slots_(slots), record_(record) {}
+
+    // Executa a partir da cabeça até voltar a ela (true) ou até uma
+    // instrução fora do subconjunto (false, ip fica nela por executar)
+    bool run(uint8_t *&ip, Value *&sp);
+
+private:
+    const Chunk &chunk_;
+    GlobalView globals_;
+    Value *slots_;
+    TraceRecord &record_;
+
+    int backEdge(int header) const;
+    void touchLocal(int slot);
+    void touchGlobal(int slot);
+    bool step(uint8_t *&ip, Value *&sp, bool &taken);
+};
+
+// O tipo à entrada é o do primeiro toque: até aí o trace não o mudou
+void Recorder::touchLocal(int slot)
+{
+    if (slot < record_.depth && record_.locals[slot] == TT_UNSET)
+        record_.locals[slot] = typeOf(slots_[slot]);
+}
+
+void Recorder::touchGlobal(int slot)
+{
+    for (const auto &global : record_.globals)
+        if (global.first == slot)
+            return;
+    record_.globals.push_back(std::make_pair(slot, typeOf(globals_.valueAt(slot))));
+}
+
+// Offset do último salto para trás que volta à cabeça: o corpo do loop
+// é [header, backEdge]
+int Recorder::backEdge(int header) const
+{
+    int end = -1;
+    StackInstruction info;
+    for (int offset = 0; offset < (int)chunk_.code.size(); offset += info.length)
+    {
+        if (!Verifier::decode(chunk_, offset, info))
+            break;
+        if (info.jumpTarget == header && offset >= header)
+            end = offset;
+    }
+    return end;
+}
+
+bool Recorder::run(uint8_t *&ip, Value *&sp)
+{
+    const uint8_t *code = chunk_.code.data();
+    const uint8_t *header = ip;
+    const uint8_t *end = code + backEdge((int)(header - code));
+    record_.depth = (int)(sp - slots_);
+    record_.locals.assign(record_.depth, TT_UNSET);
+
+    while ((int)record_.steps.size() < Tracer::MAX_TRACE)
+    {
+        TraceStep step = {(int)(ip - code), false};
+        if (!this->step(ip, sp, step.taken))
+            return false;
+        record_.steps.push_back(step);
+        if (ip == header)
+            return true;
+
+        // Saiu do corpo (o loop interior acabou e seguiu-se o exterior) ou
+        // tirou da stack valores de baixo da cabeça: o trace não fecharia
+        if (ip < header || ip > end || sp < slots_ + record_.depth)
+            return false;
+    }
+    return false;
+}
+
+// Mesma semântica que o loop do interpretador para ints e bools; a
+// aritmética faz wrap em unsigned como o hardware (o trace também)
+bool Recorder::step(uint8_t *&ip, Value *&sp, bool &taken)
+{
+    uint8_t op = ip[0];
+    switch (op)
+    {
+    case OP_CONSTANT:
+    {
+        const Value &k = chunk_.constants[ip[1]];
+        if (typeOf(k) == TT_OTHER)
+            return false;
+        *sp++ = k;
+        ip += 2;
+        return true;
+    }
+
+    case OP_PUSH_INT:
+        *sp++ = Value::makeInt((int16_t)((ip[1] << 8) | ip[2]));
+        ip += 3;
+        return true;
+
+    case OP_TRUE:
+    case OP_FALSE:
+        *sp++ = Value::makeBool(op == OP_TRUE);
+        ip += 1;
+        return true;
+
+    case OP_POP:
+        sp--;
+        ip += 1;
+        return true;
+
+    case OP_GET_LOCAL:
+        if (typeOf(slots_[ip[1]]) == TT_OTHER)
+            return false;
+        touchLocal(ip[1]);
+        *sp++ = slots_[ip[1]];
+        ip += 2;
+        return true;
+
+    case OP_SET_LOCAL:
+        touchLocal(ip[1]);
+        slots_[ip[1]] = sp[-1];
+        ip += 2;
+        return true;
+
+    case OP_GET_GLOBAL:
+    {
+        int slot = (ip[1] << 8) | ip[2];
+        if (!globals_.definedAt(slot) || typeOf(globals_.valueAt(slot)) == TT_OTHER)
+            return false;
+        touchGlobal(slot);
+        *sp++ = globals_.valueAt(slot);
+        ip += 3;
+        return true;
+    }
+
+    case OP_SET_GLOBAL:
+    {
+        // Sobrepor uma função marca-a como rebound: fica com o interpretador
+        int slot = (ip[1] << 8) | ip[2];
+        if (!globals_.definedAt(slot) || globals_.valueAt(slot).isFunction())
+            return false;
+        touchGlobal(slot);
+        globals_.valueAt(slot) = sp[-1];
+        ip += 3;
+        return true;
+    }
+
+    case OP_JUMP:
+        ip += 3 + ((ip[1] << 8) | ip[2]);
+        return true;
+
+    case OP_LOOP:
+        ip += 3 - ((ip[1] << 8) | ip[2]);
+        return true;
+
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+        if (typeOf(sp[-1]) == TT_OTHER)
+            return false;
+        taken = truthy(sp[-1]) == (op == OP_JUMP_IF_TRUE);
+        ip += 3 + (taken ? ((ip[1] << 8) | ip[2]) : 0);
+        return true;
+
+    case OP_POP_JUMP_IF_FALSE:
+        if (typeOf(sp[-1]) == TT_OTHER)
+            return false;
+        taken = !truthy(*--sp);
+        ip += 3 + (taken ? ((ip[1] << 8) | ip[2]) : 0);
+        return true;
+
+    // Condições que consomem os operandos: ints, ou igualdade entre dois
+    // valores do mesmo tipo
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+    case OP_JUMP_IF_NOT_LESS:
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+    case OP_JUMP_IF_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_LESS_IMM:
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+    {
+        bool immediate = isImmediateBranch(op);
+        uint8_t compare = branchCompare(op);
+        Value left = immediate ? sp[-1] : sp[-2];
+        Value right = immediate ? Value::makeInt((int16_t)((ip[1] << 8) | ip[2])) : sp[-1];
+        TraceType type = typeOf(left);
+        if (type == TT_OTHER || typeOf(right) != type)
+            return false;
+        if (type != TT_INT && compare != OP_EQUAL && compare != OP_NOT_EQUAL)
+            return false;
+        int a = type == TT_INT ? left.asInt() : left.asBool();
+        int b = type == TT_INT ? right.asInt() : right.asBool();
+        bool result;
+        switch (compare)
+        {
+        case OP_EQUAL:
+            result = a == b;
+            break;
+        case OP_NOT_EQUAL:
+            result = a != b;
+            break;
+        case OP_GREATER:
+            result = a > b;
+            break;
+        case OP_GREATER_EQUAL:
+            result = a >= b;
+            break;
+        case OP_LESS:
+            result = a < b;
+            break;
+        default:
+            result = a <= b;
+            break;
+        }
+        sp -= immediate ? 1 : 2;
+        taken = !result;
+        int length = immediate ? 5 : 3;
+        ip += length + (taken ? ((ip[length - 2] << 8) | ip[length - 1]) : 0);
+        return true;
+    }
+
+    case OP_ADD:
+    case OP_ADD_INT:
+    case OP_ADD_DOUBLE:
+    case OP_ADD_STRING:
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_INT:
+    case OP_SUBTRACT_DOUBLE:
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_INT:
+    case OP_MULTIPLY_DOUBLE:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    {
+        if (!sp[-2].isInt() || !sp[-1].isInt())
+            return false;
+        uint32_t a = (uint32_t)sp[-2].asInt();
+        uint32_t b = (uint32_t)sp[-1].asInt();
+        uint32_t result;
+        if (op == OP_DIVIDE || op == OP_MODULO)
+        {
+            // Zero é erro e -1 faz trap com INT_MIN: ficam com o interpretador
+            if ((int32_t)b == 0 || (int32_t)b == -1)
+                return false;
+            result = (uint32_t)(op == OP_DIVIDE ? (int32_t)a / (int32_t)b
+                                                : (int32_t)a % (int32_t)b);
+        }
+        else if (op == OP_ADD || op == OP_ADD_INT || op == OP_ADD_DOUBLE || op == OP_ADD_STRING)
+            result = a + b;
+        else if (op == OP_SUBTRACT || op == OP_SUBTRACT_INT || op == OP_SUBTRACT_DOUBLE)
+            result = a - b;
+        else
+            result = a * b;
+        sp--;
+        sp[-1] = Value::makeInt((int)result);
+        ip += 1;
+        return true;
+    }
+
+    case OP_NEGATE:
+        if (!sp[-1].isInt())
+            return false;
+        sp[-1] = Value::makeInt((int)(0u - (uint32_t)sp[-1].asInt()));
+        ip += 1;
+        return true;
+
+    case OP_NOT:
+        if (typeOf(sp[-1]) == TT_OTHER)
+            return false;
+        sp[-1] = Value::makeBool(!truthy(sp[-1]));
+        ip += 1;
+        return true;
+
+    case OP_EQUAL:
+    case OP_EQUAL_INT:
+    case OP_NOT_EQUAL:
+    case OP_NOT_EQUAL_INT:
+    {
+        TraceType type = typeOf(sp[-2]);
+        if (type == TT_OTHER || typeOf(sp[-1]) != type)
+            return false;
+        bool equal = type == TT_INT ? sp[-2].asInt() == sp[-1].asInt()
+                                    : sp[-2].asBool() == sp[-1].asBool();
+        bool result = (op == OP_NOT_EQUAL || op == OP_NOT_EQUAL_INT) ? !equal : equal;
+        sp--;
+        sp[-1] = Value::makeBool(result);
+        ip += 1;
+        return true;
+    }
+
+    case OP_GREATER:
+    case OP_GREATER_INT:
+    case OP_GREATER_DOUBLE:
+    case OP_GREATER_EQUAL:
+    case OP_GREATER_EQUAL_INT:
+    case OP_GREATER_EQUAL_DOUBLE:
+    case OP_LESS:
+    case OP_LESS_INT:
+    case OP_LESS_DOUBLE:
+    case OP_LESS_EQUAL:
+    case OP_LESS_EQUAL_INT:
+    case OP_LESS_EQUAL_DOUBLE:
+    {
+        if (!sp[-2].isInt() || !sp[-1].isInt())
+            return false;
+        int a = sp[-2].asInt();
+        int b = sp[-1].asInt();
+        bool result;
+        switch (op)
+        {
+        case OP_GREATER:
+        case OP_GREATER_INT:
+        case OP_GREATER_DOUBLE:
+            result = a > b;
+            break;
+        case OP_GREATER_EQUAL:
+        case OP_GREATER_EQUAL_INT:
+        case OP_GREATER_EQUAL_DOUBLE:
+            result = a >= b;
+            break;
+        case OP_LESS_EQUAL:
+        case OP_LESS_EQUAL_INT:
+        case OP_LESS_EQUAL_DOUBLE:
+            result = a <= b;
+            break;
+        default:
+            result = a < b;
+            break;
+        }
+        sp--;
+        sp[-1] = Value::makeBool(result);
+        ip += 1;
+        return true;
+    }
+
+    case OP_ADD_LOCALS:
+        if (!slots_[ip[1]].isInt() || !slots_[ip[2]].isInt())
+            return false;
+        touchLocal(ip[1]);
+        touchLocal(ip[2]);
+        *sp++ = Value::makeInt((int)((uint32_t)slots_[ip[1]].asInt() +
+                                     (uint32_t)slots_[ip[2]].asInt()));
+        ip += 3;
+        return true;
+
+    case OP_ADD_CONST:
+    case OP_SUBTRACT_CONST:
+    {
+        const Value &k = chunk_.constants[ip[1]];
+        if (!sp[-1].isInt() || !k.isInt())
+            return false;
+        uint32_t a = (uint32_t)sp[-1].asInt();
+        uint32_t b = (uint32_t)k.asInt();
+        sp[-1] = Value::makeInt((int)(op == OP_ADD_CONST ? a + b : a - b));
+        ip += 2;
+        return true;
+    }
+
+    case OP_ADD_IMM:
+    case OP_SUBTRACT_IMM:
+    {
+        if (!sp[-1].isInt())
+            return false;
+        uint32_t a = (uint32_t)sp[-1].asInt();
+        uint32_t b = (uint32_t)(int16_t)((ip[1] << 8) | ip[2]);
+        sp[-1] = Value::makeInt((int)(op == OP_ADD_IMM ? a + b : a - b));
+        ip += 3;
+        return true;
+    }
+
+    case OP_INC_LOCAL:
+    case OP_DEC_LOCAL:
+    {
+        Value &v = slots_[ip[1]];
+        if (!v.isInt())
+            return false;
+        touchLocal(ip[1]);
+        v = Value::makeInt((int)((uint32_t)v.asInt() + (op == OP_INC_LOCAL ? 1u : ~0u)));
+        ip += 2;
+        return true;
+    }
+
+    // For numérico com contador e limite int
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+    {
+        Value &counter = slots_[ip[1]];
+        const Value &limit = slots_[ip[2]];
+        if (!counter.isInt() || !limit.isInt())
+            return false;
+        touchLocal(ip[1]);
+        touchLocal(ip[2]);
+        int length = op == OP_FOR_PREP ? 6 : 8;
+        int jump = (ip[length - 2] << 8) | ip[length - 1];
+        if (op == OP_FOR_LOOP)
+        {
+            uint32_t delta = (uint32_t)(int16_t)((ip[4] << 8) | ip[5]);
+            counter = Value::makeInt((int)((uint32_t)counter.asInt() + delta));
+        }
+        int a = counter.asInt();
+        int b = limit.asInt();
+        bool result = ip[3] == OP_GREATER         ? a > b
+                      : ip[3] == OP_GREATER_EQUAL ? a >= b
+                      : ip[3] == OP_LESS          ? a < b
+                                                  : a <= b;
+        taken = op == OP_FOR_PREP ? !result : result;
+        if (op == OP_FOR_PREP)
+            ip += length + (taken ? jump : 0);
+        else
+            ip += length - (taken ? jump : 0);
+        return true;
+    }
+
+    // Calls, returns, natives, print, intrinsics, DEFINE_GLOBAL, nil
+    default:
+        return false;
+    }
+}
+
+// ============================================
+// COMPILAÇÃO
+// ============================================
+// Registos fixos: rbx = slots, r15 = globais, r13 = spOut. rax, rcx e
+// rdx são scratch (idiv, setcc, stubs). Os restantes são alocados: um por
+// home (local abaixo da cabeça ou global) durante o trace todo e o resto
+// para os temporários da stack de operandos.
+
+const int SLOTS = RBX;
+const int GLOBALS = R15;
+const int SP_OUT = R13;
+
+const int POOL[] = {RSI, RDI, R8, R9, R10, R11, R12, R14, RBP};
+
+const int VALUE_SIZE = (int)sizeof(Value);
+
+// Entrada da stack de operandos em tempo de compilação
+struct Operand
+{
+    enum Kind
+    {
+        CONST,
+        TEMP, // registo só desta entrada
+        HOME  // o registo do home (partilhado)
+    };
+
+    Kind kind;
+    TraceType type;
+    int32_t value; // CONST: o int, ou 0/1
+    int reg;       // TEMP
+    int home;      // HOME
+};
+
+struct Home
+{
+    bool global;
+    int slot;
+    TraceType entry; // guard à entrada e tipo que o loop tem de manter
+    TraceType type;  // tipo corrente durante a compilação
+    int reg;
+    bool written;
+};
+
+// Estado a reconstruir quando um guard falha: o interpretador executa a
+// instrução em `offset` com esta stack por cima dos homes
+struct Snapshot
+{
+    int jump; // posição a seguir ao jcc
+    int offset;
+    std::vector<Operand> stack;
+    std::vector<TraceType> types;
+};
+
+int invert(int cc)
+{
+    return cc ^ 1;
+}
+
+// a < b  <=>  b > a
+int swapped(int cc)
+{
+    switch (cc)
+    {
+    case CC_L:
+        return CC_G;
+    case CC_G:
+        return CC_L;
+    case CC_LE:
+        return CC_GE;
+    case CC_GE:
+        return CC_LE;
+    default:
+        return cc;
+    }
+}
+
+bool foldCompare(int cc, int32_t a, int32_t b)
+{
+    switch (cc)
+    {
+    case CC_E:
+        return a == b;
+    case CC_NE:
+        return a != b;
+    case CC_L:
+        return a < b;
+    case CC_LE:
+        return a <= b;
+    case CC_G:
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
+
+int compareCond(uint8_t op)
+{
+    if (isCompareBranch(op))
+        op = branchCompare(op);
+    switch (op)
+    {
+    case OP_EQUAL:
+    case OP_EQUAL_INT:
+        return CC_E;
+    case OP_NOT_EQUAL:
+    case OP_NOT_EQUAL_INT:
+        return CC_NE;
+    case OP_GREATER:
+    case OP_GREATER_INT:
+    case OP_GREATER_DOUBLE:
+        return CC_G;
+    case OP_GREATER_EQUAL:
+    case OP_GREATER_EQUAL_INT:
+    case OP_GREATER_EQUAL_DOUBLE:
+        return CC_GE;
+    case OP_LESS_EQUAL:
+    case OP_LESS_EQUAL_INT:
+    case OP_LESS_EQUAL_DOUBLE:
+        return CC_LE;
+    default:
+        return CC_L;
+    }
+}
+
+class TraceCompiler
+{
+public:
+    TraceCompiler(Function *function, const TraceRecord &record, const GlobalView &globals)
+        : chunk_(function->chunk), code_(function->chunk.code.data()),
+          record_(record), globals_(globals), ok_(true) {}
+
+    bool compile();
+
+    std::vector<uint8_t> &code() { return a_.code; }
+
+private:
+    const Chunk &chunk_;
+    uint8_t *code_;
+    const TraceRecord &record_;
+    GlobalView globals_;
+    Assembler a_;
+
+    std::vector<Home> homes_;
+    std::vector<int> localHomes_; // slot < depth -> índice em homes_ (-1)
+    std::vector<int> free_;
+    std::vector<Operand> stack_;
+    std::vector<Snapshot> exits_;
+    int entryExit_;
+    int epilogue_;
+    bool ok_;
+
+    bool collectHomes();
+    int homeOf(bool global, int slot) const;
+    int32_t homeDisp(const Home &home) const;
+
+    void emitPrologue();
+    void emitEntry();
+    bool emitStep(const TraceStep &step);
+    void emitExits();
+
+    // Registos
+    int alloc();
+    void release(const Operand &op);
+    int regOf(const Operand &op) const;
+    int ownedTemp(const Operand &op);
+    void moveInto(int reg, const Operand &op);
+    void detach(int home);
+
+    Operand pop();
+    void push(const Operand &op) { stack_.push_back(op); }
+    Operand constant(TraceType type, int32_t value) const;
+    Operand temp(int reg, TraceType type) const;
+    Operand local(int slot);
+
+    void exitIf(int cc, int offset);
+    int emitCompare(int cc, const Operand &a, const Operand &b);
+    void storeTyped(int base, int32_t disp, int reg, TraceType type);
+    void storeConstant(int base, int32_t disp, const Value &value);
+
+    void binary(uint8_t op);
+    void divide(int offset, bool modulo);
+    void compare(int cc);
+    void compareJump(int offset, int cc, bool taken);
+    void compareJumpImm(int offset, int cc, int32_t k, bool taken);
+    void setHome(int home);
+    void setLocal(int slot);
+    void step(int slot, int32_t delta);
+};
+
+int TraceCompiler::homeOf(bool global, int slot) const
+{
+    if (!global)
+        return localHomes_[slot];
+    for (size_t i = 0; i < homes_.size(); i++)
+        if (homes_[i].global && homes_[i].slot == slot)
+            return (int)i;
+    return -1;
+}
+
+int32_t TraceCompiler::homeDisp(const Home &home) const
+{
+    return home.global ? home.slot * globals_.size + globals_.value : home.slot * VALUE_SIZE;
+}
+
+bool TraceCompiler::collectHomes()
+{
+    int depth = record_.depth;
+    localHomes_.assign(depth, -1);
+
+    Home home;
+    home.written = false;
+    for (int slot = 0; slot < depth; slot++)
+    {
+        if (record_.locals[slot] == TT_UNSET)
+            continue;
+        home.global = false;
+        home.slot = slot;
+        home.entry = home.type = record_.locals[slot];
+        localHomes_[slot] = (int)homes_.size();
+        homes_.push_back(home);
+    }
+    for (const auto &global : record_.globals)
+    {
+        home.global = true;
+        home.slot = global.first;
+        home.entry = home.type = global.second;
+        homes_.push_back(home);
+    }
+
+    const int poolSize = (int)(sizeof(POOL) / sizeof(POOL[0]));
+    if ((int)homes_.size() >= poolSize)
+        return false;
+
+    for (size_t i = 0; i < homes_.size(); i++)
+    {
+        if (homes_[i].entry == TT_OTHER)
+            return false;
+        homes_[i].reg = POOL[i];
+    }
+    for (int i = poolSize - 1; i >= (int)homes_.size(); i--)
+        free_.push_back(POOL[i]);
+
+    // Só os homes escritos voltam à memória nas saídas
+    for (const TraceStep &step : record_.steps)
+    {
+        const uint8_t *ip = code_ + step.offset;
+        int h = -1;
+        if ((ip[0] == OP_SET_LOCAL || ip[0] == OP_INC_LOCAL || ip[0] == OP_DEC_LOCAL ||
+             ip[0] == OP_FOR_LOOP) &&
+            ip[1] < depth)
+            h = localHomes_[ip[1]];
+        else if (ip[0] == OP_SET_GLOBAL)
+            h = homeOf(true, (ip[1] << 8) | ip[2]);
+        if (h >= 0)
+            homes_[h].written = true;
+    }
+    return true;
+}
+
+void TraceCompiler::emitPrologue()
+{
+    // entry(slots, globals, spOut): rdi, rsi, rdx
+    a_.push(RBX);
+    a_.push(RBP);
+    a_.push(R12);
+    a_.push(R13);
+    a_.push(R14);
+    a_.push(R15);
+    a_.mov64(SLOTS, RDI);
+    a_.mov64(GLOBALS, RSI);
+    a_.mov64(SP_OUT, RDX);
+    int body = a_.jmp();
+
+    // Saída comum: rcx tem o sp, rax o ip onde o interpretador continua
+    epilogue_ = a_.here();
+    a_.store64(SP_OUT, 0, RCX);
+    a_.pop(R15);
+    a_.pop(R14);
+    a_.pop(R13);
+    a_.pop(R12);
+    a_.pop(RBP);
+    a_.pop(RBX);
+    a_.ret();
+
+    // Guard de entrada falhado: nada mudou, volta à cabeça
+    entryExit_ = a_.here();
+    a_.mov64(RCX, SLOTS);
+    a_.add64Imm(RCX, record_.depth * VALUE_SIZE);
+    a_.movImm64(RAX, (uint64_t)(uintptr_t)(code_ + record_.steps[0].offset));
+    a_.patch(a_.jmp(), epilogue_);
+
+    a_.patch(body, a_.here());
+}
+
+// Guards dos tipos à entrada e carga dos homes para os registos
+void TraceCompiler::emitEntry()
+{
+    for (const Home &home : homes_)
+    {
+        int base = home.global ? GLOBALS : SLOTS;
+        int32_t disp = homeDisp(home);
+        if (home.global)
+        {
+            a_.cmp8Imm(GLOBALS, home.slot * globals_.size + globals_.defined, 0);
+            a_.patch(a_.jcc(CC_E), entryExit_);
+        }
+
+        if (home.entry == TT_INT)
+        {
+            a_.cmp32Imm(base, disp + TAG_DISP, TAG_INT);
+            a_.patch(a_.jcc(CC_NE), entryExit_);
+            a_.load32(home.reg, base, disp + PAYLOAD_DISP);
+            continue;
+        }
+
+#if WREN_NAN_TAGGING
+        // TAG_TRUE = TAG_FALSE + 1: a tag menos TAG_FALSE já é o bool
+        a_.load32(home.reg, base, disp + TAG_DISP);
+        a_.sub32Imm(home.reg, (int32_t)TAG_FALSE);
+        a_.cmpReg32Imm(home.reg, 1);
+        a_.patch(a_.jcc(CC_A), entryExit_);
+#else
+        a_.cmp32Imm(base, disp + TAG_DISP, VAL_BOOL);
+        a_.patch(a_.jcc(CC_NE), entryExit_);
+        a_.load8(home.reg, base, disp + PAYLOAD_DISP);
+#endif
+    }
+}
+
+int TraceCompiler::alloc()
+{
+    if (free_.empty())
+    {
+        ok_ = false;
+        return RAX;
+    }
+    int reg = free_.back();
+    free_.pop_back();
+    return reg;
+}
+
+void TraceCompiler::release(const Operand &op)
+{
+    if (op.kind == Operand::TEMP)
+        free_.push_back(op.reg);
+}
+
+int TraceCompiler::regOf(const Operand &op) const
+{
+    return op.kind == Operand::TEMP ? op.reg : homes_[op.home].reg;
+}
+
+void TraceCompiler::moveInto(int reg, const Operand &op)
+{
+    if (op.kind == Operand::CONST)
+        a_.movImm32(reg, op.value);
+    else if (regOf(op) != reg)
+        a_.mov32(reg, regOf(op));
+}
+
+// Registo que o resultado pode destruir: o do próprio temp ou uma cópia
+int TraceCompiler::ownedTemp(const Operand &op)
+{
+    if (op.kind == Operand::TEMP)
+        return op.reg;
+    int reg = alloc();
+    moveInto(reg, op);
+    return reg;
+}
+
+// O home vai mudar: as entradas da stack que o leem ficam com uma cópia
+void TraceCompiler::detach(int home)
+{
+    for (Operand &op : stack_)
+    {
+        if (op.kind == Operand::HOME && op.home == home)
+        {
+            int reg = alloc();
+            a_.mov32(reg, homes_[home].reg);
+            op = temp(reg, homes_[home].type);
+        }
+    }
+}
+
+Operand TraceCompiler::pop()
+{
+    if (stack_.empty())
+    {
+        ok_ = false;
+        return constant(TT_INT, 0);
+    }
+    Operand op = stack_.back();
+    stack_.pop_back();
+    return op;
+}
+
+Operand TraceCompiler::constant(TraceType type, int32_t value) const
+{
+    Operand op;
+    op.kind = Operand::CONST;
+    op.type = type;
+    op.value = value;
+    op.reg = -1;
+    op.home = -1;
+    return op;
+}
+
+Operand TraceCompiler::temp(int reg, TraceType type) const
+{
+    Operand op = constant(type, 0);
+    op.kind = Operand::TEMP;
+    op.reg = reg;
+    return op;
+}
+
+// Operando que lê um slot: home abaixo da cabeça, entrada da stack acima.
+// Não transfere a posse de temps.
+Operand TraceCompiler::local(int slot)
+{
+    if (slot < record_.depth)
+    {
+        Operand op = constant(homes_[localHomes_[slot]].type, 0);
+        op.kind = Operand::HOME;
+        op.home = localHomes_[slot];
+        return op;
+    }
+    return stack_[slot - record_.depth];
+}
+
+void TraceCompiler::exitIf(int cc, int offset)
+{
+    Snapshot exit;
+    exit.jump = a_.jcc(cc);
+    exit.offset = offset;
+    exit.stack = stack_;
+    for (const Home &home : homes_)
+        exit.types.push_back(home.type);
+    exits_.push_back(exit);
+}
+
+// reg tem o valor nos 32 bits baixos e zeros em cima; fica intacto.
+// Usa rax.
+void TraceCompiler::storeTyped(int base, int32_t disp, int reg, TraceType type)
+{
+#if WREN_NAN_TAGGING
+    if (type == TT_INT)
+    {
+        a_.movImm64(RAX, (uint64_t)TAG_INT << 32);
+        a_.or64(RAX, reg);
+    }
+    else
+    {
+        a_.mov32(RAX, reg);
+        a_.add32Imm(RAX, (int32_t)TAG_FALSE);
+        a_.shl64Imm(RAX, 32);
+    }
+    a_.store64(base, disp, RAX);
+#else
+    a_.store64(base, disp + PAYLOAD_DISP, reg);
+    a_.store64Imm(base, disp + TAG_DISP, type == TT_INT ? VAL_INT : VAL_BOOL);
+#endif
+}
+
+void TraceCompiler::storeConstant(int base, int32_t disp, const Value &value)
+{
+    uint64_t words[sizeof(Value) / 8];
+    memcpy(words, &value, sizeof(Value));
+    for (size_t i = 0; i < sizeof(Value) / 8; i++)
+    {
+        a_.movImm64(RAX, words[i]);
+        a_.store64(base, disp + (int32_t)(i * 8), RAX);
+    }
+}
+
+// Devolve a condição a testar depois do cmp (trocada se a é constante)
+int TraceCompiler::emitCompare(int cc, const Operand &a, const Operand &b)
+{
+    if (a.kind == Operand::CONST)
+    {
+        a_.cmpReg32Imm(regOf(b), a.value);
+        return swapped(cc);
+    }
+    if (b.kind == Operand::CONST)
+        a_.cmpReg32Imm(regOf(a), b.value);
+    else
+        a_.alu32(ALU_CMP, regOf(a), regOf(b));
+    return cc;
+}
+
+void TraceCompiler::binary(uint8_t op)
+{
+    Operand b = pop();
+    Operand a = pop();
+    bool add = op == OP_ADD || op == OP_ADD_INT || op == OP_ADD_DOUBLE || op == OP_ADD_STRING;
+    bool sub = op == OP_SUBTRACT || op == OP_SUBTRACT_INT || op == OP_SUBTRACT_DOUBLE;
+
+    if (a.kind == Operand::CONST && b.kind == Operand::CONST)
+    {
+        uint32_t x = (uint32_t)a.value, y = (uint32_t)b.value;
+        push(constant(TT_INT, (int32_t)(add ? x + y : sub ? x - y : x * y)));
+        return;
+    }
+    if (a.kind == Operand::CONST && !sub)
+        std::swap(a, b);
+
+    int dst = ownedTemp(a);
+    if (b.kind == Operand::CONST)
+    {
+        if (add)
+            a_.add32Imm(dst, b.value);
+        else if (sub)
+            a_.sub32Imm(dst, b.value);
+        else
+            a_.imul32Imm(dst, dst, b.value);
+    }
+    else if (add)
+        a_.alu32(ALU_ADD, dst, regOf(b));
+    else if (sub)
+        a_.alu32(ALU_SUB, dst, regOf(b));
+    else
+        a_.imul32(dst, regOf(b));
+    release(b);
+    push(temp(dst, TT_INT));
+}
+
+void TraceCompiler::divide(int offset, bool modulo)
+{
+    const Operand &divisor = stack_.back();
+    if (divisor.kind == Operand::CONST)
+    {
+        // O recorder nunca grava estes (ficam com o interpretador)
+        if (divisor.value == 0 || divisor.value == -1)
+        {
+            ok_ = false;
+            return;
+        }
+    }
+    else
+    {
+        a_.cmpReg32Imm(regOf(divisor), 0);
+        exitIf(CC_E, offset);
+        a_.cmpReg32Imm(regOf(divisor), -1);
+        exitIf(CC_E, offset);
+    }
+
+    Operand b = pop();
+    Operand a = pop();
+    if (a.kind == Operand::CONST && b.kind == Operand::CONST)
+    {
+        push(constant(TT_INT, modulo ? a.value % b.value : a.value / b.value));
+        return;
+    }
+    moveInto(RAX, a);
+    int divisorReg = RCX;
+    if (b.kind == Operand::CONST)
+        a_.movImm32(RCX, b.value);
+    else
+        divisorReg = regOf(b);
+    a_.idiv32(divisorReg);
+    release(a);
+    release(b);
+    int dst = alloc();
+    a_.mov32(dst, modulo ? RDX : RAX);
+    push(temp(dst, TT_INT));
+}
+
+void TraceCompiler::compare(int cc)
+{
+    Operand b = pop();
+    Operand a = pop();
+    if (a.kind == Operand::CONST && b.kind == Operand::CONST)
+    {
+        push(constant(TT_BOOL, foldCompare(cc, a.value, b.value)));
+        return;
+    }
+    a_.setBool(emitCompare(cc, a, b), RAX);
+    release(a);
+    release(b);
+    int dst = alloc();
+    a_.mov32(dst, RAX);
+    push(temp(dst, TT_BOOL));
+}
+
+// O lado gravado segue em frente; o outro sai com a e b ainda na stack e
+// o interpretador refaz a comparação
+void TraceCompiler::compareJump(int offset, int cc, bool taken)
+{
+    const Operand &a = stack_[stack_.size() - 2];
+    const Operand &b = stack_.back();
+    if (a.kind != Operand::CONST || b.kind != Operand::CONST)
+    {
+        int test = emitCompare(cc, a, b);
+        exitIf(taken ? test : invert(test), offset);
+    }
+    release(pop());
+    release(pop());
+}
+
+// Igual, com b no próprio bytecode: ao sair só a está na stack
+void TraceCompiler::compareJumpImm(int offset, int cc, int32_t k, bool taken)
+{
+    const Operand &a = stack_.back();
+    if (a.kind != Operand::CONST)
+    {
+        int test = emitCompare(cc, a, constant(TT_INT, k));
+        exitIf(taken ? test : invert(test), offset);
+    }
+    release(pop());
+}
+
+// O valor do topo passa para o home (a entrada fica na stack)
+void TraceCompiler::setHome(int home)
+{
+    detach(home);
+    const Operand &value = stack_.back();
+    moveInto(homes_[home].reg, value);
+    homes_[home].type = value.type;
+}
+
+void TraceCompiler::setLocal(int slot)
+{
+    if (slot < record_.depth)
+    {
+        setHome(localHomes_[slot]);
+        return;
+    }
+
+    Operand &dst = stack_[slot - record_.depth];
+    const Operand &value = stack_.back();
+    if (&dst == &value)
+        return;
+    if (value.kind != Operand::TEMP)
+    {
+        release(dst);
+        dst = value;
+    }
+    else if (dst.kind == Operand::TEMP)
+    {
+        a_.mov32(dst.reg, value.reg);
+        dst.type = value.type;
+    }
+    else
+    {
+        int reg = alloc();
+        a_.mov32(reg, value.reg);
+        dst = temp(reg, value.type);
+    }
+}
+
+void TraceCompiler::step(int slot, int32_t delta)
+{
+    if (slot < record_.depth)
+    {
+        int home = localHomes_[slot];
+        detach(home);
+        a_.add32Imm(homes_[home].reg, delta);
+        return;
+    }
+
+    Operand &op = stack_[slot - record_.depth];
+    if (op.kind == Operand::CONST)
+    {
+        op.value = (int32_t)((uint32_t)op.value + (uint32_t)delta);
+        return;
+    }
+    if (op.kind == Operand::HOME)
+    {
+        int reg = alloc();
+        a_.mov32(reg, homes_[op.home].reg);
+        op = temp(reg, TT_INT);
+    }
+    a_.add32Imm(op.reg, delta);
+}
+
+bool TraceCompiler::emitStep(const TraceStep &traceStep)
+{
+    int offset = traceStep.offset;
+    const uint8_t *ip = code_ + offset;
+
+    switch (ip[0])
+    {
+    case OP_CONSTANT:
+    {
+        const Value &k = chunk_.constants[ip[1]];
+        push(k.isInt() ? constant(TT_INT, k.asInt()) : constant(TT_BOOL, k.asBool()));
+        break;
+    }
+
+    case OP_PUSH_INT:
+        push(constant(TT_INT, (int16_t)((ip[1] << 8) | ip[2])));
+        break;
+
+    case OP_TRUE:
+    case OP_FALSE:
+        push(constant(TT_BOOL, ip[0] == OP_TRUE));
+        break;
+
+    case OP_POP:
+        release(pop());
+        break;
+
+    case OP_GET_LOCAL:
+    {
+        Operand op = local(ip[1]);
+        if (op.kind == Operand::TEMP)
+        {
+            // Cada temp pertence a uma só entrada
+            int reg = alloc();
+            a_.mov32(reg, op.reg);
+            op = temp(reg, op.type);
+        }
+        push(op);
+        break;
+    }
+
+    case OP_SET_LOCAL:
+        setLocal(ip[1]);
+        break;
+
+    case OP_GET_GLOBAL:
+    {
+        int home = homeOf(true, (ip[1] << 8) | ip[2]);
+        Operand op = constant(homes_[home].type, 0);
+        op.kind = Operand::HOME;
+        op.home = home;
+        push(op);
+        break;
+    }
+
+    case OP_SET_GLOBAL:
+        setHome(homeOf(true, (ip[1] << 8) | ip[2]));
+        break;
+
+    case OP_JUMP:
+    case OP_LOOP:
+        break;
+
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+    {
+        // Sai quando a condição tem a verdade do lado não gravado
+        const Operand &top = stack_.back();
+        if (top.kind != Operand::CONST)
+        {
+            bool truth = traceStep.taken == (ip[0] == OP_JUMP_IF_TRUE);
+            a_.alu32(ALU_TEST, regOf(top), regOf(top));
+            exitIf(truth ? CC_E : CC_NE, offset);
+        }
+        break;
+    }
+
+    case OP_POP_JUMP_IF_FALSE:
+    {
+        const Operand &top = stack_.back();
+        if (top.kind != Operand::CONST)
+        {
+            a_.alu32(ALU_TEST, regOf(top), regOf(top));
+            exitIf(traceStep.taken ? CC_NE : CC_E, offset);
+        }
+        release(pop());
+        break;
+    }
+
+    case OP_ADD:
+    case OP_ADD_INT:
+    case OP_ADD_DOUBLE:
+    case OP_ADD_STRING:
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_INT:
+    case OP_SUBTRACT_DOUBLE:
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_INT:
+    case OP_MULTIPLY_DOUBLE:
+        binary(ip[0]);
+        break;
+
+    case OP_DIVIDE:
+    case OP_MODULO:
+        divide(offset, ip[0] == OP_MODULO);
+        break;
+
+    case OP_NEGATE:
+    {
+        Operand a = pop();
+        if (a.kind == Operand::CONST)
+        {
+            push(constant(TT_INT, (int32_t)(0u - (uint32_t)a.value)));
+            break;
+        }
+        int dst = ownedTemp(a);
+        a_.neg32(dst);
+        push(temp(dst, TT_INT));
+        break;
+    }
+
+    case OP_NOT:
+    {
+        Operand a = pop();
+        if (a.kind == Operand::CONST)
+        {
+            push(constant(TT_BOOL, a.value == 0));
+            break;
+        }
+        a_.alu32(ALU_TEST, regOf(a), regOf(a));
+        a_.setBool(CC_E, RAX);
+        release(a);
+        int dst = alloc();
+        a_.mov32(dst, RAX);
+        push(temp(dst, TT_BOOL));
+        break;
+    }
+
+    case OP_EQUAL:
+    case OP_EQUAL_INT:
+    case OP_NOT_EQUAL:
+    case OP_NOT_EQUAL_INT:
+    case OP_GREATER:
+    case OP_GREATER_INT:
+    case OP_GREATER_DOUBLE:
+    case OP_GREATER_EQUAL:
+    case OP_GREATER_EQUAL_INT:
+    case OP_GREATER_EQUAL_DOUBLE:
+    case OP_LESS:
+    case OP_LESS_INT:
+    case OP_LESS_DOUBLE:
+    case OP_LESS_EQUAL:
+    case OP_LESS_EQUAL_INT:
+    case OP_LESS_EQUAL_DOUBLE:
+        compare(compareCond(ip[0]));
+        break;
+
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+    case OP_JUMP_IF_NOT_LESS:
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+        compareJump(offset, compareCond(ip[0]), traceStep.taken);
+        break;
+
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+    case OP_JUMP_IF_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_LESS_IMM:
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+        compareJumpImm(offset, compareCond(ip[0]), (int16_t)((ip[1] << 8) | ip[2]),
+                       traceStep.taken);
+        break;
+
+    case OP_ADD_LOCALS:
+    {
+        Operand a = local(ip[1]);
+        Operand b = local(ip[2]);
+        if (a.kind == Operand::CONST && b.kind == Operand::CONST)
+        {
+            push(constant(TT_INT, (int32_t)((uint32_t)a.value + (uint32_t)b.value)));
+            break;
+        }
+        if (a.kind == Operand::CONST)
+            std::swap(a, b);
+        int dst = alloc();
+        moveInto(dst, a);
+        if (b.kind == Operand::CONST)
+            a_.add32Imm(dst, b.value);
+        else
+            a_.alu32(ALU_ADD, dst, regOf(b));
+        push(temp(dst, TT_INT));
+        break;
+    }
+
+    case OP_ADD_CONST:
+    case OP_SUBTRACT_CONST:
+    case OP_ADD_IMM:
+    case OP_SUBTRACT_IMM:
+    {
+        int32_t k = ip[0] == OP_ADD_IMM || ip[0] == OP_SUBTRACT_IMM
+                        ? (int16_t)((ip[1] << 8) | ip[2])
+                        : chunk_.constants[ip[1]].asInt();
+        Operand a = pop();
+        if (ip[0] == OP_SUBTRACT_CONST || ip[0] == OP_SUBTRACT_IMM)
+            k = (int32_t)(0u - (uint32_t)k);
+        if (a.kind == Operand::CONST)
+        {
+            push(constant(TT_INT, (int32_t)((uint32_t)a.value + (uint32_t)k)));
+            break;
+        }
+        int dst = ownedTemp(a);
+        a_.add32Imm(dst, k);
+        push(temp(dst, TT_INT));
+        break;
+    }
+
+    case OP_INC_LOCAL:
+    case OP_DEC_LOCAL:
+        step(ip[1], ip[0] == OP_INC_LOCAL ? 1 : -1);
+        break;
+
+    // Saída com o lado não gravado; no FOR_LOOP o contador novo está num
+    // temp e só passa ao slot depois do guard (o interpretador repete a
+    // instrução inteira)
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+    {
+        int cc = compareCond(ip[3]);
+        Operand counter = local(ip[1]);
+        Operand limit = local(ip[2]);
+        Operand next = counter;
+        if (ip[0] == OP_FOR_LOOP)
+        {
+            int32_t delta = (int16_t)((ip[4] << 8) | ip[5]);
+            if (counter.kind == Operand::CONST)
+                next = constant(TT_INT, (int32_t)((uint32_t)counter.value + (uint32_t)delta));
+            else
+            {
+                int reg = alloc();
+                moveInto(reg, counter);
+                a_.add32Imm(reg, delta);
+                next = temp(reg, TT_INT);
+            }
+        }
+
+        // FOR_PREP salta com a condição falsa, FOR_LOOP com ela verdadeira
+        bool result = ip[0] == OP_FOR_PREP ? !traceStep.taken : traceStep.taken;
+        if (next.kind != Operand::CONST || limit.kind != Operand::CONST)
+        {
+            int test = emitCompare(cc, next, limit);
+            exitIf(result ? invert(test) : test, offset);
+        }
+
+        if (ip[0] == OP_FOR_LOOP)
+        {
+            push(next);
+            setLocal(ip[1]);
+            release(pop());
+        }
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    return ok_;
+}
+
+// Um stub frio por guard: homes escritos de volta à memória, stack da
+// instrução reconstruída por cima deles, sp e ip para o interpretador
+void TraceCompiler::emitExits()
+{
+    for (const Snapshot &exit : exits_)
+    {
+        a_.patch(exit.jump, a_.here());
+
+        for (size_t i = 0; i < homes_.size(); i++)
+        {
+            const Home &home = homes_[i];
+            if (home.written)
+                storeTyped(home.global ? GLOBALS : SLOTS, homeDisp(home), home.reg, exit.types[i]);
+        }
+
+        int32_t disp = record_.depth * VALUE_SIZE;
+        for (const Operand &op : exit.stack)
+        {
+            if (op.kind == Operand::CONST)
+                storeConstant(SLOTS, disp, op.type == TT_INT ? Value::makeInt(op.value)
+                                                             : Value::makeBool(op.value != 0));
+            else
+                storeTyped(SLOTS, disp, regOf(op),
+                           op.kind == Operand::HOME ? exit.types[op.home] : op.type);
+            disp += VALUE_SIZE;
+        }
+
+        a_.mov64(RCX, SLOTS);
+        a_.add64Imm(RCX, disp);
+        a_.movImm64(RAX, (uint64_t)(uintptr_t)(code_ + exit.offset));
+        a_.patch(a_.jmp(), epilogue_);
+    }
+}
+
+bool TraceCompiler::compile()
+{
+    if (record_.steps.empty() || !collectHomes())
+        return false;
+
+    emitPrologue();
+    emitEntry();
+    int loop = a_.here();
+
+    for (const TraceStep &step : record_.steps)
+    {
+        if (!emitStep(step))
+            return false;
+    }
+
+    // De volta à cabeça: a stack tem de estar como à entrada e os homes
+    // com os tipos que os guards de entrada garantiram
+    if (!stack_.empty())
+        return false;
+    for (const Home &home : homes_)
+    {
+        if (home.type != home.entry)
+            return false;
+    }
+    a_.patch(a_.jmp(), loop);
+
+    emitExits();
+    return true;
+}
+
+} // namespace
+
+// ============================================
+// API
+// ============================================
+
+static TraceCode *compileTrace(Function *function, const TraceRecord &record,
+                               const GlobalView &globals, bool perfMap)
+{
+    TraceCompiler compiler(function, record, globals);
+    if (!compiler.compile())
+        return nullptr;
+
+    std::vector<uint8_t> &machine = compiler.code();
+    size_t size;
+    uint8_t *memory = x64::install(machine, size);
+    if (!memory)
+        return nullptr;
+
+    TraceCode *trace = new TraceCode();
+    trace->memory = memory;
+    trace->size = size;
+    trace->entry = (TraceEntry)memory;
+
+    if (perfMap)
+    {
+        std::string name = "wren-trace:" +
+                           (function->name.empty() ? std::string("script") : function->name) +
+                           "@" + std::to_string(record.steps[0].offset);
+        x64::writePerfMap(memory, machine.size(), name.c_str());
+    }
+    return trace;
+}
+
+uint8_t *Tracer::onLoop(VM *vm, Function *function, uint8_t *ip, Value *slots, Value *&sp)
+{
+    LoopState *loop = loopAt(function, (int)(ip - function->chunk.code.data()));
+
+    if (!loop->trace)
+    {
+        if (--loop->countdown > 0)
+            return ip;
+
+        GlobalView globals;
+        globals.base = (uint8_t *)vm->globals_.data();
+        globals.size = (int32_t)sizeof(VM::GlobalSlot);
+        globals.value = (int32_t)offsetof(VM::GlobalSlot, value);
+        globals.defined = (int32_t)offsetof(VM::GlobalSlot, defined);
+
+        TraceRecord record;
+        Recorder recorder(function, globals, slots, record);
+        if (!recorder.run(ip, sp))
+        {
+            // O ip ficou na instrução que o recorder não trata
+            loop->countdown = ++loop->aborts >= MAX_ABORTS ? INT_MAX : HOT_LOOP;
+            return ip;
+        }
+
+        loop->trace = compileTrace(function, record, globals, vm->perfMap_);
+        if (!loop->trace)
+        {
+            loop->countdown = INT_MAX;
+            return ip;
+        }
+    }
+
+    // O OP_LOOP do baseline volta ao interpretador no próximo back-edge
+    loop->countdown = 1;
+    return loop->trace->entry(slots, vm->globals_.data(), &sp);
+}
+
+void Tracer::release(std::vector<LoopState *> &loops)
+{
+    for (LoopState *loop : loops)
+    {
+        if (loop->trace)
+        {
+            x64::uninstall(loop->trace->memory, loop->trace->size);
+            delete loop->trace;
+        }
+        delete loop;
+    }
+    loops.clear();
+}
+
+#else
+
+struct TraceCode
+{
+};
+
+uint8_t *Tracer::onLoop(VM *, Function *, uint8_t *ip, Value *, Value *&)
+{
+    return ip;
+}
+
+void Tracer::release(std::vector<LoopState *> &loops)
+{
+    for (LoopState *loop : loops)
+        delete loop;
+    loops.clear();
+}
+
+#endif
+
+LoopState *Tracer::loopAt(Function *function, int header)
+{
+    for (LoopState *loop : function->loops)
+    {
+        if (loop->header == header)
+            return loop;
+    }
+    LoopState *loop = new LoopState();
+    loop->header = header;
+    loop->countdown = HOT_LOOP;
+    loop->aborts = 0;
+    loop->trace = nullptr;
+    function->loops.push_back(loop);
+    return loop;
+}
+
+bool Tracer::hasTrace(const Function *function)
+{
+    for (const LoopState *loop : function->loops)
+    {
+        if (loop->trace)
+            return true;
+    }
+    return false;
+}
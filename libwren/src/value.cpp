@@ -1,54 +1,22 @@
 #include "value.h"
 #include "stringpool.h"
 #include <cstdio>
-#include "value.h"
-#include <cstdio>
-
-Value::Value() : type(VAL_NULL)
-{
-    as.integer = 0;
-}
-
-    
-
-Value Value::makeNull()
-{
-    Value v;
-    v.type = VAL_NULL;
-    return v;
-}
 
-Value Value::makeBool(bool b)
-{
-    Value v;
-    v.type = VAL_BOOL;
-    v.as.boolean = b;
-    return v;
-}
+#if WREN_NAN_TAGGING
 
-Value Value::makeInt(int i)
+Value Value::makeString(const char *str)
 {
-    Value v;
-    v.type = VAL_INT;
-    v.as.integer = i;
-    return v;
+    const char *interned = StringPool::instance().intern(str);
+    return fromBits(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)interned);
 }
 
-Value Value::makeDouble(double d)
+Value Value::makeString(const std::string &str)
 {
-    Value v;
-    v.type = VAL_DOUBLE;
-    v.as.number = d;
-    return v;
+    const char *interned = StringPool::instance().intern(str);
+    return fromBits(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)interned);
 }
 
-Value Value::makeFloat(float f)
-{
-    Value v;
-    v.type = VAL_DOUBLE;
-    v.as.number = f;
-    return v;
-}
+#else
 
 Value Value::makeString(const char *str)
 {
@@ -66,22 +34,7 @@ Value Value::makeString(const std::string &str)
     return v;
 }
 
-Value Value::makeFunction(int idx)
-{
-    Value v;
-    v.type = VAL_FUNCTION;
-    v.as.functionIdx = idx;
-    return v;
-}
-
-
-
-bool Value::asBool() const { return as.boolean; }
-int Value::asInt() const { return as.integer; }
-double Value::asDouble() const { return as.number; }
-float Value::asFloat() const { return (float)as.number; }
-const char *Value::asString() const { return as.string; }
-int Value::asFunctionIdx() const { return as.functionIdx; }
+#endif
 
 void printValue(const Value &value)
 {
@@ -90,18 +43,18 @@ void printValue(const Value &value)
 
 std::string valueToString(const Value &value)
 {
-    switch (value.type)
+    switch (value.getType())
     {
     case VAL_NULL:
         return "null";
     case VAL_BOOL:
-        return value.as.boolean ? "true" : "false";
+        return value.asBool() ? "true" : "false";
     case VAL_INT:
-        return std::to_string(value.as.integer);
+        return std::to_string(value.asInt());
     case VAL_DOUBLE:
-        return std::to_string(value.as.number);
+        return std::to_string(value.asDouble());
     case VAL_STRING:
-        return value.as.string;
+        return value.asString();
     case VAL_FUNCTION:
         return "<fn>";
     }
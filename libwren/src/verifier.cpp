@@ -0,0 +1,454 @@
+#include "verifier.h"
+#include <cstdio>
+#include <vector>
+
+// ============================================
+// DESCODIFICAÇÃO DO BYTECODE DE STACK
+// ============================================
+
+bool Verifier::decode(const Chunk &chunk, int offset, StackInstruction &info)
+{
+    const uint8_t *code = chunk.code.data();
+    int size = (int)chunk.count();
+
+    info.length = 1;
+    info.delta = 0;
+    info.pops = 0;
+    info.jumpTarget = -1;
+    info.fallsThrough = true;
+
+    switch (code[offset])
+    {
+    case OP_NIL:
+    case OP_TRUE:
+    case OP_FALSE:
+        info.delta = 1;
+        break;
+
+    case OP_CONSTANT:
+    case OP_GET_LOCAL:
+        info.length = 2;
+        info.delta = 1;
+        break;
+
+    case OP_SET_LOCAL:
+    case OP_ADD_CONST:
+    case OP_SUBTRACT_CONST:
+        info.length = 2;
+        info.pops = 1;
+        break;
+
+    case OP_INC_LOCAL:
+    case OP_DEC_LOCAL:
+        info.length = 2;
+        break;
+
+    // Globais: slot u16
+    case OP_GET_GLOBAL:
+        info.length = 3;
+        info.delta = 1;
+        break;
+
+    case OP_SET_GLOBAL:
+        info.length = 3;
+        info.pops = 1;
+        break;
+
+    case OP_DEFINE_GLOBAL:
+        info.length = 3;
+        info.delta = -1;
+        info.pops = 1;
+        break;
+
+    case OP_POP:
+    case OP_PRINT:
+        info.delta = -1;
+        info.pops = 1;
+        break;
+
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULO:
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER:
+    case OP_GREATER_EQUAL:
+    case OP_LESS:
+    case OP_LESS_EQUAL:
+    case OP_POW:
+    case OP_ADD_INT:
+    case OP_ADD_DOUBLE:
+    case OP_ADD_STRING:
+    case OP_SUBTRACT_INT:
+    case OP_SUBTRACT_DOUBLE:
+    case OP_MULTIPLY_INT:
+    case OP_MULTIPLY_DOUBLE:
+    case OP_EQUAL_INT:
+    case OP_NOT_EQUAL_INT:
+    case OP_GREATER_INT:
+    case OP_GREATER_DOUBLE:
+    case OP_GREATER_EQUAL_INT:
+    case OP_GREATER_EQUAL_DOUBLE:
+    case OP_LESS_INT:
+    case OP_LESS_DOUBLE:
+    case OP_LESS_EQUAL_INT:
+    case OP_LESS_EQUAL_DOUBLE:
+        info.delta = -1;
+        info.pops = 2;
+        break;
+
+    case OP_NOT:
+    case OP_NEGATE:
+    case OP_SQRT:
+    case OP_ABS:
+    case OP_LEN:
+    case OP_STR:
+        info.pops = 1;
+        break;
+
+    case OP_ADD_LOCALS:
+        info.length = 3;
+        info.delta = 1;
+        break;
+
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE:
+    case OP_LOOP:
+    {
+        if (offset + 2 >= size)
+            return false;
+        int jump = (code[offset + 1] << 8) | code[offset + 2];
+        info.length = 3;
+        info.jumpTarget = code[offset] == OP_LOOP ? offset + 3 - jump : offset + 3 + jump;
+        info.fallsThrough = code[offset] != OP_JUMP && code[offset] != OP_LOOP;
+        if (code[offset] == OP_JUMP_IF_FALSE || code[offset] == OP_JUMP_IF_TRUE)
+            info.pops = 1; // só espreita a condição
+        break;
+    }
+
+    // Formas largas
+    case OP_CONSTANT_LONG:
+        info.length = 4;
+        info.delta = 1;
+        break;
+
+    case OP_GET_LOCAL_LONG:
+        info.length = 3;
+        info.delta = 1;
+        break;
+
+    case OP_SET_LOCAL_LONG:
+        info.length = 3;
+        info.pops = 1;
+        break;
+
+    case OP_JUMP_LONG:
+    case OP_JUMP_IF_FALSE_LONG:
+    case OP_JUMP_IF_TRUE_LONG:
+    case OP_LOOP_LONG:
+    case OP_POP_JUMP_IF_FALSE_LONG:
+    {
+        if (offset + 3 >= size)
+            return false;
+        int jump = (code[offset + 1] << 16) | (code[offset + 2] << 8) | code[offset + 3];
+        info.length = 4;
+        info.jumpTarget = code[offset] == OP_LOOP_LONG ? offset + 4 - jump : offset + 4 + jump;
+        info.fallsThrough = code[offset] != OP_JUMP_LONG && code[offset] != OP_LOOP_LONG;
+        if (info.fallsThrough)
+            info.pops = 1;
+        if (code[offset] == OP_POP_JUMP_IF_FALSE_LONG)
+            info.delta = -1;
+        break;
+    }
+
+    // Imediatos
+    case OP_PUSH_INT:
+        info.length = 3;
+        info.delta = 1;
+        break;
+
+    case OP_ADD_IMM:
+    case OP_SUBTRACT_IMM:
+        info.length = 3;
+        info.pops = 1;
+        break;
+
+    // Condições que consomem os operandos
+    case OP_POP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_NOT_EQUAL:
+    case OP_JUMP_IF_EQUAL:
+    case OP_JUMP_IF_NOT_GREATER:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL:
+    case OP_JUMP_IF_NOT_LESS:
+    case OP_JUMP_IF_NOT_LESS_EQUAL:
+    {
+        if (offset + 2 >= size)
+            return false;
+        int jump = (code[offset + 1] << 8) | code[offset + 2];
+        info.length = 3;
+        info.jumpTarget = offset + 3 + jump;
+        info.pops = code[offset] == OP_POP_JUMP_IF_FALSE ? 1 : 2;
+        info.delta = -info.pops;
+        break;
+    }
+
+    case OP_JUMP_IF_NOT_EQUAL_IMM:
+    case OP_JUMP_IF_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_GREATER_IMM:
+    case OP_JUMP_IF_NOT_GREATER_EQUAL_IMM:
+    case OP_JUMP_IF_NOT_LESS_IMM:
+    case OP_JUMP_IF_NOT_LESS_EQUAL_IMM:
+    {
+        if (offset + 4 >= size)
+            return false;
+        int jump = (code[offset + 3] << 8) | code[offset + 4];
+        info.length = 5;
+        info.jumpTarget = offset + 5 + jump;
+        info.pops = 1;
+        info.delta = -1;
+        break;
+    }
+
+    // Loops contados: o compare tem de ser uma das quatro ordens
+    case OP_FOR_PREP:
+    case OP_FOR_LOOP:
+    case OP_FOR_PREP_LONG:
+    case OP_FOR_LOOP_LONG:
+    {
+        bool loop = code[offset] == OP_FOR_LOOP || code[offset] == OP_FOR_LOOP_LONG;
+        bool wide = code[offset] == OP_FOR_PREP_LONG || code[offset] == OP_FOR_LOOP_LONG;
+        info.length = (loop ? 8 : 6) + (wide ? 1 : 0);
+        if (offset + info.length > size)
+            return false;
+        if (code[offset + 3] < OP_GREATER || code[offset + 3] > OP_LESS_EQUAL)
+            return false;
+        const uint8_t *at = code + offset + (loop ? 6 : 4);
+        int jump = wide ? (at[0] << 16) | (at[1] << 8) | at[2] : (at[0] << 8) | at[1];
+        int next = offset + info.length;
+        info.jumpTarget = loop ? next - jump : next + jump;
+        break;
+    }
+
+    // Os destinos estão na tabela (Chunk::switches), não no código
+    case OP_SWITCH:
+        info.length = 3;
+        info.pops = 1; // só espreita o valor
+        info.fallsThrough = false;
+        break;
+
+    case OP_CALL:
+    case OP_CALL_DIRECT:
+        if (offset + 1 >= size)
+            return false;
+        info.length = 2;
+        info.delta = -code[offset + 1];
+        info.pops = code[offset + 1] + 1;
+        break;
+
+    case OP_TAIL_CALL:
+    case OP_TAIL_CALL_DIRECT:
+        if (offset + 1 >= size)
+            return false;
+        info.length = 2;
+        info.delta = -code[offset + 1];
+        info.pops = code[offset + 1] + 1;
+        info.fallsThrough = false;
+        break;
+
+    case OP_CALL_NATIVE:
+        if (offset + 2 >= size)
+            return false;
+        info.length = 3;
+        info.delta = 1 - code[offset + 2];
+        info.pops = code[offset + 2];
+        break;
+
+    case OP_RETURN:
+        info.pops = 1;
+        info.fallsThrough = false;
+        break;
+
+    case OP_RETURN_NIL:
+        info.fallsThrough = false;
+        break;
+
+    default:
+        return false;
+    }
+
+    return offset + info.length <= size;
+}
+
+// ============================================
+// VERIFICAÇÃO
+// ============================================
+
+#define VERIFY_ERROR(...)                         \
+    do                                            \
+    {                                             \
+        snprintf(error, size, __VA_ARGS__);       \
+        return false;                             \
+    } while (0)
+
+bool Verifier::verify(Function *function, const VerifierLimits &limits,
+                      char *error, size_t size)
+{
+    const Chunk &chunk = function->chunk;
+    const uint8_t *code = chunk.code.data();
+    int count = (int)chunk.count();
+
+    if (count == 0)
+        VERIFY_ERROR("empty function");
+
+    // 1. Passagem linear: onde começa cada instrução
+    std::vector<char> isStart(count, 0);
+    for (int offset = 0; offset < count;)
+    {
+        StackInstruction info;
+        if (!Verifier::decode(chunk, offset, info))
+            VERIFY_ERROR("bad instruction %d at %04d", code[offset], offset);
+        isStart[offset] = 1;
+        offset += info.length;
+    }
+
+    // 2. Fluxo: altura da stack à entrada de cada instrução alcançável.
+    // O slot 0 (callee) e os parâmetros já estão na stack.
+    std::vector<int> depth(count, -1);
+    std::vector<int> worklist;
+    std::vector<int> next; // sucessores da instrução atual
+    int maxStack = function->arity + 1;
+
+    depth[0] = maxStack;
+    worklist.push_back(0);
+
+    while (!worklist.empty())
+    {
+        int offset = worklist.back();
+        worklist.pop_back();
+
+        StackInstruction info;
+        Verifier::decode(chunk, offset, info);
+
+        int before = depth[offset];
+        int after = before + info.delta;
+
+        // O slot 0 do frame nunca é consumido
+        if (before - info.pops < 1)
+            VERIFY_ERROR("stack underflow at %04d", offset);
+        if (after > maxStack)
+            maxStack = after;
+
+        // Operandos
+        switch (code[offset])
+        {
+        case OP_CONSTANT:
+        case OP_ADD_CONST:
+        case OP_SUBTRACT_CONST:
+            if (code[offset + 1] >= chunk.constants.size())
+                VERIFY_ERROR("constant %d out of range at %04d", code[offset + 1], offset);
+            break;
+
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_INC_LOCAL:
+        case OP_DEC_LOCAL:
+            if (code[offset + 1] >= before)
+                VERIFY_ERROR("local %d out of range at %04d", code[offset + 1], offset);
+            break;
+
+        case OP_CONSTANT_LONG:
+        {
+            size_t index = (code[offset + 1] << 16) | (code[offset + 2] << 8) | code[offset + 3];
+            if (index >= chunk.constants.size())
+                VERIFY_ERROR("constant %d out of range at %04d", (int)index, offset);
+            break;
+        }
+
+        case OP_GET_LOCAL_LONG:
+        case OP_SET_LOCAL_LONG:
+        {
+            int slot = (code[offset + 1] << 8) | code[offset + 2];
+            if (slot >= before)
+                VERIFY_ERROR("local %d out of range at %04d", slot, offset);
+            break;
+        }
+
+        case OP_ADD_LOCALS:
+        case OP_FOR_PREP:
+        case OP_FOR_LOOP:
+        case OP_FOR_PREP_LONG:
+        case OP_FOR_LOOP_LONG:
+            if (code[offset + 1] >= before || code[offset + 2] >= before)
+                VERIFY_ERROR("local out of range at %04d", offset);
+            break;
+
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        {
+            int slot = (code[offset + 1] << 8) | code[offset + 2];
+            if (slot >= limits.globals)
+                VERIFY_ERROR("global %d out of range at %04d", slot, offset);
+            break;
+        }
+
+        case OP_CALL_NATIVE:
+            if (code[offset + 1] >= limits.natives)
+                VERIFY_ERROR("native %d out of range at %04d", code[offset + 1], offset);
+            break;
+
+        default:
+            break;
+        }
+
+        next.clear();
+        if (info.fallsThrough)
+        {
+            next.push_back(offset + info.length);
+            if (next.back() >= count)
+                VERIFY_ERROR("execution falls off the end at %04d", offset);
+        }
+        // Um OP_LOOP malformado pode dar um destino negativo
+        if (info.jumpTarget >= 0 || code[offset] == OP_LOOP || code[offset] == OP_LOOP_LONG ||
+            code[offset] == OP_FOR_LOOP || code[offset] == OP_FOR_LOOP_LONG)
+        {
+            if (info.jumpTarget < 0 || info.jumpTarget >= count || !isStart[info.jumpTarget])
+                VERIFY_ERROR("bad jump target %d at %04d", info.jumpTarget, offset);
+            next.push_back(info.jumpTarget);
+        }
+        if (code[offset] == OP_SWITCH)
+        {
+            size_t table = (code[offset + 1] << 8) | code[offset + 2];
+            if (table >= chunk.switches.size())
+                VERIFY_ERROR("switch table %d out of range at %04d", (int)table, offset);
+            chunk.switches[table].forEachTarget([&](int target) {
+                next.push_back(target >= 0 && target < count && isStart[target] ? target : -1);
+            });
+        }
+
+        for (size_t i = 0; i < next.size(); i++)
+        {
+            int target = next[i];
+            if (target < 0)
+                VERIFY_ERROR("bad switch target at %04d", offset);
+            if (depth[target] == -1)
+            {
+                depth[target] = after;
+                worklist.push_back(target);
+            }
+            else if (depth[target] != after)
+            {
+                VERIFY_ERROR("stack height mismatch at %04d (%d vs %d)",
+                             target, depth[target], after);
+            }
+        }
+    }
+
+    function->maxStack = maxStack;
+    return true;
+}
+
+#undef VERIFY_ERROR
@@ -1,25 +1,54 @@
 #include "vm.h"
 #include "stringpool.h"
-#include "table.h"
+#include "verifier.h"
 #include "compiler.h"
+#include "jit.h"
+#include "tracer.h"
 #include <cstdio>
 #include <cstdarg>
+#include <cmath>
+#include <cstring>
+
+// Computed goto (labels-as-values) é extensão do GCC/Clang; os outros
+// compiladores usam o switch portável. -DWREN_COMPUTED_GOTO=0 força o switch.
+#ifndef WREN_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define WREN_COMPUTED_GOTO 1
+#else
+#define WREN_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Os dois loops de dispatch (stack e register) ficam entre estes dois: com
+// -Wpedantic cada &&label e goto * dava um aviso
+#if WREN_COMPUTED_GOTO
+#define DISPATCH_LOOP_BEGIN \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wpedantic\"")
+#define DISPATCH_LOOP_END _Pragma("GCC diagnostic pop")
+#else
+#define DISPATCH_LOOP_BEGIN
+#define DISPATCH_LOOP_END
+#endif
 
 CallFrame::CallFrame()
     : function(nullptr), ip(nullptr), slots(nullptr) {}
 
-VM::VM() : stackTop_(stack_), frameCount_(0), hasFatalError_(false)
+VM::VM() : stackLimit_(STACK_MAX), frames_(FRAMES_INITIAL), frameCount_(0),
+           framesLimit_(FRAMES_MAX), hasFatalError_(false),
+           executionMode_(ExecutionMode::Stack), jitEnabled_(Jit::isAvailable()),
+           perfMap_(false), optimize_(false), shareConstants_(false)
 {
+    stack_ = new Value[STACK_INITIAL];
+    stackEnd_ = stack_ + STACK_INITIAL;
+    stackTop_ = stack_;
     natives_.registerBuiltins();
     compiler = new Compiler(this);
-    globals_ = new Table();
 }
 
 VM::~VM()
 {
-
-    delete globals_;
     delete compiler;
+    delete[] stack_;
     StringPool::instance().clear();
     for (Function *func : functions_)
     {
@@ -93,7 +122,7 @@ void VM::resetStack()
     frameCount_ = 0;
 }
 
-void VM::registerNative(const char *name, int arity, NativeFunction fn)
+void VM::registerNative(const char *name, int arity, NativeFunction fn, void *userdata)
 {
     const char *internedName = StringPool::instance().intern(name);
 
@@ -103,28 +132,46 @@ void VM::registerNative(const char *name, int arity, NativeFunction fn)
         return;
     }
 
-    natives_.registerFunction(internedName, arity, fn);
+    if (natives_.registerFunction(internedName, arity, fn, userdata) < 0)
+    {
+        runtimeError("Too many native functions (max %d)", NativeRegistry::MAX_NATIVES);
+    }
 }
 
-bool VM::callNative(const char *name, int argCount)
+// index vem do OP_CALL_NATIVE, resolvido pelo compiler
+bool VM::callNative(int index, int argCount)
 {
-    NativeFn *native = natives_.getFunction(name);
-
-    if (!native)
+    if (index >= natives_.count())
     {
-        runtimeError("Undefined native function '%s'", name);
+        runtimeError("Invalid native function index: %d", index);
         return false;
     }
 
-    if (native->arity != -1 && argCount != native->arity)
+    NativeFn &native = natives_.get(index);
+
+    if (native.arity != -1 && argCount != native.arity)
     {
         runtimeError("%s() expects %d arguments but got %d",
-                     name, native->arity, argCount);
+                     native.name.c_str(), native.arity, argCount);
         return false;
     }
 
-    Value *args = stackTop_ - argCount;
-    Value result = native->function(this, argCount, args);
+    // A native pode fazer Push* ou chamar a VM e a stack mudar de sítio
+    // (growStack): os argumentos vão numa cópia, não em ponteiros para ela
+    Value local[NATIVE_INLINE_ARGS];
+    std::vector<Value> heap;
+    Value *args = local;
+    if (argCount > NATIVE_INLINE_ARGS)
+    {
+        heap.assign(stackTop_ - argCount, stackTop_);
+        args = heap.data();
+    }
+    else
+    {
+        for (int i = 0; i < argCount; i++)
+            local[i] = stackTop_[i - argCount];
+    }
+    Value result = native.function(this, argCount, args, native.userdata);
 
     stackTop_ -= argCount;
     push(result);
@@ -132,6 +179,117 @@ bool VM::callNative(const char *name, int argCount)
     return true;
 }
 
+// Funções vindas do compiler já trazem maxStack; as montadas à mão são
+// verificadas na primeira call
+bool VM::verifyFunction(Function *function, char *error, size_t size)
+{
+    VerifierLimits limits;
+    limits.globals = (int)globals_.size();
+    limits.natives = natives_.count();
+    return Verifier::verify(function, limits, error, size);
+}
+
+// Uma verificação por call: dentro do frame o verifier garante que a
+// stack não passa de maxStack, por isso o loop faz push/pop sem testes
+inline bool VM::checkStack(Function *function, Value *&slots)
+{
+    if (function->maxStack < 0)
+    {
+        char error[128];
+        if (!verifyFunction(function, error, sizeof(error)))
+        {
+            runtimeError("Invalid bytecode in '%s': %s", function->name.c_str(), error);
+            return false;
+        }
+    }
+    if (!reserveStack(slots, function->maxStack))
+    {
+        runtimeError("Stack overflow");
+        return false;
+    }
+    return true;
+}
+
+// ============================================
+// CRESCIMENTO DA STACK E DOS FRAMES
+// ============================================
+// A stack é realocada quando uma call não cabe; os frames guardam
+// ponteiros para ela, por isso growStack corrige-os (e o stackTop_).
+// Quem tem ponteiros em locais (loops de execução) recarrega-os depois
+// de qualquer call.
+
+void VM::setStackLimits(int maxValues, int maxFrames)
+{
+    // Abaixo da capacidade atual só impede que cresça mais
+    stackLimit_ = maxValues;
+    framesLimit_ = maxFrames;
+}
+
+// Garante [base, base + count) dentro da stack; se ela mudar de sítio
+// base passa a apontar para a mesma posição na nova
+inline bool VM::reserveStack(Value *&base, int count)
+{
+    if (base + count <= stackEnd_)
+    {
+        return true;
+    }
+    int offset = (int)(base - stack_);
+    if (!growStack(offset + count))
+    {
+        return false;
+    }
+    base = stack_ + offset;
+    return true;
+}
+
+bool VM::growStack(int needed)
+{
+    int capacity = (int)(stackEnd_ - stack_);
+    if (needed > stackLimit_)
+    {
+        return false;
+    }
+
+    int newCapacity = capacity * 2;
+    if (newCapacity < needed)
+        newCapacity = needed;
+    if (newCapacity > stackLimit_)
+        newCapacity = stackLimit_;
+
+    // Copia a capacidade toda: no modo register há registos vivos acima
+    // do stackTop_
+    Value *newStack = new Value[newCapacity];
+    for (int i = 0; i < capacity; i++)
+    {
+        newStack[i] = stack_[i];
+    }
+
+    for (int i = 0; i < frameCount_; i++)
+    {
+        frames_[i].slots = newStack + (frames_[i].slots - stack_);
+    }
+    stackTop_ = newStack + (stackTop_ - stack_);
+
+    delete[] stack_;
+    stack_ = newStack;
+    stackEnd_ = newStack + newCapacity;
+    return true;
+}
+
+bool VM::growFrames()
+{
+    int capacity = (int)frames_.size();
+    if (capacity >= framesLimit_)
+    {
+        return false;
+    }
+    int newCapacity = capacity * 2;
+    if (newCapacity > framesLimit_)
+        newCapacity = framesLimit_;
+    frames_.resize(newCapacity);
+    return true;
+}
+
 bool VM::callFunction(Function *function, int argCount)
 {
     // Verifica arity
@@ -143,30 +301,101 @@ bool VM::callFunction(Function *function, int argCount)
     }
 
     // Verifica overflow de frames
-    if (frameCount_ >= FRAMES_MAX)
+    if (frameCount_ >= (int)frames_.size() && !growFrames())
     {
         runtimeError("Stack overflow - too many nested calls");
         return false;
     }
 
+    Value *slots = stackTop_ - argCount - 1; // slot 0 = callee, args a seguir
+    if (!checkStack(function, slots))
+    {
+        return false;
+    }
+
     // Cria novo frame
     CallFrame *frame = &frames_[frameCount_++];
     frame->function = function;
     frame->ip = function->chunk.code.data();
-    frame->slots = stackTop_ - argCount; // args já estão na stack
+    frame->slots = slots;
+
+    if (jitEnabled_ && !function->jit && ++function->hotness == Jit::HOT_THRESHOLD)
+    {
+        compileHot(function);
+    }
 
     return true;
 }
 
+// Se o JIT não conseguir (plataforma, memória) a função fica interpretada;
+// o contador já passou o limiar e não volta a disparar
+void VM::compileHot(Function *function)
+{
+    function->jit = Jit::compile(function, perfMap_);
+}
+
+// ============================================
+// CALLS DIRETAS
+// ============================================
+// O compiler só emite OP_CALL_DIRECT para defs globais já registados,
+// com a função como constante no slot do callee. Enquanto o global não
+// for reatribuído (Function::rebound) basta indexar functions_.
+
+inline Function *VM::directCallee(Value *callee)
+{
+    Function *function = functions_[callee->asFunctionIdx()];
+    if (!function->rebound)
+        return function;
+    return reboundCallee(callee);
+}
+
+// Guard falhou: relê o global como o OP_GET_GLOBAL faria e segue pela
+// call genérica. Devolve nullptr (com erro) se já não for uma função.
+Function *VM::reboundCallee(Value *callee)
+{
+    Function *function = functions_[callee->asFunctionIdx()];
+    const char *name = StringPool::instance().intern(function->name);
+    Value *value = getGlobalPtr(name);
+    if (value == nullptr)
+    {
+        runtimeError("Undefined variable '%s'", name);
+        return nullptr;
+    }
+    if (!value->isFunction())
+    {
+        runtimeError("Attempt to call a non-function value (type: %s)",
+                     TypeName(value->getType()));
+        return nullptr;
+    }
+    *callee = *value;
+    return getFunction(value->asFunctionIdx());
+}
+
+// Escrita num global existente: se lá estava uma função, as calls
+// diretas para ela passam a verificar o global
+inline void VM::storeGlobal(Value *slot, const Value &value)
+{
+    if (slot->isFunction() && (size_t)slot->asFunctionIdx() < functions_.size())
+        functions_[slot->asFunctionIdx()]->rebound = true;
+    *slot = value;
+}
+
 InterpretResult VM::interpret(Function *function)
 {
 
-    // push(Value::makeNull());
+    // Slot 0 do script: não há callee, fica um placeholder
+    stackTop_ = stack_;
+    push(Value::makeNull());
+    Value *slots = stack_;
+    if (!checkStack(function, slots))
+    {
+        return InterpretResult::RUNTIME_ERROR;
+    }
 
     CallFrame *frame = &frames_[frameCount_++];
     frame->function = function;
     frame->ip = function->chunk.code.data();
-    frame->slots = stack_;
+    frame->slots = slots;
 
     return run() ? InterpretResult::OK : InterpretResult::RUNTIME_ERROR;
 }
@@ -178,12 +407,19 @@ InterpretResult VM::interpret(const std::string &source)
     {
         return InterpretResult::COMPILE_ERROR;
     }
-    // push(Value::makeNull());
+    stackTop_ = stack_;
+    push(Value::makeNull());
+    Value *slots = stack_;
+    if (!checkStack(function, slots))
+    {
+        delete function;
+        return InterpretResult::RUNTIME_ERROR;
+    }
 
     CallFrame *frame = &frames_[frameCount_++];
     frame->function = function;
     frame->ip = function->chunk.code.data();
-    frame->slots = stack_;
+    frame->slots = slots;
 
     bool status = run();
     if (!status)
@@ -205,12 +441,19 @@ InterpretResult VM::interpretExpression(const std::string &source)
     {
         return InterpretResult::COMPILE_ERROR;
     }
+    stackTop_ = stack_;
     push(Value::makeNull());
+    Value *slots = stack_;
+    if (!checkStack(function, slots))
+    {
+        delete function;
+        return InterpretResult::RUNTIME_ERROR;
+    }
 
     CallFrame *frame = &frames_[frameCount_++];
     frame->function = function;
     frame->ip = function->chunk.code.data();
-    frame->slots = stack_;
+    frame->slots = slots;
 
     bool status = run();
     if (!status)
@@ -227,7 +470,7 @@ InterpretResult VM::interpretExpression(const std::string &source)
 
 bool VM::isTruthy(const Value &value)
 {
-    switch (value.type)
+    switch (value.getType())
     {
     case VAL_NULL:
         return false;
@@ -244,7 +487,7 @@ bool VM::isTruthy(const Value &value)
 
 void VM::push(Value value)
 {
-    if (stackTop_ >= stack_ + STACK_MAX)
+    if (stackTop_ >= stackEnd_ && !growStack((int)(stackTop_ - stack_) + 1))
     {
         runtimeError("Stack overflow");
         return;
@@ -283,7 +526,6 @@ const Value &VM::peek(int distance)
 
 void VM::runtimeError(const char *format, ...)
 {
-    hasFatalError_ = true;
     fprintf(stderr, "Runtime Error: ");
 
     va_list args;
@@ -293,14 +535,33 @@ void VM::runtimeError(const char *format, ...)
 
     fputs("\n", stderr);
 
+    // Com recursão funda o trace fica só com as pontas
+    const int TRACE_EDGE = 10;
     for (int i = frameCount_ - 1; i >= 0; i--)
     {
+        if (i == frameCount_ - 1 - TRACE_EDGE && i >= TRACE_EDGE)
+        {
+            fprintf(stderr, "... (%d more frames)\n", i - TRACE_EDGE + 1);
+            i = TRACE_EDGE - 1;
+        }
+
         CallFrame *frame = &frames_[i];
         Function *function = frame->function;
 
-        size_t instruction = frame->ip - function->chunk.code.data() - 1;
+        // O ip pode apontar para o bytecode de stack ou para o register
+        const std::vector<uint8_t> &regCode = function->regCode;
+        int line;
+        if (!regCode.empty() && frame->ip > regCode.data() &&
+            frame->ip <= regCode.data() + regCode.size())
+        {
+            line = function->regLines.lineAt(frame->ip - regCode.data() - 1);
+        }
+        else
+        {
+            line = function->chunk.lines.lineAt(frame->ip - function->chunk.code.data() - 1);
+        }
 
-        fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
+        fprintf(stderr, "[line %d] in ", line);
 
         if (function->name.empty())
         {
@@ -313,6 +574,7 @@ void VM::runtimeError(const char *format, ...)
     }
 
     resetStack();
+    hasFatalError_ = true;
 }
 
 // ============================================
@@ -434,7 +696,7 @@ int VM::GetTop()
 
 void VM::SetTop(int index)
 {
-    if (index < 0 || index > STACK_MAX)
+    if (index < 0 || (stack_ + index > stackEnd_ && !growStack(index)))
     {
         runtimeError("Invalid stack index");
         return;
@@ -550,67 +812,102 @@ void VM::Copy(int from, int to)
 // Type checking
 ValueType VM::GetType(int index)
 {
-    return Peek(index).type;
+    return Peek(index).getType();
 }
 
 bool VM::IsInt(int index)
 {
-    return Peek(index).type == VAL_INT;
+    return Peek(index).isInt();
 }
 
 bool VM::IsDouble(int index)
 {
-    return Peek(index).type == VAL_DOUBLE;
+    return Peek(index).isDouble();
 }
 
 bool VM::IsString(int index)
 {
-    return Peek(index).type == VAL_STRING;
+    return Peek(index).isString();
 }
 
 bool VM::IsBool(int index)
 {
-    return Peek(index).type == VAL_BOOL;
+    return Peek(index).isBool();
 }
 
 bool VM::IsNull(int index)
 {
-    return Peek(index).type == VAL_NULL;
+    return Peek(index).isNull();
 }
 
 bool VM::IsFunction(int index)
 {
-    return Peek(index).type == VAL_FUNCTION;
+    return Peek(index).isFunction();
 }
 
 // Globals
+// Slot do global com este nome (interned), criado se ainda não existe.
+// Usado pelo compiler e pela API; os opcodes só veem o índice.
+int VM::globalSlot(const char *name)
+{
+    auto it = globalNames_.find(name);
+    if (it != globalNames_.end())
+    {
+        return it->second;
+    }
+
+    if (globals_.size() >= MAX_GLOBALS)
+    {
+        return -1;
+    }
+
+    GlobalSlot global;
+    global.value = Value::makeNull();
+    global.name = name;
+    global.defined = false;
+    globals_.push_back(global);
+
+    uint16_t slot = (uint16_t)(globals_.size() - 1);
+    globalNames_.emplace(name, slot);
+    return slot;
+}
+
+// nullptr se o global não existe ou ainda não foi definido
+Value *VM::getGlobalPtr(const char *name)
+{
+    auto it = globalNames_.find(name);
+    if (it == globalNames_.end() || !globals_[it->second].defined)
+    {
+        return nullptr;
+    }
+    return &globals_[it->second].value;
+}
+
 void VM::SetGlobal(const char *name)
 {
-    // if (!globals_->contains(name))
-    // {
-    //     runtimeError("Global '%s' already exists", name);
-    //     return;
-    // }
+    const char *interned = StringPool::instance().intern(name);
     Value value = Pop();
-    if (!globals_->define(name, value))
+
+    int slot = globalSlot(interned);
+    if (slot < 0)
+    {
+        runtimeError("Too many globals (max %d)", (int)MAX_GLOBALS);
+        return;
+    }
+    if (globals_[slot].defined)
     {
-        runtimeError("Global '%s' already exists", name);
+        runtimeError("Global '%s' already exists", interned);
+        return;
     }
+    globals_[slot].value = value;
+    globals_[slot].defined = true;
 }
 
 void VM::GetGlobal(const char *name)
 {
     const char *interned = StringPool::instance().intern(name);
 
-    // if (!globals_->contains(interned))
-    // {
-    //     runtimeError("Undefined global '%s'", interned);
-    //     PushNull();
-    //     return;
-    // }
-    // Push(globals_->get(interned));
-
-    Value *value = globals_->get_ptr(interned);
+    Value *value = getGlobalPtr(interned);
 
     if (value)
     {
@@ -635,7 +932,7 @@ void VM::Call(int argCount, int resultCount)
     if (!funcVal.isFunction())
     {
         runtimeError("Attempt to call a non-function value (type: %s)",
-                     TypeName(funcVal.type));
+                     TypeName(funcVal.getType()));
         return;
     }
 
@@ -648,32 +945,22 @@ void VM::Call(int argCount, int resultCount)
         return;
     }
 
-    // 2. Remove função da stack (shift args para baixo)
-    // Antes: [func] [arg1] [arg2]
-    // Depois: [arg1] [arg2]
-    Value *funcSlot = stackTop_ - argCount - 1;
-    for (Value *p = funcSlot; p < stackTop_ - 1; p++)
-    {
-        *p = *(p + 1);
-    }
-    stackTop_--;
-
-    // 3. Guarda frameCount antes da call
+    // 2. Guarda frameCount antes da call
     int beforeCall = frameCount_;
 
-    // 4. Cria frame (usa callFunction interno)
+    // 3. Cria frame: a função fica no slot 0, args não se movem
     if (!callFunction(func, argCount))
     {
         return; // Erro (arity mismatch, stack overflow, etc)
     }
 
-    // 5. Executa até esta função retornar
+    // 4. Executa até esta função retornar
     if (!executeUntilReturn(beforeCall))
     {
         return; // Erro de runtime
     }
 
-    // 6. Resultado está no topo
+    // 5. Resultado ficou no lugar da função
     if (resultCount == 0)
     {
         Pop();
@@ -696,7 +983,7 @@ void VM::DumpStack()
         Value v = Peek(i);
         printf("  [%2d] ", i);
 
-        switch (v.type)
+        switch (v.getType())
         {
         case VAL_NULL:
             printf("null\n");
@@ -724,6 +1011,15 @@ void VM::DumpStack()
 
 void VM::DumpGlobals()
 {
+    printf("=== Globals ===\n");
+    for (const GlobalSlot &global : globals_)
+    {
+        if (!global.defined)
+            continue;
+        printf("  %s = ", global.name);
+        printValue(global.value);
+        printf("\n");
+    }
 }
 
 const char *VM::TypeName(ValueType type)
@@ -758,647 +1054,2221 @@ bool VM::isNativeFunction(const char *name) const
 bool VM::run()
 {
     CallFrame *frame = &frames_[frameCount_ - 1];
-
-    while (frameCount_ > 0)
+    if (executionMode_ == ExecutionMode::Register && frame->function->hasRegisterCode())
     {
-        if (!executeInstruction(frame))
-        {
-            return false; // Erro fatal
-        }
+        frame->ip = frame->function->regCode.data();
+        return executeRegister(0);
     }
-
-    return true;
+    return executeUntilReturn(0);
 }
 
 // ============================================
-// EXECUTE UNTIL RETURN: Para API pública (Call)
+// HELPERS DAS SUPERINSTRUCTIONS
 // ============================================
-bool VM::executeUntilReturn(int targetFrameCount)
-{
-    while (frameCount_ > targetFrameCount)
-    {
-        CallFrame *frame = &frames_[frameCount_ - 1];
-
-        if (!executeInstruction(frame))
-        {
-            return false; // Erro fatal
-        }
-    }
+// Mesma semântica que OP_ADD / OP_SUBTRACT / OP_EQUAL genéricos,
+// partilhada pelos handlers fundidos. Devolvem false em erro de tipo.
 
+static inline bool addValues(const Value &a, const Value &b, Value &result)
+{
+    if (a.isInt() && b.isInt())
+        result = Value::makeInt(a.asInt() + b.asInt());
+    else if (a.isDouble() && b.isDouble())
+        result = Value::makeDouble(a.asDouble() + b.asDouble());
+    else if (a.isInt() && b.isDouble())
+        result = Value::makeDouble(a.asInt() + b.asDouble());
+    else if (a.isDouble() && b.isInt())
+        result = Value::makeDouble(a.asDouble() + b.asInt());
+    else if (a.isString() && b.isString())
+        result = Value::makeString(StringPool::instance().concat(a.asString(), b.asString()));
+    else
+        return false;
     return true;
 }
 
-// ============================================
-// CORE: Executa UMA instrução
-// ============================================
-bool VM::executeInstruction(CallFrame *&frame)
+static inline bool subtractValues(const Value &a, const Value &b, Value &result)
 {
-    if (hasFatalError_)
+    if (a.isInt() && b.isInt())
+        result = Value::makeInt(a.asInt() - b.asInt());
+    else if (a.isDouble() && b.isDouble())
+        result = Value::makeDouble(a.asDouble() - b.asDouble());
+    else if (a.isInt() && b.isDouble())
+        result = Value::makeDouble(a.asInt() - b.asDouble());
+    else if (a.isDouble() && b.isInt())
+        result = Value::makeDouble(a.asDouble() - b.asInt());
+    else
         return false;
+    return true;
+}
 
-#define READ_BYTE() (*frame->ip++)
-#define READ_SHORT() (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
-#define READ_CONSTANT() (frame->function->chunk.constants[READ_BYTE()])
-#define READ_STRING_PTR() (frame->function->chunk.getStringPtr(READ_BYTE()))
-
-    uint8_t instruction = READ_BYTE();
+static inline bool valuesEqual(const Value &a, const Value &b)
+{
+    if (a.getType() != b.getType())
+        return false;
+    if (a.isInt())
+        return a.asInt() == b.asInt();
+    if (a.isBool())
+        return a.asBool() == b.asBool();
+    if (a.isNull())
+        return true;
+    if (a.isString())
+        return a.asString() == b.asString();
+    if (a.isDouble())
+        return a.asDouble() == b.asDouble();
+    return false;
+}
 
-    switch (instruction)
+// Compare do OP_FOR_PREP/OP_FOR_LOOP (op é OP_GREATER..OP_LESS_EQUAL).
+// Int com double compara em double, que representa qualquer int32.
+static inline bool compareValues(uint8_t op, const Value &a, const Value &b, bool &result)
+{
+    double x, y;
+    if (a.isInt() && b.isInt())
     {
-    case OP_CONSTANT:
+        x = a.asInt();
+        y = b.asInt();
+    }
+    else if ((a.isInt() || a.isDouble()) && (b.isInt() || b.isDouble()))
     {
-        Value constant = READ_CONSTANT();
-        push(constant);
-        break;
+        x = a.isInt() ? (double)a.asInt() : a.asDouble();
+        y = b.isInt() ? (double)b.asInt() : b.asDouble();
     }
+    else
+        return false;
 
-    case OP_NIL:
-        push(Value::makeNull());
-        break;
-
-    case OP_TRUE:
-        push(Value::makeBool(true));
+    switch (op)
+    {
+    case OP_GREATER:
+        result = x > y;
         break;
-
-    case OP_FALSE:
-        push(Value::makeBool(false));
+    case OP_GREATER_EQUAL:
+        result = x >= y;
         break;
-
-    case OP_POP:
-        pop();
+    case OP_LESS:
+        result = x < y;
         break;
-    case OP_NOT:
-    {
-        Value v = pop();
-        push(Value::makeBool(!isTruthy(v)));
+    default:
+        result = x <= y;
         break;
     }
-    case OP_ADD:
+    return true;
+}
+
+// ============================================
+// HELPERS DOS INTRINSICS
+// ============================================
+// Mesma semântica que as natives de native.cpp (incluindo devolver nil
+// com aviso em stderr), usados por OP_SQRT/... e pelas versões register.
+
+static inline Value sqrtValue(const Value &a)
+{
+    if (a.isDouble())
+        return Value::makeDouble(std::sqrt(a.asDouble()));
+    if (a.isInt())
+        return Value::makeDouble(std::sqrt(a.asInt()));
+    fprintf(stderr, "sqrt() expects a number\n");
+    return Value::makeNull();
+}
+
+static inline Value absValue(const Value &a)
+{
+    if (a.isInt())
+        return Value::makeInt(std::abs(a.asInt()));
+    if (a.isDouble())
+        return Value::makeDouble(std::fabs(a.asDouble()));
+    fprintf(stderr, "abs() expects a number\n");
+    return Value::makeNull();
+}
+
+static inline Value powValues(const Value &a, const Value &b)
+{
+    if ((a.isInt() || a.isDouble()) && (b.isInt() || b.isDouble()))
     {
-        Value b = pop();
-        Value a = pop();
+        double base = a.isInt() ? a.asInt() : a.asDouble();
+        double exp = b.isInt() ? b.asInt() : b.asDouble();
+        return Value::makeDouble(std::pow(base, exp));
+    }
+    fprintf(stderr, "pow() expects numbers\n");
+    return Value::makeNull();
+}
 
-        // String concatenation
-        if (a.isString() && b.isString())
-        {
-            const char *result = StringPool::instance().concat(a.asString(), b.asString());
-            push(Value::makeString(result));
+static inline Value lenValue(const Value &a)
+{
+    if (a.isString())
+        return Value::makeInt((int)strlen(a.asString()));
+    fprintf(stderr, "len() expects a string\n");
+    return Value::makeNull();
+}
+
+static inline Value strValue(const Value &a)
+{
+    std::string result = valueToString(a);
+    return Value::makeString(result.c_str());
+}
+
+// ============================================
+// EXECUTE UNTIL RETURN: Dispatch loop
+// ============================================
+// Corre até frameCount_ voltar a targetFrameCount (0 = script inteiro,
+// usado pelo Call() da API com o frameCount de antes da chamada).
+// ip, slots e o topo da stack vivem em locais; só são escritos de volta
+// (STORE_FRAME) antes de código que os lê: calls, natives e erros.
+DISPATCH_LOOP_BEGIN
+bool VM::executeUntilReturn(int targetFrameCount)
+{
+    hasFatalError_ = false;
+
+    CallFrame *frame;
+    uint8_t *ip;
+    Value *slots;
+    const Value *constants;
+    Value *sp = stackTop_;
+    uint8_t instruction;
+
+#define STORE_FRAME()      \
+    do                     \
+    {                      \
+        frame->ip = ip;    \
+        stackTop_ = sp;    \
+    } while (0)
+
+#define LOAD_FRAME()                                         \
+    do                                                       \
+    {                                                        \
+        frame = &frames_[frameCount_ - 1];                   \
+        ip = frame->ip;                                      \
+        slots = frame->slots;                                \
+        constants = frame->function->chunk.constants.data(); \
+    } while (0)
+
+#define RUNTIME_ERROR(...)             \
+    do                                 \
+    {                                  \
+        STORE_FRAME();                 \
+        runtimeError(__VA_ARGS__);     \
+        return false;                  \
+    } while (0)
+
+#if WREN_JIT_ENABLED
+    // Corre o código nativo do frame a partir do ip atual; volta com o ip
+    // da primeira instrução que o JIT deixa ao interpretador. Os pontos de
+    // entrada são o início do frame, o fim de calls e os back-edges.
+#define JIT_ENTER()                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (frame->function->jit && jitEnabled_)                                 \
+            ip = Jit::run(frame->function->jit, ip, slots, sp, globals_.data()); \
+    } while (0)
+
+    // Tail calls e back-edges não passam pelo callFunction: contam aqui
+#define JIT_COUNT(function)                                                      \
+    do                                                                           \
+    {                                                                            \
+        if (jitEnabled_ && !(function)->jit &&                                   \
+            ++(function)->hotness == Jit::HOT_THRESHOLD)                         \
+            compileHot(function);                                                \
+    } while (0)
+
+    // Cabeça de loop: corre o trace se existe, senão conta e, a zero,
+    // grava uma iteração (que o recorder executa ele próprio)
+#define JIT_TRACE()                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (jitEnabled_)                                                         \
+            ip = Tracer::onLoop(this, frame->function, ip, slots, sp);           \
+    } while (0)
+#else
+#define JIT_ENTER() ((void)0)
+#define JIT_COUNT(function) ((void)0)
+#define JIT_TRACE() ((void)0)
+#endif
+
+    // Sem testes de limites: o verifier calculou maxStack e a call que
+    // criou o frame já confirmou que cabe (checkStack)
+#define PUSH(value) (*sp++ = (value))
+#define POP_INTO(dest) (dest = *--sp)
+
+#define PEEK() (sp[-1])
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_LONG() (ip += 3, (uint32_t)((ip[-3] << 16) | (ip[-2] << 8) | ip[-1]))
+#define READ_IMMEDIATE() ((int16_t)READ_SHORT())
+#define READ_CONSTANT() (constants[READ_BYTE()])
+#define READ_STRING_PTR() (frame->function->chunk.getStringPtr(READ_BYTE()))
+
+    // Quickening: reescreve o opcode que acabou de ser lido (sem operandos)
+#define QUICKEN(opcode) (ip[-1] = (opcode))
+
+    // Reutiliza o frame: callee e args descem para slots[0..]. O callee é
+    // relido do stackTop_ porque o checkStack pode mudar a stack de sítio.
+#define TAIL_CALL(function, callee, argCount)                                   \
+    do                                                                          \
+    {                                                                           \
+        if ((argCount) != (function)->arity)                                    \
+            RUNTIME_ERROR("Function '%s' expects %d arguments but got %d",      \
+                          (function)->name.c_str(), (function)->arity, argCount); \
+        if (!checkStack((function), slots))                                     \
+            return false;                                                       \
+        (callee) = stackTop_ - (argCount) - 1;                                  \
+        for (int i = 0; i <= (argCount); i++)                                   \
+            slots[i] = (callee)[i];                                             \
+        sp = slots + (argCount) + 1;                                            \
+        frame->function = (function);                                           \
+        ip = (function)->chunk.code.data();                                     \
+        constants = (function)->chunk.constants.data();                         \
+        JIT_COUNT(function);                                                    \
+        JIT_ENTER();                                                            \
+        DISPATCH();                                                             \
+    } while (0)
+
+    // Operações binárias numéricas: int op int = int, resto promove a double.
+    // Com os dois operandos do mesmo tipo, especializa a instrução.
+#define BINARY_NUMBER_OP(op, intOp, doubleOp)                                \
+    do                                                                       \
+    {                                                                        \
+        Value b, a;                                                          \
+        POP_INTO(b);                                                         \
+        POP_INTO(a);                                                         \
+        if (a.isInt() && b.isInt())                                          \
+        {                                                                    \
+            QUICKEN(intOp);                                                  \
+            PUSH(Value::makeInt(a.asInt() op b.asInt()));                    \
+        }                                                                    \
+        else if (a.isDouble() && b.isDouble())                               \
+        {                                                                    \
+            QUICKEN(doubleOp);                                               \
+            PUSH(Value::makeDouble(a.asDouble() op b.asDouble()));           \
+        }                                                                    \
+        else if (a.isInt() && b.isDouble())                                  \
+            PUSH(Value::makeDouble(a.asInt() op b.asDouble()));              \
+        else if (a.isDouble() && b.isInt())                                  \
+            PUSH(Value::makeDouble(a.asDouble() op b.asInt()));              \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+    } while (0)
+
+#define BINARY_COMPARE_OP(op, intOp, doubleOp)                               \
+    do                                                                       \
+    {                                                                        \
+        Value b, a;                                                          \
+        POP_INTO(b);                                                         \
+        POP_INTO(a);                                                         \
+        if (a.isInt() && b.isInt())                                          \
+        {                                                                    \
+            QUICKEN(intOp);                                                  \
+            PUSH(Value::makeBool(a.asInt() op b.asInt()));                   \
+        }                                                                    \
+        else if (a.isDouble() && b.isDouble())                               \
+        {                                                                    \
+            QUICKEN(doubleOp);                                               \
+            PUSH(Value::makeBool(a.asDouble() op b.asDouble()));             \
+        }                                                                    \
+        else if (a.isInt() && b.isDouble())                                  \
+            PUSH(Value::makeBool(a.asInt() op b.asDouble()));                \
+        else if (a.isDouble() && b.isInt())                                  \
+            PUSH(Value::makeBool(a.asDouble() op b.asInt()));                \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+    } while (0)
+
+    // Handlers especializados: os operandos já estão na stack (o genérico
+    // correu neste site), só falta o guard de tipo. Se falhar, reescreve
+    // para a forma genérica e re-despacha a mesma instrução.
+#define QUICK_BINARY_OP(check, as, make, op, generic)                        \
+    do                                                                       \
+    {                                                                        \
+        Value &a = sp[-2];                                                   \
+        const Value &b = sp[-1];                                             \
+        if (a.check() && b.check())                                          \
+        {                                                                    \
+            a = Value::make(a.as() op b.as());                               \
+            sp--;                                                            \
+            DISPATCH();                                                      \
+        }                                                                    \
+        *--ip = (generic);                                                   \
+        DISPATCH();                                                          \
+    } while (0)
+
+    // Condição de if/while/for: compara, tira a e b e salta se for falsa
+#define COMPARE_BRANCH_OP(op)                                                \
+    do                                                                       \
+    {                                                                        \
+        uint16_t offset = READ_SHORT();                                      \
+        const Value &a = sp[-2];                                             \
+        const Value &b = sp[-1];                                             \
+        bool result;                                                         \
+        if (a.isInt() && b.isInt())                                          \
+            result = a.asInt() op b.asInt();                                 \
+        else if ((a.isInt() || a.isDouble()) && (b.isInt() || b.isDouble())) \
+            result = (a.isInt() ? (double)a.asInt() : a.asDouble())          \
+                op (b.isInt() ? (double)b.asInt() : b.asDouble());           \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+        sp -= 2;                                                             \
+        if (!result)                                                         \
+            ip += offset;                                                    \
+    } while (0)
+
+#define COMPARE_IMM_BRANCH_OP(op)                                            \
+    do                                                                       \
+    {                                                                        \
+        int32_t k = READ_IMMEDIATE();                                        \
+        uint16_t offset = READ_SHORT();                                      \
+        const Value &a = sp[-1];                                             \
+        bool result;                                                         \
+        if (a.isInt())                                                       \
+            result = a.asInt() op k;                                         \
+        else if (a.isDouble())                                               \
+            result = a.asDouble() op (double)k;                              \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+        sp--;                                                                \
+        if (!result)                                                         \
+            ip += offset;                                                    \
+    } while (0)
+
+#if WREN_COMPUTED_GOTO
+
+    // Tabela de labels: cada handler salta directamente para o seguinte
+    static void *dispatchTable[256] = {nullptr};
+
+    if (dispatchTable[0] == nullptr)
+    {
+        for (int i = 0; i < 256; i++)
+            dispatchTable[i] = &&L_UNKNOWN;
+
+        dispatchTable[OP_CONSTANT] = &&L_OP_CONSTANT;
+        dispatchTable[OP_NIL] = &&L_OP_NIL;
+        dispatchTable[OP_TRUE] = &&L_OP_TRUE;
+        dispatchTable[OP_FALSE] = &&L_OP_FALSE;
+        dispatchTable[OP_POP] = &&L_OP_POP;
+        dispatchTable[OP_NOT] = &&L_OP_NOT;
+        dispatchTable[OP_ADD] = &&L_OP_ADD;
+        dispatchTable[OP_SUBTRACT] = &&L_OP_SUBTRACT;
+        dispatchTable[OP_MULTIPLY] = &&L_OP_MULTIPLY;
+        dispatchTable[OP_DIVIDE] = &&L_OP_DIVIDE;
+        dispatchTable[OP_NEGATE] = &&L_OP_NEGATE;
+        dispatchTable[OP_MODULO] = &&L_OP_MODULO;
+        dispatchTable[OP_EQUAL] = &&L_OP_EQUAL;
+        dispatchTable[OP_NOT_EQUAL] = &&L_OP_NOT_EQUAL;
+        dispatchTable[OP_GREATER] = &&L_OP_GREATER;
+        dispatchTable[OP_GREATER_EQUAL] = &&L_OP_GREATER_EQUAL;
+        dispatchTable[OP_LESS] = &&L_OP_LESS;
+        dispatchTable[OP_LESS_EQUAL] = &&L_OP_LESS_EQUAL;
+        dispatchTable[OP_GET_LOCAL] = &&L_OP_GET_LOCAL;
+        dispatchTable[OP_SET_LOCAL] = &&L_OP_SET_LOCAL;
+        dispatchTable[OP_GET_GLOBAL] = &&L_OP_GET_GLOBAL;
+        dispatchTable[OP_SET_GLOBAL] = &&L_OP_SET_GLOBAL;
+        dispatchTable[OP_DEFINE_GLOBAL] = &&L_OP_DEFINE_GLOBAL;
+        dispatchTable[OP_JUMP] = &&L_OP_JUMP;
+        dispatchTable[OP_JUMP_IF_FALSE] = &&L_OP_JUMP_IF_FALSE;
+        dispatchTable[OP_JUMP_IF_TRUE] = &&L_OP_JUMP_IF_TRUE;
+        dispatchTable[OP_LOOP] = &&L_OP_LOOP;
+        dispatchTable[OP_CALL] = &&L_OP_CALL;
+        dispatchTable[OP_TAIL_CALL] = &&L_OP_TAIL_CALL;
+        dispatchTable[OP_SQRT] = &&L_OP_SQRT;
+        dispatchTable[OP_ABS] = &&L_OP_ABS;
+        dispatchTable[OP_POW] = &&L_OP_POW;
+        dispatchTable[OP_LEN] = &&L_OP_LEN;
+        dispatchTable[OP_STR] = &&L_OP_STR;
+        dispatchTable[OP_CALL_DIRECT] = &&L_OP_CALL_DIRECT;
+        dispatchTable[OP_TAIL_CALL_DIRECT] = &&L_OP_TAIL_CALL_DIRECT;
+        dispatchTable[OP_CALL_NATIVE] = &&L_OP_CALL_NATIVE;
+        dispatchTable[OP_RETURN] = &&L_OP_RETURN;
+        dispatchTable[OP_RETURN_NIL] = &&L_OP_RETURN_NIL;
+        dispatchTable[OP_PRINT] = &&L_OP_PRINT;
+        dispatchTable[OP_ADD_INT] = &&L_OP_ADD_INT;
+        dispatchTable[OP_ADD_DOUBLE] = &&L_OP_ADD_DOUBLE;
+        dispatchTable[OP_ADD_STRING] = &&L_OP_ADD_STRING;
+        dispatchTable[OP_SUBTRACT_INT] = &&L_OP_SUBTRACT_INT;
+        dispatchTable[OP_SUBTRACT_DOUBLE] = &&L_OP_SUBTRACT_DOUBLE;
+        dispatchTable[OP_MULTIPLY_INT] = &&L_OP_MULTIPLY_INT;
+        dispatchTable[OP_MULTIPLY_DOUBLE] = &&L_OP_MULTIPLY_DOUBLE;
+        dispatchTable[OP_EQUAL_INT] = &&L_OP_EQUAL_INT;
+        dispatchTable[OP_NOT_EQUAL_INT] = &&L_OP_NOT_EQUAL_INT;
+        dispatchTable[OP_GREATER_INT] = &&L_OP_GREATER_INT;
+        dispatchTable[OP_GREATER_DOUBLE] = &&L_OP_GREATER_DOUBLE;
+        dispatchTable[OP_GREATER_EQUAL_INT] = &&L_OP_GREATER_EQUAL_INT;
+        dispatchTable[OP_GREATER_EQUAL_DOUBLE] = &&L_OP_GREATER_EQUAL_DOUBLE;
+        dispatchTable[OP_LESS_INT] = &&L_OP_LESS_INT;
+        dispatchTable[OP_LESS_DOUBLE] = &&L_OP_LESS_DOUBLE;
+        dispatchTable[OP_LESS_EQUAL_INT] = &&L_OP_LESS_EQUAL_INT;
+        dispatchTable[OP_LESS_EQUAL_DOUBLE] = &&L_OP_LESS_EQUAL_DOUBLE;
+        dispatchTable[OP_ADD_LOCALS] = &&L_OP_ADD_LOCALS;
+        dispatchTable[OP_ADD_CONST] = &&L_OP_ADD_CONST;
+        dispatchTable[OP_SUBTRACT_CONST] = &&L_OP_SUBTRACT_CONST;
+        dispatchTable[OP_INC_LOCAL] = &&L_OP_INC_LOCAL;
+        dispatchTable[OP_DEC_LOCAL] = &&L_OP_DEC_LOCAL;
+        dispatchTable[OP_CONSTANT_LONG] = &&L_OP_CONSTANT_LONG;
+        dispatchTable[OP_GET_LOCAL_LONG] = &&L_OP_GET_LOCAL_LONG;
+        dispatchTable[OP_SET_LOCAL_LONG] = &&L_OP_SET_LOCAL_LONG;
+        dispatchTable[OP_JUMP_LONG] = &&L_OP_JUMP_LONG;
+        dispatchTable[OP_JUMP_IF_FALSE_LONG] = &&L_OP_JUMP_IF_FALSE_LONG;
+        dispatchTable[OP_JUMP_IF_TRUE_LONG] = &&L_OP_JUMP_IF_TRUE_LONG;
+        dispatchTable[OP_LOOP_LONG] = &&L_OP_LOOP_LONG;
+        dispatchTable[OP_PUSH_INT] = &&L_OP_PUSH_INT;
+        dispatchTable[OP_ADD_IMM] = &&L_OP_ADD_IMM;
+        dispatchTable[OP_SUBTRACT_IMM] = &&L_OP_SUBTRACT_IMM;
+        dispatchTable[OP_POP_JUMP_IF_FALSE] = &&L_OP_POP_JUMP_IF_FALSE;
+        dispatchTable[OP_JUMP_IF_NOT_EQUAL] = &&L_OP_JUMP_IF_NOT_EQUAL;
+        dispatchTable[OP_JUMP_IF_EQUAL] = &&L_OP_JUMP_IF_EQUAL;
+        dispatchTable[OP_JUMP_IF_NOT_GREATER] = &&L_OP_JUMP_IF_NOT_GREATER;
+        dispatchTable[OP_JUMP_IF_NOT_GREATER_EQUAL] = &&L_OP_JUMP_IF_NOT_GREATER_EQUAL;
+        dispatchTable[OP_JUMP_IF_NOT_LESS] = &&L_OP_JUMP_IF_NOT_LESS;
+        dispatchTable[OP_JUMP_IF_NOT_LESS_EQUAL] = &&L_OP_JUMP_IF_NOT_LESS_EQUAL;
+        dispatchTable[OP_JUMP_IF_NOT_EQUAL_IMM] = &&L_OP_JUMP_IF_NOT_EQUAL_IMM;
+        dispatchTable[OP_JUMP_IF_EQUAL_IMM] = &&L_OP_JUMP_IF_EQUAL_IMM;
+        dispatchTable[OP_JUMP_IF_NOT_GREATER_IMM] = &&L_OP_JUMP_IF_NOT_GREATER_IMM;
+        dispatchTable[OP_JUMP_IF_NOT_GREATER_EQUAL_IMM] = &&L_OP_JUMP_IF_NOT_GREATER_EQUAL_IMM;
+        dispatchTable[OP_JUMP_IF_NOT_LESS_IMM] = &&L_OP_JUMP_IF_NOT_LESS_IMM;
+        dispatchTable[OP_JUMP_IF_NOT_LESS_EQUAL_IMM] = &&L_OP_JUMP_IF_NOT_LESS_EQUAL_IMM;
+        dispatchTable[OP_POP_JUMP_IF_FALSE_LONG] = &&L_OP_POP_JUMP_IF_FALSE_LONG;
+        dispatchTable[OP_FOR_PREP] = &&L_OP_FOR_PREP;
+        dispatchTable[OP_FOR_LOOP] = &&L_OP_FOR_LOOP;
+        dispatchTable[OP_FOR_PREP_LONG] = &&L_OP_FOR_PREP_LONG;
+        dispatchTable[OP_FOR_LOOP_LONG] = &&L_OP_FOR_LOOP_LONG;
+        dispatchTable[OP_SWITCH] = &&L_OP_SWITCH;
+    }
+
+#define INTERPRET_LOOP DISPATCH();
+#define CASE_CODE(op) L_##op:
+#define CASE_UNKNOWN L_UNKNOWN:
+#define DISPATCH() goto *dispatchTable[instruction = READ_BYTE()]
+
+#else
+
+#define INTERPRET_LOOP \
+    loop:              \
+    switch (instruction = READ_BYTE())
+#define CASE_CODE(op) case op:
+#define CASE_UNKNOWN default:
+#define DISPATCH() goto loop
+
+#endif
+
+    LOAD_FRAME();
+    JIT_ENTER();
+
+    INTERPRET_LOOP
+    {
+        CASE_CODE(OP_CONSTANT)
+        {
+            PUSH(READ_CONSTANT());
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_NIL)
+        {
+            PUSH(Value::makeNull());
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_TRUE)
+        {
+            PUSH(Value::makeBool(true));
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_FALSE)
+        {
+            PUSH(Value::makeBool(false));
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_POP)
+        {
+            if (sp <= stack_)
+                RUNTIME_ERROR("Stack underflow");
+            sp--;
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_NOT)
+        {
+            Value v;
+            POP_INTO(v);
+            PUSH(Value::makeBool(!isTruthy(v)));
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_ADD)
+        {
+            Value b, a;
+            POP_INTO(b);
+            POP_INTO(a);
+
+            // String concatenation
+            if (a.isString() && b.isString())
+            {
+                QUICKEN(OP_ADD_STRING);
+                const char *result = StringPool::instance().concat(a.asString(), b.asString());
+                PUSH(Value::makeString(result));
+            }
+            // Int + Int = Int
+            else if (a.isInt() && b.isInt())
+            {
+                QUICKEN(OP_ADD_INT);
+                PUSH(Value::makeInt(a.asInt() + b.asInt()));
+            }
+            // Double + Double = Double
+            else if (a.isDouble() && b.isDouble())
+            {
+                QUICKEN(OP_ADD_DOUBLE);
+                PUSH(Value::makeDouble(a.asDouble() + b.asDouble()));
+            }
+            // Int + Double = Double
+            else if (a.isInt() && b.isDouble())
+            {
+                PUSH(Value::makeDouble(a.asInt() + b.asDouble()));
+            }
+            // Double + Int = Double
+            else if (a.isDouble() && b.isInt())
+            {
+                PUSH(Value::makeDouble(a.asDouble() + b.asInt()));
+            }
+            else
+            {
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            }
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_SUBTRACT)
+        {
+            BINARY_NUMBER_OP(-, OP_SUBTRACT_INT, OP_SUBTRACT_DOUBLE);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_MULTIPLY)
+        {
+            BINARY_NUMBER_OP(*, OP_MULTIPLY_INT, OP_MULTIPLY_DOUBLE);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_DIVIDE)
+        {
+            // Check division by zero
+            const Value &divisor = PEEK();
+            if ((divisor.isInt() && divisor.asInt() == 0) ||
+                (divisor.isDouble() && divisor.asDouble() == 0.0))
+            {
+                RUNTIME_ERROR("Division by zero");
+            }
+
+            // Sem forma especializada (o guard de zero fica sempre)
+            BINARY_NUMBER_OP(/, OP_DIVIDE, OP_DIVIDE);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_MODULO)
+        {
+            Value b, a;
+            POP_INTO(b);
+            POP_INTO(a);
+            if (a.isInt() && b.isInt())
+            {
+                PUSH(Value::makeInt(a.asInt() % b.asInt()));
+            }
+            else
+            {
+                RUNTIME_ERROR("Operands must be integers");
+            }
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_NEGATE)
+        {
+            Value a;
+            POP_INTO(a);
+            if (a.isInt())
+            {
+                PUSH(Value::makeInt(-a.asInt()));
+            }
+            else if (a.isDouble())
+            {
+                PUSH(Value::makeDouble(-a.asDouble()));
+            }
+            else
+            {
+                RUNTIME_ERROR("Operand must be a number");
+            }
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_EQUAL)
+        {
+            Value b, a;
+            POP_INTO(b);
+            POP_INTO(a);
+
+            if (a.getType() != b.getType())
+            {
+                PUSH(Value::makeBool(false));
+            }
+            else if (a.isInt())
+            {
+                QUICKEN(OP_EQUAL_INT);
+                PUSH(Value::makeBool(a.asInt() == b.asInt()));
+            }
+            else if (a.isBool())
+            {
+                PUSH(Value::makeBool(a.asBool() == b.asBool()));
+            }
+            else if (a.isNull())
+            {
+                PUSH(Value::makeBool(true));
+            }
+            else if (a.isString())
+            {
+                PUSH(Value::makeBool(a.asString() == b.asString()));
+            }
+            else if (a.isDouble())
+            {
+                PUSH(Value::makeBool(a.asDouble() == b.asDouble()));
+            }
+            else
+            {
+                PUSH(Value::makeBool(false));
+            }
+            DISPATCH();
         }
-        // Int + Int = Int
-        else if (a.isInt() && b.isInt())
+
+        CASE_CODE(OP_NOT_EQUAL)
+        {
+            Value b, a;
+            POP_INTO(b);
+            POP_INTO(a);
+
+            if (a.getType() != b.getType())
+            {
+                PUSH(Value::makeBool(true));
+            }
+            else if (a.isInt())
+            {
+                QUICKEN(OP_NOT_EQUAL_INT);
+                PUSH(Value::makeBool(a.asInt() != b.asInt()));
+            }
+            else if (a.isBool())
+            {
+                PUSH(Value::makeBool(a.asBool() != b.asBool()));
+            }
+            else if (a.isString())
+            {
+                PUSH(Value::makeBool(a.asString() != b.asString()));
+            }
+            else if (a.isDouble())
+            {
+                PUSH(Value::makeBool(a.asDouble() != b.asDouble()));
+            }
+            else if (a.isNull())
+            {
+                PUSH(Value::makeBool(false));
+            }
+            else
+            {
+                PUSH(Value::makeBool(true));
+            }
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_GREATER)
         {
-            push(Value::makeInt(a.asInt() + b.asInt()));
+            BINARY_COMPARE_OP(>, OP_GREATER_INT, OP_GREATER_DOUBLE);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_GREATER_EQUAL)
+        {
+            BINARY_COMPARE_OP(>=, OP_GREATER_EQUAL_INT, OP_GREATER_EQUAL_DOUBLE);
+            DISPATCH();
         }
-        // Double + Double = Double
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_LESS)
         {
-            push(Value::makeDouble(a.asDouble() + b.asDouble()));
+            BINARY_COMPARE_OP(<, OP_LESS_INT, OP_LESS_DOUBLE);
+            DISPATCH();
         }
-        // Int + Double = Double
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_LESS_EQUAL)
         {
-            push(Value::makeDouble(a.asInt() + b.asDouble()));
+            BINARY_COMPARE_OP(<=, OP_LESS_EQUAL_INT, OP_LESS_EQUAL_DOUBLE);
+            DISPATCH();
         }
-        // Double + Int = Double
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_PRINT)
         {
-            push(Value::makeDouble(a.asDouble() + b.asInt()));
+            Value v;
+            POP_INTO(v);
+            printValue(v);
+            printf("\n");
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_GET_LOCAL)
         {
-            runtimeError("Operands must be numbers or strings");
-            return false;
+            uint8_t slot = READ_BYTE();
+            PUSH(slots[slot]);
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_SUBTRACT:
-    {
-        Value b = pop();
-        Value a = pop();
-
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_SET_LOCAL)
         {
-            push(Value::makeInt(a.asInt() - b.asInt()));
+            uint8_t slot = READ_BYTE();
+            slots[slot] = PEEK();
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_DEFINE_GLOBAL)
         {
-            push(Value::makeDouble(a.asDouble() - b.asDouble()));
+            GlobalSlot &global = globals_[READ_SHORT()];
+            if (global.defined)
+            {
+                RUNTIME_ERROR("Variable '%s' already defined", global.name);
+            }
+            POP_INTO(global.value);
+            global.defined = true;
+            DISPATCH();
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_GET_GLOBAL)
         {
-            push(Value::makeDouble(a.asInt() - b.asDouble()));
+            const GlobalSlot &global = globals_[READ_SHORT()];
+            if (!global.defined)
+            {
+                RUNTIME_ERROR("Undefined variable '%s'", global.name);
+            }
+            PUSH(global.value);
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_SET_GLOBAL)
         {
-            push(Value::makeDouble(a.asDouble() - b.asInt()));
+            GlobalSlot &global = globals_[READ_SHORT()];
+            if (!global.defined)
+            {
+                RUNTIME_ERROR("Undefined variable '%s'", global.name);
+            }
+            storeGlobal(&global.value, PEEK());
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_JUMP)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            uint16_t offset = READ_SHORT();
+            ip += offset;
+            DISPATCH();
         }
-        break;
-    }
-
-    case OP_MULTIPLY:
-    {
-        Value b = pop();
-        Value a = pop();
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_JUMP_IF_FALSE)
         {
-            push(Value::makeInt(a.asInt() * b.asInt()));
+            uint16_t offset = READ_SHORT();
+            if (!isTruthy(PEEK()))
+            {
+                ip += offset;
+            }
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_JUMP_IF_TRUE)
         {
-            push(Value::makeDouble(a.asDouble() * b.asDouble()));
+            uint16_t offset = READ_SHORT();
+            if (isTruthy(PEEK()))
+            {
+                ip += offset;
+            }
+            DISPATCH();
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_LOOP)
         {
-            push(Value::makeDouble(a.asInt() * b.asDouble()));
+            uint16_t offset = READ_SHORT();
+            ip -= offset;
+            JIT_TRACE();
+            JIT_COUNT(frame->function);
+            JIT_ENTER();
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isInt())
+
+        // Formas largas (funções grandes): mesma semântica, operandos maiores
+        CASE_CODE(OP_CONSTANT_LONG)
         {
-            push(Value::makeDouble(a.asDouble() * b.asInt()));
+            PUSH(constants[READ_LONG()]);
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_GET_LOCAL_LONG)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            uint16_t slot = READ_SHORT();
+            PUSH(slots[slot]);
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_DIVIDE:
-    {
-        Value b = pop();
-        Value a = pop();
+        CASE_CODE(OP_SET_LOCAL_LONG)
+        {
+            uint16_t slot = READ_SHORT();
+            slots[slot] = PEEK();
+            DISPATCH();
+        }
 
-        // Check division by zero
-        if ((b.isInt() && b.asInt() == 0) ||
-            (b.isDouble() && b.asDouble() == 0.0))
+        CASE_CODE(OP_JUMP_LONG)
         {
-            runtimeError("Division by zero");
-            return false;
+            uint32_t offset = READ_LONG();
+            ip += offset;
+            DISPATCH();
         }
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_JUMP_IF_FALSE_LONG)
         {
-            push(Value::makeInt(a.asInt() / b.asInt()));
+            uint32_t offset = READ_LONG();
+            if (!isTruthy(PEEK()))
+            {
+                ip += offset;
+            }
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_JUMP_IF_TRUE_LONG)
         {
-            push(Value::makeDouble(a.asDouble() / b.asDouble()));
+            uint32_t offset = READ_LONG();
+            if (isTruthy(PEEK()))
+            {
+                ip += offset;
+            }
+            DISPATCH();
         }
-        else if (a.isInt() && b.isDouble())
+
+        // Sem tracer: um corpo com mais de 64KB não cabe num trace
+        CASE_CODE(OP_LOOP_LONG)
         {
-            push(Value::makeDouble(a.asInt() / b.asDouble()));
+            uint32_t offset = READ_LONG();
+            ip -= offset;
+            JIT_COUNT(frame->function);
+            JIT_ENTER();
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isInt())
+
+        // ===== Imediatos =====
+
+        CASE_CODE(OP_PUSH_INT)
         {
-            push(Value::makeDouble(a.asDouble() / b.asInt()));
+            PUSH(Value::makeInt(READ_IMMEDIATE()));
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_ADD_IMM)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            int32_t k = READ_IMMEDIATE();
+            Value &a = sp[-1];
+            if (a.isInt())
+            {
+                a = Value::makeInt(a.asInt() + k);
+                DISPATCH();
+            }
+            if (!addValues(a, Value::makeInt(k), a))
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
         }
-        break;
-    }
-    case OP_MODULO:
-    {
-        Value b = pop();
-        Value a = pop();
-        if (a.isInt() && b.isInt())
+
+        CASE_CODE(OP_SUBTRACT_IMM)
         {
-            push(Value::makeInt(a.asInt() % b.asInt()));
+            int32_t k = READ_IMMEDIATE();
+            Value &a = sp[-1];
+            if (a.isInt())
+            {
+                a = Value::makeInt(a.asInt() - k);
+                DISPATCH();
+            }
+            if (!subtractValues(a, Value::makeInt(k), a))
+                RUNTIME_ERROR("Operands must be numbers");
+            DISPATCH();
         }
-        else
+
+        // ===== Condições =====
+
+        CASE_CODE(OP_POP_JUMP_IF_FALSE)
         {
-            runtimeError("Operands must be integers");
-            return false;
+            uint16_t offset = READ_SHORT();
+            if (!isTruthy(*--sp))
+                ip += offset;
+            DISPATCH();
         }
-        break;
+
+        CASE_CODE(OP_POP_JUMP_IF_FALSE_LONG)
+        {
+            uint32_t offset = READ_LONG();
+            if (!isTruthy(*--sp))
+                ip += offset;
+            DISPATCH();
+        }
+
+        // ===== For numérico =====
+        // O contador e o limite vivem em slots; FOR_PREP testa a primeira
+        // iteração, FOR_LOOP soma o passo e volta ao corpo numa só instrução.
+
+#define FOR_PREP_OP(readOffset)                                              \
+    do                                                                       \
+    {                                                                        \
+        uint8_t counter = READ_BYTE();                                       \
+        uint8_t limit = READ_BYTE();                                         \
+        uint8_t compare = READ_BYTE();                                       \
+        uint32_t offset = readOffset;                                        \
+        bool result;                                                         \
+        if (!compareValues(compare, slots[counter], slots[limit], result))  \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+        if (!result)                                                         \
+            ip += offset;                                                    \
+    } while (0)
+
+#define FOR_LOOP_STEP()                                                      \
+    uint8_t counter = READ_BYTE();                                           \
+    uint8_t limit = READ_BYTE();                                             \
+    uint8_t compare = READ_BYTE();                                           \
+    int32_t step = READ_IMMEDIATE();                                         \
+    Value &c = slots[counter];                                               \
+    const Value &l = slots[limit];                                           \
+    bool result;                                                             \
+    if (c.isInt() && l.isInt())                                              \
+    {                                                                        \
+        int32_t next = c.asInt() + step;                                     \
+        c = Value::makeInt(next);                                            \
+        switch (compare)                                                     \
+        {                                                                    \
+        case OP_GREATER:                                                     \
+            result = next > l.asInt();                                       \
+            break;                                                           \
+        case OP_GREATER_EQUAL:                                               \
+            result = next >= l.asInt();                                      \
+            break;                                                           \
+        case OP_LESS:                                                        \
+            result = next < l.asInt();                                       \
+            break;                                                           \
+        default:                                                             \
+            result = next <= l.asInt();                                      \
+            break;                                                           \
+        }                                                                    \
+    }                                                                        \
+    else                                                                     \
+    {                                                                        \
+        if (step < 0 ? !subtractValues(c, Value::makeInt(-step), c)          \
+                     : !addValues(c, Value::makeInt(step), c))               \
+            RUNTIME_ERROR(step < 0 ? "Operands must be numbers"              \
+                                   : "Operands must be numbers or strings"); \
+        if (!compareValues(compare, c, l, result))                           \
+            RUNTIME_ERROR("Operands must be numbers");                       \
     }
 
-    case OP_NEGATE:
-    {
-        Value a = pop();
-        if (a.isInt())
+        CASE_CODE(OP_FOR_PREP)
         {
-            push(Value::makeInt(-a.asInt()));
+            FOR_PREP_OP(READ_SHORT());
+            DISPATCH();
         }
-        else if (a.isDouble())
+
+        CASE_CODE(OP_FOR_LOOP)
         {
-            push(Value::makeDouble(-a.asDouble()));
+            FOR_LOOP_STEP();
+            uint16_t offset = READ_SHORT();
+            if (result)
+            {
+                ip -= offset;
+                JIT_TRACE();
+                JIT_COUNT(frame->function);
+                JIT_ENTER();
+            }
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_FOR_PREP_LONG)
         {
-            runtimeError("Operand must be a number");
-            return false;
+            FOR_PREP_OP(READ_LONG());
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_EQUAL:
-    {
-        Value b = pop();
-        Value a = pop();
+        // Como o OP_LOOP_LONG, sem tracer
+        CASE_CODE(OP_FOR_LOOP_LONG)
+        {
+            FOR_LOOP_STEP();
+            uint32_t offset = READ_LONG();
+            if (result)
+            {
+                ip -= offset;
+                JIT_COUNT(frame->function);
+                JIT_ENTER();
+            }
+            DISPATCH();
+        }
 
-        if (a.type != b.type)
+#undef FOR_PREP_OP
+#undef FOR_LOOP_STEP
+
+        // O valor do switch fica no seu slot; só se escolhe o destino
+        CASE_CODE(OP_SWITCH)
         {
-            push(Value::makeBool(false));
+            Chunk &chunk = frame->function->chunk;
+            const SwitchTable &table = chunk.switches[READ_SHORT()];
+            ip = chunk.code.data() + table.targetOf(PEEK());
+            DISPATCH();
         }
-        else if (a.isInt())
+
+        CASE_CODE(OP_JUMP_IF_NOT_EQUAL)
         {
-            push(Value::makeBool(a.asInt() == b.asInt()));
+            uint16_t offset = READ_SHORT();
+            sp -= 2;
+            if (!valuesEqual(sp[0], sp[1]))
+                ip += offset;
+            DISPATCH();
         }
-        else if (a.isBool())
+
+        CASE_CODE(OP_JUMP_IF_EQUAL)
         {
-            push(Value::makeBool(a.asBool() == b.asBool()));
+            uint16_t offset = READ_SHORT();
+            sp -= 2;
+            if (valuesEqual(sp[0], sp[1]))
+                ip += offset;
+            DISPATCH();
         }
-        else if (a.isNull())
+
+        CASE_CODE(OP_JUMP_IF_NOT_GREATER)
         {
-            push(Value::makeBool(true));
+            COMPARE_BRANCH_OP(>);
+            DISPATCH();
         }
-        else if (a.isString())
+
+        CASE_CODE(OP_JUMP_IF_NOT_GREATER_EQUAL)
         {
-            push(Value::makeBool(a.asString() == b.asString()));
+            COMPARE_BRANCH_OP(>=);
+            DISPATCH();
         }
-        else if (a.isDouble())
+
+        CASE_CODE(OP_JUMP_IF_NOT_LESS)
         {
-            push(Value::makeBool(a.asDouble() == b.asDouble()));
+            COMPARE_BRANCH_OP(<);
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_JUMP_IF_NOT_LESS_EQUAL)
         {
-            push(Value::makeBool(false));
+            COMPARE_BRANCH_OP(<=);
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_NOT_EQUAL:
-    {
-        Value b = pop();
-        Value a = pop();
+        CASE_CODE(OP_JUMP_IF_NOT_EQUAL_IMM)
+        {
+            int32_t k = READ_IMMEDIATE();
+            uint16_t offset = READ_SHORT();
+            if (!valuesEqual(*--sp, Value::makeInt(k)))
+                ip += offset;
+            DISPATCH();
+        }
 
-        if (a.type != b.type)
+        CASE_CODE(OP_JUMP_IF_EQUAL_IMM)
         {
-            push(Value::makeBool(true));
+            int32_t k = READ_IMMEDIATE();
+            uint16_t offset = READ_SHORT();
+            if (valuesEqual(*--sp, Value::makeInt(k)))
+                ip += offset;
+            DISPATCH();
         }
-        else if (a.isInt())
+
+        CASE_CODE(OP_JUMP_IF_NOT_GREATER_IMM)
         {
-            push(Value::makeBool(a.asInt() != b.asInt()));
+            COMPARE_IMM_BRANCH_OP(>);
+            DISPATCH();
         }
-        else if (a.isBool())
+
+        CASE_CODE(OP_JUMP_IF_NOT_GREATER_EQUAL_IMM)
         {
-            push(Value::makeBool(a.asBool() != b.asBool()));
+            COMPARE_IMM_BRANCH_OP(>=);
+            DISPATCH();
         }
-        else if (a.isString())
+
+        CASE_CODE(OP_JUMP_IF_NOT_LESS_IMM)
         {
-            push(Value::makeBool(a.asString() != b.asString()));
+            COMPARE_IMM_BRANCH_OP(<);
+            DISPATCH();
         }
-        else if (a.isDouble())
+
+        CASE_CODE(OP_JUMP_IF_NOT_LESS_EQUAL_IMM)
         {
-            push(Value::makeBool(a.asDouble() != b.asDouble()));
+            COMPARE_IMM_BRANCH_OP(<=);
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_CALL_NATIVE)
         {
-            push(Value::makeBool(false));
+            uint8_t index = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+
+            STORE_FRAME();
+            if (!callNative(index, argCount) || hasFatalError_)
+            {
+                return false;
+            }
+            // A native pode ter chamado a VM e feito crescer a stack
+            LOAD_FRAME();
+            sp = stackTop_;
+            JIT_ENTER();
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_GREATER:
-    {
-        Value b = pop();
-        Value a = pop();
+        CASE_CODE(OP_CALL)
+        {
+            uint8_t argCount = READ_BYTE();
+            const Value &funcVal = sp[-1 - argCount];
+            if (!funcVal.isFunction())
+            {
+                RUNTIME_ERROR("Attempt to call a non-function value (type: %s)",
+                              TypeName(funcVal.getType()));
+            }
+            uint16_t funcIdx = funcVal.asFunctionIdx();
+            STORE_FRAME();
+            Function *function = getFunction(funcIdx);
+            if (!function)
+            {
+                return false;
+            }
+            // A função fica no slot 0 do novo frame: nada a copiar
+            if (!callFunction(function, argCount))
+                return false;
+            LOAD_FRAME();
+            sp = stackTop_; // a call pode ter mudado a stack de sítio
+            JIT_ENTER();
+            DISPATCH();
+        }
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_CALL_DIRECT)
         {
-            push(Value::makeBool(a.asInt() > b.asInt()));
+            uint8_t argCount = READ_BYTE();
+            STORE_FRAME();
+            Function *function = directCallee(sp - argCount - 1);
+            if (!function || !callFunction(function, argCount))
+                return false;
+            LOAD_FRAME();
+            sp = stackTop_;
+            JIT_ENTER();
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_TAIL_CALL)
         {
-            push(Value::makeBool(a.asDouble() > b.asDouble()));
+            uint8_t argCount = READ_BYTE();
+            Value *callee = sp - argCount - 1;
+            if (!callee->isFunction())
+            {
+                RUNTIME_ERROR("Attempt to call a non-function value (type: %s)",
+                              TypeName(callee->getType()));
+            }
+            STORE_FRAME();
+            Function *function = getFunction(callee->asFunctionIdx());
+            if (!function)
+            {
+                return false;
+            }
+            TAIL_CALL(function, callee, argCount);
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_TAIL_CALL_DIRECT)
         {
-            push(Value::makeBool(a.asInt() > b.asDouble()));
+            uint8_t argCount = READ_BYTE();
+            Value *callee = sp - argCount - 1;
+            STORE_FRAME();
+            Function *function = directCallee(callee);
+            if (!function)
+            {
+                return false;
+            }
+            TAIL_CALL(function, callee, argCount);
         }
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_RETURN)
         {
-            push(Value::makeBool(a.asDouble() > b.asInt()));
+            Value result;
+            POP_INTO(result);
+            frameCount_--;
+
+            // O resultado substitui o callee (slot 0) do frame que saiu; no
+            // script fica na base da stack para quem chamar Pop()
+            sp = frame->slots;
+            PUSH(result);
+
+            if (frameCount_ == targetFrameCount)
+            {
+                stackTop_ = sp;
+                return true;
+            }
+            LOAD_FRAME();
+            JIT_ENTER();
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(OP_RETURN_NIL)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            frameCount_--;
+            sp = frame->slots;
+            PUSH(Value::makeNull());
+
+            if (frameCount_ == targetFrameCount)
+            {
+                stackTop_ = sp;
+                return true;
+            }
+            LOAD_FRAME();
+            JIT_ENTER();
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_GREATER_EQUAL:
-    {
-        Value b = pop();
-        Value a = pop();
+        // ===== Quickened =====
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_ADD_INT)
         {
-            push(Value::makeBool(a.asInt() >= b.asInt()));
+            QUICK_BINARY_OP(isInt, asInt, makeInt, +, OP_ADD);
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_ADD_DOUBLE)
         {
-            push(Value::makeBool(a.asDouble() >= b.asDouble()));
+            QUICK_BINARY_OP(isDouble, asDouble, makeDouble, +, OP_ADD);
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_ADD_STRING)
         {
-            push(Value::makeBool(a.asInt() >= b.asDouble()));
+            Value &a = sp[-2];
+            const Value &b = sp[-1];
+            if (a.isString() && b.isString())
+            {
+                a = Value::makeString(StringPool::instance().concat(a.asString(), b.asString()));
+                sp--;
+                DISPATCH();
+            }
+            *--ip = OP_ADD;
+            DISPATCH();
         }
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_SUBTRACT_INT)
         {
-            push(Value::makeBool(a.asDouble() >= b.asInt()));
+            QUICK_BINARY_OP(isInt, asInt, makeInt, -, OP_SUBTRACT);
         }
-        else
+
+        CASE_CODE(OP_SUBTRACT_DOUBLE)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            QUICK_BINARY_OP(isDouble, asDouble, makeDouble, -, OP_SUBTRACT);
         }
-        break;
-    }
 
-    case OP_LESS:
-    {
-        Value b = pop();
-        Value a = pop();
+        CASE_CODE(OP_MULTIPLY_INT)
+        {
+            QUICK_BINARY_OP(isInt, asInt, makeInt, *, OP_MULTIPLY);
+        }
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_MULTIPLY_DOUBLE)
         {
-            push(Value::makeBool(a.asInt() < b.asInt()));
+            QUICK_BINARY_OP(isDouble, asDouble, makeDouble, *, OP_MULTIPLY);
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_EQUAL_INT)
         {
-            push(Value::makeBool(a.asDouble() < b.asDouble()));
+            QUICK_BINARY_OP(isInt, asInt, makeBool, ==, OP_EQUAL);
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_NOT_EQUAL_INT)
         {
-            push(Value::makeBool(a.asInt() < b.asDouble()));
+            QUICK_BINARY_OP(isInt, asInt, makeBool, !=, OP_NOT_EQUAL);
         }
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_GREATER_INT)
         {
-            push(Value::makeBool(a.asDouble() < b.asInt()));
+            QUICK_BINARY_OP(isInt, asInt, makeBool, >, OP_GREATER);
         }
-        else
+
+        CASE_CODE(OP_GREATER_DOUBLE)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            QUICK_BINARY_OP(isDouble, asDouble, makeBool, >, OP_GREATER);
         }
-        break;
-    }
 
-    case OP_LESS_EQUAL:
-    {
-        Value b = pop();
-        Value a = pop();
+        CASE_CODE(OP_GREATER_EQUAL_INT)
+        {
+            QUICK_BINARY_OP(isInt, asInt, makeBool, >=, OP_GREATER_EQUAL);
+        }
 
-        if (a.isInt() && b.isInt())
+        CASE_CODE(OP_GREATER_EQUAL_DOUBLE)
         {
-            push(Value::makeBool(a.asInt() <= b.asInt()));
+            QUICK_BINARY_OP(isDouble, asDouble, makeBool, >=, OP_GREATER_EQUAL);
         }
-        else if (a.isDouble() && b.isDouble())
+
+        CASE_CODE(OP_LESS_INT)
         {
-            push(Value::makeBool(a.asDouble() <= b.asDouble()));
+            QUICK_BINARY_OP(isInt, asInt, makeBool, <, OP_LESS);
         }
-        else if (a.isInt() && b.isDouble())
+
+        CASE_CODE(OP_LESS_DOUBLE)
         {
-            push(Value::makeBool(a.asInt() <= b.asDouble()));
+            QUICK_BINARY_OP(isDouble, asDouble, makeBool, <, OP_LESS);
         }
-        else if (a.isDouble() && b.isInt())
+
+        CASE_CODE(OP_LESS_EQUAL_INT)
         {
-            push(Value::makeBool(a.asDouble() <= b.asInt()));
+            QUICK_BINARY_OP(isInt, asInt, makeBool, <=, OP_LESS_EQUAL);
         }
-        else
+
+        CASE_CODE(OP_LESS_EQUAL_DOUBLE)
         {
-            runtimeError("Operands must be numbers");
-            return false;
+            QUICK_BINARY_OP(isDouble, asDouble, makeBool, <=, OP_LESS_EQUAL);
         }
-        break;
-    }
 
-    case OP_PRINT:
-    {
-        printValue(pop());
-        printf("\n");
-        break;
-    }
+        // ========================================
+        // SUPERINSTRUCTIONS
+        // ========================================
 
-    case OP_GET_LOCAL:
-    {
-        uint8_t slot = READ_BYTE();
-        push(frame->slots[slot]);
-        break;
+        CASE_CODE(OP_ADD_LOCALS)
+        {
+            const Value &a = slots[READ_BYTE()];
+            const Value &b = slots[READ_BYTE()];
+            if (a.isInt() && b.isInt())
+            {
+                PUSH(Value::makeInt(a.asInt() + b.asInt()));
+                DISPATCH();
+            }
+            Value result;
+            if (!addValues(a, b, result))
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            PUSH(result);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_ADD_CONST)
+        {
+            const Value &k = READ_CONSTANT();
+            Value &a = sp[-1];
+            if (a.isInt() && k.isInt())
+            {
+                a = Value::makeInt(a.asInt() + k.asInt());
+                DISPATCH();
+            }
+            if (!addValues(a, k, a))
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_SUBTRACT_CONST)
+        {
+            const Value &k = READ_CONSTANT();
+            Value &a = sp[-1];
+            if (a.isInt() && k.isInt())
+            {
+                a = Value::makeInt(a.asInt() - k.asInt());
+                DISPATCH();
+            }
+            if (!subtractValues(a, k, a))
+                RUNTIME_ERROR("Operands must be numbers");
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_INC_LOCAL)
+        {
+            Value &v = slots[READ_BYTE()];
+            if (v.isInt())
+                v = Value::makeInt(v.asInt() + 1);
+            else if (v.isDouble())
+                v = Value::makeDouble(v.asDouble() + 1);
+            else
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_DEC_LOCAL)
+        {
+            Value &v = slots[READ_BYTE()];
+            if (v.isInt())
+                v = Value::makeInt(v.asInt() - 1);
+            else if (v.isDouble())
+                v = Value::makeDouble(v.asDouble() - 1);
+            else
+                RUNTIME_ERROR("Operands must be numbers");
+            DISPATCH();
+        }
+
+        // ===== Intrinsics =====
+
+        CASE_CODE(OP_SQRT)
+        {
+            sp[-1] = sqrtValue(sp[-1]);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_ABS)
+        {
+            sp[-1] = absValue(sp[-1]);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_POW)
+        {
+            sp[-2] = powValues(sp[-2], sp[-1]);
+            sp--;
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_LEN)
+        {
+            sp[-1] = lenValue(sp[-1]);
+            DISPATCH();
+        }
+
+        CASE_CODE(OP_STR)
+        {
+            sp[-1] = strValue(sp[-1]);
+            DISPATCH();
+        }
+
+        CASE_UNKNOWN
+        {
+            RUNTIME_ERROR("Unknown opcode: %d", instruction);
+        }
     }
 
-    case OP_SET_LOCAL:
-    {
-        uint8_t slot = READ_BYTE();
-        frame->slots[slot] = peek(0);
-        break;
+    // Não chega aqui: todos os handlers fazem DISPATCH() ou return
+    return false;
+
+#undef STORE_FRAME
+#undef LOAD_FRAME
+#undef RUNTIME_ERROR
+#undef PUSH
+#undef POP_INTO
+#undef PEEK
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_LONG
+#undef READ_IMMEDIATE
+#undef READ_CONSTANT
+#undef READ_STRING_PTR
+#undef QUICKEN
+#undef BINARY_NUMBER_OP
+#undef BINARY_COMPARE_OP
+#undef QUICK_BINARY_OP
+#undef COMPARE_BRANCH_OP
+#undef COMPARE_IMM_BRANCH_OP
+#undef TAIL_CALL
+#undef JIT_ENTER
+#undef JIT_COUNT
+#undef JIT_TRACE
+#undef INTERPRET_LOOP
+#undef CASE_CODE
+#undef CASE_UNKNOWN
+#undef DISPATCH
+}
+DISPATCH_LOOP_END
+
+// ============================================
+// EXECUTE REGISTER: Dispatch loop do formato register
+// ============================================
+// Os operandos são slots do frame (regs) ou constantes; não há push/pop.
+// O frame de uma função ocupa regs[0 .. regCount), com o callee em
+// regs[0]; uma call usa o registo do callee como base do novo frame.
+// Funções sem regCode (ex: montadas à mão) correm no loop de stack.
+DISPATCH_LOOP_BEGIN
+bool VM::executeRegister(int targetFrameCount)
+{
+    hasFatalError_ = false;
+
+    CallFrame *frame;
+    uint8_t *ip;
+    uint8_t *codeBase;
+    const Value *constants;
+    Value *regs;
+    uint8_t instruction;
+
+#define STORE_FRAME() (frame->ip = ip)
+
+#define LOAD_FRAME()                                         \
+    do                                                       \
+    {                                                        \
+        frame = &frames_[frameCount_ - 1];                   \
+        ip = frame->ip;                                      \
+        regs = frame->slots;                                 \
+        codeBase = frame->function->regCode.data();          \
+        constants = frame->function->chunk.constants.data(); \
+    } while (0)
+
+    // Depois de código que pode fazer crescer a stack ou os frames (calls
+    // no loop de stack, natives): o ip local continua válido
+#define RELOAD_REGS()                         \
+    do                                        \
+    {                                         \
+        frame = &frames_[frameCount_ - 1];    \
+        regs = frame->slots;                  \
+    } while (0)
+
+#define RUNTIME_ERROR(...)             \
+    do                                 \
+    {                                  \
+        STORE_FRAME();                 \
+        runtimeError(__VA_ARGS__);     \
+        return false;                  \
+    } while (0)
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_REG() (regs[READ_BYTE()])
+
+    // O resultado substitui o callee (slot 0), que é o registo base do
+    // R_CALL no frame de cima; o script deixa-o na stack
+    // Sem versão register a função corre no loop de stack até voltar (o
+    // OP_RETURN deixa o resultado no registo do callee); senão empilha o
+    // frame com os slots a começar no callee, sem copiar args
+#define REG_CALL(function, callee, argCount)                                        \
+    do                                                                              \
+    {                                                                               \
+        if (!(function)->hasRegisterCode())                                         \
+        {                                                                           \
+            stackTop_ = (callee) + 1 + (argCount);                                  \
+            if (!callFunction(function, argCount) ||                                \
+                !executeUntilReturn(frameCount_ - 1))                               \
+                return false;                                                       \
+            RELOAD_REGS();                                                          \
+            DISPATCH();                                                             \
+        }                                                                           \
+        if ((argCount) != (function)->arity)                                        \
+            RUNTIME_ERROR("Function '%s' expects %d arguments but got %d",          \
+                          (function)->name.c_str(), (function)->arity, argCount);   \
+        if (!reserveStack((callee), (function)->regCount))                          \
+            RUNTIME_ERROR("Stack overflow");                                        \
+        if (frameCount_ >= (int)frames_.size() && !growFrames())                    \
+            RUNTIME_ERROR("Stack overflow - too many nested calls");                \
+        frame = &frames_[frameCount_++];                                            \
+        frame->function = (function);                                               \
+        frame->slots = (callee);                                                    \
+        ip = (function)->regCode.data();                                            \
+        regs = (callee);                                                            \
+        codeBase = ip;                                                              \
+        constants = (function)->chunk.constants.data();                             \
+        DISPATCH();                                                                 \
+    } while (0)
+
+    // Reutiliza o frame: callee e args descem para regs[0..]. Sem versão
+    // register faz uma call normal no loop de stack e devolve o resultado.
+#define REG_TAIL_CALL(function, callee, argCount)                                   \
+    do                                                                              \
+    {                                                                               \
+        int calleeOffset = (int)((callee) - regs);                                  \
+        if (!(function)->hasRegisterCode())                                         \
+        {                                                                           \
+            stackTop_ = (callee) + 1 + (argCount);                                  \
+            if (!callFunction(function, argCount) ||                                \
+                !executeUntilReturn(frameCount_ - 1))                               \
+                return false;                                                       \
+            RELOAD_REGS();                                                          \
+            RETURN_VALUE(regs[calleeOffset]);                                       \
+        }                                                                           \
+        if ((argCount) != (function)->arity)                                        \
+            RUNTIME_ERROR("Function '%s' expects %d arguments but got %d",          \
+                          (function)->name.c_str(), (function)->arity, argCount);   \
+        if (!reserveStack(regs, (function)->regCount))                              \
+            RUNTIME_ERROR("Stack overflow");                                        \
+        (callee) = regs + calleeOffset;                                             \
+        for (int i = 0; i <= (argCount); i++)                                       \
+            regs[i] = (callee)[i];                                                  \
+        frame->function = (function);                                               \
+        ip = (function)->regCode.data();                                            \
+        codeBase = ip;                                                              \
+        constants = (function)->chunk.constants.data();                             \
+        DISPATCH();                                                                 \
+    } while (0)
+
+#define RETURN_VALUE(value)                      \
+    do                                           \
+    {                                            \
+        Value result = (value);                  \
+        frameCount_--;                           \
+        frame->slots[0] = result;                \
+        if (frameCount_ == 0)                    \
+            stackTop_ = frame->slots + 1;        \
+        if (frameCount_ == targetFrameCount)     \
+            return true;                         \
+        LOAD_FRAME();                            \
+        DISPATCH();                              \
+    } while (0)
+#define READ_CONSTANT() (constants[READ_BYTE()])
+#define READ_STRING_PTR() (frame->function->chunk.getStringPtr(READ_BYTE()))
+#define IS_NUMBER(v) ((v).isInt() || (v).isDouble())
+#define AS_NUMBER(v) ((v).isInt() ? (double)(v).asInt() : (v).asDouble())
+
+#define REG_NUMBER_OP(op)                                                    \
+    do                                                                       \
+    {                                                                        \
+        Value &dst = READ_REG();                                             \
+        const Value &a = READ_REG();                                         \
+        const Value &b = READ_REG();                                         \
+        if (a.isInt() && b.isInt())                                          \
+            dst = Value::makeInt(a.asInt() op b.asInt());                    \
+        else if (IS_NUMBER(a) && IS_NUMBER(b))                               \
+            dst = Value::makeDouble(AS_NUMBER(a) op AS_NUMBER(b));           \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+    } while (0)
+
+#define REG_COMPARE_OP(op)                                                   \
+    do                                                                       \
+    {                                                                        \
+        Value &dst = READ_REG();                                             \
+        const Value &a = READ_REG();                                         \
+        const Value &b = READ_REG();                                         \
+        if (a.isInt() && b.isInt())                                          \
+            dst = Value::makeBool(a.asInt() op b.asInt());                   \
+        else if (IS_NUMBER(a) && IS_NUMBER(b))                               \
+            dst = Value::makeBool(AS_NUMBER(a) op AS_NUMBER(b));             \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+    } while (0)
+
+#define REG_COMPARE_JUMP(op)                                                 \
+    do                                                                       \
+    {                                                                        \
+        const Value &a = READ_REG();                                         \
+        const Value &b = READ_REG();                                         \
+        uint16_t target = READ_SHORT();                                      \
+        bool result;                                                         \
+        if (a.isInt() && b.isInt())                                          \
+            result = a.asInt() op b.asInt();                                 \
+        else if (IS_NUMBER(a) && IS_NUMBER(b))                               \
+            result = AS_NUMBER(a) op AS_NUMBER(b);                           \
+        else                                                                 \
+            RUNTIME_ERROR("Operands must be numbers");                       \
+        if (!result)                                                         \
+            ip = codeBase + target;                                          \
+    } while (0)
+
+#if WREN_COMPUTED_GOTO
+
+    static void *dispatchTable[256] = {nullptr};
+
+    if (dispatchTable[0] == nullptr)
+    {
+        for (int i = 0; i < 256; i++)
+            dispatchTable[i] = &&L_UNKNOWN;
+
+        dispatchTable[R_MOVE] = &&L_R_MOVE;
+        dispatchTable[R_LOADK] = &&L_R_LOADK;
+        dispatchTable[R_LOADNIL] = &&L_R_LOADNIL;
+        dispatchTable[R_LOADTRUE] = &&L_R_LOADTRUE;
+        dispatchTable[R_LOADFALSE] = &&L_R_LOADFALSE;
+        dispatchTable[R_ADD] = &&L_R_ADD;
+        dispatchTable[R_SUBTRACT] = &&L_R_SUBTRACT;
+        dispatchTable[R_MULTIPLY] = &&L_R_MULTIPLY;
+        dispatchTable[R_DIVIDE] = &&L_R_DIVIDE;
+        dispatchTable[R_MODULO] = &&L_R_MODULO;
+        dispatchTable[R_ADDK] = &&L_R_ADDK;
+        dispatchTable[R_SUBTRACTK] = &&L_R_SUBTRACTK;
+        dispatchTable[R_NEGATE] = &&L_R_NEGATE;
+        dispatchTable[R_NOT] = &&L_R_NOT;
+        dispatchTable[R_INC] = &&L_R_INC;
+        dispatchTable[R_DEC] = &&L_R_DEC;
+        dispatchTable[R_EQUAL] = &&L_R_EQUAL;
+        dispatchTable[R_NOT_EQUAL] = &&L_R_NOT_EQUAL;
+        dispatchTable[R_GREATER] = &&L_R_GREATER;
+        dispatchTable[R_GREATER_EQUAL] = &&L_R_GREATER_EQUAL;
+        dispatchTable[R_LESS] = &&L_R_LESS;
+        dispatchTable[R_LESS_EQUAL] = &&L_R_LESS_EQUAL;
+        dispatchTable[R_GET_GLOBAL] = &&L_R_GET_GLOBAL;
+        dispatchTable[R_SET_GLOBAL] = &&L_R_SET_GLOBAL;
+        dispatchTable[R_DEFINE_GLOBAL] = &&L_R_DEFINE_GLOBAL;
+        dispatchTable[R_JUMP] = &&L_R_JUMP;
+        dispatchTable[R_JUMP_IF_FALSE] = &&L_R_JUMP_IF_FALSE;
+        dispatchTable[R_JUMP_IF_TRUE] = &&L_R_JUMP_IF_TRUE;
+        dispatchTable[R_LESS_JUMP_IF_FALSE] = &&L_R_LESS_JUMP_IF_FALSE;
+        dispatchTable[R_GREATER_JUMP_IF_FALSE] = &&L_R_GREATER_JUMP_IF_FALSE;
+        dispatchTable[R_EQUAL_JUMP_IF_FALSE] = &&L_R_EQUAL_JUMP_IF_FALSE;
+        dispatchTable[R_CALL] = &&L_R_CALL;
+        dispatchTable[R_CALL_NATIVE] = &&L_R_CALL_NATIVE;
+        dispatchTable[R_TAIL_CALL] = &&L_R_TAIL_CALL;
+        dispatchTable[R_SQRT] = &&L_R_SQRT;
+        dispatchTable[R_ABS] = &&L_R_ABS;
+        dispatchTable[R_POW] = &&L_R_POW;
+        dispatchTable[R_LEN] = &&L_R_LEN;
+        dispatchTable[R_STR] = &&L_R_STR;
+        dispatchTable[R_CALL_DIRECT] = &&L_R_CALL_DIRECT;
+        dispatchTable[R_TAIL_CALL_DIRECT] = &&L_R_TAIL_CALL_DIRECT;
+        dispatchTable[R_RETURN] = &&L_R_RETURN;
+        dispatchTable[R_RETURN_NIL] = &&L_R_RETURN_NIL;
+        dispatchTable[R_PRINT] = &&L_R_PRINT;
+    }
+
+#define INTERPRET_LOOP DISPATCH();
+#define CASE_CODE(op) L_##op:
+#define CASE_UNKNOWN L_UNKNOWN:
+#define DISPATCH() goto *dispatchTable[instruction = READ_BYTE()]
+
+#else
+
+#define INTERPRET_LOOP \
+    loop:              \
+    switch (instruction = READ_BYTE())
+#define CASE_CODE(op) case op:
+#define CASE_UNKNOWN default:
+#define DISPATCH() goto loop
+
+#endif
+
+    LOAD_FRAME();
+
+    if (!reserveStack(regs, frame->function->regCount))
+    {
+        RUNTIME_ERROR("Stack overflow");
     }
 
-    case OP_DEFINE_GLOBAL:
+    INTERPRET_LOOP
     {
-        const char *name = READ_STRING_PTR();
-        Value value = pop();
+        CASE_CODE(R_MOVE)
+        {
+            Value &dst = READ_REG();
+            dst = READ_REG();
+            DISPATCH();
+        }
 
-        if (!globals_->define(name, value))
+        CASE_CODE(R_LOADK)
         {
-            runtimeError("Variable '%s' already defined", name);
-            return false;
+            Value &dst = READ_REG();
+            dst = READ_CONSTANT();
+            DISPATCH();
         }
 
-        // ✅ Invalida cache (nova variável pode ter mudado índices)
-        global_cache_.invalidate();
+        CASE_CODE(R_LOADNIL)
+        {
+            READ_REG() = Value::makeNull();
+            DISPATCH();
+        }
 
-        break;
-    }
+        CASE_CODE(R_LOADTRUE)
+        {
+            READ_REG() = Value::makeBool(true);
+            DISPATCH();
+        }
 
-    case OP_GET_GLOBAL:
-    {
-        const char *name = READ_STRING_PTR();
+        CASE_CODE(R_LOADFALSE)
+        {
+            READ_REG() = Value::makeBool(false);
+            DISPATCH();
+        }
 
-        // ✅ Cache hit? (comparação de pointers!)
-        if (global_cache_.name == name)
+        CASE_CODE(R_ADD)
         {
-            push(*global_cache_.value_ptr);
-            break;
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            if (a.isInt() && b.isInt())
+            {
+                dst = Value::makeInt(a.asInt() + b.asInt());
+                DISPATCH();
+            }
+            if (!addValues(a, b, dst))
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
         }
 
-        // Cache miss - lookup normal
-        Value *value = globals_->get_ptr(name);
-        if (value == nullptr)
+        CASE_CODE(R_SUBTRACT)
         {
-            runtimeError("Undefined variable '%s'", name);
-            return false;
+            REG_NUMBER_OP(-);
+            DISPATCH();
         }
 
-        // ✅ Atualiza cache
-        global_cache_.name = name;
-        global_cache_.value_ptr = value;
+        CASE_CODE(R_MULTIPLY)
+        {
+            REG_NUMBER_OP(*);
+            DISPATCH();
+        }
 
-        push(*value);
-        break;
-    }
+        CASE_CODE(R_DIVIDE)
+        {
+            const Value &divisor = regs[ip[2]];
+            if ((divisor.isInt() && divisor.asInt() == 0) ||
+                (divisor.isDouble() && divisor.asDouble() == 0.0))
+            {
+                RUNTIME_ERROR("Division by zero");
+            }
+            REG_NUMBER_OP(/);
+            DISPATCH();
+        }
 
-    case OP_SET_GLOBAL:
-    {
-        const char *name = READ_STRING_PTR();
+        CASE_CODE(R_MODULO)
+        {
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            if (!a.isInt() || !b.isInt())
+                RUNTIME_ERROR("Operands must be integers");
+            dst = Value::makeInt(a.asInt() % b.asInt());
+            DISPATCH();
+        }
 
-        // ✅ Cache hit?
-        if (global_cache_.name == name && global_cache_.value_ptr != nullptr)
+        CASE_CODE(R_ADDK)
         {
-            *global_cache_.value_ptr = peek(0);
-            break;
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &k = READ_CONSTANT();
+            if (a.isInt() && k.isInt())
+            {
+                dst = Value::makeInt(a.asInt() + k.asInt());
+                DISPATCH();
+            }
+            if (!addValues(a, k, dst))
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
         }
 
-        // Cache miss
-        if (!globals_->set_if_exists(name, peek(0)))
+        CASE_CODE(R_SUBTRACTK)
         {
-            runtimeError("Undefined variable '%s'", name);
-            return false;
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &k = READ_CONSTANT();
+            if (a.isInt() && k.isInt())
+            {
+                dst = Value::makeInt(a.asInt() - k.asInt());
+                DISPATCH();
+            }
+            if (!subtractValues(a, k, dst))
+                RUNTIME_ERROR("Operands must be numbers");
+            DISPATCH();
         }
 
-        // ✅ Atualiza cache
-        global_cache_.name = name;
-        global_cache_.value_ptr = globals_->get_ptr(name);
+        CASE_CODE(R_NEGATE)
+        {
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            if (a.isInt())
+                dst = Value::makeInt(-a.asInt());
+            else if (a.isDouble())
+                dst = Value::makeDouble(-a.asDouble());
+            else
+                RUNTIME_ERROR("Operand must be a number");
+            DISPATCH();
+        }
 
-        break;
-    }
+        CASE_CODE(R_NOT)
+        {
+            Value &dst = READ_REG();
+            dst = Value::makeBool(!isTruthy(READ_REG()));
+            DISPATCH();
+        }
 
-    case OP_JUMP:
-    {
-        uint16_t offset = READ_SHORT();
-        frame->ip += offset;
-        break;
-    }
+        CASE_CODE(R_INC)
+        {
+            Value &v = READ_REG();
+            if (v.isInt())
+                v = Value::makeInt(v.asInt() + 1);
+            else if (v.isDouble())
+                v = Value::makeDouble(v.asDouble() + 1);
+            else
+                RUNTIME_ERROR("Operands must be numbers or strings");
+            DISPATCH();
+        }
 
-    case OP_JUMP_IF_FALSE:
-    {
-        uint16_t offset = READ_SHORT();
-        if (!isTruthy(peek(0)))
+        CASE_CODE(R_DEC)
         {
-            frame->ip += offset;
+            Value &v = READ_REG();
+            if (v.isInt())
+                v = Value::makeInt(v.asInt() - 1);
+            else if (v.isDouble())
+                v = Value::makeDouble(v.asDouble() - 1);
+            else
+                RUNTIME_ERROR("Operands must be numbers");
+            DISPATCH();
         }
-        break;
-    }
 
-    case OP_LOOP:
-    {
-        uint16_t offset = READ_SHORT();
-        frame->ip -= offset;
-        break;
-    }
+        CASE_CODE(R_EQUAL)
+        {
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            dst = Value::makeBool(valuesEqual(a, b));
+            DISPATCH();
+        }
 
-    case OP_CALL_NATIVE:
-    {
-        const char *name = READ_STRING_PTR();
-        uint8_t argCount = READ_BYTE();
+        CASE_CODE(R_NOT_EQUAL)
+        {
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            dst = Value::makeBool(!valuesEqual(a, b));
+            DISPATCH();
+        }
 
-        if (!callNative(name, argCount))
+        CASE_CODE(R_GREATER)
         {
-            return false;
+            REG_COMPARE_OP(>);
+            DISPATCH();
         }
 
-        break;
-    }
-    case OP_CALL:
-    {
-        uint8_t argCount = READ_BYTE();
-        const Value &funcVal = peek(argCount);
-        if (!funcVal.isFunction())
+        CASE_CODE(R_GREATER_EQUAL)
         {
-            runtimeError("Attempt to call a non-function value (type: %s)",
-                         TypeName(funcVal.type));
-            return false;
+            REG_COMPARE_OP(>=);
+            DISPATCH();
         }
-        uint16_t funcIdx = funcVal.asFunctionIdx();
-        Function *function = getFunction(funcIdx);
-        if (!function)
+
+        CASE_CODE(R_LESS)
         {
-            runtimeError("Invalid function index: %d", funcIdx);
-            return false;
+            REG_COMPARE_OP(<);
+            DISPATCH();
         }
-        // Remove função da stack (shift args para baixo)
-        Value *funcSlot = stackTop_ - argCount - 1;
-        for (Value *p = funcSlot; p < stackTop_ - 1; p++)
-            *p = *(p + 1);
-        stackTop_--;
-        // Faz a call
-        if (!callFunction(function, argCount))
-            return false;
-        // Atualiza frame pointer
-        frame = &frames_[frameCount_ - 1];
-        break;
-    }
 
-    case OP_RETURN:
-    {
-        // DumpStack();
-        Value result = pop();
-        Value *resultSlot = frame->slots;
-        frameCount_--;
+        CASE_CODE(R_LESS_EQUAL)
+        {
+            REG_COMPARE_OP(<=);
+            DISPATCH();
+        }
 
-        if (frameCount_ == 0)
+        CASE_CODE(R_GET_GLOBAL)
         {
-            // printf("=== Script finished ===\n");
+            Value &dst = READ_REG();
+            const GlobalSlot &global = globals_[READ_SHORT()];
+            if (!global.defined)
+            {
+                RUNTIME_ERROR("Undefined variable '%s'", global.name);
+            }
+            dst = global.value;
+            DISPATCH();
+        }
 
-            // Script principal terminou
-            stackTop_ = stack_;
-            push(result); // Resultado fica na stack para quem chamar Pop()
+        CASE_CODE(R_SET_GLOBAL)
+        {
+            const Value &src = READ_REG();
+            GlobalSlot &global = globals_[READ_SHORT()];
+            if (!global.defined)
+            {
+                RUNTIME_ERROR("Undefined variable '%s'", global.name);
+            }
+            storeGlobal(&global.value, src);
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(R_DEFINE_GLOBAL)
         {
-            // Retornou de função
-            stackTop_ = resultSlot;
-            push(result);
+            const Value &src = READ_REG();
+            GlobalSlot &global = globals_[READ_SHORT()];
+            if (global.defined)
+            {
+                RUNTIME_ERROR("Variable '%s' already defined", global.name);
+            }
+            global.value = src;
+            global.defined = true;
+            DISPATCH();
+        }
 
-            // printf("DEBUG: Returning value: ");
-            // printValue(result);
-            // printf("\n");
-            // DumpStack();  // See stack after return
-            frame = &frames_[frameCount_ - 1];
+        CASE_CODE(R_JUMP)
+        {
+            uint16_t target = READ_SHORT();
+            ip = codeBase + target;
+            DISPATCH();
         }
-        break;
-    }
-    case OP_RETURN_NIL:
 
-    {
-        Value *resultSlot = frame->slots; // Save BEFORE decrementing
+        CASE_CODE(R_JUMP_IF_FALSE)
+        {
+            const Value &cond = READ_REG();
+            uint16_t target = READ_SHORT();
+            if (!isTruthy(cond))
+                ip = codeBase + target;
+            DISPATCH();
+        }
 
-        frameCount_--;
-        if (frameCount_ == 0)
+        CASE_CODE(R_JUMP_IF_TRUE)
         {
-            stackTop_ = stack_;
-            push(Value::makeNull());
+            const Value &cond = READ_REG();
+            uint16_t target = READ_SHORT();
+            if (isTruthy(cond))
+                ip = codeBase + target;
+            DISPATCH();
         }
-        else
+
+        CASE_CODE(R_LESS_JUMP_IF_FALSE)
         {
-            stackTop_ = resultSlot; // Use saved value
-            push(Value::makeNull());
-            frame = &frames_[frameCount_ - 1];
+            REG_COMPARE_JUMP(<);
+            DISPATCH();
+        }
+
+        CASE_CODE(R_GREATER_JUMP_IF_FALSE)
+        {
+            REG_COMPARE_JUMP(>);
+            DISPATCH();
+        }
+
+        CASE_CODE(R_EQUAL_JUMP_IF_FALSE)
+        {
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            uint16_t target = READ_SHORT();
+            if (!valuesEqual(a, b))
+                ip = codeBase + target;
+            DISPATCH();
+        }
+
+        CASE_CODE(R_CALL)
+        {
+            uint8_t base = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+            const Value &funcVal = regs[base];
+            if (!funcVal.isFunction())
+            {
+                RUNTIME_ERROR("Attempt to call a non-function value (type: %s)",
+                              TypeName(funcVal.getType()));
+            }
+
+            STORE_FRAME();
+            Function *function = getFunction((uint16_t)funcVal.asFunctionIdx());
+            if (!function)
+            {
+                return false;
+            }
+
+            Value *callee = regs + base;
+            REG_CALL(function, callee, argCount);
+        }
+
+        CASE_CODE(R_CALL_DIRECT)
+        {
+            uint8_t base = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+            Value *callee = regs + base;
+
+            STORE_FRAME();
+            Function *function = directCallee(callee);
+            if (!function)
+            {
+                return false;
+            }
+            REG_CALL(function, callee, argCount);
+        }
+
+        CASE_CODE(R_CALL_NATIVE)
+        {
+            uint8_t base = READ_BYTE();
+            uint8_t index = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+
+            STORE_FRAME();
+            stackTop_ = regs + base + argCount;
+            if (!callNative(index, argCount) || hasFatalError_)
+            {
+                return false;
+            }
+            RELOAD_REGS();
+            regs[base] = stackTop_[-1];
+            DISPATCH();
+        }
+
+        CASE_CODE(R_TAIL_CALL)
+        {
+            uint8_t base = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+            Value *callee = regs + base;
+            if (!callee->isFunction())
+            {
+                RUNTIME_ERROR("Attempt to call a non-function value (type: %s)",
+                              TypeName(callee->getType()));
+            }
+
+            STORE_FRAME();
+            Function *function = getFunction((uint16_t)callee->asFunctionIdx());
+            if (!function)
+            {
+                return false;
+            }
+
+            REG_TAIL_CALL(function, callee, argCount);
+        }
+
+        CASE_CODE(R_TAIL_CALL_DIRECT)
+        {
+            uint8_t base = READ_BYTE();
+            uint8_t argCount = READ_BYTE();
+            Value *callee = regs + base;
+
+            STORE_FRAME();
+            Function *function = directCallee(callee);
+            if (!function)
+            {
+                return false;
+            }
+            REG_TAIL_CALL(function, callee, argCount);
+        }
+
+        CASE_CODE(R_RETURN)
+        {
+            RETURN_VALUE(READ_REG());
+        }
+
+        CASE_CODE(R_RETURN_NIL)
+        {
+            RETURN_VALUE(Value::makeNull());
+        }
+
+        CASE_CODE(R_PRINT)
+        {
+            printValue(READ_REG());
+            printf("\n");
+            DISPATCH();
+        }
+
+        // ===== Intrinsics =====
+
+        CASE_CODE(R_SQRT)
+        {
+            Value &dst = READ_REG();
+            dst = sqrtValue(READ_REG());
+            DISPATCH();
+        }
+
+        CASE_CODE(R_ABS)
+        {
+            Value &dst = READ_REG();
+            dst = absValue(READ_REG());
+            DISPATCH();
+        }
+
+        CASE_CODE(R_POW)
+        {
+            Value &dst = READ_REG();
+            const Value &a = READ_REG();
+            const Value &b = READ_REG();
+            dst = powValues(a, b);
+            DISPATCH();
+        }
+
+        CASE_CODE(R_LEN)
+        {
+            Value &dst = READ_REG();
+            dst = lenValue(READ_REG());
+            DISPATCH();
+        }
+
+        CASE_CODE(R_STR)
+        {
+            Value &dst = READ_REG();
+            dst = strValue(READ_REG());
+            DISPATCH();
+        }
+
+        CASE_UNKNOWN
+        {
+            RUNTIME_ERROR("Unknown register opcode: %d", instruction);
         }
-        break;
-    }
-    default:
-        runtimeError("Unknown opcode: %d", instruction);
-        return false;
     }
 
+    return false;
+
+#undef STORE_FRAME
+#undef LOAD_FRAME
+#undef RUNTIME_ERROR
 #undef READ_BYTE
 #undef READ_SHORT
+#undef READ_REG
+#undef RETURN_VALUE
+#undef REG_CALL
+#undef RELOAD_REGS
+#undef REG_TAIL_CALL
 #undef READ_CONSTANT
-#undef READ_STRING
 #undef READ_STRING_PTR
-
-    return true;
+#undef IS_NUMBER
+#undef AS_NUMBER
+#undef REG_NUMBER_OP
+#undef REG_COMPARE_OP
+#undef REG_COMPARE_JUMP
+#undef INTERPRET_LOOP
+#undef CASE_CODE
+#undef CASE_UNKNOWN
+#undef DISPATCH
 }
+DISPATCH_LOOP_END
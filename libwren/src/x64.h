@@ -0,0 +1,334 @@
+#pragma once
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Partilhado pelo JIT baseline (jit.cpp) e pelo tracing JIT (tracer.cpp).
+// Só se inclui dentro de #if WREN_JIT_ENABLED.
+
+namespace x64
+{
+
+// ============================================
+// ASSEMBLER x86-64
+// ============================================
+// Só as formas que os stencils usam. Memória é sempre [base + disp32].
+
+enum Reg
+{
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+    R8 = 8,
+    R9 = 9,
+    R10 = 10,
+    R11 = 11,
+    R12 = 12,
+    R13 = 13,
+    R14 = 14,
+    R15 = 15
+};
+
+enum Cond
+{
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_A = 0x7,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF
+};
+
+// Operações ALU reg, reg (opcode "r/m32, r32")
+enum AluOp
+{
+    ALU_ADD = 0x01,
+    ALU_SUB = 0x29,
+    ALU_CMP = 0x39,
+    ALU_TEST = 0x85
+};
+
+class Assembler
+{
+public:
+    std::vector<uint8_t> code;
+
+    int here() const { return (int)code.size(); }
+
+    void byte(uint8_t b) { code.push_back(b); }
+
+    void dword(uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            byte((uint8_t)(v >> (i * 8)));
+    }
+
+    void qword(uint64_t v)
+    {
+        for (int i = 0; i < 8; i++)
+            byte((uint8_t)(v >> (i * 8)));
+    }
+
+    void load64(int reg, int base, int32_t disp) { op(true, 0x8B, reg, base, disp); }
+    void store64(int base, int32_t disp, int reg) { op(true, 0x89, reg, base, disp); }
+    void load32(int reg, int base, int32_t disp) { op(false, 0x8B, reg, base, disp); }
+
+    // movzx r32, byte [base + disp]
+    void load8(int reg, int base, int32_t disp)
+    {
+        rex(false, reg, base);
+        byte(0x0F);
+        byte(0xB6);
+        mem(reg, base, disp);
+    }
+
+    // imm32 com extensão de sinal para 64 bits
+    void store64Imm(int base, int32_t disp, int32_t imm)
+    {
+        op(true, 0xC7, 0, base, disp);
+        dword((uint32_t)imm);
+    }
+
+    void cmp32Imm(int base, int32_t disp, uint32_t imm)
+    {
+        op(false, 0x81, 7, base, disp);
+        dword(imm);
+    }
+
+    void cmp8Imm(int base, int32_t disp, uint8_t imm)
+    {
+        op(false, 0x80, 7, base, disp);
+        byte(imm);
+    }
+
+    void movImm64(int reg, uint64_t imm)
+    {
+        rex(true, 0, reg);
+        byte(0xB8 + (reg & 7));
+        qword(imm);
+    }
+
+    void mov32(int dst, int src)
+    {
+        rex(false, src, dst);
+        byte(0x89);
+        modrm(src, dst);
+    }
+
+    // Zera os 32 bits de cima, como qualquer operação de 32 bits
+    void movImm32(int reg, int32_t imm)
+    {
+        rex(false, 0, reg);
+        byte(0xB8 + (reg & 7));
+        dword((uint32_t)imm);
+    }
+
+    void sub32MemImm(int base, int32_t disp, int32_t imm)
+    {
+        op(false, 0x81, 5, base, disp);
+        dword((uint32_t)imm);
+    }
+
+    void mov64(int dst, int src)
+    {
+        rex(true, src, dst);
+        byte(0x89);
+        modrm(src, dst);
+    }
+
+    void add64Imm(int reg, int32_t imm) { aluImm(true, 0, reg, imm); }
+    void sub64Imm(int reg, int32_t imm) { aluImm(true, 5, reg, imm); }
+    void add32Imm(int reg, int32_t imm) { aluImm(false, 0, reg, imm); }
+    void sub32Imm(int reg, int32_t imm) { aluImm(false, 5, reg, imm); }
+    void xor32Imm(int reg, int32_t imm) { aluImm(false, 6, reg, imm); }
+    void cmpReg32Imm(int reg, int32_t imm) { aluImm(false, 7, reg, imm); }
+
+    void alu32(AluOp opcode, int dst, int src)
+    {
+        rex(false, src, dst);
+        byte(opcode);
+        modrm(src, dst);
+    }
+
+    void imul32(int dst, int src)
+    {
+        rex(false, dst, src);
+        byte(0x0F);
+        byte(0xAF);
+        modrm(dst, src);
+    }
+
+    void imul32Imm(int dst, int src, int32_t imm)
+    {
+        rex(false, dst, src);
+        byte(0x69);
+        modrm(dst, src);
+        dword((uint32_t)imm);
+    }
+
+    void or64(int dst, int src)
+    {
+        rex(true, src, dst);
+        byte(0x09);
+        modrm(src, dst);
+    }
+
+    void shl64Imm(int reg, uint8_t count)
+    {
+        rex(true, 0, reg);
+        byte(0xC1);
+        modrm(4, reg);
+        byte(count);
+    }
+
+    void neg32(int reg)
+    {
+        rex(false, 0, reg);
+        byte(0xF7);
+        modrm(3, reg);
+    }
+
+    // cdq; idiv r32: edx:eax / reg -> eax, resto em edx
+    void idiv32(int reg)
+    {
+        byte(0x99);
+        rex(false, 0, reg);
+        byte(0xF7);
+        modrm(7, reg);
+    }
+
+    // setcc al/cl/dl/bl + movzx: reg fica 0 ou 1 (só registos 0-3)
+    void setBool(int cc, int reg)
+    {
+        byte(0x0F);
+        byte(0x90 | cc);
+        modrm(0, reg);
+        byte(0x0F);
+        byte(0xB6);
+        modrm(reg, reg);
+    }
+
+    // Saltos rel32 a remendar: devolvem a posição a seguir ao salto
+    int jcc(int cc)
+    {
+        byte(0x0F);
+        byte(0x80 | cc);
+        dword(0);
+        return here();
+    }
+
+    int jmp()
+    {
+        byte(0xE9);
+        dword(0);
+        return here();
+    }
+
+    void patch(int end, int target)
+    {
+        int32_t rel = target - end;
+        memcpy(&code[end - 4], &rel, 4);
+    }
+
+    void jmpReg(int reg)
+    {
+        rex(false, 0, reg);
+        byte(0xFF);
+        modrm(4, reg);
+    }
+
+    void push(int reg)
+    {
+        rex(false, 0, reg);
+        byte(0x50 + (reg & 7));
+    }
+
+    void pop(int reg)
+    {
+        rex(false, 0, reg);
+        byte(0x58 + (reg & 7));
+    }
+
+    void ret() { byte(0xC3); }
+
+private:
+    void rex(bool w, int reg, int base)
+    {
+        uint8_t prefix = 0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3);
+        if (prefix != 0x40)
+            byte(prefix);
+    }
+
+    void modrm(int reg, int rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+    void mem(int reg, int base, int32_t disp)
+    {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            byte(0x24); // SIB para rsp/r12
+        dword((uint32_t)disp);
+    }
+
+    void op(bool w, uint8_t opcode, int reg, int base, int32_t disp)
+    {
+        rex(w, reg, base);
+        byte(opcode);
+        mem(reg, base, disp);
+    }
+
+    void aluImm(bool w, int ext, int reg, int32_t imm)
+    {
+        rex(w, 0, reg);
+        byte(0x81);
+        modrm(ext, reg);
+        dword((uint32_t)imm);
+    }
+};
+
+// ============================================
+// LAYOUT DO VALUE
+// ============================================
+// TAG_DISP: dword que identifica o tipo (type no union, metade alta no
+// NaN-boxing); PAYLOAD_DISP: o int/bool.
+//
+// Os valores escrevem-se sempre em qwords inteiros e copiam-se qword a
+// qword: um load que apanhe dois stores (ou um store mais estreito) não
+// tem store forwarding e custa ~15 ciclos por instrução.
+
+const int VALUE_SIZE = (int)sizeof(Value);
+
+#if WREN_NAN_TAGGING
+const int TAG_DISP = 4;
+const int PAYLOAD_DISP = 0;
+const uint32_t TAG_INT = Value::INT_HIGH;
+const uint32_t TAG_FUNCTION = Value::FUNCTION_HIGH;
+const uint32_t TAG_NULL = (uint32_t)(Value::NULL_VAL >> 32);
+const uint32_t TAG_FALSE = (uint32_t)(Value::FALSE_VAL >> 32);
+const uint32_t TAG_TRUE = (uint32_t)(Value::TRUE_VAL >> 32);
+#else
+const int TAG_DISP = (int)offsetof(Value, type);
+const int PAYLOAD_DISP = (int)offsetof(Value, as);
+const uint32_t TAG_INT = VAL_INT;
+const uint32_t TAG_FUNCTION = VAL_FUNCTION;
+#endif
+
+// ============================================
+// MEMÓRIA EXECUTÁVEL / PERF
+// ============================================
+
+// Copia o código para páginas RX; size devolve o tamanho mapeado
+uint8_t *install(const std::vector<uint8_t> &machine, size_t &size);
+void uninstall(uint8_t *memory, size_t size);
+
+// Uma linha "início tamanho nome" em /tmp/perf-PID.map
+void writePerfMap(const uint8_t *start, size_t length, const char *name);
+
+} // namespace x64
@@ -214,8 +214,18 @@ int main(int argc, char **argv)
     // if (argc > 1)
     // {
         // Modo script
+        // -O liga o middle end SSA; o resto é o ficheiro (main.cc por omissão)
         VM vm;
-        std::ifstream file("main.cc");
+        std::string path = "main.cc";
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "-O")
+                vm.setOptimize(true);
+            else
+                path = arg;
+        }
+        std::ifstream file(path);
         std::string code((std::istreambuf_iterator<char>(file)),
                          std::istreambuf_iterator<char>());
         vm.interpret(code);
@@ -77,9 +77,9 @@ void benchAddFunction() {
     // Cria função add
     Function* addFunc = new Function("add", 2);
     addFunc->chunk.write(OP_GET_LOCAL, 1);
-    addFunc->chunk.write(0, 1);
-    addFunc->chunk.write(OP_GET_LOCAL, 1);
     addFunc->chunk.write(1, 1);
+    addFunc->chunk.write(OP_GET_LOCAL, 1);
+    addFunc->chunk.write(2, 1);
     addFunc->chunk.write(OP_ADD, 1);
     addFunc->chunk.write(OP_RETURN, 1);
     
@@ -142,7 +142,7 @@ void benchFibonacci() {
     
     // if (n < 2) return n;
     chunk.write(OP_GET_LOCAL, 1);
-    chunk.write(0, 1);
+    chunk.write(1, 1);
     int idx = chunk.addConstant(Value::makeInt(2));
     chunk.write(OP_CONSTANT, 1);
     chunk.write(idx, 1);
@@ -153,7 +153,7 @@ void benchFibonacci() {
     chunk.write(0, 1);
     chunk.write(OP_POP, 1);
     chunk.write(OP_GET_LOCAL, 1);
-    chunk.write(0, 1);
+    chunk.write(1, 1);
     chunk.write(OP_RETURN, 1);
     
     int offset = chunk.count() - elseJump - 2;
@@ -163,7 +163,7 @@ void benchFibonacci() {
     
     // return fib(n-1) + fib(n-2);
     chunk.write(OP_GET_LOCAL, 1);
-    chunk.write(0, 1);
+    chunk.write(1, 1);
     idx = chunk.addConstant(Value::makeInt(1));
     chunk.write(OP_CONSTANT, 1);
     chunk.write(idx, 1);
@@ -174,7 +174,7 @@ void benchFibonacci() {
     chunk.write(1, 1);
     
     chunk.write(OP_GET_LOCAL, 1);
-    chunk.write(0, 1);
+    chunk.write(1, 1);
     idx = chunk.addConstant(Value::makeInt(2));
     chunk.write(OP_CONSTANT, 1);
     chunk.write(idx, 1);
@@ -252,6 +252,131 @@ void benchStackOps() {
 }
 
 
+// ============================================
+// BENCHMARK 5: Superinstructions
+// ============================================
+// sum(n): acc += i para i em [0, n). A mesma função montada duas vezes,
+// com a sequência clássica e com as superinstructions.
+struct ChunkBuilder {
+    Chunk& chunk;
+
+    void op(uint8_t byte) { chunk.write(byte, 1); }
+    void op(uint8_t byte, uint8_t operand) { op(byte); op(operand); }
+
+    int jump(uint8_t instruction) {
+        op(instruction);
+        op(0xff);
+        op(0xff);
+        return (int)chunk.count() - 2;
+    }
+
+    void patch(int offset) {
+        int jump = (int)chunk.count() - offset - 2;
+        chunk.code[offset] = (jump >> 8) & 0xff;
+        chunk.code[offset + 1] = jump & 0xff;
+    }
+
+    void loop(int start) {
+        op(OP_LOOP);
+        int offset = (int)chunk.count() - start + 2;
+        op((offset >> 8) & 0xff);
+        op(offset & 0xff);
+    }
+};
+
+static Function* buildSum(bool fused) {
+    Function* fn = new Function(fused ? "sum_fused" : "sum_plain", 1);
+    ChunkBuilder b{fn->chunk};
+    uint8_t zero = (uint8_t)fn->chunk.addConstant(Value::makeInt(0));
+    uint8_t one = (uint8_t)fn->chunk.addConstant(Value::makeInt(1));
+
+    // slot 0 = callee, slot 1 = n, slot 2 = i, slot 3 = acc
+    b.op(OP_CONSTANT, zero);
+    b.op(OP_CONSTANT, zero);
+
+    int loopStart = (int)fn->chunk.count();
+    b.op(OP_GET_LOCAL, 2);
+    b.op(OP_GET_LOCAL, 1);
+    int exitJump;
+    if (fused) {
+        exitJump = b.jump(OP_JUMP_IF_NOT_LESS);
+        b.op(OP_ADD_LOCALS, 3);
+        b.op(2);
+        b.op(OP_SET_LOCAL, 3);
+        b.op(OP_POP);
+        b.op(OP_INC_LOCAL, 2);
+    } else {
+        b.op(OP_LESS);
+        exitJump = b.jump(OP_JUMP_IF_FALSE);
+        b.op(OP_POP);
+        b.op(OP_GET_LOCAL, 3);
+        b.op(OP_GET_LOCAL, 2);
+        b.op(OP_ADD);
+        b.op(OP_SET_LOCAL, 3);
+        b.op(OP_POP);
+        b.op(OP_GET_LOCAL, 2);
+        b.op(OP_CONSTANT, one);
+        b.op(OP_ADD);
+        b.op(OP_SET_LOCAL, 2);
+        b.op(OP_POP);
+    }
+    b.loop(loopStart);
+    b.patch(exitJump);
+    if (!fused) {
+        b.op(OP_POP);
+    }
+    b.op(OP_GET_LOCAL, 3);
+    b.op(OP_RETURN);
+    return fn;
+}
+
+static double timeSum(VM& vm, const char* name, int n, int calls, int* result) {
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < calls; i++) {
+        vm.GetGlobal(name);
+        vm.PushInt(n);
+        vm.Call(1, 1);
+        *result = vm.Pop().asInt();
+    }
+    auto end = high_resolution_clock::now();
+    return duration_cast<microseconds>(end - start).count() / 1000.0;
+}
+
+bool benchSuperinstructions() {
+    printf("\n╔════════════════════════════════════╗\n");
+    printf("║   BENCHMARK: Superinstructions     ║\n");
+    printf("╚════════════════════════════════════╝\n\n");
+
+    VM vm;
+
+    Function* plain = buildSum(false);
+    Function* fused = buildSum(true);
+    Debug::disassembleChunk(fused->chunk, "sum_fused");
+
+    vm.Push(Value::makeFunction(vm.registerFunction("sum_plain", plain)));
+    vm.SetGlobal("sum_plain");
+    vm.Push(Value::makeFunction(vm.registerFunction("sum_fused", fused)));
+    vm.SetGlobal("sum_fused");
+
+    const int N = 10000;
+    const int CALLS = 200;
+    const int expected = N * (N - 1) / 2;
+    int plainResult = 0;
+    int fusedResult = 0;
+
+    printf("\nRunning %d calls of sum(%d)...\n", CALLS, N);
+    double plainMs = timeSum(vm, "sum_plain", N, CALLS, &plainResult);
+    double fusedMs = timeSum(vm, "sum_fused", N, CALLS, &fusedResult);
+
+    bool ok = plainResult == expected && fusedResult == expected;
+
+    printf("\n📊 Results:\n");
+    printf("  Plain:   %.2f ms (sum = %d)\n", plainMs, plainResult);
+    printf("  Fused:   %.2f ms (sum = %d)\n", fusedMs, fusedResult);
+    printf("  Speedup: %.2fx\n", plainMs / fusedMs);
+    printf("  %s\n", ok ? "✅ Results match" : "❌ Results differ");
+    return ok;
+}
 
 // ============================================
 // MAIN
@@ -266,6 +391,7 @@ int main() {
     benchAddFunction();
     benchFibonacci();
     benchStackOps();
+    bool ok = benchSuperinstructions();
     
     printf("\n╔════════════════════════════════════════════════╗\n");
     printf("║            BENCHMARKS COMPLETE                 ║\n");
@@ -276,5 +402,5 @@ int main() {
     printf("  Python 3.12: 20M empty calls/sec\n");
     printf("  Your VM:     Check results above!\n");
     
-    return 0;
+    return ok ? 0 : 1;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "compiler.h"
 #include "vm.h"
+#include "stringpool.h"
+#include "jit.h"
+#include "tracer.h"
+#include "verifier.h"
 #include <iostream>
 #include <cassert>
 #include <cmath>
@@ -160,9 +164,11 @@ Value executeProgram(const std::string &code)
     printValue(ret);
     return ret;
 }
-Value executeProgram(const std::string &code, const std::string &varName)
+Value executeProgram(const std::string &code, const std::string &varName,
+                     ExecutionMode mode = ExecutionMode::Stack)
 {
     VM vm;
+    vm.setExecutionMode(mode);
     InterpretResult result = vm.interpret(code);
     if (result != InterpretResult::OK)
     {
@@ -220,6 +226,42 @@ TEST(function_mutual_recursion)
     ASSERT_TRUE(result.asBool());
 }
 
+TEST(function_locals_survive_nested_calls)
+{
+    std::string code = R"(
+        def g(x) { var t = x + 1; return t * 2; }
+        def f(a) {
+            var b = a * 2;
+            var c = g(b);
+            return a + b + c;
+        }
+        var result = f(3) + g(f(1));
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 3 + 6 + 14 + 2 * (1 + 2 + 6 + 1));
+}
+
+TEST(function_call_from_host_keeps_stack_balanced)
+{
+    VM vm;
+    ASSERT_TRUE(vm.interpret("def add(a, b) { return a + b; }") == InterpretResult::OK);
+    vm.Pop();
+
+    int top = vm.GetTop();
+    vm.GetGlobal("add");
+    vm.PushInt(10);
+    vm.PushInt(20);
+    vm.Call(2, 1);
+    ASSERT_EQ(vm.GetTop(), top + 1);
+    ASSERT_EQ(vm.Pop().asInt(), 30);
+
+    vm.GetGlobal("add");
+    vm.PushInt(1);
+    vm.PushInt(2);
+    vm.Call(2, 0);
+    ASSERT_EQ(vm.GetTop(), top);
+}
+
 TEST(if_statement_true_branch)
 {
     std::string code = R"(
@@ -484,6 +526,26 @@ TEST(while_with_continue)
     ASSERT_EQ(result.asInt(), 50); // 1+2+3+4+6+7+8+9+10 = 50 (sem o 5)
 }
 
+TEST(while_break_keeps_stack_balanced)
+{
+    std::string code = R"(
+        def count() {
+            var i = 0;
+            while (true) {
+                i = i + 1;
+                if (i == 3) {
+                    break;
+                }
+            }
+            return i;
+        }
+        var base = 10;
+        var result = base + count();
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 13);
+}
+
 TEST(function_with_if_statement)
 {
     std::string code = R"(
@@ -651,6 +713,1757 @@ TEST(if_with_modulo)
     ASSERT_EQ(result.asInt(), 1);
 }
 
+// ============================================
+// TESTES DE REPRESENTAÇÃO DE VALORES
+// ============================================
+
+TEST(value_roundtrip_all_types)
+{
+    ASSERT_TRUE(Value::makeNull().isNull());
+    ASSERT_TRUE(Value().isNull());
+    ASSERT_TRUE(Value::makeBool(true).asBool());
+    ASSERT_FALSE(Value::makeBool(false).asBool());
+    ASSERT_TRUE(Value::makeBool(false).isBool());
+    ASSERT_EQ(Value::makeInt(-123456).asInt(), -123456);
+    ASSERT_TRUE(Value::makeInt(0).isInt());
+    ASSERT_FALSE(Value::makeInt(0).isDouble());
+    ASSERT_DOUBLE_EQ(Value::makeDouble(-2.5).asDouble(), -2.5);
+    ASSERT_TRUE(Value::makeDouble(0.0).isDouble());
+    ASSERT_TRUE(Value::makeDouble(0.0 / 0.0).isDouble());
+    ASSERT_TRUE(Value::makeDouble(-(0.0 / 0.0)).isDouble());
+    ASSERT_EQ(Value::makeFunction(65535).asFunctionIdx(), 65535);
+    ASSERT_TRUE(Value::makeFunction(3).isFunction());
+    ASSERT_FALSE(Value::makeFunction(3).isInt());
+
+    Value s = Value::makeString("hello");
+    ASSERT_TRUE(s.isString());
+    ASSERT_EQ(std::string(s.asString()), std::string("hello"));
+    ASSERT_TRUE(s.asString() == Value::makeString("hello").asString());
+    ASSERT_TRUE(s.getType() == VAL_STRING);
+}
+
+TEST(value_nan_arithmetic_stays_double)
+{
+    std::string code = R"(
+        var zero = 0.0;
+        var x = zero / 1.0;
+        var result = (x - x) + 1.5;
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_TRUE(result.isDouble());
+    ASSERT_DOUBLE_EQ(result.asDouble(), 1.5);
+}
+
+// ============================================
+// TESTES DE QUICKENING
+// ============================================
+
+// Percorre instrução a instrução: um operando igual ao opcode não conta
+static bool chunkHasOp(const Chunk &chunk, uint8_t op)
+{
+    StackInstruction info;
+    for (int offset = 0; offset < (int)chunk.count(); offset += info.length)
+    {
+        if (!Verifier::decode(chunk, offset, info))
+            return false;
+        if (chunk.code[offset] == op)
+            return true;
+    }
+    return false;
+}
+
+TEST(quickening_specialises_int_add)
+{
+    VM vm;
+    // id(b) evita a fusão em OP_ADD_LOCALS: fica o OP_ADD genérico
+    std::string code = R"(
+        def id(x) { return x; }
+        def add(a, b) { return a + id(b); }
+        var result = add(1, 2);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    Function *add = vm.getFunction(StringPool::instance().intern("add"));
+    ASSERT_TRUE(add != nullptr);
+    ASSERT_TRUE(chunkHasOp(add->chunk, OP_ADD_INT));
+    ASSERT_FALSE(chunkHasOp(add->chunk, OP_ADD));
+}
+
+TEST(quickening_guard_falls_back_on_type_change)
+{
+    std::string code = R"(
+        def id(x) { return x; }
+        def add(a, b) { return a + id(b); }
+        def less(a, b) { return a < b; }
+        var i = add(1, 2);
+        var d = add(1.5, 2.0);
+        var s = add("ab", "cd");
+        var m = add(1, 0.5);
+        var i2 = add(20, 22);
+        var c1 = less(1, 2);
+        var c2 = less(2.5, 1.5);
+        var c3 = less(1, 1.5);
+        var result = 0;
+        if (i == 3 && d == 3.5 && s == "abcd" && m == 1.5 && i2 == 42) {
+            result = 1;
+        }
+        if (c1 && !c2 && c3) {
+            result = result + 1;
+        }
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 2);
+}
+
+TEST(quickening_in_loop_with_mixed_accumulator)
+{
+    std::string code = R"(
+        var total = 0;
+        for (var i = 0; i < 10; i++) {
+            if (i == 5) {
+                total = total + 0.5;
+            }
+            total = total + i;
+        }
+    )";
+    Value result = executeProgram(code, "total");
+    ASSERT_TRUE(result.isDouble());
+    ASSERT_DOUBLE_EQ(result.asDouble(), 45.5);
+}
+
+// ============================================
+// TESTES DE SUPERINSTRUCTIONS
+// ============================================
+
+TEST(superinstructions_emitted_for_common_sequences)
+{
+    VM vm;
+    std::string code = R"(
+        def sum(a, b) { return a + b; }
+        def dec(n) { return n - 1; }
+        def count(n) {
+            var c = 0;
+            var i = 0;
+            while (i < n) { c += 0.5; i++; }
+            return c;
+        }
+        var r = sum(1, 2) + dec(5) + count(3);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    StringPool &pool = StringPool::instance();
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("sum"))->chunk, OP_ADD_LOCALS));
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("dec"))->chunk, OP_SUBTRACT_IMM));
+
+    const Chunk &loop = vm.getFunction(pool.intern("count"))->chunk;
+    ASSERT_TRUE(chunkHasOp(loop, OP_JUMP_IF_NOT_LESS));
+    ASSERT_TRUE(chunkHasOp(loop, OP_INC_LOCAL));
+    ASSERT_TRUE(chunkHasOp(loop, OP_ADD_CONST));
+}
+
+TEST(superinstructions_keep_generic_semantics)
+{
+    std::string code = R"(
+        def cat(a, b) { return a + b; }
+        def step(x) { x++; x += 0.5; return x; }
+        def same(a, b) { if (a == b) { return 1; } return 0; }
+        var result = 0;
+        if (cat("ab", "cd") == "abcd") { result = result + 1; }
+        if (cat(1, 0.5) == 1.5) { result = result + 1; }
+        if (step(1) == 2.5) { result = result + 1; }
+        if (same("x", "x") + same(1, 1.0) + same(nil, nil) == 2) { result = result + 1; }
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 4);
+}
+
+TEST(superinstructions_not_fused_across_jump_target)
+{
+    // O salto do && cai entre os dois operandos do +
+    std::string code = R"(
+        def f(a, b) { var t = a && b; return t + b; }
+        def g(a, b) { return (a && b) + b; }
+        var result = f(true, 1) + g(2, 3);
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 8);
+}
+
+TEST(prefix_increment_leaves_one_value)
+{
+    std::string code = R"(
+        var g = 0;
+        var result = 0;
+        for (var i = 0; i < 300; ++i) { ++g; --g; ++g; }
+        result = g;
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_EQ(result.asInt(), 300);
+}
+
+// ============================================
+// TESTES DE TAIL CALLS
+// ============================================
+
+TEST(tail_call_emitted_only_in_tail_position)
+{
+    VM vm;
+    std::string code = R"(
+        def id(x) { return x; }
+        def tail(x) { return id(x); }
+        def notTail(x) { return id(x) + 1; }
+        def guarded(x) { return x && id(x); }
+        var r = tail(1) + notTail(1) + guarded(1);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    StringPool &pool = StringPool::instance();
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("tail"))->chunk, OP_TAIL_CALL_DIRECT));
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("notTail"))->chunk, OP_TAIL_CALL_DIRECT));
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("guarded"))->chunk, OP_TAIL_CALL_DIRECT));
+}
+
+TEST(tail_call_runs_in_constant_frames)
+{
+    // Muito mais fundo que FRAMES_MAX
+    std::string code = R"(
+        def sum(n, acc) {
+            if (n == 0) { return acc; }
+            return sum(n - 1, acc + n);
+        }
+        def ping(n) { if (n == 0) { return 1; } return pong(n - 1); }
+        def pong(n) { if (n == 0) { return 2; } return ping(n - 1); }
+        var result = sum(10000, 0) + ping(5001);
+    )";
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Stack).asInt(), 50005000 + 2);
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Register).asInt(), 50005000 + 2);
+}
+
+// ============================================
+// TESTES DE CALLS DIRETAS
+// ============================================
+
+TEST(direct_call_emitted_for_known_functions)
+{
+    VM vm;
+    std::string code = R"(
+        def fact(n) { if (n <= 1) { return 1; } return n * fact(n - 1); }
+        def viaVar(n) { var g = fact; return g(n) + 0; }
+        var result = fact(5) + viaVar(3);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    StringPool &pool = StringPool::instance();
+    const Chunk &fact = vm.getFunction(pool.intern("fact"))->chunk;
+    ASSERT_TRUE(chunkHasOp(fact, OP_CALL_DIRECT));
+    ASSERT_FALSE(chunkHasOp(fact, OP_GET_GLOBAL));
+
+    const Chunk &viaVar = vm.getFunction(pool.intern("viaVar"))->chunk;
+    ASSERT_TRUE(chunkHasOp(viaVar, OP_CALL));
+    ASSERT_FALSE(chunkHasOp(viaVar, OP_CALL_DIRECT));
+
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 126);
+}
+
+TEST(direct_call_follows_reassigned_global)
+{
+    std::string code = R"(
+        def one() { return 1; }
+        def two() { return 2; }
+        def callOne() { return one() * 10; }
+        def tailOne() { return one(); }
+        var result = callOne() + tailOne();
+        one = two;
+        result = result * 100 + callOne() + tailOne();
+    )";
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Stack).asInt(), 1100 + 22);
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Register).asInt(), 1100 + 22);
+
+    VM vm;
+    std::string bad = R"(
+        def f() { return 1; }
+        def g() { return f(); }
+        f = 3;
+        var result = g();
+    )";
+    ASSERT_TRUE(vm.interpret(bad) == InterpretResult::RUNTIME_ERROR);
+}
+
+// ============================================
+// TESTES DE NATIVES
+// ============================================
+
+static Value nativeBump(VM *vm, int argCount, Value *args, void *userdata)
+{
+    (void)vm;
+    (void)argCount;
+    int *counter = static_cast<int *>(userdata);
+    *counter += args[0].asInt();
+    return Value::makeInt(*counter);
+}
+
+TEST(native_receives_userdata)
+{
+    for (ExecutionMode mode : {ExecutionMode::Stack, ExecutionMode::Register})
+    {
+        int counter = 0;
+        VM vm;
+        vm.setExecutionMode(mode);
+        vm.registerNative("bump", 1, nativeBump, &counter);
+
+        std::string code = R"(
+            def run(n) {
+                var last = 0;
+                for (var i = 0; i < n; i++) { last = bump(2); }
+                return last + abs(-1);
+            }
+            var result = run(10);
+        )";
+        ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+        ASSERT_EQ(counter, 20);
+        vm.GetGlobal("result");
+        ASSERT_EQ(vm.Pop().asInt(), 21);
+    }
+}
+
+// Empilha mais do que STACK_INITIAL: a stack muda de sítio a meio da native
+static Value nativePushMany(VM *vm, int argCount, Value *args, void *userdata)
+{
+    (void)userdata;
+    for (int i = 0; i < VM::STACK_INITIAL + 144; i++)
+        vm->PushInt(i);
+    for (int i = 0; i < VM::STACK_INITIAL + 144; i++)
+        vm->Pop();
+    int sum = 0;
+    for (int i = 0; i < argCount; i++)
+        sum += args[i].asInt();
+    return Value::makeInt(sum);
+}
+
+TEST(native_args_survive_stack_growth)
+{
+    for (ExecutionMode mode : {ExecutionMode::Stack, ExecutionMode::Register})
+    {
+        VM vm;
+        vm.setExecutionMode(mode);
+        vm.registerNative("many", -1, nativePushMany, nullptr);
+
+        std::string code = R"(
+            def run() { return many(40, 2) + many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10) * 100; }
+            var result = run();
+        )";
+        ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+        vm.GetGlobal("result");
+        ASSERT_EQ(vm.Pop().asInt(), 42 + 5500);
+    }
+}
+
+TEST(native_arity_checked_at_compile_time)
+{
+    VM vm;
+    ASSERT_TRUE(vm.interpret("var x = sqrt(1, 2);") == InterpretResult::COMPILE_ERROR);
+    ASSERT_TRUE(vm.interpret("var x = len(\"abc\");") == InterpretResult::OK);
+}
+
+TEST(intrinsics_emitted_for_hot_builtins)
+{
+    VM vm;
+    std::string code = R"(
+        def f(x) { return sqrt(x) + abs(x) + pow(x, 2) + len(str(x)); }
+        var r = f(4);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_SQRT));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_ABS));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_POW));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_LEN));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_STR));
+    ASSERT_FALSE(chunkHasOp(chunk, OP_CALL_NATIVE));
+}
+
+TEST(intrinsics_keep_native_semantics)
+{
+    std::string code = R"(
+        def check() {
+            var ok = 0;
+            if (sqrt(16) == 4.0) { ok = ok + 1; }
+            if (sqrt(2.25) == 1.5) { ok = ok + 1; }
+            if (abs(-3) == 3 && abs(-2.5) == 2.5) { ok = ok + 1; }
+            if (pow(2, 10) == 1024.0) { ok = ok + 1; }
+            if (len("hello") == 5) { ok = ok + 1; }
+            if (str(42) == "42") { ok = ok + 1; }
+            if (sqrt("x") == nil && len(3) == nil) { ok = ok + 1; }
+            return ok;
+        }
+        var result = check();
+    )";
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Stack).asInt(), 7);
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Register).asInt(), 7);
+}
+
+// ============================================
+// TESTES DO VERIFIER
+// ============================================
+
+TEST(verifier_computes_max_stack)
+{
+    VM vm;
+    std::string code = R"(
+        def sum3(a, b, c) { return a + (b + (c + 1)); }
+        var result = sum3(1, 2, 3);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    // callee + 3 parâmetros + a, b e c empilhados (c + 1 é OP_ADD_CONST)
+    Function *sum3 = vm.getFunction(StringPool::instance().intern("sum3"));
+    ASSERT_EQ(sum3->maxStack, 7);
+}
+
+TEST(verifier_rejects_malformed_function)
+{
+    VM vm;
+    // POP sem nada empilhado: consumiria o slot do callee
+    Function *bad = new Function("bad", 0);
+    bad->chunk.write(OP_POP, 1);
+    bad->chunk.write(OP_RETURN_NIL, 1);
+    uint16_t idx = vm.registerFunction("bad", bad);
+
+    vm.Push(Value::makeFunction(idx));
+    vm.Call(0, 1);
+    ASSERT_EQ(bad->maxStack, -1);
+    ASSERT_EQ(vm.GetTop(), 0); // runtimeError limpa a stack
+}
+
+TEST(verifier_stack_overflow_checked_per_call)
+{
+    VM vm;
+    std::string code = R"(
+        def deep(n) { return 1 + deep(n + 1); }
+        var result = deep(0);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+}
+
+// ============================================
+// TESTES DA STACK
+// ============================================
+
+TEST(deep_recursion_grows_stack)
+{
+    // Muito mais fundo que STACK_INITIAL e FRAMES_INITIAL, sem tail calls
+    std::string code = R"(
+        def depth(n) { if (n == 0) { return 0; } return 1 + depth(n - 1); }
+        def mixed(n) { if (n == 0) { return sqrt(16); } return mixed(n - 1) + 1; }
+        var result = depth(20000) + mixed(5000);
+    )";
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Stack).asDouble(), 25004.0);
+    ASSERT_EQ(executeProgram(code, "result", ExecutionMode::Register).asDouble(), 25004.0);
+}
+
+TEST(stack_limits_are_configurable)
+{
+    std::string code = R"(
+        def depth(n) { if (n == 0) { return 0; } return 1 + depth(n - 1); }
+        var result = depth(1000);
+    )";
+
+    VM small;
+    small.setStackLimits(VM::STACK_MAX, 500);
+    ASSERT_TRUE(small.interpret(code) == InterpretResult::RUNTIME_ERROR);
+
+    VM tight;
+    tight.setStackLimits(VM::STACK_INITIAL, VM::FRAMES_MAX);
+    ASSERT_TRUE(tight.interpret(code) == InterpretResult::RUNTIME_ERROR);
+
+    VM roomy;
+    roomy.setStackLimits(VM::STACK_MAX, 2000);
+    ASSERT_TRUE(roomy.interpret(code) == InterpretResult::OK);
+}
+
+// ============================================
+// TESTES DO JIT
+// ============================================
+
+Value executeWithJit(const std::string &code, bool jit, const std::string &varName = "result")
+{
+    VM vm;
+    vm.setJitEnabled(jit);
+    if (vm.interpret(code) != InterpretResult::OK)
+    {
+        throw std::runtime_error("Runtime error: " + code);
+    }
+    vm.GetGlobal(varName.c_str());
+    return vm.Pop();
+}
+
+TEST(jit_compiles_hot_functions)
+{
+    VM vm;
+    std::string code = R"(
+        def step(x) { return x + 1; }
+        var result = 0;
+        for (var i = 0; i < 1000; i++) { result = step(result); }
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    Function *step = vm.getFunction(StringPool::instance().intern("step"));
+    ASSERT_EQ(step->jit != nullptr, Jit::isAvailable());
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 1000);
+}
+
+TEST(jit_matches_interpreter)
+{
+    // Cada programa passa o limiar e mistura casos rápidos com saídas
+    // para o interpretador (doubles, strings, natives, erros de tipo)
+    std::vector<std::string> programs = {
+        R"(
+            var result = 0;
+            for (var i = 0; i < 5000; i++) { result += i * 3 - (i % 7) + i / 5; }
+        )",
+        R"(
+            var result = 0;
+            for (var i = 0; i < 3000; i++) {
+                if (i == 1500) { result = result + 0.5; }
+                result = result + 1;
+            }
+        )",
+        R"(
+            var result = "";
+            for (var i = 0; i < 500; i++) { if (i % 100 == 0) { result = result + "x"; } }
+        )",
+        R"(
+            def fib(n) { if (n <= 1) { return n; } return fib(n - 1) + fib(n - 2); }
+            var result = fib(20);
+        )",
+        R"(
+            var result = 0;
+            var j = 1000;
+            while (j) { j--; if (j > 500 && j != 700) { result++; } }
+            var k = -17;
+            result = result * 100 + k / 5 + k % 5 + -k;
+        )",
+        R"(
+            def count(n) { var c = 0; for (var i = 0; i < n; i++) { c += abs(i - 50); } return c; }
+            var result = 0;
+            for (var i = 0; i < 300; i++) { result += count(100); }
+        )",
+        R"(
+            var result = 0;
+            var flag = nil;
+            for (var i = 0; i < 2000; i++) {
+                if (flag) { result += 2; } else { result += 1; }
+                if (i == 999) { flag = true; }
+            }
+        )",
+    };
+
+    for (const std::string &code : programs)
+    {
+        Value interpreted = executeWithJit(code, false);
+        Value jitted = executeWithJit(code, true);
+        ASSERT_EQ(valueToString(jitted), valueToString(interpreted));
+    }
+}
+
+TEST(jit_leaves_errors_to_interpreter)
+{
+    std::string code = R"(
+        def tick(n) { return n + 1; }
+        var result = 0;
+        for (var i = 0; i < 1000; i++) { result = tick(result); }
+        for (var i = 0; i < 1000; i++) { if (i == 900) { result = result / 0; } }
+    )";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+}
+
+TEST(jit_respects_rebound_functions)
+{
+    std::string code = R"(
+        def one() { return 1; }
+        def two() { return 2; }
+        var result = 0;
+        for (var i = 0; i < 1000; i++) {
+            if (i == 500) { one = two; }
+            result += one();
+        }
+    )";
+    ASSERT_EQ(executeWithJit(code, true).asInt(), 500 * 1 + 500 * 2);
+}
+
+TEST(tracer_compiles_hot_loops)
+{
+    VM vm;
+    std::string code = R"(
+        def sum(n) { var s = 0; for (var i = 0; i < n; i++) { s += i; } return s; }
+        var result = sum(100000);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    Function *sum = vm.getFunction(StringPool::instance().intern("sum"));
+    ASSERT_EQ(Tracer::hasTrace(sum), Jit::isAvailable());
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 704982704); // 4999950000 em 32 bits
+}
+
+TEST(tracer_matches_interpreter)
+{
+    // Guards que falham a meio (ramos instáveis, tipos que mudam, divisor
+    // zero evitado), globais em registos, locais do corpo e loops aninhados
+    std::vector<std::string> programs = {
+        R"(
+            var result = 0;
+            for (var i = 0; i < 5000; i++) {
+                if (i % 3 == 0) { result += i; } else { result -= 1; }
+            }
+        )",
+        R"(
+            var result = 0;
+            var a = 0;
+            var b = 1;
+            for (var i = 0; i < 2990; i++) { var t = a; a = b; b = (t + b) % 1000; result = a; }
+        )",
+        R"(
+            var result = 0;
+            for (var i = 0; i < 1000; i++) {
+                if (i == 600) { result = result + 0.25; }
+                result = result + 2;
+            }
+        )",
+        R"(
+            var result = 0;
+            for (var i = 0; i < 100; i++) {
+                for (var j = 0; j < 100; j++) { result = result + i * j - (j / 3); }
+            }
+        )",
+        R"(
+            var result = 0;
+            var on = false;
+            var n = 3000;
+            while (n > 0) {
+                n--;
+                on = !on;
+                if (on == true && n != 5) { result += 3; }
+                if (-n < -2990) { result += 1; }
+            }
+        )",
+        R"(
+            def spin(n) { var c = 0; var k = n; while (k > 0) { k = k - 1; c = c + k % 7; } return c; }
+            var result = 0;
+            for (var r = 0; r < 50; r++) { result += spin(200); }
+        )",
+        R"(
+            var result = 0;
+            for (var i = 1; i < 2000; i++) {
+                var d = 1000 - i;
+                if (d != 0 && d != -1) { result += 100000 / d; }
+            }
+        )",
+    };
+
+    for (const std::string &code : programs)
+    {
+        Value interpreted = executeWithJit(code, false);
+        Value jitted = executeWithJit(code, true);
+        ASSERT_EQ(valueToString(jitted), valueToString(interpreted));
+    }
+}
+
+TEST(tracer_aborts_when_inner_loop_exits)
+{
+    // O loop interior aquece mas só dá 3 voltas: a gravação sai do corpo
+    // e faz pop dos locais de baixo da cabeça antes de voltar a ela
+    std::string code = R"(
+        def k(p) {
+            var a = 0;
+            for (var i = 0; i < 100; i += 1) { for (var j = 0; j < p; ++j) { a += 1; } }
+            return a;
+        }
+        var result = k(3);
+    )";
+    ASSERT_EQ(executeWithJit(code, false).asInt(), 300);
+    ASSERT_EQ(executeWithJit(code, true).asInt(), 300);
+}
+
+// ============================================
+// TESTES DO OPTIMIZER
+// ============================================
+
+// Operando int16 da instrução em offset (PUSH_INT, ADD_IMM, ...)
+static int immediateAt(const Chunk &chunk, int offset)
+{
+    return (int16_t)((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+}
+
+TEST(optimizer_folds_constant_expressions)
+{
+    VM vm;
+    std::string code = R"(
+        def k() { return 2 * 3 + 4; }
+        def s() { return "a" + "b"; }
+        def d() { return 1 / 0; }
+        var r = k();
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    StringPool &pool = StringPool::instance();
+    const Chunk &k = vm.getFunction(pool.intern("k"))->chunk;
+    ASSERT_EQ(k.count(), (size_t)4);
+    ASSERT_EQ(k.code[0], OP_PUSH_INT);
+    ASSERT_EQ(immediateAt(k, 0), 10);
+    ASSERT_EQ(k.lines.size(), k.code.size());
+
+    const Chunk &s = vm.getFunction(pool.intern("s"))->chunk;
+    ASSERT_FALSE(chunkHasOp(s, OP_ADD));
+
+    // A divisão por zero tem de falhar em runtime, não desaparecer
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("d"))->chunk, OP_DIVIDE));
+}
+
+TEST(optimizer_removes_dead_branches_and_unreachable_code)
+{
+    VM vm;
+    std::string code = R"(
+        def h(x) {
+            if (false) { x = x * 100; }
+            while (true) {
+                if (x > 3) { break; }
+                x = x + 1;
+            }
+            return x;
+            x = x * 7;
+        }
+        var r = h(0);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    const Chunk &h = vm.getFunction(StringPool::instance().intern("h"))->chunk;
+    ASSERT_FALSE(chunkHasOp(h, OP_MULTIPLY));
+    ASSERT_FALSE(chunkHasOp(h, OP_TRUE));
+    ASSERT_FALSE(chunkHasOp(h, OP_FALSE));
+    ASSERT_EQ(h.lines.size(), h.code.size());
+}
+
+TEST(optimizer_keeps_branch_semantics)
+{
+    // Condições negadas, elif em cadeia, && e || e ramos constantes
+    std::string code = R"(
+        def g(x) {
+            if (x == 1) { return 10; } elif (x == 2) { return 20; } elif (x == 3) { return 30; }
+            return 40;
+        }
+        def n(a, b) {
+            var c = 0;
+            if (!(a == b)) { c = c + 1; }
+            if (!(a < b)) { c = c + 10; }
+            if (!!(a > 0) && !(b < 0)) { c = c + 100; }
+            if (a == 0 || !(b != 2)) { c = c + 1000; }
+            return c;
+        }
+        var result = g(1) + g(2) + g(3) + g(4);
+        result = result + n(1, 2) + n(2, 2) + n(3, 1) + n(0, -1);
+        if (1 < 2 && !(3 == 4)) { result = result + 5; }
+        while (false) { result = 0; }
+    )";
+    Value result = executeProgram(code, "result");
+    ASSERT_TRUE(result.isInt());
+    ASSERT_EQ(result.asInt(), 10 + 20 + 30 + 40 + 1101 + 1110 + 111 + 1011 + 5);
+}
+
+TEST(optimizer_keeps_runtime_error_lines)
+{
+    VM vm;
+    std::string code = "var a = 1 + 2;\nif (false) { a = 0; }\nvar b = a + nil;\n";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+}
+
+// ============================================
+// TESTES DO MIDDLE END SSA (-O)
+// ============================================
+
+static Value executeOptimized(const std::string &code, const std::string &varName,
+                              bool optimize)
+{
+    VM vm;
+    vm.setOptimize(optimize);
+    if (vm.interpret(code) != InterpretResult::OK)
+        throw std::runtime_error("Runtime error: " + code);
+    vm.GetGlobal(varName.c_str());
+    return vm.Pop();
+}
+
+// A referência é o interpretador sem JIT; register, JIT e -O têm de dar
+// o mesmo valor. Devolve o da referência.
+static Value assertSameInAllModes(const std::string &code, const std::string &varName)
+{
+    Value reference = executeWithJit(code, false, varName);
+    ASSERT_EQ(valueToString(executeProgram(code, varName, ExecutionMode::Register)),
+              valueToString(reference));
+    ASSERT_EQ(valueToString(executeWithJit(code, true, varName)), valueToString(reference));
+    ASSERT_EQ(valueToString(executeOptimized(code, varName, true)), valueToString(reference));
+    return reference;
+}
+
+TEST(ssa_keeps_program_results)
+{
+    // Loops com break/continue, elif, && e ||, trocas de locais (phis em
+    // ciclo), strings, tail calls, switch e globais escritos no loop
+    assertSameInAllModes(R"(
+        def fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        def br(x) {
+            var c = 0;
+            if (x > 2 && x < 10) { c = 1; } elif (x == 0 || x == 1) { c = 2; } else { c = 3; }
+            return c;
+        }
+        def w(n) {
+            var i = 0;
+            var t = 0;
+            while (true) {
+                i = i + 1;
+                if (i > n) { break; }
+                if (i % 2 == 0) { continue; }
+                t = t + i;
+            }
+            return t;
+        }
+        def rot(n) {
+            var a = 1; var b = 2; var c = 3;
+            for (var i = 0; i < n; i++) { var t = a; a = b; b = c; c = t; }
+            return a * 100 + b * 10 + c;
+        }
+        def tc(n, acc) { if (n == 0) { return acc; } return tc(n - 1, acc + n); }
+        def strs(n) { var s = ""; for (var i = 0; i < n; i++) { s = s + str(i); } return len(s); }
+        def sel(x) { var r = 0; switch (x) { case 1: r = 10; case 2: r = 20; default: r = 30; } return r; }
+        var g = 0;
+        def sg(n) { for (var i = 0; i < n; i++) { g = g + i; } return g; }
+        var result = fib(15) + br(5) + br(1) + br(20) + w(9) + rot(4) + rot(5) + tc(100, 0);
+        result = result + strs(12) + sel(1) + sel(2) + sel(9) + sg(5) + sg(5);
+    )", "result");
+
+    assertSameInAllModes(R"(
+        def dbl(x) { var y = x / 2; var z = -y; return abs(z) + sqrt(16) + pow(2, 3); }
+        def mixed(a) { var x = 1; if (a) { x = 2; } var y = x; return y * 3; }
+        def ne(a, b) { return a != b && !(a == 0); }
+        var result = dbl(8) + mixed(true) + mixed(false);
+        if (ne(1, 2)) { result = result + 1; }
+    )", "result");
+}
+
+TEST(ssa_propagates_constants_through_locals)
+{
+    VM vm;
+    vm.setOptimize(true);
+    std::string code = R"(
+        def f() { var a = 2; var b = a * 3; if (b > 5) { b = b + 1; } else { b = 0; } return b; }
+        var r = f();
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    const Chunk &f = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_EQ(f.count(), (size_t)4);
+    ASSERT_EQ(f.code[0], OP_PUSH_INT);
+    ASSERT_EQ(immediateAt(f, 0), 7);
+}
+
+TEST(ssa_hoists_invariant_global_loads)
+{
+    VM vm;
+    vm.setOptimize(true);
+    std::string code = R"(
+        var limit = 50;
+        def lic() {
+            var s = 0;
+            var i = 0;
+            while (i < limit) { s = s + limit; i = i + 1; }
+            return s;
+        }
+        var result = lic();
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 2500);
+
+    // Uma só leitura de 'limit', antes do início do loop
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("lic"))->chunk;
+    int loads = 0;
+    int load = -1;
+    int header = -1;
+    StackInstruction info;
+    for (int offset = 0; offset < (int)chunk.count(); offset += info.length)
+    {
+        ASSERT_TRUE(Verifier::decode(chunk, offset, info));
+        if (chunk.code[offset] == OP_GET_GLOBAL)
+        {
+            loads++;
+            load = offset;
+        }
+        if (chunk.code[offset] == OP_LOOP)
+            header = info.jumpTarget;
+    }
+    ASSERT_EQ(loads, 1);
+    ASSERT_TRUE(header > load);
+}
+
+TEST(ssa_keeps_runtime_errors)
+{
+    // A leitura no corpo de um loop que não corre não pode subir
+    std::string code = R"(
+        def body(n) { var s = 0; while (s < n) { s = s + missing; } return s; }
+        var result = body(0);
+    )";
+    assertSameInAllModes(code, "result");
+
+    VM vm;
+    vm.setOptimize(true);
+    ASSERT_TRUE(vm.interpret(code + "result = body(1);") == InterpretResult::RUNTIME_ERROR);
+
+    VM other;
+    other.setOptimize(true);
+    std::string dead = "def f(a) { var x = a * nil; return 1; }\nvar result = f(2);\n";
+    ASSERT_TRUE(other.interpret(dead) == InterpretResult::RUNTIME_ERROR);
+}
+
+// ============================================
+// TESTES DE OPERANDOS LARGOS
+// ============================================
+
+TEST(wide_constants_past_256)
+{
+    // 400 constantes distintas numa função e no script
+    std::string sum;
+    for (int i = 0; i < 400; i++)
+        sum += (i ? " + " : "") + std::to_string(i) + ".5";
+    std::string code = "def f() { return " + sum + "; }\n"
+                       "var a = " + sum + ";\n"
+                       "var result = a + f();\n";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asDouble(), 160000.0);
+
+    StringPool &pool = StringPool::instance();
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("f"))->chunk, OP_CONSTANT_LONG));
+}
+
+TEST(wide_locals_past_256)
+{
+    std::string code = "def f() {\n";
+    for (int i = 0; i < 300; i++)
+        code += "var v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    code += R"(
+            v299++;
+            ++v298;
+            v297 += 5;
+            --v296;
+            var s = 0;
+            for (var i = 0; i < 3; i++) { s = s + v299 + i; }
+            switch (v0) { case 0: s = s + 1; default: s = s + 100; }
+            return v0 + v1 + v296 + v297 + v298 + v299 + s;
+        }
+        var result = f();
+    )";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 2101);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_GET_LOCAL_LONG));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_SET_LOCAL_LONG));
+}
+
+TEST(wide_jumps_over_64kb)
+{
+    std::string body;
+    for (int i = 0; i < 10000; i++)
+        body += "g = g + 1;\n";
+    std::string code = R"(
+        var g = 0;
+        def f(x) {
+            var i = 0;
+            while (i < 3) {
+                i = i + 1;
+                if (x > i) {
+    )" + body + R"(
+                } else { g = g - 1; }
+            }
+            return g;
+        }
+        var result = f(2);
+    )";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 9998);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_LOOP_LONG));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_FALSE_LONG) || chunkHasOp(chunk, OP_JUMP_IF_TRUE_LONG) ||
+                chunkHasOp(chunk, OP_POP_JUMP_IF_FALSE_LONG));
+}
+
+TEST(wide_forms_only_when_needed)
+{
+    VM vm;
+    std::string code = R"(
+        def f(n) {
+            var t = 0;
+            for (var i = 0; i < n; i++) { if (i % 2 == 0) { t = t + 3; } }
+            return t;
+        }
+        var result = f(10);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    const uint8_t wide[] = {OP_CONSTANT_LONG, OP_GET_LOCAL_LONG, OP_SET_LOCAL_LONG,
+                            OP_JUMP_LONG, OP_JUMP_IF_FALSE_LONG, OP_JUMP_IF_TRUE_LONG,
+                            OP_POP_JUMP_IF_FALSE_LONG, OP_LOOP_LONG,
+                            OP_FOR_PREP_LONG, OP_FOR_LOOP_LONG};
+    for (uint8_t op : wide)
+        ASSERT_FALSE(chunkHasOp(chunk, op));
+}
+
+// ============================================
+// TESTES DA POOL DE CONSTANTES
+// ============================================
+
+TEST(constants_deduplicated_per_function)
+{
+    VM vm;
+    std::string code = R"(
+        def f(a) { return a * 7 + a * 7 + a * 7 + 7; }
+        def g(a) { return a + 1 + 1.0 + 1 + 1.0; }
+        def h(s) { return s + "ab" + "ab" + "ab"; }
+        var result = f(1) + g(1) + len(h(""));
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asDouble(), 28.0 + 5.0 + 6.0);
+
+    StringPool &pool = StringPool::instance();
+    ASSERT_EQ((int)vm.getFunction(pool.intern("f"))->chunk.constants.size(), 1);
+    // 1 e 1.0 continuam a ser constantes diferentes
+    ASSERT_EQ((int)vm.getFunction(pool.intern("g"))->chunk.constants.size(), 2);
+    ASSERT_EQ((int)vm.getFunction(pool.intern("h"))->chunk.constants.size(), 1);
+}
+
+TEST(constants_repeated_past_256_stay_narrow)
+{
+    std::string sum = "x";
+    for (int i = 0; i < 600; i++)
+        sum += " + 3";
+    std::string code = "def f(x) { return " + sum + "; }\n"
+                       "var result = f(0);\n";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 1800);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_FALSE(chunkHasOp(chunk, OP_CONSTANT_LONG));
+    ASSERT_EQ((int)chunk.constants.size(), 1);
+}
+
+TEST(constants_shared_across_module)
+{
+    std::string code = R"(
+        def a(n) { return n * 3 + len("shared"); }
+        def b(n) { return n * 3 - len("shared"); }
+        def c(n) { return a(n) + b(n) + 0.5; }
+        var result = c(10);
+    )";
+    VM vm;
+    vm.setShareConstants(true);
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asDouble(), 60.5);
+
+    StringPool &pool = StringPool::instance();
+    const ConstantTable &ka = vm.getFunction(pool.intern("a"))->chunk.constants;
+    const ConstantTable &kb = vm.getFunction(pool.intern("b"))->chunk.constants;
+    const ConstantTable &kc = vm.getFunction(pool.intern("c"))->chunk.constants;
+    ASSERT_TRUE(ka.isSharedWith(kb));
+    ASSERT_TRUE(ka.isSharedWith(kc));
+    ASSERT_EQ(ka.find(Value::makeInt(3)), kb.find(Value::makeInt(3)));
+
+    // Cada interpret é um módulo novo, com a sua tabela
+    VM other;
+    ASSERT_TRUE(other.interpret(code) == InterpretResult::OK);
+    ASSERT_FALSE(other.getFunction(pool.intern("a"))->chunk.constants.isSharedWith(
+        other.getFunction(pool.intern("b"))->chunk.constants));
+}
+
+// ============================================
+// TESTES DA TABELA DE LINHAS
+// ============================================
+
+TEST(line_table_runs_and_lookup)
+{
+    LineTable lines;
+    for (int i = 0; i < 5; i++)
+        lines.add(1);
+    for (int i = 0; i < 3; i++)
+        lines.add(4);
+    lines.add(2);
+    lines.add(4);
+
+    ASSERT_EQ((int)lines.size(), 10);
+    ASSERT_EQ((int)lines.runCount(), 4);
+    ASSERT_EQ(lines.lineAt(0), 1);
+    ASSERT_EQ(lines.lineAt(4), 1);
+    ASSERT_EQ(lines.lineAt(5), 4);
+    ASSERT_EQ(lines.lineAt(7), 4);
+    ASSERT_EQ(lines.lineAt(8), 2);
+    ASSERT_EQ(lines.lineAt(9), 4);
+
+    // Cortar a meio de um run e voltar a escrever
+    lines.truncate(6);
+    ASSERT_EQ((int)lines.size(), 6);
+    ASSERT_EQ((int)lines.runCount(), 2);
+    lines.add(9);
+    ASSERT_EQ(lines.lineAt(5), 4);
+    ASSERT_EQ(lines.lineAt(6), 9);
+    lines.truncate(5);
+    ASSERT_EQ((int)lines.runCount(), 1);
+}
+
+TEST(line_table_one_run_per_line)
+{
+    VM vm;
+    std::string code = "def f(a, b) {\n"
+                       "    var c = a * b + a - b;\n"
+                       "    var d = c * c + 1;\n"
+                       "    return c + d;\n"
+                       "}\n"
+                       "var r = f(2, 3);\n";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    const Chunk &f = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_EQ(f.lines.size(), f.code.size());
+    ASSERT_TRUE(f.lines.runCount() <= 4);
+    ASSERT_EQ(f.lines.lineAt(0), 2);
+    ASSERT_EQ(f.lines.lineAt(f.code.size() - 1), 4);
+}
+
+// ============================================
+// TESTES DE IMEDIATOS
+// ============================================
+
+TEST(immediates_replace_small_constants)
+{
+    VM vm;
+    std::string code = R"(
+        def count(n) {
+            var c = 0;
+            var i = 0;
+            while (i < 100) { c += 1; if (c == 50) { c -= 1; } i++; }
+            return c + n - 300;
+        }
+        var r = count(1);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("count"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_PUSH_INT));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_LESS_IMM));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_EQUAL_IMM));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_SUBTRACT_IMM));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_INC_LOCAL));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_DEC_LOCAL));
+    ASSERT_FALSE(chunkHasOp(chunk, OP_CONSTANT));
+}
+
+// ============================================
+// TESTES DE CONDIÇÕES
+// ============================================
+
+TEST(conditions_compare_directly)
+{
+    VM vm;
+    std::string code = R"(
+        def le(a, b) { return a <= b; }
+        def ge(a, b) { return a >= b; }
+        def ne(a, b) { return a != b; }
+        var r = 0;
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    StringPool &pool = StringPool::instance();
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("le"))->chunk, OP_LESS_EQUAL));
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("ge"))->chunk, OP_GREATER_EQUAL));
+    ASSERT_TRUE(chunkHasOp(vm.getFunction(pool.intern("ne"))->chunk, OP_NOT_EQUAL));
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("le"))->chunk, OP_NOT));
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("ge"))->chunk, OP_NOT));
+}
+
+TEST(conditions_branch_without_pop)
+{
+    VM vm;
+    std::string code = R"(
+        def f(n, m) {
+            var t = 0;
+            while (t <= n) { t = t + 1; }
+            if (t != m) { t = t * 2; }
+            if (t >= 100) { t = 0; }
+            if (t) { t = t + 1; }
+            return t;
+        }
+        var r = f(3, 5);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("r");
+    ASSERT_EQ(vm.Pop().asInt(), 9);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_LESS_EQUAL));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_EQUAL));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_GREATER_EQUAL_IMM));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_POP_JUMP_IF_FALSE));
+    ASSERT_FALSE(chunkHasOp(chunk, OP_JUMP_IF_FALSE));
+}
+
+TEST(conditions_and_chain_fused)
+{
+    VM vm;
+    std::string code = R"(
+        def inside(x, lo, hi) {
+            if (x >= lo && x < hi) { return 1; }
+            return 0;
+        }
+        var r = inside(5, 0, 10) + inside(10, 0, 10) + inside(-1, 0, 10);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("r");
+    ASSERT_EQ(vm.Pop().asInt(), 1);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("inside"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_GREATER_EQUAL));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_JUMP_IF_NOT_LESS));
+    ASSERT_FALSE(chunkHasOp(chunk, OP_JUMP_IF_FALSE));
+    ASSERT_FALSE(chunkHasOp(chunk, OP_POP));
+}
+
+// ============================================
+// TESTES DO FOR NUMÉRICO
+// ============================================
+
+TEST(for_numeric_emits_prep_and_loop)
+{
+    VM vm;
+    std::string code = R"(
+        def up(n) { var s = 0; for (var i = 0; i < n; i++) { s = s + i; } return s; }
+        def down() { var s = 0; for (var i = 10; i >= 0; i -= 2) { s = s + i; } return s; }
+        def steps() { var s = 0; for (var i = 1; i <= 100; i += 7) { s = s + 1; } return s; }
+        def odd(n) { var s = 0; for (var i = 0; i < n; i = i * 2 + 1) { s = s + i; } return s; }
+        var result = up(5) + down() + steps() + odd(20);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 10 + 30 + 15 + 26);
+
+    StringPool &pool = StringPool::instance();
+    for (const char *name : {"up", "down", "steps"})
+    {
+        const Chunk &chunk = vm.getFunction(pool.intern(name))->chunk;
+        ASSERT_TRUE(chunkHasOp(chunk, OP_FOR_PREP));
+        ASSERT_TRUE(chunkHasOp(chunk, OP_FOR_LOOP));
+        ASSERT_FALSE(chunkHasOp(chunk, OP_LOOP));
+        ASSERT_FALSE(chunkHasOp(chunk, OP_INC_LOCAL));
+    }
+
+    // Incremento que não é uma soma constante: fica o for genérico
+    const Chunk &odd = vm.getFunction(pool.intern("odd"))->chunk;
+    ASSERT_FALSE(chunkHasOp(odd, OP_FOR_PREP));
+    ASSERT_TRUE(chunkHasOp(odd, OP_LOOP));
+}
+
+TEST(for_numeric_wide_body)
+{
+    std::string body;
+    for (int i = 0; i < 8000; i++)
+        body += "g = g + 1;\n";
+    std::string code = R"(
+        var g = 0;
+        def f(n) {
+            for (var i = 0; i < n; i++) {
+    )" + body + R"(
+            }
+            return g;
+        }
+        var result = f(3);
+    )";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 24000);
+
+    const Chunk &chunk = vm.getFunction(StringPool::instance().intern("f"))->chunk;
+    ASSERT_TRUE(chunkHasOp(chunk, OP_FOR_PREP_LONG));
+    ASSERT_TRUE(chunkHasOp(chunk, OP_FOR_LOOP_LONG));
+}
+
+// ============================================
+// TESTES DOS OPCODES ESPECIALIZADOS
+// ============================================
+
+TEST(specialized_ops_match_generic_semantics)
+{
+    // Imediatos, condições fundidas e o for numérico: operandos fora do
+    // caso rápido (doubles, strings, nil, limites grandes) e loops quentes
+    // o bastante para o JIT e o tracer
+    struct Program
+    {
+        const char *code;
+        int expected;
+    };
+    std::vector<Program> programs = {
+        {R"(
+            def step(x) { x += 1; x -= 2; return x; }
+            def small(x) { if (x < 3) { return 1; } return 0; }
+            def same(x) { if (x == 2) { return 1; } return 0; }
+            var result = 0;
+            if (step(0.5) == -0.5) { result = result + 1; }
+            if (small(2.5) + small(3.5) + small(-40000) == 2) { result = result + 1; }
+            if (same(2.0) + same("2") + same(2) == 1) { result = result + 1; }
+            var big = 40000;
+            var neg = -32768;
+            if (big + 1 == 40001 && neg - 1 == -32769) { result = result + 1; }
+        )", 4},
+        {R"(
+            var result = 0;
+            if (1 <= 1.5 && 2.5 >= 2 && 2 >= 2) { result = result + 1; }
+            if (1 != 1.0 && "a" != "b" && nil != false) { result = result + 1; }
+            if (!(nil != nil) && !("a" != "a")) { result = result + 1; }
+            var n = nil;
+            if (n != 3) { result = result + 1; }
+            var x = 0.5;
+            while (x <= 3) { x = x + 1; }
+            if (x == 3.5) { result = result + 1; }
+            var t = 0;
+            for (var i = 10; i >= 0; i--) { if (i != 5) { t = t + 1; } }
+            if (t == 10) { result = result + 1; }
+        )", 6},
+        {R"(
+            var result = 0;
+            var t = 0;
+            for (var i = 0; i < 10; i++) { if (i == 3) continue; if (i == 7) break; t = t + i; }
+            if (t == 0 + 1 + 2 + 4 + 5 + 6) { result = result + 1; }
+            t = 0;
+            for (var i = 0.5; i < 3; i++) { t = t + i; }
+            if (t == 0.5 + 1.5 + 2.5) { result = result + 1; }
+            t = 0;
+            for (var i = 0; i <= 2.5; i++) { t = t + 1; }
+            if (t == 3) { result = result + 1; }
+            t = 0;
+            var n = 10;
+            for (var i = 0; i < n; i++) { n = n - 1; i = i + 1; t = t + 1; }
+            if (t == 4) { result = result + 1; }
+            t = 0;
+            for (var i = 5; i > 0; i--) { t = t * 10 + i; }
+            if (t == 54321) { result = result + 1; }
+            t = 0;
+            for (var i = 0; i < 0; i++) { t = 1; }
+            if (t == 0) { result = result + 1; }
+            var i = 100;
+            for (i = 0; i < 3; i++) { }
+            if (i == 3) { result = result + 1; }
+        )", 7},
+        {R"(
+            def walk(n, k) {
+                var t = 0;
+                for (var i = 0; i <= n; i++) {
+                    if (i > k && i != 400) { t += 2; } else { t -= 1; }
+                    if (i == 777) { t = t + 1000; }
+                    if (t <= 5) { t = t + 3; }
+                }
+                return t;
+            }
+            var result = walk(5000, 300);
+        )", 10405},
+        {R"(
+            def sum(n) {
+                var s = 0;
+                for (var i = 0; i < n; i++) {
+                    if (i % 3 == 0) continue;
+                    for (var j = n; j > i; j -= 250) { s += 1; }
+                    s = s + i;
+                }
+                return s;
+            }
+            var result = sum(2000);
+        )", 1338664},
+        {R"(
+            def few(p) {
+                var a = 0;
+                for (var i = 0; i < 1000; i += 1) {
+                    for (var j = 0; j < p; ++j) { if (j == i) break; a += j; }
+                }
+                return a;
+            }
+            var result = few(3) + few(1);
+        )", 2992},
+    };
+
+    for (const Program &program : programs)
+        ASSERT_EQ(assertSameInAllModes(program.code, "result").asInt(), program.expected);
+
+    for (const char *code : {"var s = \"a\"; var t = s - 1;",
+                             "var s = nil; if (s < 1) { s = 2; }",
+                             "var s = \"a\"; if (s <= 1) { s = 2; }",
+                             "for (var i = 0; i < \"a\"; i++) { }",
+                             "for (var i = 0; i < 3; i++) { i = nil; }"})
+    {
+        VM vm;
+        ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+    }
+}
+
+// ============================================
+// TESTES DO SWITCH
+
+// ============================================
+
+TEST(switch_emits_jump_table)
+{
+    VM vm;
+    std::string code = R"(
+        def route(op) {
+            var r = 0;
+            switch (op) {
+                case 0: r = 10;
+                case 1: r = 11;
+                case 2: r = 12;
+                case 4: r = 14;
+                case 5: r = 15;
+                case -1: r = 9;
+                default: r = -1;
+            }
+            return r;
+        }
+        def command(cmd) {
+            var r = 0;
+            switch (cmd) {
+                case "start": r = 1;
+                case "stop": r = 2;
+                case "pause": r = 3;
+            }
+            return r;
+        }
+        def sparse(x) {
+            switch (x) {
+                case 1: return 1;
+                case 1000: return 2;
+                case 70000: return 3;
+                case "x": return 4;
+            }
+            return 0;
+        }
+        def few(x) { var r = 0; switch (x) { case 1: r = 1; case 2: r = 2; } return r; }
+        def computed(x, y) {
+            var r = 0;
+            switch (x) { case 1: r = 1; case y: r = 2; case 3: r = 3; }
+            return r;
+        }
+        var result = route(0) + route(4) * 10 + route(3) * 100 + route(-1) * 1000 + route(9);
+        var strings = command("stop") * 10 + command("pause") + command("go") * 100;
+        var other = sparse(70000) * 100 + sparse("x") * 10 + sparse(2) + few(2) * 1000 +
+                    computed(5, 5) * 10000;
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 10 + 140 - 100 + 9000 - 1);
+    vm.GetGlobal("strings");
+    ASSERT_EQ(vm.Pop().asInt(), 23);
+    vm.GetGlobal("other");
+    ASSERT_EQ(vm.Pop().asInt(), 300 + 40 + 2000 + 20000);
+
+    // Com tabela a cadeia de testes fica inalcançável e sai
+    StringPool &pool = StringPool::instance();
+    for (const char *name : {"route", "command", "sparse"})
+    {
+        const Chunk &chunk = vm.getFunction(pool.intern(name))->chunk;
+        ASSERT_TRUE(chunkHasOp(chunk, OP_SWITCH));
+        ASSERT_FALSE(chunkHasOp(chunk, OP_JUMP_IF_NOT_EQUAL_IMM));
+        ASSERT_FALSE(chunkHasOp(chunk, OP_JUMP_IF_NOT_EQUAL));
+    }
+    const Chunk &route = vm.getFunction(pool.intern("route"))->chunk;
+    ASSERT_EQ((int)route.switches[0].dense.size(), 7);
+    ASSERT_EQ(route.switches[0].low, -1);
+    const Chunk &sparse = vm.getFunction(pool.intern("sparse"))->chunk;
+    ASSERT_EQ((int)sparse.switches[0].ints.size(), 3);
+    ASSERT_EQ((int)sparse.switches[0].strings.size(), 1);
+
+    // Poucos cases, ou um que não é literal: fica a cadeia
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("few"))->chunk, OP_SWITCH));
+    ASSERT_FALSE(chunkHasOp(vm.getFunction(pool.intern("computed"))->chunk, OP_SWITCH));
+}
+
+TEST(switch_table_keeps_chain_semantics)
+{
+    // default antes de cases (corre e continua nos testes seguintes),
+    // valores repetidos (ganha o primeiro), tipos que não são iguais
+    // (1.0 não é 1), strings feitas em runtime, break e continue de um
+    // loop dentro de um case
+    std::string code = R"(
+        def first(x) {
+            var r = 0;
+            switch (x) {
+                default: r = r + 1;
+                case 1: r = r + 10;
+                case 2: r = r + 100;
+                case 3: r = r + 1000;
+            }
+            return r;
+        }
+        def dup(x) {
+            var r = 0;
+            switch (x) { case 1: r = 1; case 2: r = 2; case 1: r = 3; case 3: r = 4; }
+            return r;
+        }
+        def typed(x) {
+            switch (x) { case 1: return 1; case 2: return 2; case "1": return 3; }
+            return 0;
+        }
+        var result = first(2) + first(7) * 10000 + dup(1) * 100000 + typed(1.0) * 1000000;
+        result = result + typed("" + "1") * 10000000;
+        var total = 0;
+        for (var i = 0; i < 10; i++) {
+            var a = i;
+            switch (i) {
+                case 0: continue;
+                case 1: total += 1;
+                case 2: total += 2;
+                case 8: break;
+                default: total += a * 100;
+            }
+            total += a * 1000;
+        }
+        result = result + total;
+    )";
+    // total: 1 + 2 + (3..7) * 100 + (1..7) * 1000
+    ASSERT_EQ(assertSameInAllModes(code, "result").asInt(),
+              101 + 1 * 10000 + 1 * 100000 + 3 * 10000000 + 30503);
+}
+
+TEST(switch_top_level_value_in_slot)
+{
+    // No script o valor também vai para um slot: nada de global temporário,
+    // e switches encadeados não se pisam
+    std::string code = R"(
+        var result = 0;
+        var i = 0;
+        while (i < 6) {
+            switch (i % 3) {
+                case 0:
+                    switch (i) { case 0: result += 1; case 3: result += 2; case 6: result += 4; }
+                case 1: result += 10;
+                case 2: result += 100;
+            }
+            i++;
+        }
+        switch ("b") { case "a": result = -1; case "b": result += 1000; case "c": result = -1; }
+    )";
+    VM vm;
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 3 + 20 + 200 + 1000);
+    ASSERT_EQ(executeWithJit(code, false).asInt(), 3 + 20 + 200 + 1000);
+}
+
+// ============================================
+// TESTES DE GLOBAIS
+// ============================================
+
+TEST(globals_share_slots_with_host_api)
+{
+    VM vm;
+    vm.PushInt(40);
+    vm.SetGlobal("base");
+
+    // O compiler reutiliza o slot criado pela API e vice-versa
+    ASSERT_TRUE(vm.interpret("var result = base + 2;") == InterpretResult::OK);
+    ASSERT_TRUE(vm.interpret("base = 1; result = result + base;") == InterpretResult::OK);
+
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 43);
+}
+
+static Value nativeDefineGlobals(VM *vm, int argCount, Value *args, void *userdata)
+{
+    int *next = (int *)userdata;
+    char name[32];
+    for (int i = 0; i < 64; i++)
+    {
+        snprintf(name, sizeof(name), "g%d", (*next)++);
+        vm->PushInt(i);
+        vm->SetGlobal(name);
+    }
+    return Value::makeNull();
+}
+
+TEST(globals_survive_slot_vector_growth)
+{
+    // Cada leitura/escrita indexa o slot de novo: o vetor pode crescer
+    // a meio do loop sem deixar nada a apontar para memória antiga
+    int next = 0;
+    VM vm;
+    vm.registerNative("grow", 0, nativeDefineGlobals, &next);
+    std::string code = R"(
+        var a = 1;
+        var b = 0;
+        for (var i = 0; i < 20; i++) {
+            grow();
+            b = b + a;
+            a = a + 1;
+        }
+        var result = b;
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 210);
+    vm.GetGlobal("g1279");
+    ASSERT_EQ(vm.Pop().asInt(), 63);
+}
+
+TEST(globals_undefined_slot_is_runtime_error)
+{
+    VM vm;
+    // 'later' já tem slot na leitura, mas só é definido depois
+    std::string code = R"(
+        def read() { return later; }
+        var result = read();
+        var later = 1;
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+}
+
+// ============================================
+// TESTES DO FORMATO REGISTER
+// ============================================
+
+TEST(register_code_generated_by_compiler)
+{
+    VM vm;
+    std::string code = R"(
+        def fib(n) {
+            if (n <= 1) { return n; }
+            return fib(n - 1) + fib(n - 2);
+        }
+        var result = fib(5);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+
+    Function *fib = vm.getFunction(StringPool::instance().intern("fib"));
+    ASSERT_TRUE(fib->hasRegisterCode());
+    ASSERT_TRUE(fib->regCount > fib->arity);
+}
+
+TEST(register_mode_matches_stack_mode)
+{
+    assertSameInAllModes(R"(
+        def fib(n) {
+            if (n <= 1) { return n; }
+            return fib(n - 1) + fib(n - 2);
+        }
+        var result = fib(15);
+    )", "result");
+
+    assertSameInAllModes(R"(
+        def iter(n) {
+            var a = 0;
+            var b = 1;
+            for (var i = 0; i < n; i++) {
+                var temp = a;
+                a = b;
+                b = temp + b;
+            }
+            return a;
+        }
+        var result = iter(30);
+    )", "result");
+
+    assertSameInAllModes(R"(
+        var result = "";
+        var i = 0;
+        while (true) {
+            i++;
+            if (i % 2 == 0) { continue; }
+            if (i > 9) { break; }
+            result = result + "x";
+        }
+    )", "result");
+
+    assertSameInAllModes(R"(
+        def pick(x) {
+            var r = 0;
+            switch (x) {
+                case 1: r = 10;
+                case 2: r = 20;
+                default: r = -1;
+            }
+            return r;
+        }
+        var result = pick(1) + pick(2) * 2 + pick(7) * 3;
+    )", "result");
+
+    assertSameInAllModes(R"(
+        def mix(a, b) {
+            var x = a;
+            x += b;
+            x -= 1;
+            var y = ++x;
+            var z = x--;
+            return (x * y + z) / 2.0 + sqrt(16.0);
+        }
+        var result = mix(3, 4);
+    )", "result");
+
+    assertSameInAllModes(R"(
+        def both(a, b) { return a && b || !a; }
+        var result = both(true, false) == both(false, true);
+    )", "result");
+}
+
+TEST(register_mode_runtime_error)
+{
+    VM vm;
+    vm.setExecutionMode(ExecutionMode::Register);
+    std::string code = R"(
+        def div(a, b) { return a / b; }
+        var result = div(1, 0);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::RUNTIME_ERROR);
+}
+
+TEST(register_mode_calls_stack_only_function)
+{
+    VM vm;
+    vm.setExecutionMode(ExecutionMode::Register);
+
+    // Montada à mão: não tem versão register, corre no loop de stack
+    Function *twice = new Function("twice", 1);
+    twice->chunk.write(OP_GET_LOCAL, 1);
+    twice->chunk.write(1, 1);
+    twice->chunk.write(OP_GET_LOCAL, 1);
+    twice->chunk.write(1, 1);
+    twice->chunk.write(OP_ADD, 1);
+    twice->chunk.write(OP_RETURN, 1);
+    vm.Push(Value::makeFunction(vm.registerFunction("twice", twice)));
+    vm.SetGlobal("twice");
+
+    std::string code = R"(
+        def f(n) { return twice(n) + 1; }
+        var result = f(20);
+    )";
+    ASSERT_TRUE(vm.interpret(code) == InterpretResult::OK);
+    vm.GetGlobal("result");
+    ASSERT_EQ(vm.Pop().asInt(), 41);
+}
+
 // ============================================
 // TESTES DE OPERADORES ARITMÉTICOS
 // ============================================
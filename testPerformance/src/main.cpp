@@ -9,9 +9,31 @@
 class Benchmark
 {
 public:
+    // Corre o mesmo código nos dois formatos (stack e register) e em
+    // stack com o JIT
     static void run(const std::string &name, const std::string &code, int iterations = 1)
+    {
+        double stackMs = time(code, iterations, ExecutionMode::Stack, false);
+        double registerMs = time(code, iterations, ExecutionMode::Register, false);
+        double jitMs = time(code, iterations, ExecutionMode::Stack, true);
+
+        std::cout << "┌─────────────────────────────────────┐\n";
+        std::cout << "│ " << name << "\n";
+        std::cout << "├─────────────────────────────────────┤\n";
+        std::cout << "│ Stack:    " << stackMs << " ms (avg " << stackMs / iterations << " ms)\n";
+        std::cout << "│ Register: " << registerMs << " ms (avg " << registerMs / iterations << " ms)\n";
+        std::cout << "│ Speedup:  " << stackMs / registerMs << "x\n";
+        std::cout << "│ JIT:      " << jitMs << " ms (" << stackMs / jitMs << "x vs stack)\n";
+        std::cout << "│ Iterations: " << iterations << "\n";
+        std::cout << "└─────────────────────────────────────┘\n\n";
+    }
+
+private:
+    static double time(const std::string &code, int iterations, ExecutionMode mode, bool jit)
     {
         VM vm;
+        vm.setExecutionMode(mode);
+        vm.setJitEnabled(jit);
 
         auto start = std::chrono::high_resolution_clock::now();
 
@@ -23,16 +45,7 @@ public:
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
-        double ms = duration.count() / 1000.0;
-        double avg_ms = ms / iterations;
-
-        std::cout << "┌─────────────────────────────────────┐\n";
-        std::cout << "│ " << name << "\n";
-        std::cout << "├─────────────────────────────────────┤\n";
-        std::cout << "│ Total:   " << ms << " ms\n";
-        std::cout << "│ Average: " << avg_ms << " ms\n";
-        std::cout << "│ Iterations: " << iterations << "\n";
-        std::cout << "└─────────────────────────────────────┘\n\n";
+        return duration.count() / 1000.0;
     }
 };
 